@@ -0,0 +1,8 @@
+// Per-frame data, mirrored by FrameUniforms in shader.h.
+layout (std140) uniform FrameData {
+    mat4 uView;
+    mat4 uProj;
+    vec4 uViewPos;
+    vec4 uClusterParams;   // near plane, slices per log depth, viewport width, height
+    ivec4 uClusterDims;    // clusters in x, y, z; light count
+};
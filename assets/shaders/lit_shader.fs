@@ -3,32 +3,54 @@ out vec4 FragColor;
 
 in vec3 vWorldPos;
 in vec3 vNormal;
+in vec3 vColor;
 
-uniform vec3 uLightPos;
-uniform vec3 uViewPos;
+#include "frame_data.glsl"
 
-uniform vec3 uObjectColor;
-uniform vec3 uLightColor;
+// clustered lights, see lightclusters.h
+uniform samplerBuffer uLights;          // position + radius, color + intensity
+uniform usamplerBuffer uClusterGrid;    // offset, count per cluster
+uniform usamplerBuffer uLightIndices;
 
 void main() {
     vec3 N = normalize(vNormal);
-    vec3 L = normalize(uLightPos - vWorldPos);
+    vec3 V = normalize(uViewPos.xyz - vWorldPos);
+
+    // the cluster this fragment falls in, as assigned on the CPU
+    float depth = -(uView * vec4(vWorldPos, 1.0)).z;
+    ivec3 cell = ivec3(ivec2(gl_FragCoord.xy / uClusterParams.zw * vec2(uClusterDims.xy)),
+                       int(log(max(depth, uClusterParams.x) / uClusterParams.x) * uClusterParams.y));
+    cell = clamp(cell, ivec3(0), uClusterDims.xyz - 1);
+    int cluster = (cell.z * uClusterDims.y + cell.y) * uClusterDims.x + cell.x;
+    uvec2 range = texelFetch(uClusterGrid, cluster).xy;
 
     // ambient
     float ambientStrength = 0.15;
-    vec3 ambient = ambientStrength * uLightColor;
+    vec3 light = vec3(ambientStrength);
+
+    for (uint i = 0u; i < range.y; ++i) {
+        int index = int(texelFetch(uLightIndices, int(range.x + i)).r);
+        vec4 positionRadius = texelFetch(uLights, 2 * index);
+        vec4 colorIntensity = texelFetch(uLights, 2 * index + 1);
+
+        vec3 toLight = positionRadius.xyz - vWorldPos;
+        float dist = length(toLight);
+        vec3 L = toLight / max(dist, 1e-4);
+        // smooth window reaching zero at the radius, nearly flat well inside it
+        float window = clamp(1.0 - pow(dist / positionRadius.w, 4.0), 0.0, 1.0);
+        vec3 radiance = colorIntensity.rgb * colorIntensity.a * window * window;
+
+        // diffuse
+        float diff = max(dot(N, L), 0.0);
 
-    // diffuse
-    float diff = max(dot(N, L), 0.0);
-    vec3 diffuse = diff * uLightColor;
+        // specular (Blinn-Phong)
+        vec3 H = normalize(L + V);
+        float spec = pow(max(dot(N, H), 0.0), 64.0);
+        float specStrength = 0.6;
 
-    // specular (Blinn-Phong)
-    vec3 V = normalize(uViewPos - vWorldPos);
-    vec3 H = normalize(L + V);
-    float spec = pow(max(dot(N, H), 0.0), 64.0);
-    float specStrength = 0.6;
-    vec3 specular = specStrength * spec * uLightColor;
+        light += (diff + specStrength * spec) * radiance;
+    }
 
-    vec3 color = (ambient + diffuse + specular) * uObjectColor;
+    vec3 color = light * vColor;
     FragColor = vec4(color, 1.0);
 }
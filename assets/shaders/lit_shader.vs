@@ -1,20 +1,24 @@
 #version 330 core
-layout (location=0) in vec3 aPos;
+layout (location=0) in vec4 aPos;   // packed when w = 0, see vertex_decode.glsl
 layout (location=1) in vec3 aNormal;
 
+#include "frame_data.glsl"
+#include "vertex_decode.glsl"
+
 uniform mat4 uModel;
-uniform mat4 uView;
-uniform mat4 uProj;
+uniform mat3 uNormalMatrix;   // inverse transpose of uModel, from the CPU
+uniform vec3 uObjectColor;
 
 out vec3 vWorldPos;
 out vec3 vNormal;
+out vec3 vColor;
 
 void main() {
-    vec4 world = uModel * vec4(aPos, 1.0);
+    vec4 world = uModel * vec4(aPos.xyz, 1.0);
     vWorldPos = world.xyz;
 
-    // correct normal transform
-    vNormal = mat3(transpose(inverse(uModel))) * aNormal;
+    vNormal = uNormalMatrix * decode_normal(aPos, aNormal);
+    vColor = uObjectColor;
 
     gl_Position = uProj * uView * world;
 }
@@ -0,0 +1,23 @@
+#version 330 core
+layout (location=0) in vec4 aPos;   // packed when w = 0, see vertex_decode.glsl
+layout (location=1) in vec3 aNormal;
+layout (location=3) in mat4 aModel;   // per instance, takes locations 3..6
+layout (location=7) in vec4 aColor;   // per instance
+layout (location=8) in mat3 aNormalMatrix;   // per instance, 8..10
+
+#include "frame_data.glsl"
+#include "vertex_decode.glsl"
+
+out vec3 vWorldPos;
+out vec3 vNormal;
+out vec3 vColor;
+
+void main() {
+    vec4 world = aModel * vec4(aPos.xyz, 1.0);
+    vWorldPos = world.xyz;
+
+    vNormal = aNormalMatrix * decode_normal(aPos, aNormal);
+    vColor = aColor.rgb;
+
+    gl_Position = uProj * uView * world;
+}
@@ -0,0 +1,32 @@
+#version 430 core
+layout (location=0) in vec4 aPos;   // packed when w = 0, see vertex_decode.glsl
+layout (location=1) in vec3 aNormal;
+layout (location=2) in uint aDrawId;   // per instance, equals the draw's baseInstance
+
+#include "frame_data.glsl"
+#include "vertex_decode.glsl"
+
+struct ObjectData {
+    mat4 model;
+    mat3 normalMatrix;   // inverse transpose of model, from the CPU
+    vec4 color;
+};
+
+layout (std430, binding=0) readonly buffer Objects {
+    ObjectData objects[];
+};
+
+out vec3 vWorldPos;
+out vec3 vNormal;
+out vec3 vColor;
+
+void main() {
+    ObjectData obj = objects[aDrawId];
+    vec4 world = obj.model * vec4(aPos.xyz, 1.0);
+    vWorldPos = world.xyz;
+
+    vNormal = obj.normalMatrix * decode_normal(aPos, aNormal);
+    vColor = obj.color.rgb;
+
+    gl_Position = uProj * uView * world;
+}
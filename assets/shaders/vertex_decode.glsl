@@ -0,0 +1,14 @@
+// Vertex attribute decoding, mirrored by vertexpack.h. Packed meshes give
+// unorm16 positions with w = 0, their box being folded into the model
+// matrix, and octahedral snorm16 normals. Float meshes give three position
+// components, so w reads as 1, and plain normals.
+vec3 oct_decode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+vec3 decode_normal(vec4 pos, vec3 normal) {
+    return pos.w == 0.0 ? oct_decode(normal.xy) : normal;
+}
@@ -0,0 +1,134 @@
+// Benchmark for the geometry arena's range allocator.
+//
+//   arenabench [--ops N] [--budget UNITS]
+//
+// Loads and unloads meshes of random sizes (default 200000 operations) the
+// way the arena does, growing by doubling when nothing fits, then compacts
+// the result with the same moves as geometryarena_defrag, at most --budget
+// units (default 65536) per frame. Live ranges and free blocks must tile the
+// capacity exactly after every phase.
+
+#include "benchutil.h"
+#include "rangealloc.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <vector>
+
+// Live ranges and free blocks must cover [0, capacity) once, and `used` must
+// be the live total.
+static bool check_tiling(const RangeAllocator *alloc, const std::map<uint32_t, uint32_t> &live) {
+    std::vector<std::pair<uint32_t, uint32_t>> spans(live.begin(), live.end());
+    spans.insert(spans.end(), alloc->freeByOffset.begin(), alloc->freeByOffset.end());
+    std::sort(spans.begin(), spans.end());
+    uint32_t end = 0;
+    uint64_t used = 0;
+    for (const auto &s : spans) {
+        if (s.first != end) return false;
+        end = s.first + s.second;
+    }
+    for (const auto &l : live) used += l.second;
+    return end == alloc->capacity && used == alloc->used && alloc->freeBySize.size() == alloc->freeByOffset.size();
+}
+
+static uint32_t alloc_growing(RangeAllocator *alloc, uint32_t size, int *grows) {
+    uint32_t offset = rangealloc_alloc(alloc, size);
+    if (offset != RANGE_NONE) return offset;
+    rangealloc_grow(alloc, std::max(alloc->capacity * 2, alloc->capacity + size));
+    ++*grows;
+    return rangealloc_alloc(alloc, size);
+}
+
+// One defragmentation step, as in geometryarena.cpp. Returns the units moved.
+static uint64_t defrag_step(RangeAllocator *alloc, std::map<uint32_t, uint32_t> *live, uint64_t budget) {
+    uint64_t moved = 0;
+    int skipped = 0;
+    auto it = live->end();
+    while (it != live->begin() && moved < budget && skipped < 16) {
+        --it;
+        const uint32_t from = it->first, size = it->second;
+        if (moved > 0 && moved + size > budget) break;
+        uint32_t to = rangealloc_alloc_below(alloc, size, from);
+        if (to == RANGE_NONE) {
+            ++skipped;
+            continue;
+        }
+        rangealloc_free(alloc, from, size);
+        it = live->erase(it);
+        (*live)[to] = size;
+        moved += size;
+    }
+    return moved;
+}
+
+int main(int argc, char **argv)
+{
+    long ops = 200000;
+    uint64_t budget = 65536;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--ops") == 0 && i + 1 < argc)
+            ops = std::max(1L, std::atol(argv[++i]));
+        else if (std::strcmp(argv[i], "--budget") == 0 && i + 1 < argc)
+            budget = std::max(1ULL, std::strtoull(argv[++i], nullptr, 10));
+    }
+
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<float> u(0.0f, 1.0f);
+    RangeAllocator alloc;
+    rangealloc_init(&alloc, 1u << 16);
+    std::map<uint32_t, uint32_t> live;   // offset -> size
+    std::vector<uint32_t> offsets;       // the same, for picking one at random
+    int grows = 0;
+    bool ok = true;
+
+    // drifts towards ~2000 live meshes of 64 to 64K units, log-uniform
+    double t0 = now_seconds();
+    for (long op = 0; op < ops; ++op) {
+        bool load = live.empty() || u(rng) < 2000.0f / (2000.0f + (float)live.size());
+        if (load) {
+            uint32_t size = (uint32_t)std::exp2(6.0f + u(rng) * 10.0f);
+            uint32_t offset = alloc_growing(&alloc, size, &grows);
+            live[offset] = size;
+            offsets.push_back(offset);
+        } else {
+            size_t i = std::min(offsets.size() - 1, (size_t)(u(rng) * offsets.size()));
+            auto it = live.find(offsets[i]);
+            rangealloc_free(&alloc, it->first, it->second);
+            live.erase(it);
+            offsets[i] = offsets.back();
+            offsets.pop_back();
+        }
+    }
+    double t1 = now_seconds();
+    ok = ok && check_tiling(&alloc, live);
+
+    std::printf("%ld operations in %.3f ms (%.0f ns each), %d grows\n",
+                ops, (t1 - t0) * 1000.0, (t1 - t0) * 1e9 / ops, grows);
+    std::printf("before compaction: %zu live, %.1f%% occupied, %zu free blocks, fragmentation %.1f%%\n",
+                live.size(), 100.0 * alloc.used / alloc.capacity, rangealloc_free_blocks(&alloc),
+                rangealloc_fragmentation(&alloc) * 100.0f);
+
+    int frames = 0;
+    uint64_t moved = 0, step, worst = 0;
+    double t2 = now_seconds();
+    while ((step = defrag_step(&alloc, &live, budget)) > 0) {
+        moved += step;
+        worst = std::max(worst, step);
+        ++frames;
+    }
+    double t3 = now_seconds();
+    ok = ok && check_tiling(&alloc, live);
+
+    std::printf("after compaction:  %zu free blocks, fragmentation %.1f%%, largest free %u of %u units\n",
+                rangealloc_free_blocks(&alloc), rangealloc_fragmentation(&alloc) * 100.0f,
+                rangealloc_largest_free(&alloc), alloc.capacity - alloc.used);
+    std::printf("%d frames, %llu units moved (at most %llu per frame), %.3f ms bookkeeping\n",
+                frames, (unsigned long long)moved, (unsigned long long)worst, (t3 - t2) * 1000.0);
+
+    return bench_exit(ok, "live ranges and free blocks do not tile the arena");
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+
+// Shared by the programs in bench/. Most of them check what they time
+// against a reference and finish with bench_exit, so a failed check is a
+// non-zero exit; CMakeLists.txt runs those under CTest with small sizes.
+
+inline double now_seconds() {
+    using clock = std::chrono::steady_clock;
+    return std::chrono::duration<double>(clock::now().time_since_epoch()).count();
+}
+
+// Exit status for main: 0 if `ok`, otherwise 1 after printing MISMATCH and
+// the printf style reason.
+inline int bench_exit(bool ok, const char *format, ...) {
+    if (ok) return 0;
+    std::printf("MISMATCH: ");
+    va_list args;
+    va_start(args, format);
+    std::vprintf(format, args);
+    va_end(args);
+    std::printf("\n");
+    return 1;
+}
@@ -0,0 +1,127 @@
+// Benchmark for clustered light assignment.
+//
+//   clusterbench [--lights N] [--frames N] [--threads N]
+//
+// Scatters N (default 4096) point lights through a scene volume, moves them
+// along circles and assigns them to clusters every frame, with one thread
+// and with a pool (default one thread per core, up to 8). Both runs must
+// produce identical lists, and for random points in the frustum every light
+// whose sphere contains the point must be listed in the point's cluster.
+
+#include "benchutil.h"
+#include "lightclusters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+struct Orbit
+{
+    glm::vec3 center;
+    float radius, speed, phase;
+};
+
+static void move_lights(std::vector<PointLight> *lights, const std::vector<Orbit> &orbits, float t) {
+    for (size_t i = 0; i < lights->size(); ++i) {
+        const Orbit &o = orbits[i];
+        float a = o.phase + o.speed * t;
+        glm::vec3 p = o.center + glm::vec3(std::cos(a), 0.0f, std::sin(a)) * o.radius;
+        (*lights)[i].positionRadius = glm::vec4(p, (*lights)[i].positionRadius.w);
+    }
+}
+
+// Every light containing a sample point has to be in the point's cluster.
+static size_t check_coverage(const LightClusters *clusters, const std::vector<PointLight> &lights,
+                             const glm::mat4 &view, const glm::mat4 &proj, std::mt19937 *rng) {
+    std::uniform_real_distribution<float> u(0.0f, 1.0f);
+    const glm::mat4 invView = glm::inverse(view);
+    size_t missing = 0;
+    for (int s = 0; s < 20000; ++s) {
+        float ndcX = u(*rng) * 2.0f - 1.0f, ndcY = u(*rng) * 2.0f - 1.0f;
+        float depth = clusters->nearClip * std::pow(clusters->farClip / clusters->nearClip, u(*rng));
+        glm::vec3 pv(ndcX * depth / proj[0][0], ndcY * depth / proj[1][1], -depth);
+        glm::vec3 pw = glm::vec3(invView * glm::vec4(pv, 1.0f));
+
+        int x = std::min(CLUSTER_X - 1, (int)((ndcX * 0.5f + 0.5f) * CLUSTER_X));
+        int y = std::min(CLUSTER_Y - 1, (int)((ndcY * 0.5f + 0.5f) * CLUSTER_Y));
+        int c = lightclusters_index(x, y, lightclusters_slice(clusters, depth));
+        const uint32_t *list = &clusters->indices[clusters->grid[2 * c]];
+        const uint32_t n = clusters->grid[2 * c + 1];
+        for (size_t i = 0; i < lights.size(); ++i) {
+            glm::vec3 d = glm::vec3(lights[i].positionRadius) - pw;
+            float r = lights[i].positionRadius.w * 0.999f;   // not on the boundary
+            if (glm::dot(d, d) < r * r && std::find(list, list + n, (uint32_t)i) == list + n)
+                ++missing;
+        }
+    }
+    return missing;
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = 4096;
+    int frames = 100;
+    int threads = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--lights") == 0 && i + 1 < argc)
+            count = (size_t)std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frames = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threads = std::atoi(argv[++i]);
+    }
+
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<float> pos(-40.0f, 40.0f);
+    std::uniform_real_distribution<float> u(0.0f, 1.0f);
+    std::vector<PointLight> lights(count);
+    std::vector<Orbit> orbits(count);
+    for (size_t i = 0; i < count; ++i) {
+        orbits[i] = Orbit{ glm::vec3(pos(rng), u(rng) * 6.0f, pos(rng)), 0.5f + u(rng) * 3.0f,
+                           0.5f + u(rng) * 2.0f, u(rng) * 6.2831853f };
+        lights[i].positionRadius = glm::vec4(0.0f, 0.0f, 0.0f, 0.5f + u(rng) * 2.5f);
+        lights[i].colorIntensity = glm::vec4(u(rng), u(rng), u(rng), 1.0f);
+    }
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 12.0f, 50.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    const float nearClip = 0.1f, farClip = 100.0f;
+    glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, nearClip, farClip);
+
+    LightClusters serial, parallel;
+    lightclusters_init(&serial, 1);
+    lightclusters_init(&parallel, threads);
+
+    double tSerial = 0.0, tParallel = 0.0;
+    size_t mismatched = 0, missing = 0;
+    for (int f = 0; f < frames; ++f) {
+        move_lights(&lights, orbits, f / 60.0f);
+        double t0 = now_seconds();
+        lightclusters_build(&serial, lights.data(), lights.size(), view, proj, nearClip, farClip);
+        double t1 = now_seconds();
+        lightclusters_build(&parallel, lights.data(), lights.size(), view, proj, nearClip, farClip);
+        double t2 = now_seconds();
+        tSerial += t1 - t0;
+        tParallel += t2 - t1;
+        if (serial.grid != parallel.grid || serial.indices != parallel.indices) ++mismatched;
+        if (f % 25 == 0) missing += check_coverage(&parallel, lights, view, proj, &rng);
+    }
+
+    const LightClusterStats &st = parallel.stats;
+    std::printf("%zu lights, %d visible, %d clusters: %d indices, at most %d per cluster%s\n",
+                count, st.visible, CLUSTER_COUNT, st.indices, st.maxPerCluster, st.truncated ? " (truncated)" : "");
+    std::printf("assignment: %.3f ms on 1 thread, %.3f ms on %d threads\n",
+                tSerial * 1000.0 / frames, tParallel * 1000.0 / frames, workerpool_size(&parallel.pool));
+
+    lightclusters_destroy(&serial);
+    lightclusters_destroy(&parallel);
+
+    return bench_exit(!mismatched && !missing,
+                      "%zu frames differ between thread counts, %zu lights missing from their clusters",
+                      mismatched, missing);
+}
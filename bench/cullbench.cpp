@@ -0,0 +1,85 @@
+// Benchmark for batch frustum culling.
+//
+//   cullbench [--boxes N]
+//
+// Scatters N (default one million) randomly rotated and scaled boxes around
+// a camera and culls them with the SIMD path and the one-at-a-time
+// reference. The visible sets must be identical.
+
+#include "benchutil.h"
+#include "culling.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/euler_angles.hpp>
+
+int main(int argc, char **argv)
+{
+    size_t count = 1000000;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--boxes") == 0 && i + 1 < argc)
+            count = (size_t)std::strtoull(argv[++i], nullptr, 10);
+    }
+
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<float> pos(-200.0f, 200.0f);
+    std::uniform_real_distribution<float> angle(-3.14159f, 3.14159f);
+    std::uniform_real_distribution<float> size(0.1f, 4.0f);
+
+    std::vector<CullBounds> bounds(count);
+    std::vector<glm::mat4> models(count);
+    std::vector<const glm::mat4*> modelPtrs(count);
+    for (size_t i = 0; i < count; ++i) {
+        glm::vec3 ext(size(rng), size(rng), size(rng));
+        glm::vec3 center(pos(rng) * 0.01f, pos(rng) * 0.01f, pos(rng) * 0.01f);
+        bounds[i].center = glm::vec4(center, glm::length(ext));
+        bounds[i].extent = glm::vec4(ext, 0.0f);
+        models[i] = glm::translate(glm::mat4(1.0f), glm::vec3(pos(rng), pos(rng), pos(rng))) *
+                    glm::eulerAngleXYZ(angle(rng), angle(rng), angle(rng)) *
+                    glm::scale(glm::mat4(1.0f), glm::vec3(size(rng)));
+        modelPtrs[i] = &models[i];
+    }
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 20.0f, 150.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 300.0f);
+    Frustum frustum;
+    frustum_from_matrix(&frustum, proj * view);
+
+    CullScratch scratch;
+    std::vector<uint32_t> visible, reference;
+    visible.reserve(count);
+    reference.reserve(count);
+
+    const int runs = 5;
+    double best = 1e30, bestReference = 1e30;
+    for (int r = 0; r < runs; ++r) {
+        visible.clear();
+        double t0 = now_seconds();
+        cull_frustum(&scratch, &frustum, bounds.data(), modelPtrs.data(), count, &visible);
+        best = std::min(best, now_seconds() - t0);
+
+        reference.clear();
+        t0 = now_seconds();
+        cull_frustum_reference(&frustum, bounds.data(), modelPtrs.data(), count, &reference);
+        bestReference = std::min(bestReference, now_seconds() - t0);
+    }
+
+#if defined(__AVX__)
+    const char *path = "SSE transform, AVX planes";
+#elif defined(__SSE__) || defined(_M_X64)
+    const char *path = "SSE";
+#else
+    const char *path = "scalar";
+#endif
+    std::printf("%zu boxes, %zu visible (%.1f%%)\n", count, visible.size(), 100.0 * visible.size() / count);
+    std::printf("  batched (%s)  %8.2f ms  %6.2f ns/box\n", path, best * 1000.0, best * 1e9 / count);
+    std::printf("  reference      %8.2f ms  %6.2f ns/box\n", bestReference * 1000.0, bestReference * 1e9 / count);
+
+    return bench_exit(visible == reference, "visible sets differ from the reference");
+}
@@ -0,0 +1,224 @@
+// Scaling benchmark for frame preparation on the job system.
+//
+//   frameprepbench [--objects N] [--frames N] [--threads N]
+//
+// Builds a city of N objects (default 250000): one root turning every
+// frame, districts of 64 groups below it, and each group a node with 15
+// children using one of three meshes with four LODs. Every frame then runs
+// the render queue's CPU stages from frameprep.h, the same code the viewer
+// runs before any GL call: update every transform, gather the drawable
+// objects, frustum cull them in slices, pick LODs and make sort keys, radix
+// sort, and write per-object data for the draws. This runs on 1, 2, 4 ...
+// up to --threads workers (default one per core), best frame of --frames
+// (default 20) each. The last frame must produce the same keys and
+// per-object data at every thread count.
+
+#include "benchutil.h"
+#include "frameprep.h"
+#include "jobsystem.h"
+#include "transforms.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+static const int MESHES = 3;
+static const int LODS = 4;
+
+struct BenchMesh
+{
+    CullBounds bounds;
+    MeshLod lods[LODS];
+    glm::mat4 dequantize;
+    bool packed;
+};
+
+// The parts of a RenderObj frame preparation reads.
+struct BenchObject
+{
+    NodeId node;
+    int mesh;   // -1 for a group
+    glm::vec3 color;
+    float lodErrorPixels;
+    float lodHysteresis;
+    int lodForce;
+    int lod;
+};
+
+struct FrameTimes
+{
+    double transforms, gather, cull, keys, sort, fill;
+    double total() const { return transforms + gather + cull + keys + sort + fill; }
+};
+
+static void prepare_frame(FramePrep *prep, std::vector<ObjectGPUData> *objectData, JobSystem *jobs,
+                          TransformHierarchy *h, std::vector<BenchObject> *objects, const BenchMesh *meshes,
+                          const glm::mat4 &view, const glm::mat4 &proj, FrameTimes *times) {
+    double t0 = now_seconds();
+    transforms_update(h, jobs);
+    double t1 = now_seconds();
+
+    frameprep_gather(prep, jobs, objects->size(), [&](size_t begin, size_t end) {
+        uint32_t n = 0;
+        for (size_t i = begin; i < end; ++i) n += (*objects)[i].mesh >= 0;
+        return n;
+    }, [&](size_t begin, size_t end, size_t k) {
+        for (size_t i = begin; i < end; ++i) {
+            BenchObject *o = &(*objects)[i];
+            if (o->mesh < 0) continue;
+            const BenchMesh &mesh = meshes[o->mesh];
+            prep->candidates[k] = (uint32_t)i;
+            prep->cullBounds[k] = mesh.bounds;
+            prep->cullModels[k] = &transforms_world(h, o->node);
+            PrepDraw &draw = prep->draws[k];
+            draw.node = o->node;
+            draw.state = (uint32_t)(1 + o->mesh % 2) << 16 | (uint32_t)o->mesh;
+            draw.mesh = (uint32_t)o->mesh;
+            draw.lods = mesh.lods;
+            draw.lodCount = LODS;
+            draw.dequantize = mesh.packed ? &mesh.dequantize : nullptr;
+            draw.color = o->color;
+            draw.lodErrorPixels = o->lodErrorPixels;
+            draw.lodHysteresis = o->lodHysteresis;
+            draw.lodForce = o->lodForce;
+            draw.lod = &o->lod;
+            ++k;
+        }
+    });
+    double t2 = now_seconds();
+
+    Frustum frustum;
+    frustum_from_matrix(&frustum, proj * view);
+    frameprep_cull(prep, jobs, &frustum);
+    double t3 = now_seconds();
+
+    frameprep_keys(prep, jobs, view, proj, 1080, 0.1f, 500.0f);
+    double t4 = now_seconds();
+
+    frameprep_sort(prep, jobs);
+    double t5 = now_seconds();
+
+    // stands in for the mapped buffer
+    objectData->resize(prep->items.size());
+    frameprep_fill(prep, jobs, h, objectData->data());
+    double t6 = now_seconds();
+
+    *times = FrameTimes{ t1 - t0, t2 - t1, t3 - t2, t4 - t3, t5 - t4, t6 - t5 };
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = 250000;
+    int frames = 20;
+    int maxThreads = (int)std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--objects") == 0 && i + 1 < argc)
+            count = (size_t)std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frames = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            maxThreads = std::max(1, std::atoi(argv[++i]));
+    }
+
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<float> u(0.0f, 1.0f);
+    BenchMesh meshes[MESHES];
+    for (int m = 0; m < MESHES; ++m) {
+        glm::vec3 ext(0.5f + u(rng), 0.5f + u(rng), 0.5f + u(rng));
+        meshes[m].bounds.center = glm::vec4(0.0f, ext.y, 0.0f, glm::length(ext));
+        meshes[m].bounds.extent = glm::vec4(ext, 0.0f);
+        for (int l = 0; l < LODS; ++l)
+            meshes[m].lods[l] = MeshLod{ 0, 0, l == 0 ? 0.0f : 0.002f * (float)(1 << (2 * l)) };
+        meshes[m].packed = m == MESHES - 1;
+        meshes[m].dequantize = glm::translate(glm::mat4(1.0f), -ext) * glm::scale(glm::mat4(1.0f), ext * 2.0f);
+    }
+
+    TransformHierarchy h;
+    transforms_clear(&h);
+    std::vector<BenchObject> objects;
+    objects.reserve(count);
+    NodeId city = transforms_add(&h, NODE_NONE, glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(1.0f));
+    objects.push_back(BenchObject{ city, -1, glm::vec3(1.0f), 1.0f, 0.25f, -1, 0 });
+    const int side = (int)std::ceil(std::sqrt(count / 16.0));
+    NodeId district = NODE_NONE;
+    for (size_t g = 0; objects.size() < count; ++g) {
+        if (g % 64 == 0) {
+            district = transforms_add(&h, city, glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(1.0f));
+            objects.push_back(BenchObject{ district, -1, glm::vec3(1.0f), 1.0f, 0.25f, -1, 0 });
+        }
+        glm::vec3 at((g % side - side * 0.5f) * 2.0f, 0.0f, (g / side - side * 0.5f) * 2.0f);
+        NodeId group = transforms_add(&h, district, at, glm::vec3(0.0f), glm::vec3(1.0f));
+        objects.push_back(BenchObject{ group, -1, glm::vec3(1.0f), 1.0f, 0.25f, -1, 0 });
+        for (int c = 0; c < 15; ++c) {
+            glm::vec3 local(u(rng) * 2.0f - 1.0f, u(rng) * 0.5f, u(rng) * 2.0f - 1.0f);
+            NodeId node = transforms_add(&h, group, local, glm::vec3(0.0f, u(rng) * 360.0f, 0.0f),
+                                         glm::vec3(0.05f + u(rng) * 0.1f));
+            objects.push_back(BenchObject{ node, (int)(u(rng) * MESHES) % MESHES, glm::vec3(u(rng), u(rng), u(rng)),
+                                           1.0f, 0.25f, -1, 0 });
+        }
+    }
+    count = objects.size();
+
+    const float extent = side * 1.0f;
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, extent * 0.3f, extent * 0.9f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, extent * 3.0f);
+
+    std::vector<int> threadCounts;
+    for (int t = 1; t < maxThreads; t *= 2) threadCounts.push_back(t);
+    threadCounts.push_back(maxThreads);
+
+    std::vector<uint64_t> referenceKeys;
+    std::vector<uint32_t> referenceItems;
+    std::vector<ObjectGPUData> referenceData;
+    double serial = 0.0;
+    int mismatches = 0;
+    std::printf("%zu objects, %d frames per run\n", count, frames);
+    std::printf("threads   transforms   gather     cull   lod/keys    sort    fill    total   speedup  steals\n");
+    for (int threads : threadCounts) {
+        JobSystem jobs;
+        jobsystem_start(&jobs, threads);
+        FramePrep prep;
+        std::vector<ObjectGPUData> objectData;
+        for (BenchObject &o : objects) o.lod = 0;   // LOD hysteresis carries over between frames
+        FrameTimes best = {};
+        double bestTotal = 1e30;
+        for (int frame = 0; frame < frames; ++frame) {
+            // the same angles at every thread count, so the last frames match
+            transforms_set_rotation(&h, city, glm::vec3(0.0f, frame * 0.5f, 0.0f));
+            FrameTimes t;
+            prepare_frame(&prep, &objectData, &jobs, &h, &objects, meshes, view, proj, &t);
+            if (t.total() < bestTotal) {
+                bestTotal = t.total();
+                best = t;
+            }
+        }
+        uint64_t steals = jobs.stolen;
+        jobsystem_stop(&jobs);
+
+        if (threads == 1) {
+            serial = bestTotal;
+            referenceKeys = prep.keys;
+            referenceItems = prep.items;
+            referenceData = objectData;
+        } else if (prep.keys != referenceKeys || prep.items != referenceItems ||
+                   objectData.size() != referenceData.size() ||
+                   std::memcmp(objectData.data(), referenceData.data(), objectData.size() * sizeof(ObjectGPUData)) != 0) {
+            std::printf("  %d threads: keys or per-object data differ from one thread\n", threads);
+            ++mismatches;
+        }
+        std::printf("%7d %12.3f %8.3f %8.3f %10.3f %7.3f %7.3f %8.3f %8.2fx %7llu\n", threads,
+                    best.transforms * 1000.0, best.gather * 1000.0, best.cull * 1000.0, best.keys * 1000.0,
+                    best.sort * 1000.0, best.fill * 1000.0, bestTotal * 1000.0, serial / bestTotal,
+                    (unsigned long long)steals);
+    }
+    std::printf("%zu visible, times in ms\n", referenceKeys.size());
+
+    return bench_exit(mismatches == 0, "%d thread counts differ from one thread", mismatches);
+}
@@ -0,0 +1,175 @@
+// Throughput benchmark for the OBJ loader.
+//
+//   objbench [--faces N] [file.obj ...]
+//
+// Parses each file (the bundled assets by default) repeatedly and reports
+// MB/s and faces/s, then does the same for a generated grid OBJ with about N
+// faces written to the temp directory. Each file also gets a mesh report:
+// vertex/index counts and ACMR before and after indexing and optimization,
+// triangles per LOD, the packed vertex size and error,
+// and a cold load through the mesh cache on a miss and on a hit.
+
+#include "benchutil.h"
+#include "mesh.h"
+#include "meshcache.h"
+#include "objloader.h"
+#include "vertexpack.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+static void report_mesh(const std::string &path) {
+    Mesh mesh;
+    MeshReport report;
+    double start = now_seconds();
+    mesh_load_obj(&mesh, path, &report);
+    double elapsed = now_seconds() - start;
+
+    std::printf("%-40s %10zu verts -> %8zu verts %10zu indices (%d-bit)   ACMR %.3f -> %.3f (flat 3.000) %9.3f ms\n",
+                path.c_str(), report.flatVertexCount, report.vertexCount, report.indexCount,
+                report.indexSize * 8, report.acmrBefore, report.acmrAfter, elapsed * 1000.0);
+    std::printf("%-40s LOD triangles:", "");
+    for (int i = 0; i < report.lodCount; ++i)
+        std::printf(" %zu", report.lodTriangles[i]);
+    std::printf("\n");
+
+    std::vector<PackedVertex> packed;
+    VertexPackError error;
+    bool accepted = vertexpack_pack(&packed, &mesh, &error);
+    std::printf("%-40s vertices %zu KB float, %zu KB packed%s: position error %.3g (%.4f of an edge), normals %.4f deg\n",
+                "", mesh.vertices.size() * sizeof(float) / 1024, packed.size() * sizeof(PackedVertex) / 1024,
+                accepted ? "" : " (rejected)", error.position, error.positionRatio, error.normalDegrees);
+}
+
+static void bench_cache(const std::string &path) {
+    std::error_code ec;
+    std::filesystem::remove(meshcache_path(path), ec);
+
+    MeshAsset asset;
+    bool hit = false;
+    double start = now_seconds();
+    bool ok = meshcache_load(&asset, path, MESH_COOK_PACK_VERTICES, &hit);
+    double missTime = now_seconds() - start;
+    meshcache_release(&asset);
+    if (!ok) return;
+
+    start = now_seconds();
+    meshcache_load(&asset, path, MESH_COOK_PACK_VERTICES, &hit);
+    double hitTime = now_seconds() - start;
+    meshcache_release(&asset);
+
+    std::printf("%-40s  source %9.3f ms   cached %9.3f ms%s   %6.1fx\n",
+                path.c_str(), missTime * 1000.0, hitTime * 1000.0,
+                hit ? "" : " (cache not written)", missTime / hitTime);
+}
+
+static void bench_file(const std::string &path) {
+    ObjStats stats{};
+    ObjData out;
+
+    // Warm the page cache, then run for at least half a second.
+    objloader_load(path, &out, &stats);
+    if (stats.bytes == 0) {
+        std::printf("%-40s  (empty or missing)\n", path.c_str());
+        return;
+    }
+
+    int runs = 0;
+    double start = now_seconds();
+    double elapsed = 0.0;
+    do {
+        objloader_load(path, &out, &stats);
+        ++runs;
+        elapsed = now_seconds() - start;
+    } while (elapsed < 0.5 || runs < 3);
+
+    double perRun = elapsed / runs;
+    double mb = (double)stats.bytes / (1024.0 * 1024.0);
+    std::printf("%-40s %10.2f MB %8d runs %9.3f ms %10.1f MB/s %14.0f faces/s\n",
+                path.c_str(), mb, runs, perRun * 1000.0, mb / perRun,
+                (double)stats.faceCount / perRun);
+}
+
+static std::string write_grid_obj(size_t faces) {
+    size_t side = 1;
+    while (side * side < faces) ++side;
+
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "objbench_grid.obj";
+    FILE *f = std::fopen(path.string().c_str(), "wb");
+    if (!f) {
+        std::fprintf(stderr, "Failed to create %s\n", path.string().c_str());
+        return {};
+    }
+
+    std::fprintf(f, "# generated %zux%zu grid\n", side, side);
+    for (size_t y = 0; y <= side; ++y) {
+        for (size_t x = 0; x <= side; ++x) {
+            float h = 0.05f * (float)((x * 7 + y * 13) % 17);
+            std::fprintf(f, "v %.6f %.6f %.6f\n", (float)x / side, h, (float)y / side);
+            std::fprintf(f, "vn 0.000000 1.000000 0.000000\n");
+        }
+    }
+
+    // Alternate the token forms the loader has to handle: one quad per cell,
+    // or two triangles with v/vt/vn and bare v corners.
+    size_t row = side + 1;
+    size_t written = 0;
+    for (size_t cell = 0; cell < side * side && written < faces; ++cell) {
+        size_t a = (cell / side) * row + (cell % side) + 1, b = a + 1, c = a + row + 1, d = a + row;
+        if (cell % 2) {
+            std::fprintf(f, "f %zu//%zu %zu//%zu %zu//%zu %zu//%zu\n", a, a, b, b, c, c, d, d);
+            written += 1;
+        } else {
+            std::fprintf(f, "f %zu/1/%zu %zu/1/%zu %zu/1/%zu\nf %zu %zu %zu\n", a, a, b, b, c, c, a, c, d);
+            written += 2;
+        }
+    }
+    std::fclose(f);
+    return path.string();
+}
+
+int main(int argc, char **argv) {
+    size_t faces = 1000000;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--faces") == 0 && i + 1 < argc)
+            faces = std::strtoull(argv[++i], nullptr, 10);
+        else
+            files.push_back(argv[i]);
+    }
+    if (files.empty()) {
+        files = {
+            "assets/models/Planet.obj",
+            "assets/models/funnything.obj",
+            "assets/models/buildings.obj",
+        };
+    }
+
+    std::string grid = write_grid_obj(faces);
+    if (!grid.empty())
+        files.push_back(grid);
+
+    std::printf("-- parse throughput\n");
+    for (const std::string &path : files)
+        bench_file(path);
+
+    std::printf("-- mesh report\n");
+    for (const std::string &path : files)
+        report_mesh(path);
+
+    std::printf("-- mesh cache\n");
+    for (const std::string &path : files)
+        bench_cache(path);
+
+    if (!grid.empty()) {
+        std::error_code ec;
+        std::filesystem::remove(meshcache_path(grid), ec);
+        std::filesystem::remove(grid, ec);
+    }
+    return 0;
+}
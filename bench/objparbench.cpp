@@ -0,0 +1,173 @@
+// Scaling benchmark for parallel OBJ parsing.
+//
+//   objparbench [--mb N] [--threads N] [file.obj ...]
+//
+// Parses each file (the bundled assets and a generated OBJ of about N MB by
+// default) serially and then with 1..N threads, at least 1..4 so the split
+// is checked on any machine. An explicit thread count splits the text even
+// when the chunks come out far below OBJ_PARALLEL_MIN_CHUNK_BYTES, so the
+// small bundled models are cut into several pieces too. Every parallel
+// result is compared byte for byte against the serial one, so this doubles
+// as the equivalence check for the chunked parser. The generated file mixes
+// positive and negative (relative) indices that reach back across chunk
+// boundaries.
+
+#include "benchutil.h"
+#include "mappedfile.h"
+#include "objloader.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+template <typename T>
+static bool same_bytes(const std::vector<T> &a, const std::vector<T> &b) {
+    return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+}
+
+static bool same_result(const ObjData &a, const ObjStats &sa, const ObjData &b, const ObjStats &sb) {
+    return same_bytes(a.positions, b.positions) && same_bytes(a.normals, b.normals) &&
+           a.corners.size() == b.corners.size() &&
+           (a.corners.empty() || std::memcmp(a.corners.data(), b.corners.data(), a.corners.size() * sizeof(ObjCorner)) == 0) &&
+           sa.positionCount == sb.positionCount && sa.normalCount == sb.normalCount &&
+           sa.faceCount == sb.faceCount && sa.triangleCount == sb.triangleCount;
+}
+
+static std::string write_random_obj(size_t megabytes) {
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "objparbench_random.obj";
+    FILE *f = std::fopen(path.string().c_str(), "wb");
+    if (!f) {
+        std::fprintf(stderr, "Failed to create %s\n", path.string().c_str());
+        return {};
+    }
+
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<float> coord(-100.0f, 100.0f);
+    std::uniform_int_distribution<int> pick(0, 99);
+
+    const size_t target = megabytes * 1024 * 1024;
+    size_t written = 0;
+    int vcount = 0, ncount = 0;
+
+    auto index = [&](int count) {
+        // mostly nearby vertices like a real exporter, some far back,
+        // half of them written as negative indices
+        int back = pick(rng) < 90 ? 1 + (int)(rng() % 64) : 1 + (int)(rng() % count);
+        if (back > count) back = count;
+        return pick(rng) < 50 ? -back : count - back + 1;
+    };
+
+    while (written < target) {
+        int r = pick(rng);
+        int n = 0;
+        if (r < 35 || vcount < 3) {
+            n = std::fprintf(f, "v %.6f %.6f %.6f\n", coord(rng), coord(rng), coord(rng));
+            ++vcount;
+        } else if (r < 50) {
+            n = std::fprintf(f, "vn %.5f %.5f %.5f%s\n", coord(rng) / 100, coord(rng) / 100, coord(rng) / 100,
+                             pick(rng) < 10 ? "\r" : "");
+            ++ncount;
+        } else if (r < 53) {
+            n = std::fprintf(f, "%s\n", pick(rng) < 50 ? "# comment" : "vt 0.5 0.5");
+        } else {
+            int corners = 3 + pick(rng) % 4;
+            n = std::fprintf(f, "f");
+            for (int i = 0; i < corners; ++i) {
+                int v = index(vcount);
+                if (ncount > 0 && pick(rng) < 60)
+                    n += std::fprintf(f, pick(rng) < 50 ? " %d//%d" : " %d/1/%d", v, index(ncount));
+                else
+                    n += std::fprintf(f, " %d", v);
+            }
+            n += std::fprintf(f, "\n");
+        }
+        written += (size_t)n;
+    }
+    std::fclose(f);
+    return path.string();
+}
+
+static bool bench_file(const std::string &path, int maxThreads) {
+    MappedFile file;
+    if (!mappedfile_open(&file, path)) {
+        std::printf("%s: cannot open\n", path.c_str());
+        return false;
+    }
+
+    ObjData reference;
+    ObjStats refStats{};
+    double serial = 1e30;
+    double start;
+    for (int run = 0; run < 3; ++run) {
+        start = now_seconds();
+        objloader_parse(file.data, file.size, &reference, &refStats);
+        double t = now_seconds() - start;
+        if (t < serial) serial = t;
+    }
+
+    double mb = (double)file.size / (1024.0 * 1024.0);
+    std::printf("%s: %.2f MB, %zu faces, serial %.3f ms\n", path.c_str(), mb, refStats.faceCount, serial * 1000.0);
+
+    bool ok = true;
+    ObjData out;
+    for (int threads = 1; threads <= std::max(maxThreads, 4); ++threads) {
+        ObjStats stats{};
+        double best = 1e30;
+        for (int run = 0; run < 3; ++run) {
+            start = now_seconds();
+            objloader_parse_parallel(file.data, file.size, &out, threads, &stats);
+            double t = now_seconds() - start;
+            if (t < best) best = t;
+        }
+        bool same = same_result(reference, refStats, out, stats);
+        ok = ok && same;
+        std::printf("  %2d threads %9.3f ms %9.1f MB/s  %5.2fx  %s\n",
+                    threads, best * 1000.0, mb / best, serial / best, same ? "identical" : "MISMATCH");
+    }
+
+    mappedfile_close(&file);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    size_t megabytes = 64;
+    int maxThreads = (int)std::thread::hardware_concurrency();
+    if (maxThreads < 1) maxThreads = 1;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--mb") == 0 && i + 1 < argc)
+            megabytes = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            maxThreads = std::atoi(argv[++i]);
+        else
+            files.push_back(argv[i]);
+    }
+
+    std::string generated;
+    if (files.empty()) {
+        files = {
+            "assets/models/Planet.obj",
+            "assets/models/funnything.obj",
+            "assets/models/buildings.obj",
+        };
+        generated = write_random_obj(megabytes);
+        if (!generated.empty())
+            files.push_back(generated);
+    }
+
+    bool ok = true;
+    for (const std::string &path : files)
+        ok = bench_file(path, maxThreads) && ok;
+
+    if (!generated.empty())
+        std::filesystem::remove(generated);
+
+    return bench_exit(ok, "parallel results differ from serial");
+}
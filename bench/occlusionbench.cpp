@@ -0,0 +1,192 @@
+// Benchmark for software occlusion culling.
+//
+//   occlusionbench [--blocks N] [--props N]
+//
+// Builds an N x N (default 24) city of box buildings and scatters small
+// props (default 20000) along the streets, then renders the buildings as
+// occluders from street level and tests every building and prop. The same
+// occluders are also rasterized into an exact per-pixel depth buffer; an
+// object the masked buffer hides must be hidden there too. Needs no GPU.
+
+#include "benchutil.h"
+#include "occlusion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+// Unit cube from -1 to 1, 12 triangles.
+static std::vector<glm::vec3> make_cube() {
+    static const int faces[6][4] = {
+        { 0, 2, 3, 1 }, { 4, 5, 7, 6 }, { 0, 1, 5, 4 },
+        { 2, 6, 7, 3 }, { 0, 4, 6, 2 }, { 1, 3, 7, 5 },
+    };
+    std::vector<glm::vec3> tris;
+    for (const int *f : faces) {
+        glm::vec3 c[4];
+        for (int k = 0; k < 4; ++k)
+            c[k] = glm::vec3(f[k] & 1 ? 1.0f : -1.0f, f[k] & 2 ? 1.0f : -1.0f, f[k] & 4 ? 1.0f : -1.0f);
+        tris.insert(tris.end(), { c[0], c[1], c[2], c[0], c[2], c[3] });
+    }
+    return tris;
+}
+
+struct ReferenceBuffer
+{
+    int width, height;
+    std::vector<float> depth;
+};
+
+// Plain per-pixel rasterizer: near-clipped, center sampled, exact depth.
+static void reference_triangle(ReferenceBuffer *ref, const glm::mat4 &mvp, const glm::vec3 *corners) {
+    glm::vec4 in[3], poly[4];
+    for (int c = 0; c < 3; ++c)
+        in[c] = mvp * glm::vec4(corners[c], 1.0f);
+    int n = 0;
+    for (int i = 0; i < 3; ++i) {
+        const glm::vec4 &a = in[i], &b = in[(i + 1) % 3];
+        float da = a.z + a.w, db = b.z + b.w;
+        if (da >= 0.0f) poly[n++] = a;
+        if ((da >= 0.0f) != (db >= 0.0f)) poly[n++] = a + (b - a) * (da / (da - db));
+    }
+    glm::vec3 s[4];
+    for (int i = 0; i < n; ++i)
+        s[i] = glm::vec3((poly[i].x / poly[i].w * 0.5f + 0.5f) * ref->width,
+                         (poly[i].y / poly[i].w * 0.5f + 0.5f) * ref->height,
+                         poly[i].z / poly[i].w * 0.5f + 0.5f);
+    for (int i = 2; i < n; ++i) {
+        glm::vec3 a = s[0], b = s[i - 1], c = s[i];
+        float area = (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+        if (!(std::fabs(area) > 1e-8f)) continue;
+        int x0 = std::max(0, (int)std::floor(std::min(std::min(a.x, b.x), c.x)));
+        int x1 = std::min(ref->width - 1, (int)std::ceil(std::max(std::max(a.x, b.x), c.x)));
+        int y0 = std::max(0, (int)std::floor(std::min(std::min(a.y, b.y), c.y)));
+        int y1 = std::min(ref->height - 1, (int)std::ceil(std::max(std::max(a.y, b.y), c.y)));
+        for (int y = y0; y <= y1; ++y)
+            for (int x = x0; x <= x1; ++x) {
+                float px = x + 0.5f, py = y + 0.5f;
+                float w0 = ((b.x - px) * (c.y - py) - (c.x - px) * (b.y - py)) / area;
+                float w1 = ((c.x - px) * (a.y - py) - (a.x - px) * (c.y - py)) / area;
+                float w2 = 1.0f - w0 - w1;
+                // a little generous so edge pixels can't disagree with the masked buffer
+                const float EPS = -1e-3f;
+                if (w0 < EPS || w1 < EPS || w2 < EPS) continue;
+                float z = std::min(1.0f, w0 * a.z + w1 * b.z + w2 * c.z);
+                float &d = ref->depth[(size_t)y * ref->width + x];
+                d = std::min(d, z);
+            }
+    }
+}
+
+static bool reference_visible(const ReferenceBuffer *ref, const glm::mat4 &viewProj,
+                              const CullBounds &bounds, const glm::mat4 &model) {
+    glm::mat4 mvp = viewProj * model;
+    float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, minZ = 1e30f;
+    for (int c = 0; c < 8; ++c) {
+        glm::vec3 p(c & 1 ? bounds.extent.x : -bounds.extent.x,
+                    c & 2 ? bounds.extent.y : -bounds.extent.y,
+                    c & 4 ? bounds.extent.z : -bounds.extent.z);
+        glm::vec4 clip = mvp * glm::vec4(glm::vec3(bounds.center) + p, 1.0f);
+        if (clip.z < -clip.w || clip.w <= 0.0f) return true;
+        minX = std::min(minX, (clip.x / clip.w * 0.5f + 0.5f) * ref->width);
+        maxX = std::max(maxX, (clip.x / clip.w * 0.5f + 0.5f) * ref->width);
+        minY = std::min(minY, (clip.y / clip.w * 0.5f + 0.5f) * ref->height);
+        maxY = std::max(maxY, (clip.y / clip.w * 0.5f + 0.5f) * ref->height);
+        minZ = std::min(minZ, clip.z / clip.w * 0.5f + 0.5f);
+    }
+    int x0 = std::max(0, (int)std::floor(minX)), x1 = std::min(ref->width - 1, (int)std::floor(maxX));
+    int y0 = std::max(0, (int)std::floor(minY)), y1 = std::min(ref->height - 1, (int)std::floor(maxY));
+    for (int y = y0; y <= y1; ++y)
+        for (int x = x0; x <= x1; ++x)
+            if (minZ <= ref->depth[(size_t)y * ref->width + x]) return true;
+    return false;
+}
+
+int main(int argc, char **argv)
+{
+    int blocks = 24;
+    size_t props = 20000;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--blocks") == 0 && i + 1 < argc)
+            blocks = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--props") == 0 && i + 1 < argc)
+            props = (size_t)std::strtoull(argv[++i], nullptr, 10);
+    }
+
+    const std::vector<glm::vec3> cube = make_cube();
+    const CullBounds cubeBounds = { glm::vec4(0.0f, 0.0f, 0.0f, std::sqrt(3.0f)), glm::vec4(1.0f, 1.0f, 1.0f, 0.0f) };
+
+    // buildings on a 12 unit grid with 4 unit streets, props on the streets
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<float> height(4.0f, 40.0f);
+    std::uniform_real_distribution<float> u(0.0f, 1.0f);
+    std::vector<glm::mat4> models;
+    const float half = blocks * 6.0f;
+    for (int z = 0; z < blocks; ++z)
+        for (int x = 0; x < blocks; ++x) {
+            float h = height(rng);
+            glm::vec3 center(x * 12.0f - half + 6.0f, h * 0.5f, z * 12.0f - half + 6.0f);
+            models.push_back(glm::translate(glm::mat4(1.0f), center) * glm::scale(glm::mat4(1.0f), glm::vec3(4.0f, h * 0.5f, 4.0f)));
+        }
+    const size_t buildings = models.size();
+    for (size_t i = 0; i < props; ++i) {
+        int street = (int)(u(rng) * blocks);
+        float along = u(rng) * 2.0f * half - half;
+        float across = street * 12.0f - half + (u(rng) * 3.0f - 1.5f);
+        glm::vec3 p = u(rng) < 0.5f ? glm::vec3(across, 0.5f, along) : glm::vec3(along, 0.5f, across);
+        models.push_back(glm::translate(glm::mat4(1.0f), p) * glm::scale(glm::mat4(1.0f), glm::vec3(0.5f)));
+    }
+
+    std::vector<Occluder> occluders(buildings);
+    for (size_t i = 0; i < buildings; ++i)
+        occluders[i] = Occluder{ cube.data(), cube.size() / 3, &models[i] };
+
+    glm::mat4 view = glm::lookAt(glm::vec3(-half + 12.0f, 1.7f, -half + 12.0f), glm::vec3(0.0f, 1.7f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+    glm::mat4 viewProj = proj * view;
+
+    OcclusionBuffer buffer;
+    occlusion_init(&buffer, 256, 144);
+
+    double tRaster = 1e30, tTest = 1e30;
+    std::vector<char> visible(models.size());
+    for (int run = 0; run < 5; ++run) {
+        occlusion_render(&buffer, viewProj, occluders.data(), occluders.size());
+        tRaster = std::min(tRaster, buffer.stats.rasterSeconds);
+        double t0 = now_seconds();
+        for (size_t i = 0; i < models.size(); ++i)
+            visible[i] = occlusion_test(&buffer, cubeBounds, models[i]);
+        tTest = std::min(tTest, now_seconds() - t0);
+    }
+
+    ReferenceBuffer ref;
+    ref.width = buffer.width;
+    ref.height = buffer.height;
+    ref.depth.assign((size_t)ref.width * ref.height, 1.0f);
+    for (size_t i = 0; i < buildings; ++i)
+        for (size_t t = 0; t < cube.size(); t += 3)
+            reference_triangle(&ref, viewProj * models[i], &cube[t]);
+
+    size_t hidden = 0, refHidden = 0, wrong = 0;
+    for (size_t i = 0; i < models.size(); ++i) {
+        bool refVisible = reference_visible(&ref, viewProj, cubeBounds, models[i]);
+        hidden += !visible[i];
+        refHidden += !refVisible;
+        if (!visible[i] && refVisible) ++wrong;
+    }
+
+    std::printf("%zu occluders (%d triangles rasterized) into %dx%d on %zu threads: %.3f ms\n",
+                buildings, buffer.stats.triangles, buffer.width, buffer.height,
+                (size_t)workerpool_size(&buffer.pool), tRaster * 1000.0);
+    std::printf("%zu objects tested in %.3f ms: %zu hidden, %zu hidden by the exact depth buffer\n",
+                models.size(), tTest * 1000.0, hidden, refHidden);
+    occlusion_destroy(&buffer);
+
+    return bench_exit(wrong == 0, "%zu objects hidden that the exact depth buffer shows", wrong);
+}
@@ -0,0 +1,176 @@
+// Ray throughput benchmark for the picking BVH.
+//
+//   raybench [--tris N] [--rays N]
+//
+// Builds a triangle BVH over a bumpy height field of about N triangles
+// (default one million) and casts N rays (default 200k) against it, then
+// against a two-level scene of 64 transformed instances of the same mesh.
+// A sample of the single-mesh rays is checked against brute force and the
+// two-level results against casting into every instance directly, once
+// after building the top level and again after moving half the instances
+// and refitting it.
+
+#include "benchutil.h"
+#include "raycast.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+static void make_height_field(size_t triangles, std::vector<float> *positions, std::vector<uint32_t> *indices) {
+    size_t n = (size_t)std::sqrt((double)triangles / 2.0) + 1;   // quads per side
+    positions->clear();
+    indices->clear();
+    for (size_t z = 0; z <= n; ++z)
+        for (size_t x = 0; x <= n; ++x) {
+            float fx = (float)x / n * 2.0f - 1.0f, fz = (float)z / n * 2.0f - 1.0f;
+            float y = 0.1f * std::sin(fx * 17.0f) * std::cos(fz * 13.0f) + 0.05f * std::sin((fx + fz) * 41.0f);
+            positions->insert(positions->end(), { fx, y, fz });
+        }
+    for (size_t z = 0; z < n; ++z)
+        for (size_t x = 0; x < n; ++x) {
+            uint32_t i = (uint32_t)(z * (n + 1) + x);
+            uint32_t r = i + (uint32_t)(n + 1);
+            indices->insert(indices->end(), { i, r, i + 1, i + 1, r, r + 1 });
+        }
+}
+
+static float brute_force(const std::vector<float> &p, const std::vector<uint32_t> &idx,
+                         const glm::vec3 &o, const glm::vec3 &d) {
+    // one-triangle BVHs share the exact intersection routine
+    float best = 1e30f;
+    for (size_t t = 0; t + 2 < idx.size(); t += 3) {
+        MeshBvh tri;
+        meshbvh_build(&tri, p.data(), 3 * sizeof(float), &idx[t], 4, 3);
+        RayHit hit;
+        hit.t = best;
+        if (meshbvh_raycast(&tri, o, d, &hit)) best = hit.t;
+    }
+    return best;
+}
+
+static bool close(float a, float b) {
+    return std::fabs(a - b) <= 1e-4f * std::fmax(1.0f, std::fabs(b));
+}
+
+int main(int argc, char **argv)
+{
+    size_t triangles = 1000000, rayCount = 200000;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--tris") == 0 && i + 1 < argc)
+            triangles = (size_t)std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--rays") == 0 && i + 1 < argc)
+            rayCount = (size_t)std::strtoull(argv[++i], nullptr, 10);
+    }
+
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    make_height_field(triangles, &positions, &indices);
+
+    MeshBvh mesh;
+    double t0 = now_seconds();
+    meshbvh_build(&mesh, positions.data(), 3 * sizeof(float), indices.data(), 4, indices.size());
+    double tBuild = now_seconds() - t0;
+    std::printf("mesh: %zu triangles, %zu nodes, built in %.1f ms\n",
+                indices.size() / 3, mesh.bvh.nodes.size(), tBuild * 1000.0);
+
+    // rays from above aimed at random points on the field
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<float> u(-1.0f, 1.0f);
+    std::vector<glm::vec3> origins(rayCount), dirs(rayCount);
+    for (size_t i = 0; i < rayCount; ++i) {
+        origins[i] = glm::vec3(u(rng) * 2.0f, 1.0f + u(rng) * 0.5f + 0.5f, u(rng) * 2.0f);
+        dirs[i] = glm::normalize(glm::vec3(u(rng) * 0.9f, 0.0f, u(rng) * 0.9f) - origins[i]);
+    }
+
+    std::vector<float> single(rayCount);
+    size_t hits = 0;
+    t0 = now_seconds();
+    for (size_t i = 0; i < rayCount; ++i) {
+        RayHit hit;
+        hit.t = 1e30f;
+        hits += meshbvh_raycast(&mesh, origins[i], dirs[i], &hit);
+        single[i] = hit.t;
+    }
+    double tSingle = now_seconds() - t0;
+    std::printf("  %zu rays, %zu hits: %.2f Mrays/s, %.2f us/ray\n",
+                rayCount, hits, rayCount / tSingle * 1e-6, tSingle * 1e6 / rayCount);
+
+    bool ok = true;
+    const size_t checked = std::min<size_t>(rayCount, 20);
+    for (size_t i = 0; i < checked; ++i)
+        if (!close(single[i], brute_force(positions, indices, origins[i], dirs[i]))) ok = false;
+
+    // two-level: 8x8 instances, rotated and scaled
+    SceneBvh scene;
+    for (int z = 0; z < 8; ++z)
+        for (int x = 0; x < 8; ++x) {
+            BvhInstance inst;
+            inst.mesh = &mesh;
+            inst.world = glm::translate(glm::mat4(1.0f), glm::vec3(x * 2.5f - 9.0f, 0.0f, z * 2.5f - 9.0f)) *
+                         glm::rotate(glm::mat4(1.0f), 0.3f * (x + z), glm::vec3(0.0f, 1.0f, 0.0f)) *
+                         glm::scale(glm::mat4(1.0f), glm::vec3(1.0f + 0.05f * x));
+            inst.invWorld = glm::inverse(inst.world);
+            inst.userId = (uint32_t)(z * 8 + x);
+            scene.instances.push_back(inst);
+        }
+    t0 = now_seconds();
+    scenebvh_build(&scene);
+    double tTop = now_seconds() - t0;
+
+    for (size_t i = 0; i < rayCount; ++i) {
+        origins[i] = glm::vec3(u(rng) * 10.0f, 3.0f, u(rng) * 10.0f);
+        dirs[i] = glm::normalize(glm::vec3(u(rng) * 10.0f, 0.0f, u(rng) * 10.0f) - origins[i]);
+    }
+    std::vector<RayHit> twoLevel(rayCount);
+    hits = 0;
+    t0 = now_seconds();
+    for (size_t i = 0; i < rayCount; ++i) {
+        twoLevel[i].t = 1e30f;
+        hits += scenebvh_raycast(&scene, origins[i], dirs[i], &twoLevel[i]);
+    }
+    double tTwo = now_seconds() - t0;
+    std::printf("scene: %zu instances, %zu triangles, top level built in %.3f ms\n",
+                scene.instances.size(), scene.instances.size() * indices.size() / 3, tTop * 1000.0);
+    std::printf("  %zu rays, %zu hits: %.2f Mrays/s, %.2f us/ray\n",
+                rayCount, hits, rayCount / tTwo * 1e-6, tTwo * 1e6 / rayCount);
+
+    auto check_scene = [&] {
+        bool same = true;
+        for (size_t i = 0; i < std::min<size_t>(rayCount, 1000); ++i) {
+            RayHit hit;
+            hit.t = 1e30f;
+            scenebvh_raycast(&scene, origins[i], dirs[i], &hit);
+            float best = 1e30f;
+            for (const BvhInstance &inst : scene.instances) {
+                RayHit local;
+                local.t = best;
+                glm::vec3 o = glm::vec3(inst.invWorld * glm::vec4(origins[i], 1.0f));
+                glm::vec3 d = glm::vec3(inst.invWorld * glm::vec4(dirs[i], 0.0f));
+                if (meshbvh_raycast(inst.mesh, o, d, &local)) best = local.t;
+            }
+            if (!close(hit.t, best)) same = false;
+        }
+        return same;
+    };
+    ok = check_scene() && ok;
+
+    // move every other instance, as dragging objects between picks does
+    for (size_t k = 0; k < scene.instances.size(); k += 2) {
+        BvhInstance &inst = scene.instances[k];
+        inst.world = glm::translate(glm::mat4(1.0f), glm::vec3(3.0f, 0.5f, -2.0f)) * inst.world;
+        inst.invWorld = glm::inverse(inst.world);
+    }
+    t0 = now_seconds();
+    scenebvh_refit(&scene);
+    double tRefit = now_seconds() - t0;
+    std::printf("  half the instances moved, top level refit in %.3f ms\n", tRefit * 1000.0);
+    ok = check_scene() && ok;
+
+    return bench_exit(ok, "ray hits differ from brute force");
+}
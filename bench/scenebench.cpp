@@ -0,0 +1,260 @@
+// Benchmark for loading saved scenes.
+//
+//   scenebench [--objects N] [--runs N] [--out file.scene]
+//
+// Builds a scene of N objects (default 100000): groups of 16, each a group
+// node with 15 children placing the bundled models. It is saved as a binary
+// scene file and as the same table in a line based text format, then each
+// is loaded into an in-memory object list, best of --runs (default 5) with
+// the files in the page cache. Both loads must give back exactly what was
+// saved, and copies of the binary file whose header offsets are near 2^64,
+// so that offset plus size wraps around, must be rejected. --out keeps the
+// binary file, which `mygl --scene` opens.
+
+#include "benchutil.h"
+#include "scenefile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+// What a loader hands to the scene.
+struct LoadedObject
+{
+    std::string name;
+    int mesh;     // index in the mesh list, -1 for a group
+    int parent;   // -1 for a root
+    float values[12];   // position, rotation, scale, color
+
+    bool operator==(const LoadedObject &o) const {
+        return name == o.name && mesh == o.mesh && parent == o.parent &&
+               std::memcmp(values, o.values, sizeof(values)) == 0;
+    }
+};
+
+struct LoadedScene
+{
+    std::vector<std::string> meshes;
+    std::vector<LoadedObject> objects;
+};
+
+static LoadedObject to_loaded(const SceneFileObject &o, const std::string &name) {
+    LoadedObject r;
+    r.name = name;
+    r.mesh = o.mesh == SCENE_FILE_NONE ? -1 : (int)o.mesh;
+    r.parent = o.parent == SCENE_FILE_NONE ? -1 : (int)o.parent;
+    std::memcpy(r.values, o.position, sizeof(r.values));
+    return r;
+}
+
+// Mesh paths are only turned into strings when an object first uses them,
+// as the viewer does.
+static bool load_binary(LoadedScene *out, const std::string &path) {
+    SceneFile file;
+    if (!scenefile_open(&file, path)) return false;
+    const SceneFileHeader *h = file.header;
+    out->meshes.assign(h->meshCount, std::string());
+    out->objects.clear();
+    out->objects.reserve(h->objectCount);
+    std::vector<uint8_t> resolved(h->meshCount, 0);
+    for (uint32_t i = 0; i < h->objectCount; ++i) {
+        const SceneFileObject &o = file.objects[i];
+        if (o.mesh != SCENE_FILE_NONE && !resolved[o.mesh]) {
+            out->meshes[o.mesh] = scenefile_string(&file, file.meshes[o.mesh].path);
+            resolved[o.mesh] = 1;
+        }
+        out->objects.push_back(to_loaded(o, scenefile_string(&file, o.name)));
+    }
+    scenefile_close(&file);
+    return true;
+}
+
+// Text equivalent, one record per line:
+//   scene <objects> <meshes>
+//   mesh <path>
+//   object <mesh> <parent> <12 floats> <name>
+// with -1 for no mesh or parent. Floats are written with enough digits to
+// read back exactly.
+static bool save_text(const SceneFileWriter *writer, const std::string &path) {
+    FILE *f = std::fopen(path.c_str(), "w");
+    if (!f) return false;
+    std::fprintf(f, "scene %zu %zu\n", writer->objects.size(), writer->meshes.size());
+    for (const SceneFileMesh &m : writer->meshes)
+        std::fprintf(f, "mesh %.*s\n", (int)m.path.length, writer->strings.data() + m.path.offset);
+    for (const SceneFileObject &o : writer->objects) {
+        std::fprintf(f, "object %d %d", o.mesh == SCENE_FILE_NONE ? -1 : (int)o.mesh,
+                     o.parent == SCENE_FILE_NONE ? -1 : (int)o.parent);
+        float values[12];
+        std::memcpy(values, o.position, sizeof(values));
+        for (float v : values) std::fprintf(f, " %.9g", v);
+        std::fprintf(f, " %.*s\n", (int)o.name.length, writer->strings.data() + o.name.offset);
+    }
+    return std::fclose(f) == 0;
+}
+
+static const char* rest_of_line(const char *p, std::string *out) {
+    const char *end = std::strchr(p, '\n');
+    if (!end) end = p + std::strlen(p);
+    out->assign(p, end);
+    return *end ? end + 1 : end;
+}
+
+static bool load_text(LoadedScene *out, const std::string &path) {
+    FILE *f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+    std::string text;
+    std::fseek(f, 0, SEEK_END);
+    text.resize((size_t)std::ftell(f));
+    std::fseek(f, 0, SEEK_SET);
+    bool read = std::fread(&text[0], 1, text.size(), f) == text.size();
+    std::fclose(f);
+    if (!read) return false;
+
+    const char *p = text.c_str();
+    char *end;
+    if (std::strncmp(p, "scene ", 6) != 0) return false;
+    size_t objectCount = std::strtoul(p + 6, &end, 10);
+    size_t meshCount = std::strtoul(end, &end, 10);
+    p = end + 1;
+    out->meshes.resize(meshCount);
+    for (size_t i = 0; i < meshCount; ++i) {
+        if (std::strncmp(p, "mesh ", 5) != 0) return false;
+        p = rest_of_line(p + 5, &out->meshes[i]);
+    }
+    out->objects.resize(objectCount);
+    for (size_t i = 0; i < objectCount; ++i) {
+        if (std::strncmp(p, "object ", 7) != 0) return false;
+        LoadedObject &o = out->objects[i];
+        o.mesh = (int)std::strtol(p + 7, &end, 10);
+        o.parent = (int)std::strtol(end, &end, 10);
+        for (int k = 0; k < 12; ++k) o.values[k] = std::strtof(end, &end);
+        p = rest_of_line(end + 1, &o.name);
+    }
+    return true;
+}
+
+// Writes `image` with one header field changed and tries to open it.
+// Returns true if scenefile_open refuses it.
+static bool rejects(std::vector<char> image, size_t fieldOffset, uint64_t value, const std::string &path) {
+    std::memcpy(image.data() + fieldOffset, &value, sizeof(value));
+    FILE *f = std::fopen(path.c_str(), "wb");
+    if (!f) return false;
+    std::fwrite(image.data(), 1, image.size(), f);
+    std::fclose(f);
+    SceneFile scene;
+    bool opened = scenefile_open(&scene, path);
+    if (opened) scenefile_close(&scene);
+    return !opened;
+}
+
+template <typename Load>
+static double best_of(int runs, Load load) {
+    double best = 1e30;
+    for (int r = 0; r < runs; ++r) {
+        double t0 = now_seconds();
+        if (!load()) return -1.0;
+        best = std::min(best, now_seconds() - t0);
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = 100000;
+    int runs = 5;
+    std::string out;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--objects") == 0 && i + 1 < argc)
+            count = (size_t)std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--runs") == 0 && i + 1 < argc)
+            runs = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+            out = argv[++i];
+    }
+
+    const char *models[] = { "assets/models/Planet.obj", "assets/models/funnything.obj", "assets/models/buildings.obj" };
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<float> u(0.0f, 1.0f);
+    SceneFileWriter writer;
+    uint32_t group = SCENE_FILE_NONE;
+    const int side = (int)std::ceil(std::sqrt(count / 16.0));
+    for (size_t i = 0; i < count; ++i) {
+        if (i % 16 == 0) {
+            int g = (int)(i / 16);
+            glm::vec3 at((g % side - side * 0.5f) * 2.0f, 0.0f, (g / side - side * 0.5f) * 2.0f);
+            group = scenefile_add_object(&writer, "group " + std::to_string(g), SCENE_FILE_NONE, SCENE_FILE_NONE,
+                                         at, glm::vec3(0.0f), glm::vec3(1.0f), glm::vec3(1.0f));
+        } else {
+            int m = (int)(u(rng) * 3) % 3;
+            glm::vec3 at(u(rng) * 2.0f - 1.0f, u(rng) * 0.5f, u(rng) * 2.0f - 1.0f);
+            scenefile_add_object(&writer, models[m] + std::string(" ") + std::to_string(i),
+                                 scenefile_add_mesh(&writer, models[m]), group, at,
+                                 glm::vec3(0.0f, u(rng) * 360.0f, 0.0f), glm::vec3(0.05f + u(rng) * 0.1f),
+                                 glm::vec3(u(rng), u(rng), u(rng)));
+        }
+    }
+
+    std::string binPath = out.empty() ? "scenebench.scene" : out;
+    std::string textPath = "scenebench.txt";
+    if (!scenefile_save(&writer, binPath) || !save_text(&writer, textPath)) {
+        std::printf("could not write the scene files\n");
+        return 1;
+    }
+
+    LoadedScene expected;
+    expected.meshes.resize(writer.meshes.size());
+    for (size_t i = 0; i < writer.meshes.size(); ++i)
+        expected.meshes[i] = writer.strings.substr(writer.meshes[i].path.offset, writer.meshes[i].path.length);
+    for (const SceneFileObject &o : writer.objects)
+        expected.objects.push_back(to_loaded(o, writer.strings.substr(o.name.offset, o.name.length)));
+
+    SceneFile mapped;
+    LoadedScene binary, text;
+    double tOpen = best_of(runs, [&] {
+        bool ok = scenefile_open(&mapped, binPath);
+        scenefile_close(&mapped);
+        return ok;
+    });
+    double tBinary = best_of(runs, [&] { return load_binary(&binary, binPath); });
+    double tText = best_of(runs, [&] { return load_text(&text, textPath); });
+
+    std::error_code ec;
+    uintmax_t binBytes = std::filesystem::file_size(binPath, ec);
+    uintmax_t textBytes = std::filesystem::file_size(textPath, ec);
+    std::printf("%zu objects, %zu meshes\n", writer.objects.size(), writer.meshes.size());
+    std::printf("binary: %.2f MB, map and validate %.3f ms, read every object %.3f ms\n",
+                binBytes / 1048576.0, tOpen * 1000.0, tBinary * 1000.0);
+    std::printf("text:   %.2f MB, parse every object %.3f ms (%.1fx the binary load)\n",
+                textBytes / 1048576.0, tText * 1000.0, tText / tBinary);
+
+    std::vector<char> image(binBytes);
+    FILE *f = std::fopen(binPath.c_str(), "rb");
+    bool read = f && std::fread(image.data(), 1, image.size(), f) == image.size();
+    if (f) std::fclose(f);
+    const std::string badPath = "scenebench_bad.scene";
+    const uint64_t wrap = ~(uint64_t)63;   // aligned for any table, and wraps when anything is added
+    bool corruptOk = read && image.size() >= sizeof(SceneFileHeader) &&
+                     rejects(image, offsetof(SceneFileHeader, objectOffset), wrap, badPath) &&
+                     rejects(image, offsetof(SceneFileHeader, meshOffset), wrap, badPath) &&
+                     rejects(image, offsetof(SceneFileHeader, stringOffset), wrap, badPath) &&
+                     rejects(image, offsetof(SceneFileHeader, stringBytes), wrap, badPath);
+    std::printf("headers with wrapping offsets: %s\n", corruptOk ? "rejected" : "ACCEPTED");
+
+    std::filesystem::remove(textPath, ec);
+    std::filesystem::remove(badPath, ec);
+    if (out.empty()) std::filesystem::remove(binPath, ec);
+
+    bool binaryOk = tBinary >= 0.0 && binary.meshes == expected.meshes && binary.objects == expected.objects;
+    bool textOk = tText >= 0.0 && text.meshes == expected.meshes && text.objects == expected.objects;
+    return bench_exit(binaryOk && textOk && corruptOk, "%s%s%s",
+                      binaryOk ? "" : "binary load differs from the saved scene; ",
+                      textOk ? "" : "text load differs from the saved scene; ",
+                      corruptOk ? "" : "a header with wrapping offsets was accepted");
+}
@@ -0,0 +1,104 @@
+// Benchmark for the Hierarchy's name search index.
+//
+//   searchbench [--names N]
+//
+// Indexes N (default 100000) object names like those of a large saved
+// scene, then runs a set of queries through the index and through a plain
+// scan of every name, before and after removing and renaming a slice of
+// them. Both must return the same ids.
+
+#include "benchutil.h"
+#include "searchindex.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+static std::string lower(std::string s) {
+    for (char &c : s) c = (char)std::tolower((unsigned char)c);
+    return s;
+}
+
+static void scan(const std::vector<std::string> &names, const std::vector<uint8_t> &live, const std::string &query,
+                 std::vector<uint32_t> *ids) {
+    ids->clear();
+    const std::string q = lower(query);
+    for (uint32_t i = 0; i < (uint32_t)names.size(); ++i)
+        if (live[i] && lower(names[i]).find(q) != std::string::npos) ids->push_back(i);
+}
+
+// Returns the number of queries whose results differ.
+static int run_queries(const SearchIndex *index, const std::vector<std::string> &names, const std::vector<uint8_t> &live,
+                       const char *label) {
+    const char *queries[] = { "", "g", "pl", "planet", "Funny", "buildings.obj 12", "group 99", "obj 4242", "zzz", "s/b" };
+    std::vector<uint32_t> fromIndex, fromScan;
+    double tIndex = 0.0, tScan = 0.0;
+    int mismatches = 0;
+    for (const char *q : queries) {
+        double t0 = now_seconds();
+        searchindex_query(index, q, &fromIndex);
+        double t1 = now_seconds();
+        scan(names, live, q, &fromScan);
+        double t2 = now_seconds();
+        tIndex += t1 - t0;
+        tScan += t2 - t1;
+        if (fromIndex != fromScan) {
+            std::printf("  \"%s\": %zu from the index, %zu from the scan\n", q, fromIndex.size(), fromScan.size());
+            ++mismatches;
+        }
+    }
+    int n = (int)(sizeof(queries) / sizeof(queries[0]));
+    std::printf("%s: %d queries, index %.3f ms, scan %.3f ms per query\n", label, n, tIndex * 1000.0 / n,
+                tScan * 1000.0 / n);
+    return mismatches;
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = 100000;
+    for (int i = 1; i < argc; ++i)
+        if (std::strcmp(argv[i], "--names") == 0 && i + 1 < argc)
+            count = (size_t)std::strtoull(argv[++i], nullptr, 10);
+
+    // the same naming as scenebench's scene
+    const char *models[] = { "assets/models/Planet.obj", "assets/models/funnything.obj", "assets/models/buildings.obj" };
+    std::mt19937 rng(12345);
+    std::vector<std::string> names(count);
+    std::vector<uint8_t> live(count, 1);
+    for (size_t i = 0; i < count; ++i)
+        names[i] = i % 16 == 0 ? "group " + std::to_string(i / 16) : models[rng() % 3] + std::string(" ") + std::to_string(i);
+
+    SearchIndex index;
+    double t0 = now_seconds();
+    for (size_t i = 0; i < count; ++i) searchindex_set(&index, (uint32_t)i, names[i]);
+    double t1 = now_seconds();
+    size_t postings = 0;
+    for (const auto &p : index.postings) postings += p.second.size();
+    std::printf("%zu names indexed in %.1f ms: %zu trigrams, %zu postings\n", count, (t1 - t0) * 1000.0,
+                index.postings.size(), postings);
+
+    int mismatches = run_queries(&index, names, live, "built");
+
+    // drop every 7th name and rename every 11th, as edits would
+    double t2 = now_seconds();
+    int edits = 0;
+    for (size_t i = 0; i < count; i += 7, ++edits) {
+        searchindex_remove(&index, (uint32_t)i);
+        live[i] = 0;
+    }
+    for (size_t i = 5; i < count; i += 11, ++edits) {
+        names[i] = "Renamed Planet " + std::to_string(i);
+        searchindex_set(&index, (uint32_t)i, names[i]);
+        live[i] = 1;
+    }
+    double t3 = now_seconds();
+    std::printf("%d edits in %.1f ms (%.2f us each)\n", edits, (t3 - t2) * 1000.0, (t3 - t2) * 1e6 / edits);
+
+    mismatches += run_queries(&index, names, live, "edited");
+    return bench_exit(mismatches == 0, "%d queries differ between the index and a scan", mismatches);
+}
@@ -0,0 +1,215 @@
+// Correctness check for simplify_indices.
+//
+//   simplifybench [--grid N] [file.obj ...]
+//
+// Simplifies LOD 0 of each file (the bundled models by default) and of a
+// generated N x N height field (default 96) with a square hole, so it has
+// an outer and an inner open boundary, to a half, a quarter and an eighth
+// of its triangles at two error limits. Every result must
+//
+//   - index only vertices below the vertex count,
+//   - report an error of at most the limit it was given,
+//   - have no triangle facing away from the LOD 0 normals of its corners,
+//     unless LOD 0 already had such triangles,
+//   - keep every boundary loop: each open edge must run forward along one
+//     loop of LOD 0, and together they must go round each loop exactly once.
+
+#include "benchutil.h"
+#include "mesh.h"
+#include "simplify.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+// Height field over [-1, 1]^2 with analytic normals, minus the middle
+// ninth of the cells.
+static void make_grid(Mesh *mesh, int n) {
+    mesh->vertices.clear();
+    mesh->indices.clear();
+    for (int z = 0; z <= n; ++z)
+        for (int x = 0; x <= n; ++x) {
+            float fx = (float)x / n * 2.0f - 1.0f, fz = (float)z / n * 2.0f - 1.0f;
+            float y = 0.05f * std::sin(fx * 3.0f) * std::cos(fz * 2.0f);
+            float dx = 0.15f * std::cos(fx * 3.0f) * std::cos(fz * 2.0f);
+            float dz = -0.1f * std::sin(fx * 3.0f) * std::sin(fz * 2.0f);
+            float len = std::sqrt(dx * dx + 1.0f + dz * dz);
+            mesh->vertices.insert(mesh->vertices.end(), { fx, y, fz, -dx / len, 1.0f / len, -dz / len });
+        }
+    for (int z = 0; z < n; ++z)
+        for (int x = 0; x < n; ++x) {
+            if (x >= n / 3 && x < n - n / 3 && z >= n / 3 && z < n - n / 3) continue;
+            uint32_t i = (uint32_t)(z * (n + 1) + x);
+            uint32_t r = i + 1, d = i + (uint32_t)n + 1, dr = d + 1;
+            mesh->indices.insert(mesh->indices.end(), { i, d, r, r, d, dr });
+        }
+    mesh_compute_bounds(mesh);
+    mesh->lods.assign(1, MeshLod{ 0, (uint32_t)mesh->indices.size(), 0.0f });
+}
+
+// Vertices with bit-identical positions are one point, as in the simplifier.
+static std::vector<uint32_t> position_ids(const Mesh *mesh) {
+    const size_t count = mesh_vertex_count(mesh);
+    std::map<std::vector<uint32_t>, uint32_t> first;
+    std::vector<uint32_t> ids(count);
+    for (size_t v = 0; v < count; ++v) {
+        std::vector<uint32_t> bits(3);
+        std::memcpy(bits.data(), &mesh->vertices[v * MESH_VERTEX_FLOATS], 3 * sizeof(float));
+        ids[v] = first.emplace(bits, (uint32_t)v).first->second;
+    }
+    return ids;
+}
+
+// Open edges (a, b) by position: no triangle has the edge (b, a).
+static std::vector<std::pair<uint32_t, uint32_t>> open_edges(const uint32_t *indices, size_t count,
+                                                             const std::vector<uint32_t> &pos) {
+    std::map<std::pair<uint32_t, uint32_t>, int> edges;
+    for (size_t t = 0; t + 2 < count; t += 3)
+        for (int k = 0; k < 3; ++k) {
+            uint32_t a = pos[indices[t + k]], b = pos[indices[t + (k + 1) % 3]];
+            if (a != b) edges[{ a, b }]++;
+        }
+    std::vector<std::pair<uint32_t, uint32_t>> open;
+    for (const auto &e : edges)
+        if (!edges.count({ e.first.second, e.first.first }))
+            open.push_back(e.first);
+    return open;
+}
+
+struct Loops
+{
+    std::map<uint32_t, std::pair<int, int>> at;   // position -> loop, step along it
+    std::vector<int> length;
+};
+
+// Follows the open edges of LOD 0 into loops. Returns false if they do not
+// form simple loops, in which case there is nothing to compare against.
+static bool find_loops(const std::vector<std::pair<uint32_t, uint32_t>> &open, Loops *loops) {
+    std::map<uint32_t, uint32_t> next;
+    for (const auto &e : open)
+        if (!next.emplace(e.first, e.second).second) return false;
+    for (const auto &e : next) {
+        if (loops->at.count(e.first)) continue;
+        int loop = (int)loops->length.size(), step = 0;
+        uint32_t p = e.first;
+        do {
+            if (loops->at.count(p)) return false;
+            loops->at[p] = { loop, step++ };
+            auto it = next.find(p);
+            if (it == next.end()) return false;
+            p = it->second;
+        } while (p != e.first);
+        loops->length.push_back(step);
+    }
+    return true;
+}
+
+static bool same_loops(const std::vector<std::pair<uint32_t, uint32_t>> &open, const Loops &loops) {
+    std::vector<int> covered(loops.length.size(), 0);
+    for (const auto &e : open) {
+        auto a = loops.at.find(e.first), b = loops.at.find(e.second);
+        if (a == loops.at.end() || b == loops.at.end() || a->second.first != b->second.first) return false;
+        int loop = a->second.first, n = loops.length[loop];
+        covered[loop] += ((b->second.second - a->second.second) % n + n) % n;
+    }
+    for (size_t l = 0; l < covered.size(); ++l)
+        if (covered[l] != loops.length[l]) return false;
+    return true;
+}
+
+// Triangles whose winding disagrees with the normals of their corners.
+static size_t flipped(const Mesh *mesh, const uint32_t *indices, size_t count) {
+    size_t flips = 0;
+    for (size_t t = 0; t + 2 < count; t += 3) {
+        const float *v[3];
+        for (int k = 0; k < 3; ++k)
+            v[k] = &mesh->vertices[(size_t)indices[t + k] * MESH_VERTEX_FLOATS];
+        float e1[3], e2[3], s[3];
+        for (int c = 0; c < 3; ++c) {
+            e1[c] = v[1][c] - v[0][c];
+            e2[c] = v[2][c] - v[0][c];
+            s[c] = v[0][3 + c] + v[1][3 + c] + v[2][3 + c];
+        }
+        float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+        if (n[0] * s[0] + n[1] * s[1] + n[2] * s[2] < 0.0f) flips++;
+    }
+    return flips;
+}
+
+static bool check_mesh(const std::string &name, const Mesh *mesh) {
+    const size_t vertexCount = mesh_vertex_count(mesh);
+    const uint32_t *lod0 = &mesh->indices[mesh->lods[0].firstIndex];
+    const size_t lod0Count = mesh->lods[0].indexCount;
+    const std::vector<uint32_t> pos = position_ids(mesh);
+    const size_t lod0Flips = flipped(mesh, lod0, lod0Count);
+
+    Loops loops;
+    const bool simple = find_loops(open_edges(lod0, lod0Count, pos), &loops);
+    std::printf("%s: %zu triangles, %zu boundary loops%s, %zu triangles against their normals\n", name.c_str(),
+                lod0Count / 3, loops.length.size(), simple ? "" : " (not simple, unchecked)", lod0Flips);
+
+    bool ok = true;
+    std::vector<uint32_t> out(lod0Count);
+    for (float limit : { 0.01f, 0.05f }) {
+        const float maxError = limit * mesh->bounds.radius;
+        for (size_t divide : { 2, 4, 8 }) {
+            const size_t target = lod0Count / 3 / divide * 3;
+            float error = 0.0f;
+            double start = now_seconds();
+            size_t count = simplify_indices(out.data(), lod0, lod0Count, mesh->vertices.data(), vertexCount,
+                                            MESH_VERTEX_FLOATS, target, maxError, &error);
+            double seconds = now_seconds() - start;
+
+            bool inRange = count % 3 == 0 && count <= lod0Count;
+            for (size_t i = 0; i < count && inRange; ++i)
+                inRange = out[i] < vertexCount;
+            bool withinError = error <= maxError;
+            size_t flips = inRange ? flipped(mesh, out.data(), count) : 0;
+            bool facing = lod0Flips > 0 || flips == 0;
+            bool boundary = !simple || (inRange && same_loops(open_edges(out.data(), count, pos), loops));
+            bool pass = inRange && withinError && facing && boundary;
+            ok = ok && pass;
+            std::printf("  limit %.3f, 1/%zu: %6zu triangles, error %.5f, %zu flipped, %7.3f ms  %s%s%s%s\n",
+                        maxError, divide, count / 3, error, flips, seconds * 1000.0, pass ? "ok" : "FAILED",
+                        inRange ? "" : " (index out of range)", withinError ? "" : " (error over limit)",
+                        boundary ? (facing ? "" : " (flipped)") : " (boundary changed)");
+        }
+    }
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    int grid = 96;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--grid") == 0 && i + 1 < argc)
+            grid = std::max(6, std::atoi(argv[++i]));
+        else
+            files.push_back(argv[i]);
+    }
+    if (files.empty())
+        files = { "assets/models/Planet.obj", "assets/models/funnything.obj", "assets/models/buildings.obj" };
+
+    bool ok = true;
+    for (const std::string &path : files) {
+        Mesh mesh;
+        if (!mesh_load_obj(&mesh, path, nullptr, 1) || mesh.lods.empty()) {
+            std::printf("%s: cannot load\n", path.c_str());
+            ok = false;
+            continue;
+        }
+        ok = check_mesh(path, &mesh) && ok;
+    }
+
+    Mesh gridMesh;
+    make_grid(&gridMesh, grid);
+    ok = check_mesh("height field with a hole", &gridMesh) && ok;
+
+    return bench_exit(ok, "simplified meshes failed the checks above");
+}
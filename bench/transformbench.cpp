@@ -0,0 +1,143 @@
+// Benchmark for the transform hierarchy update.
+//
+//   transformbench [--nodes N] [--dirty PERCENT]
+//
+// Builds random hierarchies of 100k and 1M nodes (or N) and times a full
+// update, an update after touching PERCENT of the nodes, and an update with
+// nothing dirty. The full update is checked against the straightforward
+// glm composition with a general inverse per node.
+
+#include "benchutil.h"
+#include "transforms.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// Assemblies of parts up to MAX_DEPTH levels deep: most nodes hang below a
+// recent node, so subtrees are mostly contiguous, but some attach further
+// back and force a relayout.
+static const int MAX_DEPTH = 8;
+
+static void build(TransformHierarchy *h, size_t count, std::mt19937 *rng) {
+    std::uniform_real_distribution<float> pos(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> rot(-180.0f, 180.0f);
+    std::uniform_real_distribution<float> scl(0.5f, 1.5f);
+    std::uniform_int_distribution<int> pick(0, 99);
+
+    std::vector<NodeId> parents(count);
+    std::vector<int> depth(count);
+    transforms_clear(h);
+    for (size_t i = 0; i < count; ++i) {
+        NodeId parent = NODE_NONE;
+        int p = pick(*rng);
+        if (i > 0 && p < 97) {
+            size_t back = p < 80 ? 1 + (size_t)p % 4 : 1 + (size_t)(*rng)() % 1000;
+            parent = (NodeId)(i > back ? i - back : 0);
+            while (parent != NODE_NONE && depth[parent] >= MAX_DEPTH)
+                parent = parents[parent];
+        }
+        parents[i] = parent;
+        depth[i] = parent == NODE_NONE ? 0 : depth[parent] + 1;
+        transforms_add(h, parent, glm::vec3(pos(*rng), pos(*rng), pos(*rng)),
+                       glm::vec3(rot(*rng), rot(*rng), rot(*rng)),
+                       glm::vec3(scl(*rng), scl(*rng), scl(*rng)));
+    }
+}
+
+static float max_error(const std::vector<glm::mat4> &a, const std::vector<glm::mat4> &b) {
+    float worst = 0.0f;
+    for (size_t i = 0; i < a.size(); ++i)
+        for (int c = 0; c < 4; ++c)
+            for (int r = 0; r < 4; ++r) {
+                float scale = std::fmax(1.0f, std::fabs(b[i][c][r]));
+                worst = std::fmax(worst, std::fabs(a[i][c][r] - b[i][c][r]) / scale);
+            }
+    return worst;
+}
+
+static float max_error(const std::vector<glm::mat3> &a, const std::vector<glm::mat3> &b) {
+    float worst = 0.0f;
+    for (size_t i = 0; i < a.size(); ++i)
+        for (int c = 0; c < 3; ++c)
+            for (int r = 0; r < 3; ++r) {
+                float scale = std::fmax(1.0f, std::fabs(b[i][c][r]));
+                worst = std::fmax(worst, std::fabs(a[i][c][r] - b[i][c][r]) / scale);
+            }
+    return worst;
+}
+
+static bool run(size_t count, double dirtyPercent) {
+    std::mt19937 rng(12345);
+    TransformHierarchy h;
+
+    double t0 = now_seconds();
+    build(&h, count, &rng);
+    double tBuild = now_seconds() - t0;
+
+    t0 = now_seconds();
+    TransformUpdateStats first = transforms_update(&h);
+    double tFirst = now_seconds() - t0;
+
+    // every root dirty, so every node is recomputed without relayout
+    for (size_t s = 0; s < count; ++s)
+        if (h.parent[s] == NODE_NONE) transforms_mark_dirty(&h, h.node[s]);
+    t0 = now_seconds();
+    TransformUpdateStats full = transforms_update(&h);
+    double tFull = now_seconds() - t0;
+
+    std::vector<glm::mat4> world = h.world;
+    std::vector<glm::mat3> normal = h.normalMatrix;
+    t0 = now_seconds();
+    transforms_update_all_reference(&h);
+    double tReference = now_seconds() - t0;
+    float worldError = max_error(world, h.world);
+    float normalError = max_error(normal, h.normalMatrix);
+
+    std::uniform_int_distribution<size_t> any(0, count - 1);
+    size_t touched = (size_t)(count * dirtyPercent / 100.0);
+    for (size_t i = 0; i < touched; ++i) {
+        NodeId node = (NodeId)any(rng);
+        transforms_set_position(&h, node, transforms_position(&h, node) + glm::vec3(0.01f));
+    }
+    t0 = now_seconds();
+    TransformUpdateStats sparse = transforms_update(&h);
+    double tSparse = now_seconds() - t0;
+
+    t0 = now_seconds();
+    transforms_update(&h);
+    double tClean = now_seconds() - t0;
+
+    std::printf("%zu nodes\n", count);
+    std::printf("  build           %8.2f ms\n", tBuild * 1000.0);
+    std::printf("  first update    %8.2f ms  (relayout + %zu nodes)\n", tFirst * 1000.0, first.nodes);
+    std::printf("  full update     %8.2f ms  %6.1f ns/node  (%zu subtrees)\n",
+                tFull * 1000.0, tFull * 1e9 / (double)full.nodes, full.subtrees);
+    std::printf("  reference       %8.2f ms  %6.1f ns/node\n", tReference * 1000.0, tReference * 1e9 / (double)count);
+    std::printf("  %.2f%% touched   %8.2f ms  (%zu subtrees, %zu nodes)\n",
+                dirtyPercent, tSparse * 1000.0, sparse.subtrees, sparse.nodes);
+    std::printf("  clean update    %8.3f ms\n", tClean * 1000.0);
+    std::printf("  max rel. error  world %.2e  normal %.2e\n", worldError, normalError);
+
+    return worldError < 1e-3f && normalError < 1e-3f;
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<size_t> counts = { 100000, 1000000 };
+    double dirtyPercent = 1.0;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--nodes") == 0 && i + 1 < argc)
+            counts = { (size_t)std::strtoull(argv[++i], nullptr, 10) };
+        else if (std::strcmp(argv[i], "--dirty") == 0 && i + 1 < argc)
+            dirtyPercent = std::atof(argv[++i]);
+    }
+
+    bool ok = true;
+    for (size_t count : counts)
+        ok = run(count, dirtyPercent) && ok;
+    return bench_exit(ok, "transforms differ from the reference");
+}
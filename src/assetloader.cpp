@@ -0,0 +1,128 @@
+#include "assetloader.h"
+
+#include <chrono>
+
+static void queue_init(MeshResultQueue *q) {
+    q->stub.next.store(nullptr, std::memory_order_relaxed);
+    q->head.store(&q->stub, std::memory_order_relaxed);
+    q->tail = &q->stub;
+}
+
+static void queue_push(MeshResultQueue *q, MeshLoadResult *node) {
+    node->next.store(nullptr, std::memory_order_relaxed);
+    MeshLoadResult *prev = q->head.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+}
+
+static MeshLoadResult* queue_pop(MeshResultQueue *q) {
+    MeshLoadResult *tail = q->tail;
+    MeshLoadResult *next = tail->next.load(std::memory_order_acquire);
+    if (tail == &q->stub) {
+        if (!next) return nullptr;
+        q->tail = next;
+        tail = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+    if (next) {
+        q->tail = next;
+        return tail;
+    }
+
+    // tail is the last node; a producer may be between its exchange and
+    // its link store, in which case we try again next poll
+    if (tail != q->head.load(std::memory_order_acquire)) return nullptr;
+
+    queue_push(q, &q->stub);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next) {
+        q->tail = next;
+        return tail;
+    }
+    return nullptr;
+}
+
+static void worker_main(AssetLoader *loader) {
+    for (;;) {
+        MeshLoadRequest request;
+        {
+            std::unique_lock<std::mutex> lock(loader->requestMutex);
+            loader->requestReady.wait(lock, [loader] { return loader->stopping || !loader->requests.empty(); });
+            if (loader->stopping) return;
+            request = std::move(loader->requests.front());
+            loader->requests.pop_front();
+        }
+
+        MeshLoadResult *result = new MeshLoadResult();
+        result->userId = request.userId;
+        result->path = std::move(request.path);
+
+        auto start = std::chrono::steady_clock::now();
+        // the workers already keep the cores busy, one file each
+        result->ok = meshcache_load(&result->asset, result->path, loader->cookFlags, &result->cacheHit, 1);
+        if (result->ok)
+            meshbvh_build_asset(&result->bvh, &result->asset);
+        result->loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        queue_push(&loader->results, result);
+    }
+}
+
+void assetloader_start(AssetLoader *loader, int threadCount, uint32_t cookFlags)
+{
+    if (threadCount <= 0) {
+        int cores = (int)std::thread::hardware_concurrency();
+        threadCount = cores > 1 ? cores - 1 : 1;
+    }
+
+    loader->stopping = false;
+    loader->cookFlags = cookFlags;
+    loader->pending.store(0);
+    queue_init(&loader->results);
+    for (int i = 0; i < threadCount; ++i)
+        loader->workers.emplace_back(worker_main, loader);
+}
+
+void assetloader_stop(AssetLoader *loader)
+{
+    {
+        std::lock_guard<std::mutex> lock(loader->requestMutex);
+        loader->stopping = true;
+        loader->requests.clear();
+    }
+    loader->requestReady.notify_all();
+    for (std::thread &t : loader->workers)
+        t.join();
+    loader->workers.clear();
+
+    while (MeshLoadResult *r = assetloader_poll(loader))
+        assetloader_free(r);
+    loader->pending.store(0);
+}
+
+void assetloader_request(AssetLoader *loader, const std::string &path, uint32_t userId)
+{
+    loader->pending.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(loader->requestMutex);
+        loader->requests.push_back({ userId, path });
+    }
+    loader->requestReady.notify_one();
+}
+
+MeshLoadResult* assetloader_poll(AssetLoader *loader)
+{
+    MeshLoadResult *r = queue_pop(&loader->results);
+    if (r) loader->pending.fetch_sub(1);
+    return r;
+}
+
+void assetloader_free(MeshLoadResult *result)
+{
+    meshcache_release(&result->asset);
+    delete result;
+}
+
+int assetloader_pending(AssetLoader *loader)
+{
+    return loader->pending.load();
+}
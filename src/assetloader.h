@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "meshcache.h"
+#include "raycast.h"
+
+// Background mesh loading. Worker threads parse/cook meshes and publish the
+// CPU-side result on a lock-free queue; the thread that owns the GL context
+// polls it and does the upload.
+
+struct MeshLoadResult
+{
+    std::atomic<MeshLoadResult*> next;   // intrusive queue link
+
+    uint32_t userId;        // whatever the requester passed in
+    std::string path;
+    bool ok;
+    bool cacheHit;
+    double loadSeconds;     // time spent on the worker, BVH included
+    MeshAsset asset;
+    MeshBvh bvh;            // picking BVH, built on the worker
+};
+
+// Intrusive multi-producer single-consumer queue (Vyukov). Pushing never
+// blocks or allocates; popping is only done by the consumer thread.
+struct MeshResultQueue
+{
+    std::atomic<MeshLoadResult*> head;
+    MeshLoadResult *tail;
+    MeshLoadResult stub;
+};
+
+struct MeshLoadRequest
+{
+    uint32_t userId;
+    std::string path;
+};
+
+struct AssetLoader
+{
+    std::vector<std::thread> workers;
+
+    std::mutex requestMutex;
+    std::condition_variable requestReady;
+    std::deque<MeshLoadRequest> requests;
+    bool stopping;
+    uint32_t cookFlags;   // MESH_COOK_*
+
+    MeshResultQueue results;
+    std::atomic<int> pending;   // requested and not yet polled
+};
+
+// threadCount <= 0 uses one thread per core, leaving one for the render thread.
+void assetloader_start(AssetLoader *loader, int threadCount = 0, uint32_t cookFlags = MESH_COOK_PACK_VERTICES);
+
+void assetloader_stop(AssetLoader *loader);
+
+void assetloader_request(AssetLoader *loader, const std::string &path, uint32_t userId);
+
+// Next finished load, or nullptr. Must be released with assetloader_free.
+MeshLoadResult* assetloader_poll(AssetLoader *loader);
+
+void assetloader_free(MeshLoadResult *result);
+
+int assetloader_pending(AssetLoader *loader);
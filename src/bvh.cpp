@@ -0,0 +1,181 @@
+#include "bvh.h"
+
+#include <algorithm>
+
+static const int SAH_BINS = 16;
+static const int MAX_DEPTH = 60;   // traversal stacks hold 64 entries
+
+static float half_area(const BvhBox &b) {
+    glm::vec3 d = b.max - b.min;
+    return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+static void box_empty(BvhBox *b) {
+    b->min = glm::vec3(1e30f);
+    b->max = glm::vec3(-1e30f);
+}
+
+static void box_grow(BvhBox *b, const BvhBox &o) {
+    b->min = glm::min(b->min, o.min);
+    b->max = glm::max(b->max, o.max);
+}
+
+static void box_grow(BvhBox *b, const glm::vec3 &p) {
+    b->min = glm::min(b->min, p);
+    b->max = glm::max(b->max, p);
+}
+
+struct BuildTask
+{
+    uint32_t node;
+    uint32_t begin, end;
+    int depth;
+};
+
+struct SahBin
+{
+    BvhBox box;
+    uint32_t count;
+};
+
+void bvh_build(Bvh *bvh, const BvhBox *boxes, size_t count, int maxLeafSize)
+{
+    bvh->nodes.clear();
+    bvh->prims.resize(count);
+    if (count == 0) return;
+    for (size_t i = 0; i < count; ++i)
+        bvh->prims[i] = (uint32_t)i;
+
+    std::vector<glm::vec3> centroid(count);
+    for (size_t i = 0; i < count; ++i)
+        centroid[i] = 0.5f * (boxes[i].min + boxes[i].max);
+
+    bvh->nodes.reserve(2 * count / (size_t)std::max(1, maxLeafSize / 2) + 1);
+    bvh->nodes.push_back(BvhNode{});
+
+    std::vector<BuildTask> tasks;
+    tasks.push_back({ 0, 0, (uint32_t)count, 0 });
+    uint32_t *prims = bvh->prims.data();
+    while (!tasks.empty()) {
+        BuildTask task = tasks.back();
+        tasks.pop_back();
+
+        BvhBox box, cbox;
+        box_empty(&box);
+        box_empty(&cbox);
+        for (uint32_t i = task.begin; i < task.end; ++i) {
+            box_grow(&box, boxes[prims[i]]);
+            box_grow(&cbox, centroid[prims[i]]);
+        }
+        BvhNode &node = bvh->nodes[task.node];
+        node.min = box.min;
+        node.max = box.max;
+
+        const uint32_t n = task.end - task.begin;
+        if ((int)n <= maxLeafSize || task.depth >= MAX_DEPTH) {
+            node.first = task.begin;
+            node.count = n;
+            continue;
+        }
+
+        // best binned split over all three axes
+        int bestAxis = -1, bestBin = 0;
+        float bestCost = 1e30f;
+        for (int axis = 0; axis < 3; ++axis) {
+            float lo = cbox.min[axis], extent = cbox.max[axis] - lo;
+            if (extent <= 0.0f) continue;
+            float scale = SAH_BINS / extent;
+
+            SahBin bins[SAH_BINS];
+            for (SahBin &b : bins) {
+                box_empty(&b.box);
+                b.count = 0;
+            }
+            for (uint32_t i = task.begin; i < task.end; ++i) {
+                int b = std::min(SAH_BINS - 1, (int)((centroid[prims[i]][axis] - lo) * scale));
+                bins[b].count++;
+                box_grow(&bins[b].box, boxes[prims[i]]);
+            }
+
+            // sweep from the right, then from the left evaluating each plane
+            float rightArea[SAH_BINS];
+            uint32_t rightCount[SAH_BINS];
+            BvhBox acc;
+            box_empty(&acc);
+            uint32_t accCount = 0;
+            for (int b = SAH_BINS - 1; b > 0; --b) {
+                if (bins[b].count) box_grow(&acc, bins[b].box);
+                accCount += bins[b].count;
+                rightArea[b] = accCount ? half_area(acc) : 0.0f;
+                rightCount[b] = accCount;
+            }
+            box_empty(&acc);
+            accCount = 0;
+            for (int b = 0; b < SAH_BINS - 1; ++b) {
+                if (bins[b].count) box_grow(&acc, bins[b].box);
+                accCount += bins[b].count;
+                if (!accCount || !rightCount[b + 1]) continue;
+                float cost = half_area(acc) * accCount + rightArea[b + 1] * rightCount[b + 1];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = b + 1;
+                }
+            }
+        }
+
+        uint32_t mid;
+        if (bestAxis < 0) {
+            // every centroid in the same spot; halve the range to bound leaves
+            mid = task.begin + n / 2;
+        } else {
+            float lo = cbox.min[bestAxis];
+            float scale = SAH_BINS / (cbox.max[bestAxis] - lo);
+            uint32_t *split = std::partition(prims + task.begin, prims + task.end, [&](uint32_t p) {
+                return std::min(SAH_BINS - 1, (int)((centroid[p][bestAxis] - lo) * scale)) < bestBin;
+            });
+            mid = (uint32_t)(split - prims);
+        }
+
+        uint32_t left = (uint32_t)bvh->nodes.size();
+        bvh->nodes[task.node].first = left;
+        bvh->nodes[task.node].count = 0;
+        bvh->nodes.push_back(BvhNode{});
+        bvh->nodes.push_back(BvhNode{});
+        tasks.push_back({ left + 1, mid, task.end, task.depth + 1 });
+        tasks.push_back({ left, task.begin, mid, task.depth + 1 });
+    }
+}
+
+void bvh_refit(Bvh *bvh, const BvhBox *boxes)
+{
+    // children always come after their parent, so back to front visits
+    // both children before the node
+    for (size_t n = bvh->nodes.size(); n-- > 0;) {
+        BvhNode &node = bvh->nodes[n];
+        BvhBox box;
+        box_empty(&box);
+        if (node.count) {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i)
+                box_grow(&box, boxes[bvh->prims[i]]);
+        } else {
+            const BvhNode &a = bvh->nodes[node.first], &b = bvh->nodes[node.first + 1];
+            box_grow(&box, BvhBox{ a.min, a.max });
+            box_grow(&box, BvhBox{ b.min, b.max });
+        }
+        node.min = box.min;
+        node.max = box.max;
+    }
+}
+
+BvhBox bvh_bounds(const Bvh *bvh)
+{
+    BvhBox b;
+    if (bvh->nodes.empty()) {
+        b.min = b.max = glm::vec3(0.0f);
+        return b;
+    }
+    b.min = bvh->nodes[0].min;
+    b.max = bvh->nodes[0].max;
+    return b;
+}
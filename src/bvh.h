@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Bounding volume hierarchy over arbitrary primitives given by their boxes,
+// built top down with binned SAH. The primitives themselves are never seen:
+// queries report leaf ranges of `prims` (primitive indices in tree order)
+// and the caller tests whatever those indices stand for.
+
+struct BvhBox
+{
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// 32 bytes. Children of an inner node are adjacent: `first` and `first + 1`.
+struct BvhNode
+{
+    glm::vec3 min;
+    uint32_t first;   // left child, or first entry in prims for a leaf
+    glm::vec3 max;
+    uint32_t count;   // primitives in a leaf, 0 for an inner node
+};
+
+struct Bvh
+{
+    std::vector<BvhNode> nodes;   // nodes[0] is the root
+    std::vector<uint32_t> prims;
+};
+
+const int BVH_MAX_LEAF_SIZE = 4;
+
+void bvh_build(Bvh *bvh, const BvhBox *boxes, size_t count, int maxLeafSize = BVH_MAX_LEAF_SIZE);
+
+// Recomputes every node's box from new primitive boxes, keeping the tree.
+// Much cheaper than a build, but the splits no longer follow the primitives
+// once they have moved far.
+void bvh_refit(Bvh *bvh, const BvhBox *boxes);
+
+inline bool bvh_empty(const Bvh *bvh) { return bvh->prims.empty(); }
+
+BvhBox bvh_bounds(const Bvh *bvh);
+
+// Slab test; returns the entry distance or a negative value on a miss.
+inline float bvh_ray_box(const glm::vec3 &min, const glm::vec3 &max,
+                         const glm::vec3 &origin, const glm::vec3 &invDir, float tMax)
+{
+    glm::vec3 t0 = (min - origin) * invDir;
+    glm::vec3 t1 = (max - origin) * invDir;
+    float tNear = glm::max(glm::max(glm::min(t0.x, t1.x), glm::min(t0.y, t1.y)), glm::min(t0.z, t1.z));
+    float tFar = glm::min(glm::min(glm::max(t0.x, t1.x), glm::max(t0.y, t1.y)), glm::max(t0.z, t1.z));
+    tFar = glm::min(tFar, tMax);
+    if (tNear > tFar || tFar < 0.0f) return -1.0f;
+    return glm::max(tNear, 0.0f);
+}
+
+// Visits the leaves a ray passes through, nearer child first, skipping
+// anything beyond `*tMax`. `leaf(prims, count, tMax)` tests the primitives
+// and may shorten *tMax when it finds a hit.
+template <typename LeafFn>
+void bvh_raycast(const Bvh *bvh, const glm::vec3 &origin, const glm::vec3 &dir, float *tMax, LeafFn leaf)
+{
+    if (bvh_empty(bvh)) return;
+    const glm::vec3 invDir = 1.0f / dir;
+    const BvhNode *nodes = bvh->nodes.data();
+
+    uint32_t stack[64];
+    int top = 0;
+    if (bvh_ray_box(nodes[0].min, nodes[0].max, origin, invDir, *tMax) < 0.0f) return;
+    stack[top++] = 0;
+    while (top > 0) {
+        const BvhNode &node = nodes[stack[--top]];
+        if (node.count) {
+            leaf(&bvh->prims[node.first], node.count, tMax);
+            continue;
+        }
+        uint32_t a = node.first, b = node.first + 1;
+        float ta = bvh_ray_box(nodes[a].min, nodes[a].max, origin, invDir, *tMax);
+        float tb = bvh_ray_box(nodes[b].min, nodes[b].max, origin, invDir, *tMax);
+        if (ta >= 0.0f && tb >= 0.0f) {
+            // push the far one first so the near one is visited next
+            if (ta > tb) { uint32_t t = a; a = b; b = t; }
+            stack[top++] = b;
+            stack[top++] = a;
+        } else if (ta >= 0.0f) {
+            stack[top++] = a;
+        } else if (tb >= 0.0f) {
+            stack[top++] = b;
+        }
+    }
+}
+
+// Visits the leaves overlapping `box`: `leaf(prims, count)`.
+template <typename LeafFn>
+void bvh_query_box(const Bvh *bvh, const BvhBox &box, LeafFn leaf)
+{
+    if (bvh_empty(bvh)) return;
+    const BvhNode *nodes = bvh->nodes.data();
+    uint32_t stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const BvhNode &node = nodes[stack[--top]];
+        if (node.max.x < box.min.x || node.min.x > box.max.x ||
+            node.max.y < box.min.y || node.min.y > box.max.y ||
+            node.max.z < box.min.z || node.min.z > box.max.z)
+            continue;
+        if (node.count) {
+            leaf(&bvh->prims[node.first], node.count);
+            continue;
+        }
+        stack[top++] = node.first + 1;
+        stack[top++] = node.first;
+    }
+}
@@ -0,0 +1,218 @@
+#include "culling.h"
+
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define CULLING_SSE 1
+#endif
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CULLING_AVX 1
+#endif
+
+static const size_t CULL_BATCH = 8;   // scratch padding, the widest batch
+
+// World bounds of one object. Every SIMD path below does exactly these
+// operations in this order, so all paths agree bit for bit.
+static inline void transform_bounds(const CullBounds &b, const glm::mat4 &m,
+                                    float *cx, float *cy, float *cz,
+                                    float *ex, float *ey, float *ez, float *r) {
+    *cx = ((m[0][0] * b.center.x + m[1][0] * b.center.y) + m[2][0] * b.center.z) + m[3][0];
+    *cy = ((m[0][1] * b.center.x + m[1][1] * b.center.y) + m[2][1] * b.center.z) + m[3][1];
+    *cz = ((m[0][2] * b.center.x + m[1][2] * b.center.y) + m[2][2] * b.center.z) + m[3][2];
+
+    // extents through the absolute matrix (Arvo)
+    *ex = (std::fabs(m[0][0]) * b.extent.x + std::fabs(m[1][0]) * b.extent.y) + std::fabs(m[2][0]) * b.extent.z;
+    *ey = (std::fabs(m[0][1]) * b.extent.x + std::fabs(m[1][1]) * b.extent.y) + std::fabs(m[2][1]) * b.extent.z;
+    *ez = (std::fabs(m[0][2]) * b.extent.x + std::fabs(m[1][2]) * b.extent.y) + std::fabs(m[2][2]) * b.extent.z;
+
+    // radius scaled by the largest axis scale
+    float s0 = (m[0][0] * m[0][0] + m[0][1] * m[0][1]) + m[0][2] * m[0][2];
+    float s1 = (m[1][0] * m[1][0] + m[1][1] * m[1][1]) + m[1][2] * m[1][2];
+    float s2 = (m[2][0] * m[2][0] + m[2][1] * m[2][1]) + m[2][2] * m[2][2];
+    float s = s0 > s1 ? s0 : s1;
+    s = s > s2 ? s : s2;
+    *r = b.center.w * std::sqrt(s);
+}
+
+static inline bool outside(const Frustum *f, float cx, float cy, float cz,
+                           float ex, float ey, float ez, float r) {
+    for (int p = 0; p < 6; ++p) {
+        const glm::vec4 &pl = f->planes[p];
+        float dist = ((pl.x * cx + pl.y * cy) + pl.z * cz) + pl.w;
+        float box = (std::fabs(pl.x) * ex + std::fabs(pl.y) * ey) + std::fabs(pl.z) * ez;
+        if (dist + box < 0.0f || dist + r < 0.0f) return true;
+    }
+    return false;
+}
+
+#ifdef CULLING_SSE
+static inline __m128 abs_ps(__m128 v) {
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+}
+
+// Four objects: matrices and bounds are loaded as columns and transposed so
+// each register holds one component of four objects.
+static void transform_bounds4(const CullBounds *b, const glm::mat4 *const *m, CullScratch *s, size_t i) {
+    __m128 col[4][4];   // col[c][k]: component k of column c, four objects
+    for (int c = 0; c < 4; ++c) {
+        __m128 r0 = _mm_loadu_ps(&(*m[0])[c][0]);
+        __m128 r1 = _mm_loadu_ps(&(*m[1])[c][0]);
+        __m128 r2 = _mm_loadu_ps(&(*m[2])[c][0]);
+        __m128 r3 = _mm_loadu_ps(&(*m[3])[c][0]);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        col[c][0] = r0; col[c][1] = r1; col[c][2] = r2; col[c][3] = r3;
+    }
+    __m128 bx = _mm_loadu_ps(&b[0].center.x), by = _mm_loadu_ps(&b[1].center.x);
+    __m128 bz = _mm_loadu_ps(&b[2].center.x), br = _mm_loadu_ps(&b[3].center.x);
+    _MM_TRANSPOSE4_PS(bx, by, bz, br);   // center x, y, z, radius
+    __m128 ex = _mm_loadu_ps(&b[0].extent.x), ey = _mm_loadu_ps(&b[1].extent.x);
+    __m128 ez = _mm_loadu_ps(&b[2].extent.x), ew = _mm_loadu_ps(&b[3].extent.x);
+    _MM_TRANSPOSE4_PS(ex, ey, ez, ew);
+
+    float *outC[3] = { &s->cx[i], &s->cy[i], &s->cz[i] };
+    float *outE[3] = { &s->ex[i], &s->ey[i], &s->ez[i] };
+    for (int k = 0; k < 3; ++k) {
+        __m128 c = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(col[0][k], bx), _mm_mul_ps(col[1][k], by)),
+                                         _mm_mul_ps(col[2][k], bz)), col[3][k]);
+        __m128 e = _mm_add_ps(_mm_add_ps(_mm_mul_ps(abs_ps(col[0][k]), ex), _mm_mul_ps(abs_ps(col[1][k]), ey)),
+                              _mm_mul_ps(abs_ps(col[2][k]), ez));
+        _mm_storeu_ps(outC[k], c);
+        _mm_storeu_ps(outE[k], e);
+    }
+
+    __m128 scale[3];
+    for (int c = 0; c < 3; ++c)
+        scale[c] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(col[c][0], col[c][0]), _mm_mul_ps(col[c][1], col[c][1])),
+                              _mm_mul_ps(col[c][2], col[c][2]));
+    __m128 smax = _mm_max_ps(_mm_max_ps(scale[0], scale[1]), scale[2]);
+    _mm_storeu_ps(&s->radius[i], _mm_mul_ps(br, _mm_sqrt_ps(smax)));
+}
+#endif
+
+// Appends the set bits of `mask`, offset by `base`.
+static inline void push_mask(std::vector<uint32_t> *visible, unsigned mask, size_t base, size_t count) {
+    while (mask) {
+        unsigned bit = 0;
+        while (!(mask & (1u << bit))) ++bit;
+        mask &= mask - 1;
+        if (base + bit < count) visible->push_back((uint32_t)(base + bit));
+    }
+}
+
+void frustum_from_matrix(Frustum *frustum, const glm::mat4 &m)
+{
+    // Gribb/Hartmann: rows of the matrix combined
+    glm::vec4 row[4];
+    for (int r = 0; r < 4; ++r)
+        row[r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+
+    frustum->planes[0] = row[3] + row[0];   // left
+    frustum->planes[1] = row[3] - row[0];   // right
+    frustum->planes[2] = row[3] + row[1];   // bottom
+    frustum->planes[3] = row[3] - row[1];   // top
+    frustum->planes[4] = row[3] + row[2];   // near
+    frustum->planes[5] = row[3] - row[2];   // far
+    for (glm::vec4 &p : frustum->planes) {
+        float len = std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+        p = p / len;
+    }
+}
+
+static_assert(CULL_RANGE_ALIGN % CULL_BATCH == 0, "ranges must not split a batch");
+
+void cull_reserve(CullScratch *scratch, size_t count)
+{
+    const size_t padded = (count + CULL_BATCH - 1) / CULL_BATCH * CULL_BATCH;
+    if (scratch->cx.size() < padded) {
+        for (std::vector<float> *v : { &scratch->cx, &scratch->cy, &scratch->cz,
+                                       &scratch->ex, &scratch->ey, &scratch->ez, &scratch->radius })
+            v->resize(padded);
+    }
+}
+
+void cull_frustum(CullScratch *scratch, const Frustum *frustum,
+                  const CullBounds *bounds, const glm::mat4 *const *models, size_t count,
+                  std::vector<uint32_t> *visible)
+{
+    cull_reserve(scratch, count);
+    cull_frustum_range(scratch, frustum, bounds, models, 0, count, visible);
+}
+
+void cull_frustum_range(CullScratch *scratch, const Frustum *frustum,
+                        const CullBounds *bounds, const glm::mat4 *const *models, size_t begin, size_t end,
+                        std::vector<uint32_t> *visible)
+{
+    // pass 1: world bounds
+    size_t i = begin;
+#ifdef CULLING_SSE
+    for (; i + 4 <= end; i += 4)
+        transform_bounds4(bounds + i, models + i, scratch, i);
+#endif
+    for (; i < end; ++i)
+        transform_bounds(bounds[i], *models[i], &scratch->cx[i], &scratch->cy[i], &scratch->cz[i],
+                         &scratch->ex[i], &scratch->ey[i], &scratch->ez[i], &scratch->radius[i]);
+    // the padding is tested too; its results are dropped by push_mask
+
+    // pass 2: planes
+    i = begin;
+#if defined(CULLING_AVX)
+    for (; i < end; i += 8) {
+        __m256 cx = _mm256_loadu_ps(&scratch->cx[i]), cy = _mm256_loadu_ps(&scratch->cy[i]), cz = _mm256_loadu_ps(&scratch->cz[i]);
+        __m256 ex = _mm256_loadu_ps(&scratch->ex[i]), ey = _mm256_loadu_ps(&scratch->ey[i]), ez = _mm256_loadu_ps(&scratch->ez[i]);
+        __m256 r = _mm256_loadu_ps(&scratch->radius[i]);
+        __m256 out = _mm256_setzero_ps();
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 sign = _mm256_set1_ps(-0.0f);
+        for (int p = 0; p < 6; ++p) {
+            const glm::vec4 &pl = frustum->planes[p];
+            __m256 nx = _mm256_set1_ps(pl.x), ny = _mm256_set1_ps(pl.y), nz = _mm256_set1_ps(pl.z);
+            __m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, cx), _mm256_mul_ps(ny, cy)),
+                                                      _mm256_mul_ps(nz, cz)), _mm256_set1_ps(pl.w));
+            __m256 box = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_andnot_ps(sign, nx), ex),
+                                                     _mm256_mul_ps(_mm256_andnot_ps(sign, ny), ey)),
+                                       _mm256_mul_ps(_mm256_andnot_ps(sign, nz), ez));
+            out = _mm256_or_ps(out, _mm256_cmp_ps(_mm256_add_ps(dist, box), zero, _CMP_LT_OQ));
+            out = _mm256_or_ps(out, _mm256_cmp_ps(_mm256_add_ps(dist, r), zero, _CMP_LT_OQ));
+        }
+        push_mask(visible, ~(unsigned)_mm256_movemask_ps(out) & 0xffu, i, end);
+    }
+#elif defined(CULLING_SSE)
+    for (; i < end; i += 4) {
+        __m128 cx = _mm_loadu_ps(&scratch->cx[i]), cy = _mm_loadu_ps(&scratch->cy[i]), cz = _mm_loadu_ps(&scratch->cz[i]);
+        __m128 ex = _mm_loadu_ps(&scratch->ex[i]), ey = _mm_loadu_ps(&scratch->ey[i]), ez = _mm_loadu_ps(&scratch->ez[i]);
+        __m128 r = _mm_loadu_ps(&scratch->radius[i]);
+        __m128 out = _mm_setzero_ps();
+        const __m128 zero = _mm_setzero_ps();
+        for (int p = 0; p < 6; ++p) {
+            const glm::vec4 &pl = frustum->planes[p];
+            __m128 nx = _mm_set1_ps(pl.x), ny = _mm_set1_ps(pl.y), nz = _mm_set1_ps(pl.z);
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)),
+                                                _mm_mul_ps(nz, cz)), _mm_set1_ps(pl.w));
+            __m128 box = _mm_add_ps(_mm_add_ps(_mm_mul_ps(abs_ps(nx), ex), _mm_mul_ps(abs_ps(ny), ey)),
+                                    _mm_mul_ps(abs_ps(nz), ez));
+            out = _mm_or_ps(out, _mm_cmplt_ps(_mm_add_ps(dist, box), zero));
+            out = _mm_or_ps(out, _mm_cmplt_ps(_mm_add_ps(dist, r), zero));
+        }
+        push_mask(visible, ~(unsigned)_mm_movemask_ps(out) & 0xfu, i, end);
+    }
+#else
+    for (; i < end; ++i)
+        if (!outside(frustum, scratch->cx[i], scratch->cy[i], scratch->cz[i],
+                     scratch->ex[i], scratch->ey[i], scratch->ez[i], scratch->radius[i]))
+            visible->push_back((uint32_t)i);
+#endif
+}
+
+void cull_frustum_reference(const Frustum *frustum,
+                            const CullBounds *bounds, const glm::mat4 *const *models, size_t count,
+                            std::vector<uint32_t> *visible)
+{
+    for (size_t i = 0; i < count; ++i) {
+        float cx, cy, cz, ex, ey, ez, r;
+        transform_bounds(bounds[i], *models[i], &cx, &cy, &cz, &ex, &ey, &ez, &r);
+        if (!outside(frustum, cx, cy, cz, ex, ey, ez, r))
+            visible->push_back((uint32_t)i);
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Frustum culling of objects given by local bounds and a world matrix.
+//
+// Objects are processed in two passes over structure-of-arrays scratch: the
+// first transforms four objects at a time into a world box (center and
+// half extents) and a world sphere, the second tests those against the six
+// planes eight (AVX) or four (SSE) objects at a time. An object is culled
+// if either its box or its sphere is fully outside one plane.
+
+struct Frustum
+{
+    glm::vec4 planes[6];   // xyz normal pointing inside, w distance; normalized
+};
+
+// Local bounds of a mesh: box center and half extents, and a sphere around
+// the same center.
+struct CullBounds
+{
+    glm::vec4 center;   // xyz center, w sphere radius
+    glm::vec4 extent;   // xyz half size, w unused
+};
+
+struct CullStats
+{
+    int tested;
+    int visible;
+    double seconds;
+};
+
+struct CullScratch
+{
+    // world space bounds, one entry per object, padded to the batch width
+    std::vector<float> cx, cy, cz;
+    std::vector<float> ex, ey, ez;
+    std::vector<float> radius;
+};
+
+// Planes of the clip volume of `viewProj` (OpenGL conventions).
+void frustum_from_matrix(Frustum *frustum, const glm::mat4 &viewProj);
+
+// Tests `count` objects; object i has local bounds `bounds[i]` and world
+// matrix `*models[i]`. Appends the i of every visible object to `visible`,
+// in increasing order.
+void cull_frustum(CullScratch *scratch, const Frustum *frustum,
+                  const CullBounds *bounds, const glm::mat4 *const *models, size_t count,
+                  std::vector<uint32_t> *visible);
+
+// cull_frustum split for running on several threads: cull_reserve sizes the
+// scratch for all `count` objects, then each cull_frustum_range tests
+// objects [begin, end) and appends their visible indices. `begin` must be a
+// multiple of CULL_RANGE_ALIGN, and only the range ending at `count` may end
+// unaligned, so no two ranges write the same scratch batch.
+const size_t CULL_RANGE_ALIGN = 8;
+
+void cull_reserve(CullScratch *scratch, size_t count);
+
+void cull_frustum_range(CullScratch *scratch, const Frustum *frustum,
+                        const CullBounds *bounds, const glm::mat4 *const *models, size_t begin, size_t end,
+                        std::vector<uint32_t> *visible);
+
+// One object at a time with the same arithmetic. Reference for the benchmark.
+void cull_frustum_reference(const Frustum *frustum,
+                            const CullBounds *bounds, const glm::mat4 *const *models, size_t count,
+                            std::vector<uint32_t> *visible);
@@ -0,0 +1,129 @@
+#include "frameprep.h"
+#include "jobsystem.h"
+#include "radixsort.h"
+
+#include <algorithm>
+
+static const size_t FILL_GRAIN = 512;   // objects per job writing per-object data
+
+uint64_t frameprep_key(uint32_t state, uint32_t mesh, int lod, float depth01)
+{
+    depth01 = depth01 < 0.0f ? 0.0f : (depth01 > 1.0f ? 1.0f : depth01);
+    uint64_t depth = (uint64_t)(depth01 * 65535.0f);
+    return ((uint64_t)state << 32) | ((uint64_t)(mesh & 0x1fff) << 19) | ((uint64_t)(lod & 0x7) << 16) | depth;
+}
+
+int frameprep_select_lod(const PrepDraw *draw, float pixelsPerUnit)
+{
+    if (draw->lodForce >= 0)
+        return std::min(draw->lodForce, draw->lodCount - 1);
+    int lod = std::min(*draw->lod, draw->lodCount - 1);
+    while (lod > 0 && draw->lods[lod].error * pixelsPerUnit > draw->lodErrorPixels)
+        --lod;
+    const float coarser = draw->lodErrorPixels * (1.0f - draw->lodHysteresis);
+    while (lod + 1 < draw->lodCount && draw->lods[lod + 1].error * pixelsPerUnit <= coarser)
+        ++lod;
+    return lod;
+}
+
+void frameprep_gather(FramePrep *prep, JobSystem *jobs, size_t objectCount,
+                      const std::function<uint32_t(size_t, size_t)> &count,
+                      const std::function<void(size_t, size_t, size_t)> &write)
+{
+    // each slice is counted, then written at its offset
+    const size_t slices = (objectCount + FRAMEPREP_SLICE - 1) / FRAMEPREP_SLICE;
+    prep->sliceCounts.assign(slices + 1, 0);
+    jobsystem_parallel_for(jobs, slices, 1, [&](size_t first, size_t last) {
+        for (size_t c = first; c < last; ++c)
+            prep->sliceCounts[c + 1] = count(c * FRAMEPREP_SLICE, std::min(objectCount, (c + 1) * FRAMEPREP_SLICE));
+    });
+    for (size_t c = 0; c < slices; ++c)
+        prep->sliceCounts[c + 1] += prep->sliceCounts[c];
+
+    const size_t total = prep->sliceCounts[slices];
+    prep->candidates.resize(total);
+    prep->cullBounds.resize(total);
+    prep->cullModels.resize(total);
+    prep->draws.resize(total);
+    jobsystem_parallel_for(jobs, slices, 1, [&](size_t first, size_t last) {
+        for (size_t c = first; c < last; ++c)
+            write(c * FRAMEPREP_SLICE, std::min(objectCount, (c + 1) * FRAMEPREP_SLICE), prep->sliceCounts[c]);
+    });
+}
+
+void frameprep_cull(FramePrep *prep, JobSystem *jobs, const Frustum *frustum)
+{
+    // each slice is culled into its own list; joined in order they are what
+    // one cull_frustum over everything gives
+    static_assert(FRAMEPREP_SLICE % CULL_RANGE_ALIGN == 0, "slices must start on a cull batch");
+    const size_t count = prep->candidates.size();
+    const size_t slices = (count + FRAMEPREP_SLICE - 1) / FRAMEPREP_SLICE;
+    if (prep->sliceVisible.size() < slices) prep->sliceVisible.resize(slices);
+    cull_reserve(&prep->cullScratch, count);
+    jobsystem_parallel_for(jobs, slices, 1, [&](size_t first, size_t last) {
+        for (size_t c = first; c < last; ++c) {
+            prep->sliceVisible[c].clear();
+            cull_frustum_range(&prep->cullScratch, frustum, prep->cullBounds.data(), prep->cullModels.data(),
+                               c * FRAMEPREP_SLICE, std::min(count, (c + 1) * FRAMEPREP_SLICE), &prep->sliceVisible[c]);
+        }
+    });
+    prep->visible.clear();
+    for (size_t c = 0; c < slices; ++c)
+        prep->visible.insert(prep->visible.end(), prep->sliceVisible[c].begin(), prep->sliceVisible[c].end());
+}
+
+void frameprep_keys(FramePrep *prep, JobSystem *jobs, const glm::mat4 &view, const glm::mat4 &proj,
+                    int viewportHeight, float nearClip, float farClip)
+{
+    // every visible object writes its own key, so slices need no merging
+    const size_t count = prep->visible.size();
+    prep->keys.resize(count);
+    prep->order.resize(count);
+    const float projScale = 0.5f * proj[1][1] * (float)viewportHeight;   // pixels per unit at unit distance
+    const glm::vec3 eye = glm::vec3(glm::inverse(view)[3]);
+    const CullScratch &world = prep->cullScratch;
+    jobsystem_parallel_for(jobs, count, FRAMEPREP_SLICE / 4, [&](size_t first, size_t last) {
+        for (size_t k = first; k < last; ++k) {
+            uint32_t v = prep->visible[k];
+            const PrepDraw &draw = prep->draws[v];
+
+            // model units to pixels at the nearest point of the bounding sphere
+            glm::vec3 toCenter = glm::vec3(world.cx[v], world.cy[v], world.cz[v]) - eye;
+            float distance = std::max(glm::length(toCenter) - world.radius[v], nearClip);
+            float scale = prep->cullBounds[v].center.w > 0.0f ? world.radius[v] / prep->cullBounds[v].center.w : 1.0f;
+            int lod = frameprep_select_lod(&draw, scale * projScale / distance);
+            *draw.lod = lod;
+
+            float viewDepth = -(view * (*prep->cullModels[v])[3]).z;
+            prep->keys[k] = frameprep_key(draw.state, draw.mesh, lod, viewDepth / farClip);
+            prep->order[k] = v;
+        }
+    });
+}
+
+void frameprep_sort(FramePrep *prep, JobSystem *jobs)
+{
+    radixsort_u64(prep->keys.data(), prep->order.data(), prep->keys.size(), &prep->scratchKeys, &prep->scratchOrder);
+    prep->items.resize(prep->order.size());
+    jobsystem_parallel_for(jobs, prep->order.size(), FRAMEPREP_SLICE, [&](size_t first, size_t last) {
+        for (size_t k = first; k < last; ++k)
+            prep->items[k] = prep->candidates[prep->order[k]];
+    });
+}
+
+void frameprep_fill(const FramePrep *prep, JobSystem *jobs, const TransformHierarchy *transforms,
+                    ObjectGPUData *out)
+{
+    jobsystem_parallel_for(jobs, prep->order.size(), FILL_GRAIN, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            const PrepDraw &draw = prep->draws[prep->order[i]];
+            const glm::mat4 &world = transforms_world(transforms, draw.node);
+            const glm::mat3 &normal = transforms_normal(transforms, draw.node);
+            ObjectGPUData &data = out[i];
+            data.model = draw.dequantize ? world * *draw.dequantize : world;
+            for (int c = 0; c < 3; ++c)
+                data.normalMatrix[c] = glm::vec4(normal[c], 0.0f);
+            data.color = glm::vec4(draw.color, 1.0f);
+        }
+    });
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "culling.h"
+#include "mesh.h"
+#include "transforms.h"
+
+struct JobSystem;
+
+// The CPU side of building a frame's draw list, shared by the render queue
+// and the frame preparation benchmark. The caller gathers the objects worth
+// culling, then the stages run in slices on a job system:
+//
+//   frameprep_gather   candidates and what drawing each one takes
+//   frameprep_cull     frustum culling into `visible`
+//   frameprep_keys     LOD selection and a sort key per visible object
+//   frameprep_sort     keys in draw order, `items` the objects
+//   frameprep_fill     per-object data for the draws
+//
+// Each slice writes only its own entries and slices are joined in order, so
+// results do not depend on the number of threads. Sort keys are laid out
+// by frameprep_key below.
+
+const size_t FRAMEPREP_SLICE = 2048;   // objects per job
+
+// What drawing one candidate takes, written by the gather.
+struct PrepDraw
+{
+    NodeId node;
+    uint32_t state;       // the key's program (high 16 bits) and geometry (low 16)
+    uint32_t mesh;        // id for the key and for telling runs apart
+    const MeshLod *lods;  // finest first
+    int lodCount;
+    const glm::mat4 *dequantize;   // applied before the world matrix, or null
+    glm::vec3 color;
+
+    // level of detail, as on RenderObj
+    float lodErrorPixels;
+    float lodHysteresis;
+    int lodForce;
+    int *lod;             // the object's current level, updated in place
+};
+
+// std430 mirror of ObjectData in lit_shader_mdi.vs, and the per-instance
+// attributes of lit_shader_instanced.vs
+struct ObjectGPUData
+{
+    glm::mat4 model;
+    glm::vec4 normalMatrix[3];   // mat3 columns, padded as std430 does
+    glm::vec4 color;
+};
+
+struct FramePrep
+{
+    // one entry per candidate
+    std::vector<uint32_t> candidates;   // the caller's object index
+    std::vector<CullBounds> cullBounds;
+    std::vector<const glm::mat4*> cullModels;
+    std::vector<PrepDraw> draws;
+    std::vector<uint32_t> visible;      // indices into candidates, ascending
+    CullScratch cullScratch;            // world bounds after frameprep_cull
+
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> order;   // candidate index for each key
+    std::vector<uint32_t> items;   // object index for each key, after frameprep_sort
+
+    std::vector<uint32_t> sliceCounts;
+    std::vector<std::vector<uint32_t>> sliceVisible;
+    std::vector<uint64_t> scratchKeys;
+    std::vector<uint32_t> scratchOrder;
+};
+
+// Keys of the same state group share these bits.
+inline bool frameprep_same_state(uint64_t a, uint64_t b) { return (a >> 32) == (b >> 32); }
+inline bool frameprep_same_mesh(uint64_t a, uint64_t b) { return (a >> 16) == (b >> 16); }
+
+// The sort key of one visible object:
+//
+//   63..48 program | 47..32 geometry | 31..16 mesh | 15..0 view depth
+//
+// The geometry field is the vertex array of the mesh's arena over one bit
+// of index size. The mesh field is 13 bits of mesh id over 3 bits of LOD;
+// ids past 13 bits wrap, so callers split runs where the mesh id changes.
+// Depth is 0..1 of the far plane, clamped.
+uint64_t frameprep_key(uint32_t state, uint32_t mesh, int lod, float depth01);
+
+// Keeps the current level while it is within the error budget; only steps
+// coarser when the next level fits with the hysteresis margin to spare.
+int frameprep_select_lod(const PrepDraw *draw, float pixelsPerUnit);
+
+// Slices [0, objectCount) of the caller's objects. count(begin, end)
+// returns how many candidates the slice has; write(begin, end, k) then
+// writes them from candidate k on, in object order, to every per-candidate
+// array. Both run on the job system.
+void frameprep_gather(FramePrep *prep, JobSystem *jobs, size_t objectCount,
+                      const std::function<uint32_t(size_t, size_t)> &count,
+                      const std::function<void(size_t, size_t, size_t)> &write);
+
+void frameprep_cull(FramePrep *prep, JobSystem *jobs, const Frustum *frustum);
+
+// For a viewport `viewportHeight` pixels tall; depth is scaled by farClip.
+void frameprep_keys(FramePrep *prep, JobSystem *jobs, const glm::mat4 &view, const glm::mat4 &proj,
+                    int viewportHeight, float nearClip, float farClip);
+
+void frameprep_sort(FramePrep *prep, JobSystem *jobs);
+
+// Writes element i for sorted key i, for instance into a mapped buffer.
+void frameprep_fill(const FramePrep *prep, JobSystem *jobs, const TransformHierarchy *transforms,
+                    ObjectGPUData *out);
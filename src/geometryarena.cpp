@@ -0,0 +1,213 @@
+#include "geometryarena.h"
+
+#include <algorithm>
+
+static const uint32_t INITIAL_VERTICES = 1u << 16;
+static const uint32_t INITIAL_INDEX_WORDS = 1u << 17;
+static const int DEFRAG_MAX_SKIPS = 16;   // allocations with no hole below, per pass
+
+static void attrib_gl_format(uint32_t format, GLenum *type, GLboolean *normalized) {
+    switch (format) {
+    case MESH_ATTRIB_UNORM16:
+        *type = GL_UNSIGNED_SHORT;
+        *normalized = GL_TRUE;
+        break;
+    case MESH_ATTRIB_SNORM16:
+        *type = GL_SHORT;
+        *normalized = GL_TRUE;
+        break;
+    case MESH_ATTRIB_FLOAT32:
+    default:
+        *type = GL_FLOAT;
+        *normalized = GL_FALSE;
+        break;
+    }
+}
+
+// (Re)points the vertex array at the current buffers.
+static void point_vertex_array(const GeometryArena *arena) {
+    glBindVertexArray(arena->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, arena->vbo);
+    for (uint32_t i = 0; i < arena->attribCount; ++i) {
+        const MeshFileAttrib &a = arena->attribs[i];
+        GLenum type;
+        GLboolean normalized;
+        attrib_gl_format(a.format, &type, &normalized);
+        glVertexAttribPointer(a.location, (GLint)a.components, type, normalized, (GLsizei)arena->vertexStride, (void*)(uintptr_t)a.offset);
+        glEnableVertexAttribArray(a.location);
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena->ebo);
+}
+
+static GLuint make_buffer(size_t bytes) {
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)bytes, nullptr, GL_STATIC_DRAW);
+    return buffer;
+}
+
+// New buffer of `newBytes` holding the first `oldBytes` of `old`.
+static GLuint grow_buffer(GLuint old, size_t oldBytes, size_t newBytes) {
+    GLuint buffer = make_buffer(newBytes);
+    glBindBuffer(GL_COPY_READ_BUFFER, old);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, (GLsizeiptr)oldBytes);
+    glDeleteBuffers(1, &old);
+    return buffer;
+}
+
+// Allocates `size` units, doubling the buffer until they fit.
+static uint32_t alloc_growing(GeometryArena *arena, RangeAllocator *alloc, GLuint *buffer, size_t unitBytes, uint32_t size) {
+    if (size == 0) return 0;
+    uint32_t offset = rangealloc_alloc(alloc, size);
+    if (offset != RANGE_NONE) return offset;
+
+    uint32_t capacity = std::max(alloc->capacity * 2, alloc->capacity + size);
+    *buffer = grow_buffer(*buffer, (size_t)alloc->capacity * unitBytes, (size_t)capacity * unitBytes);
+    rangealloc_grow(alloc, capacity);
+    point_vertex_array(arena);
+    glBindVertexArray(0);
+    arena->stats.grows++;
+    return rangealloc_alloc(alloc, size);
+}
+
+void geometryarena_create(GeometryArena *arena, const MeshFileHeader *header)
+{
+    arena->vertexFormat = header->vertexFormat;
+    arena->vertexStride = header->vertexStride;
+    arena->attribCount = header->attribCount;
+    std::copy(header->attribs, header->attribs + header->attribCount, arena->attribs);
+
+    rangealloc_init(&arena->vertices, INITIAL_VERTICES);
+    rangealloc_init(&arena->indices, INITIAL_INDEX_WORDS);
+    arena->ranges.clear();
+    arena->freeSlots.clear();
+    arena->byVertexOffset.clear();
+    arena->byIndexOffset.clear();
+    arena->stats = GeometryArenaStats{};
+
+    glGenVertexArrays(1, &arena->vao);
+    arena->vbo = make_buffer((size_t)INITIAL_VERTICES * arena->vertexStride);
+    arena->ebo = make_buffer((size_t)INITIAL_INDEX_WORDS * 4);
+    point_vertex_array(arena);
+    glBindVertexArray(0);
+}
+
+void geometryarena_destroy(GeometryArena *arena)
+{
+    glDeleteBuffers(1, &arena->vbo);
+    glDeleteBuffers(1, &arena->ebo);
+    glDeleteVertexArrays(1, &arena->vao);
+    arena->vao = arena->vbo = arena->ebo = 0;
+    arena->ranges.clear();
+    arena->freeSlots.clear();
+    arena->byVertexOffset.clear();
+    arena->byIndexOffset.clear();
+    rangealloc_init(&arena->vertices, 0);
+    rangealloc_init(&arena->indices, 0);
+}
+
+GeometryAllocId geometryarena_add(GeometryArena *arena, const MeshAsset *asset)
+{
+    const MeshFileHeader *h = asset->header;
+    GeometryRange r;
+    r.vertexCount = h->vertexCount;
+    r.indexWords = (uint32_t)((h->indexBytes + 3) / 4);
+    r.vertexOffset = alloc_growing(arena, &arena->vertices, &arena->vbo, arena->vertexStride, r.vertexCount);
+    r.indexOffset = alloc_growing(arena, &arena->indices, &arena->ebo, 4, r.indexWords);
+    r.live = true;
+
+    // through the copy target so no vertex array's element binding changes
+    glBindBuffer(GL_COPY_WRITE_BUFFER, arena->vbo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)r.vertexOffset * arena->vertexStride, (GLsizeiptr)h->vertexBytes, asset->vertexData);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, arena->ebo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)r.indexOffset * 4, (GLsizeiptr)h->indexBytes, asset->indexData);
+
+    GeometryAllocId id;
+    if (!arena->freeSlots.empty()) {
+        id = arena->freeSlots.back();
+        arena->freeSlots.pop_back();
+    } else {
+        id = (GeometryAllocId)arena->ranges.size();
+        arena->ranges.emplace_back();
+    }
+    arena->ranges[id] = r;
+    if (r.vertexCount) arena->byVertexOffset[r.vertexOffset] = id;
+    if (r.indexWords) arena->byIndexOffset[r.indexOffset] = id;
+    return id;
+}
+
+void geometryarena_remove(GeometryArena *arena, GeometryAllocId id)
+{
+    if (id == GEOMETRY_ALLOC_NONE || !arena->ranges[id].live) return;
+    GeometryRange &r = arena->ranges[id];
+    if (r.vertexCount) {
+        rangealloc_free(&arena->vertices, r.vertexOffset, r.vertexCount);
+        arena->byVertexOffset.erase(r.vertexOffset);
+    }
+    if (r.indexWords) {
+        rangealloc_free(&arena->indices, r.indexOffset, r.indexWords);
+        arena->byIndexOffset.erase(r.indexOffset);
+    }
+    r = GeometryRange{};
+    arena->freeSlots.push_back(id);
+}
+
+struct DefragPass
+{
+    RangeAllocator *alloc;
+    std::map<uint32_t, GeometryAllocId> *owners;
+    uint32_t GeometryRange::*offset;
+    uint32_t GeometryRange::*size;
+    GLuint buffer;
+    size_t unitBytes;
+};
+
+// Walks down from the last allocation, moving each into the lowest hole
+// before it that fits. One allocation bigger than the budget may go when
+// nothing else was copied, otherwise it would never move.
+static size_t defrag_pass(GeometryArena *arena, const DefragPass &p, size_t budgetBytes) {
+    size_t copied = 0;
+    int skipped = 0;
+    auto it = p.owners->end();
+    glBindBuffer(GL_COPY_READ_BUFFER, p.buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, p.buffer);
+    while (it != p.owners->begin() && copied < budgetBytes && skipped < DEFRAG_MAX_SKIPS) {
+        --it;
+        GeometryAllocId id = it->second;
+        GeometryRange &r = arena->ranges[id];
+        const uint32_t from = r.*p.offset, size = r.*p.size;
+        const size_t bytes = size * p.unitBytes;
+        if (copied > 0 && copied + bytes > budgetBytes) break;
+
+        uint32_t to = rangealloc_alloc_below(p.alloc, size, from);
+        if (to == RANGE_NONE) {
+            ++skipped;
+            continue;
+        }
+        // the hole ends at or before `from`, so the ranges don't overlap
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)(from * p.unitBytes),
+                            (GLintptr)(to * p.unitBytes), (GLsizeiptr)bytes);
+        rangealloc_free(p.alloc, from, size);
+        r.*p.offset = to;
+        it = p.owners->erase(it);
+        (*p.owners)[to] = id;
+        copied += bytes;
+        arena->stats.moves++;
+    }
+    arena->stats.movedBytes += copied;
+    return copied;
+}
+
+size_t geometryarena_defrag(GeometryArena *arena, size_t budgetBytes)
+{
+    if (!arena->vao) return 0;
+    DefragPass vertices = { &arena->vertices, &arena->byVertexOffset, &GeometryRange::vertexOffset,
+                            &GeometryRange::vertexCount, arena->vbo, arena->vertexStride };
+    DefragPass indices = { &arena->indices, &arena->byIndexOffset, &GeometryRange::indexOffset,
+                           &GeometryRange::indexWords, arena->ebo, 4 };
+    size_t copied = defrag_pass(arena, vertices, budgetBytes);
+    if (copied < budgetBytes)
+        copied += defrag_pass(arena, indices, budgetBytes - copied);
+    return copied;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "meshcache.h"
+#include "rangealloc.h"
+
+// Shared vertex and index buffers for every mesh of one vertex format, with
+// one vertex array over them. Meshes are suballocated: vertex ranges in
+// whole vertices, so a range's offset is its draw's base vertex, and index
+// ranges in 4 byte words, which keeps 16 and 32 bit index lists aligned for
+// indirect draws. The buffers double when full (a GPU side copy), and free
+// space is handed back on unload.
+//
+// geometryarena_defrag moves the allocations nearest the end of a buffer
+// into holes before them, a bounded number of bytes per call, so the free
+// space gathers at the end without a frame ever copying much. The copies
+// are ordinary GL commands, ordered before any later draw.
+
+typedef uint32_t GeometryAllocId;
+const GeometryAllocId GEOMETRY_ALLOC_NONE = 0xffffffffu;
+
+struct GeometryRange
+{
+    uint32_t vertexOffset;   // base vertex
+    uint32_t vertexCount;
+    uint32_t indexOffset;    // in words
+    uint32_t indexWords;
+    bool live;
+};
+
+struct GeometryArenaStats
+{
+    long moves;           // allocations moved by defragmentation
+    size_t movedBytes;
+    long grows;
+};
+
+struct GeometryArena
+{
+    uint32_t vertexFormat;   // MeshVertexFormat
+    uint32_t vertexStride;
+    uint32_t attribCount;
+    MeshFileAttrib attribs[MESH_FILE_MAX_ATTRIBS];
+
+    GLuint vao = 0, vbo = 0, ebo = 0;   // no vertex array until the first mesh
+    RangeAllocator vertices;   // in vertices
+    RangeAllocator indices;    // in words
+
+    std::vector<GeometryRange> ranges;   // indexed by GeometryAllocId, slots are reused
+    std::vector<GeometryAllocId> freeSlots;
+    std::map<uint32_t, GeometryAllocId> byVertexOffset;   // live ranges, for defragmentation
+    std::map<uint32_t, GeometryAllocId> byIndexOffset;
+    GeometryArenaStats stats;
+};
+
+// Creates the buffers and vertex array for the layout in `header`.
+void geometryarena_create(GeometryArena *arena, const MeshFileHeader *header);
+
+void geometryarena_destroy(GeometryArena *arena);
+
+// Allocates and uploads the vertices and indices of a cooked mesh.
+GeometryAllocId geometryarena_add(GeometryArena *arena, const MeshAsset *asset);
+
+void geometryarena_remove(GeometryArena *arena, GeometryAllocId id);
+
+inline const GeometryRange& geometryarena_range(const GeometryArena *arena, GeometryAllocId id) {
+    return arena->ranges[id];
+}
+
+// Moves allocations towards the start of the buffers, copying at most about
+// `budgetBytes`. Returns the bytes copied.
+size_t geometryarena_defrag(GeometryArena *arena, size_t budgetBytes);
@@ -0,0 +1,32 @@
+#include "glstats.h"
+
+#include <glad/glad.h>
+#include <cstring>
+
+static GLStats current;
+static GLStats last;
+
+static void count_gl_call(const char *name, void *funcptr, int len_args, ...) {
+    (void)funcptr;
+    (void)len_args;
+    current.calls++;
+    // glDrawArrays, glDrawElementsInstanced, glMultiDrawElementsIndirect...
+    if (std::strncmp(name, "glDraw", 6) == 0 || std::strncmp(name, "glMultiDraw", 11) == 0)
+        current.drawCalls++;
+}
+
+void glstats_install()
+{
+    glad_set_pre_callback(count_gl_call);
+}
+
+void glstats_begin_frame()
+{
+    last = current;
+    current = GLStats{};
+}
+
+const GLStats& glstats_last()
+{
+    return last;
+}
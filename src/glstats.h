@@ -0,0 +1,17 @@
+#pragma once
+
+// Counts GL calls made through glad. The bundled glad is the debug
+// generator, which routes every call through a pre-call hook; ImGui's
+// backend uses its own loader and is not counted.
+struct GLStats
+{
+    int calls;
+    int drawCalls;
+};
+
+void glstats_install();
+
+// Starts a new frame; the finished frame's counts move to glstats_last().
+void glstats_begin_frame();
+
+const GLStats& glstats_last();
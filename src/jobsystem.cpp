@@ -0,0 +1,164 @@
+#include "jobsystem.h"
+
+#include <algorithm>
+
+struct Job
+{
+    std::function<void()> fn;
+    JobCounter *done;
+};
+
+static thread_local const JobSystem *tlsSystem = nullptr;
+static thread_local int tlsWorker = 0;
+
+int jobsystem_worker(const JobSystem *sys)
+{
+    return tlsSystem == sys ? tlsWorker : 0;
+}
+
+static void push(JobSystem *sys, Job *job) {
+    JobDeque *d = sys->deques[jobsystem_worker(sys)].get();
+    {
+        std::lock_guard<std::mutex> lock(d->mutex);
+        d->jobs.push_back(job);
+    }
+    sys->queued++;
+    // taking the lock orders this against a worker that has just found
+    // nothing queued and is about to sleep
+    { std::lock_guard<std::mutex> lock(sys->sleepMutex); }
+    sys->wake.notify_one();
+}
+
+// The worker's own newest job, else the oldest of another worker's.
+static Job* take(JobSystem *sys, int self) {
+    if (sys->queued.load(std::memory_order_relaxed) == 0) return nullptr;
+    const int n = (int)sys->deques.size();
+    for (int k = 0; k < n; ++k) {
+        int victim = (self + k) % n;
+        JobDeque *d = sys->deques[victim].get();
+        std::lock_guard<std::mutex> lock(d->mutex);
+        if (d->head == d->jobs.size()) continue;
+        Job *job;
+        if (k == 0) {
+            job = d->jobs.back();
+            d->jobs.pop_back();
+        } else {
+            job = d->jobs[d->head++];
+            sys->stolen.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (d->head == d->jobs.size()) {
+            d->jobs.clear();
+            d->head = 0;
+        }
+        sys->queued--;
+        return job;
+    }
+    return nullptr;
+}
+
+static void execute(JobSystem *sys, Job *job) {
+    job->fn();
+    JobCounter *c = job->done;
+    delete job;
+    sys->executed.fetch_add(1, std::memory_order_relaxed);
+
+    std::vector<Job*> ready;
+    {
+        // under the lock, so a waiter that sees zero can still lock the
+        // counter once to know this thread is done with it
+        std::lock_guard<std::mutex> lock(c->mutex);
+        if (--c->pending == 0) ready.swap(c->waiting);
+    }
+    for (Job *j : ready) push(sys, j);
+}
+
+static void worker_main(JobSystem *sys, int index) {
+    tlsSystem = sys;
+    tlsWorker = index;
+    while (!sys->stopping) {
+        if (Job *job = take(sys, index)) {
+            execute(sys, job);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sys->sleepMutex);
+        sys->wake.wait(lock, [&] { return sys->stopping || sys->queued > 0; });
+    }
+}
+
+void jobsystem_start(JobSystem *sys, int threadCount)
+{
+    if (threadCount <= 0)
+        threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+    sys->stopping = false;
+    sys->queued = 0;
+    sys->deques.clear();
+    for (int i = 0; i < threadCount; ++i)
+        sys->deques.push_back(std::unique_ptr<JobDeque>(new JobDeque()));
+    tlsSystem = sys;
+    tlsWorker = 0;
+    for (int i = 1; i < threadCount; ++i)
+        sys->threads.emplace_back(worker_main, sys, i);
+}
+
+void jobsystem_stop(JobSystem *sys)
+{
+    {
+        std::lock_guard<std::mutex> lock(sys->sleepMutex);
+        sys->stopping = true;
+    }
+    sys->wake.notify_all();
+    for (std::thread &t : sys->threads)
+        t.join();
+    sys->threads.clear();
+    sys->deques.clear();
+    if (tlsSystem == sys) tlsSystem = nullptr;
+}
+
+void jobsystem_run(JobSystem *sys, std::function<void()> fn, JobCounter *done, JobCounter *after)
+{
+    Job *job = new Job{ std::move(fn), done };
+    done->pending++;
+    if (after) {
+        std::lock_guard<std::mutex> lock(after->mutex);
+        if (after->pending > 0) {
+            after->waiting.push_back(job);
+            return;
+        }
+    }
+    push(sys, job);
+}
+
+void jobsystem_wait(JobSystem *sys, JobCounter *counter)
+{
+    const int self = jobsystem_worker(sys);
+    while (counter->pending > 0) {
+        if (Job *job = take(sys, self))
+            execute(sys, job);
+        else
+            std::this_thread::yield();
+    }
+    std::lock_guard<std::mutex> lock(counter->mutex);
+}
+
+void jobsystem_parallel_for(JobSystem *sys, size_t count, size_t grain,
+                            const std::function<void(size_t, size_t)> &fn)
+{
+    if (count == 0) return;
+    grain = std::max<size_t>(grain, 1);
+    // a few chunks per worker, so stealing can even out uneven ones
+    size_t chunk = (count + jobsystem_size(sys) * 4 - 1) / (jobsystem_size(sys) * 4);
+    chunk = (std::max(chunk, grain) + grain - 1) / grain * grain;
+    if (chunk >= count || jobsystem_size(sys) == 1) {
+        fn(0, count);
+        return;
+    }
+
+    JobCounter done;
+    // the first chunk is left for the caller
+    for (size_t begin = chunk; begin < count; begin += chunk) {
+        size_t end = std::min(count, begin + chunk);
+        jobsystem_run(sys, [&fn, begin, end] { fn(begin, end); }, &done);
+    }
+    fn(0, chunk);
+    jobsystem_wait(sys, &done);
+}
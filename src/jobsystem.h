@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing job pool for the per-frame passes. Every worker owns a
+// deque: it pushes and pops its own jobs at the back, newest first while
+// their data is still in cache, and a worker whose deque is empty steals
+// from the front of another's, taking the oldest and usually largest work.
+// The thread that started the pool is worker 0 and runs jobs whenever it
+// waits, so a pool of one has no threads and runs everything inline.
+//
+// Jobs are counted on a JobCounter that the caller owns and waits on. A job
+// can be held back until another counter drops to zero, which is how one
+// pass depends on an earlier one. Each deque has its own lock; jobs are
+// chunks of hundreds of objects, so that never shows next to the work.
+//
+// Only worker threads may add jobs or wait.
+
+struct Job;
+
+struct JobCounter
+{
+    std::atomic<int> pending{0};
+    std::mutex mutex;
+    std::vector<Job*> waiting;   // queued once pending reaches zero
+};
+
+struct JobDeque
+{
+    std::mutex mutex;
+    std::vector<Job*> jobs;   // front at `head`
+    size_t head = 0;
+};
+
+struct JobSystem
+{
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<JobDeque>> deques;   // one per worker
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<int> queued{0};
+    std::atomic<bool> stopping{false};
+    std::atomic<uint64_t> executed{0};
+    std::atomic<uint64_t> stolen{0};
+};
+
+// threadCount <= 0 picks one worker per core.
+void jobsystem_start(JobSystem *sys, int threadCount);
+
+void jobsystem_stop(JobSystem *sys);
+
+// Workers including the thread that started the pool.
+inline int jobsystem_size(const JobSystem *sys) { return (int)sys->deques.size(); }
+
+// Index of the calling worker, 0 on the starting thread. Jobs use it to
+// pick per-worker scratch.
+int jobsystem_worker(const JobSystem *sys);
+
+// Queues `fn`. `done` is raised now and lowered when fn has run; if `after`
+// is given, fn is only queued once its count is zero.
+void jobsystem_run(JobSystem *sys, std::function<void()> fn, JobCounter *done, JobCounter *after = nullptr);
+
+// Runs queued jobs until `counter` reaches zero.
+void jobsystem_wait(JobSystem *sys, JobCounter *counter);
+
+// Calls fn(begin, end) over [0, count) in chunks and returns when all are
+// done. Chunks hold at least `grain` items and start at multiples of it.
+void jobsystem_parallel_for(JobSystem *sys, size_t count, size_t grain,
+                            const std::function<void(size_t, size_t)> &fn);
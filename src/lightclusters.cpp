@@ -0,0 +1,143 @@
+#include "lightclusters.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+void lightclusters_init(LightClusters *clusters, int threadCount)
+{
+    clusters->nearClip = 0.1f;
+    clusters->farClip = 100.0f;
+    clusters->sliceScale = 1.0f;
+    clusters->maxIndices = (size_t)1 << 22;
+    clusters->grid.assign(2 * CLUSTER_COUNT, 0);
+    clusters->indices.clear();
+    clusters->counts.assign(CLUSTER_COUNT, 0);
+    clusters->stats = LightClusterStats{};
+    workerpool_start(&clusters->pool, threadCount, 8);
+}
+
+void lightclusters_destroy(LightClusters *clusters)
+{
+    workerpool_stop(&clusters->pool);
+    clusters->grid.clear();
+    clusters->indices.clear();
+    clusters->ranges.clear();
+}
+
+int lightclusters_slice(const LightClusters *clusters, float depth)
+{
+    float s = std::log(std::max(depth, clusters->nearClip) / clusters->nearClip) * clusters->sliceScale;
+    return std::min(CLUSTER_Z - 1, (int)s);
+}
+
+static int to_tile(float ndc, int tiles) {
+    int t = (int)std::floor((ndc * 0.5f + 0.5f) * tiles);
+    return std::min(tiles - 1, std::max(0, t));
+}
+
+// The sphere's view space box, clipped to the depth range. x / depth over
+// the box is extreme at its corners, so four corners bound it on screen.
+static LightClusterRange light_range(const LightClusters *clusters, const PointLight &light,
+                                     const glm::mat4 &view, const glm::mat4 &proj) {
+    const LightClusterRange miss = { 1, 0, 1, 0, 1, 0 };
+    glm::vec3 p = glm::vec3(view * glm::vec4(glm::vec3(light.positionRadius), 1.0f));
+    float r = light.positionRadius.w;
+    float depth = -p.z;
+    if (r <= 0.0f || depth + r < clusters->nearClip || depth - r > clusters->farClip) return miss;
+    float zNear = std::max(depth - r, clusters->nearClip);
+    float zFar = std::min(depth + r, clusters->farClip);
+
+    float minX = 1e30f, maxX = -1e30f, minY = 1e30f, maxY = -1e30f;
+    for (float z : { zNear, zFar })
+        for (float s : { -r, r }) {
+            float x = proj[0][0] * (p.x + s) / z, y = proj[1][1] * (p.y + s) / z;
+            minX = std::min(minX, x); maxX = std::max(maxX, x);
+            minY = std::min(minY, y); maxY = std::max(maxY, y);
+        }
+    if (minX > 1.0f || maxX < -1.0f || minY > 1.0f || maxY < -1.0f) return miss;
+
+    LightClusterRange range;
+    range.x0 = (int16_t)to_tile(minX, CLUSTER_X);
+    range.x1 = (int16_t)to_tile(maxX, CLUSTER_X);
+    range.y0 = (int16_t)to_tile(minY, CLUSTER_Y);
+    range.y1 = (int16_t)to_tile(maxY, CLUSTER_Y);
+    range.z0 = (int16_t)lightclusters_slice(clusters, zNear);
+    range.z1 = (int16_t)lightclusters_slice(clusters, zFar);
+    return range;
+}
+
+void lightclusters_build(LightClusters *clusters, const PointLight *lights, size_t count,
+                         const glm::mat4 &view, const glm::mat4 &proj, float nearClip, float farClip)
+{
+    auto start = std::chrono::steady_clock::now();
+    clusters->nearClip = nearClip;
+    clusters->farClip = farClip;
+    clusters->sliceScale = CLUSTER_Z / std::log(farClip / nearClip);
+    clusters->ranges.resize(count);
+    const int threads = workerpool_size(&clusters->pool);
+
+    workerpool_run(&clusters->pool, [&](int index) {
+        size_t begin = count * index / threads, end = count * (index + 1) / threads;
+        for (size_t i = begin; i < end; ++i)
+            clusters->ranges[i] = light_range(clusters, lights[i], view, proj);
+    });
+
+    // count, then fill the same way once offsets are known; each thread
+    // owns whole depth slices so no cluster is written by two threads
+    workerpool_run(&clusters->pool, [&](int index) {
+        int z0 = CLUSTER_Z * index / threads, z1 = CLUSTER_Z * (index + 1) / threads;
+        uint32_t *counts = clusters->counts.data();
+        std::fill(counts + lightclusters_index(0, 0, z0), counts + lightclusters_index(0, 0, z1), 0u);
+        for (const LightClusterRange &r : clusters->ranges) {
+            int zb = std::max<int>(r.z0, z0), ze = std::min<int>(r.z1, z1 - 1);
+            if (r.x0 > r.x1 || zb > ze) continue;
+            for (int z = zb; z <= ze; ++z)
+                for (int y = r.y0; y <= r.y1; ++y)
+                    for (int x = r.x0; x <= r.x1; ++x)
+                        counts[lightclusters_index(x, y, z)]++;
+        }
+    });
+
+    LightClusterStats &st = clusters->stats;
+    st.truncated = false;
+    st.maxPerCluster = 0;
+    uint32_t offset = 0;
+    for (int c = 0; c < CLUSTER_COUNT; ++c) {
+        uint32_t n = clusters->counts[c];
+        if (offset + n > clusters->maxIndices) {
+            n = (uint32_t)(clusters->maxIndices - offset);
+            st.truncated = true;
+        }
+        clusters->grid[2 * c] = offset;
+        clusters->grid[2 * c + 1] = n;
+        st.maxPerCluster = std::max(st.maxPerCluster, (int)n);
+        offset += n;
+    }
+    clusters->indices.resize(offset);
+
+    workerpool_run(&clusters->pool, [&](int index) {
+        int z0 = CLUSTER_Z * index / threads, z1 = CLUSTER_Z * (index + 1) / threads;
+        uint32_t *written = clusters->counts.data();
+        std::fill(written + lightclusters_index(0, 0, z0), written + lightclusters_index(0, 0, z1), 0u);
+        for (size_t i = 0; i < count; ++i) {
+            const LightClusterRange &r = clusters->ranges[i];
+            int zb = std::max<int>(r.z0, z0), ze = std::min<int>(r.z1, z1 - 1);
+            if (r.x0 > r.x1 || zb > ze) continue;
+            for (int z = zb; z <= ze; ++z)
+                for (int y = r.y0; y <= r.y1; ++y)
+                    for (int x = r.x0; x <= r.x1; ++x) {
+                        int c = lightclusters_index(x, y, z);
+                        if (written[c] < clusters->grid[2 * c + 1])
+                            clusters->indices[clusters->grid[2 * c] + written[c]++] = (uint32_t)i;
+                    }
+        }
+    });
+
+    st.lights = (int)count;
+    st.visible = 0;
+    for (const LightClusterRange &r : clusters->ranges)
+        st.visible += r.x0 <= r.x1;
+    st.indices = (int)offset;
+    st.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "workerpool.h"
+
+// Light assignment for clustered forward shading.
+//
+// The view frustum is cut into CLUSTER_X x CLUSTER_Y tiles on screen and
+// CLUSTER_Z depth slices, spaced exponentially between the near and far
+// planes so clusters stay roughly cubic. Every light's sphere is bounded by
+// a box of clusters in view space; each cluster then lists the lights whose
+// box covers it. The result is a compact grid of (offset, count) pairs into
+// one light index list, which the fragment shader reads for its cluster.
+//
+// Assignment runs in three parallel passes: light boxes over ranges of
+// lights, then counting and filling over ranges of depth slices, with a
+// prefix sum over the clusters in between. The output doesn't depend on the
+// number of threads.
+
+const int CLUSTER_X = 16;
+const int CLUSTER_Y = 9;
+const int CLUSTER_Z = 24;
+const int CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+
+// Two RGBA32F texels of the light buffer.
+struct PointLight
+{
+    glm::vec4 positionRadius;   // world position, range of influence
+    glm::vec4 colorIntensity;   // rgb, intensity
+};
+
+// Cluster box of one light, inclusive; x0 > x1 if it misses the frustum.
+struct LightClusterRange
+{
+    int16_t x0, x1, y0, y1, z0, z1;
+};
+
+struct LightClusterStats
+{
+    int lights;
+    int visible;         // lights touching at least one cluster
+    int indices;         // entries in the light index list
+    int maxPerCluster;
+    bool truncated;      // index list hit maxIndices
+    double seconds;
+};
+
+struct LightClusters
+{
+    float nearClip, farClip;
+    float sliceScale;      // slices per unit of log(depth / near)
+    size_t maxIndices;     // index list capacity, e.g. the texture buffer size
+
+    std::vector<uint32_t> grid;      // offset, count per cluster; x fastest, then y, then z
+    std::vector<uint32_t> indices;   // light indices, cluster by cluster
+
+    std::vector<LightClusterRange> ranges;
+    std::vector<uint32_t> counts;    // per cluster, between the passes
+    LightClusterStats stats;
+    WorkerPool pool;
+};
+
+// threadCount <= 0 picks one per core, up to 8.
+void lightclusters_init(LightClusters *clusters, int threadCount = 0);
+
+void lightclusters_destroy(LightClusters *clusters);
+
+// Assigns `lights` to the clusters of the frustum given by `view` and the
+// perspective `proj` with its clip planes.
+void lightclusters_build(LightClusters *clusters, const PointLight *lights, size_t count,
+                         const glm::mat4 &view, const glm::mat4 &proj, float nearClip, float farClip);
+
+// Depth slice of a view space depth (positive, in front of the camera).
+int lightclusters_slice(const LightClusters *clusters, float depth);
+
+inline int lightclusters_index(int x, int y, int z) { return (z * CLUSTER_Y + y) * CLUSTER_X + x; }
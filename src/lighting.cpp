@@ -0,0 +1,59 @@
+#include "lighting.h"
+
+#include <algorithm>
+
+#include "shader.h"
+
+static const GLenum FORMATS[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+static const GLuint UNITS[3] = { LIGHT_TEXTURE_UNIT, CLUSTER_GRID_TEXTURE_UNIT, LIGHT_INDEX_TEXTURE_UNIT };
+
+void lighting_create(LightingGpu *gpu)
+{
+    glGenBuffers(3, gpu->buffers);
+    glGenTextures(3, gpu->textures);
+    for (int i = 0; i < 3; ++i) {
+        // never empty, so the textures are complete before the first upload
+        gpu->capacity[i] = 16;
+        glBindBuffer(GL_TEXTURE_BUFFER, gpu->buffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, gpu->capacity[i], nullptr, GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, gpu->textures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, FORMATS[i], gpu->buffers[i]);
+    }
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    GLint maxTexels = 65536;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    gpu->maxTexels = (size_t)maxTexels;
+}
+
+void lighting_destroy(LightingGpu *gpu)
+{
+    glDeleteTextures(3, gpu->textures);
+    glDeleteBuffers(3, gpu->buffers);
+}
+
+// Orphans the old store so the driver doesn't wait on last frame's reads.
+static void stream(LightingGpu *gpu, int i, const void *data, size_t bytes) {
+    glBindBuffer(GL_TEXTURE_BUFFER, gpu->buffers[i]);
+    if (bytes > gpu->capacity[i])
+        gpu->capacity[i] = std::max(bytes, gpu->capacity[i] * 2);
+    glBufferData(GL_TEXTURE_BUFFER, gpu->capacity[i], nullptr, GL_STREAM_DRAW);
+    if (bytes) glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+}
+
+void lighting_upload(LightingGpu *gpu, const PointLight *lights, size_t count, const LightClusters *clusters)
+{
+    stream(gpu, 0, lights, count * sizeof(PointLight));
+    stream(gpu, 1, clusters->grid.data(), clusters->grid.size() * sizeof(uint32_t));
+    stream(gpu, 2, clusters->indices.data(), clusters->indices.size() * sizeof(uint32_t));
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void lighting_bind(const LightingGpu *gpu)
+{
+    for (int i = 0; i < 3; ++i) {
+        glActiveTexture(GL_TEXTURE0 + UNITS[i]);
+        glBindTexture(GL_TEXTURE_BUFFER, gpu->textures[i]);
+    }
+    glActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstddef>
+
+#include "lightclusters.h"
+
+// GPU side of clustered lighting: the lights, the cluster grid and the
+// light index list as texture buffers, which GL 3.3 has and which need no
+// SSBO. Lights take two RGBA32F texels each, the grid an RG32UI (offset,
+// count) texel per cluster and the index list one R32UI texel per entry.
+
+struct LightingGpu
+{
+    GLuint buffers[3];    // lights, grid, indices
+    GLuint textures[3];
+    size_t capacity[3];   // bytes allocated
+    size_t maxTexels;     // GL_MAX_TEXTURE_BUFFER_SIZE
+};
+
+void lighting_create(LightingGpu *gpu);
+
+void lighting_destroy(LightingGpu *gpu);
+
+// Streams this frame's lights and cluster lists into the buffers.
+void lighting_upload(LightingGpu *gpu, const PointLight *lights, size_t count, const LightClusters *clusters);
+
+// Binds the three buffers to the texture units shader.h reserves for them.
+void lighting_bind(const LightingGpu *gpu);
@@ -1,413 +1,459 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
 #include <string>
+#include <thread>
 #include <vector>
-#include <fstream>
-#include <sstream>
 #include <iostream>
 
-#include <cctype>
 #include <imgui.h>
 #include <backends/imgui_impl_glfw.h>
 #include <backends/imgui_impl_opengl3.h>
 #include <ImGuizmo.h>
 #include "glm/ext/matrix_transform.hpp"
 #include <glm/gtc/matrix_transform.hpp>
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/euler_angles.hpp>
-#include "orbitcamera.h"
-#include <glm/gtc/quaternion.hpp>
-
-static int fix_obj_index(int idx, int count) {
-    // OBJ:  1..count  (positive)
-    //       -1..-count (negative, relative to end)
-    // We return 0-based index, or -1 if invalid/zero.
-    if (idx > 0) return idx - 1;
-    if (idx < 0) return count + idx;   // e.g. -1 => last element
-    return -1;
-}
-
-static std::vector<float> load_obj(const std::string& path)
-{
-    std::vector<float> out;   // flat list: px py pz nx ny nz, triangulated
-    std::vector<float> verts; // flat xyzxyz...
-    std::vector<float> norms; // flat xyzxyz...
-
-    std::ifstream file(path);
-    if (!file.is_open()) {
-        std::cerr << "Failed to open OBJ file: " << path << "\n";
-        return out;
-    }
-
-    auto parse_tok = [&](const std::string& t) -> std::pair<int,int> {
-        // returns (vi, ni) as 0-based indices; ni = -1 if missing
-        int vi_raw = 0, ni_raw = 0;
-
-        // Token formats:
-        // v
-        // v/vt
-        // v//vn
-        // v/vt/vn
-        //
-        // We only care about v and vn.
-        size_t s1 = t.find('/');
-        if (s1 == std::string::npos) {
-            vi_raw = std::stoi(t);
-        } else {
-            vi_raw = std::stoi(t.substr(0, s1));
-
-            size_t s2 = t.find('/', s1 + 1);
-            if (s2 != std::string::npos) {
-                // there is a vn field (maybe empty between //)
-                if (s2 + 1 < t.size()) {
-                    std::string vn_part = t.substr(s2 + 1);
-                    if (!vn_part.empty())
-                        ni_raw = std::stoi(vn_part);
-                }
-            }
-            // if only v/vt, no normal
-        }
-
-        int vcount = static_cast<int>(verts.size() / 3);
-        int ncount = static_cast<int>(norms.size() / 3);
-
-        int vi = fix_obj_index(vi_raw, vcount);
-        int ni = (ni_raw != 0) ? fix_obj_index(ni_raw, ncount) : -1;
-
-        return {vi, ni};
-    };
-
-    std::string line;
-    while (std::getline(file, line)) {
-        if (line.empty() || line[0] == '#')
-            continue;
-
-        // trim leading whitespace
-        size_t start = 0;
-        while (start < line.size() && std::isspace(static_cast<unsigned char>(line[start])))
-            ++start;
-        if (start >= line.size() || line[start] == '#')
-            continue;
-
-        std::istringstream iss(line.substr(start));
-        std::string type;
-        iss >> type;
-
-        if (type == "v") {
-            float x, y, z;
-            if (iss >> x >> y >> z) {
-                verts.push_back(x);
-                verts.push_back(y);
-                verts.push_back(z);
-            }
-        }
-        else if (type == "vn") {
-            float x, y, z;
-            if (iss >> x >> y >> z) {
-                norms.push_back(x);
-                norms.push_back(y);
-                norms.push_back(z);
-            }
-        }
-        else if (type == "f") {
-            std::vector<std::string> face;
-            std::string tok;
-            while (iss >> tok)
-                face.push_back(tok);
-
-            if (face.size() < 3)
-                continue;
-
-            // fan triangulation: (0, i, i+1)
-            auto [v0i, n0i] = parse_tok(face[0]);
-            if (v0i < 0) continue;
-
-            for (size_t i = 1; i + 1 < face.size(); ++i) {
-                auto [v1i, n1i] = parse_tok(face[i]);
-                auto [v2i, n2i] = parse_tok(face[i + 1]);
-                if (v1i < 0 || v2i < 0) continue;
-
-                const int vis[3] = { v0i, v1i, v2i };
-                const int nis[3] = { n0i, n1i, n2i };
-
-                for (int k = 0; k < 3; ++k) {
-                    int vo = vis[k] * 3;
-                    float px = verts[vo + 0];
-                    float py = verts[vo + 1];
-                    float pz = verts[vo + 2];
-
-                    float nx = 0.f, ny = 0.f, nz = 0.f;
-                    if (nis[k] >= 0) {
-                        int no = nis[k] * 3;
-                        if (no + 2 < (int)norms.size()) {
-                            nx = norms[no + 0];
-                            ny = norms[no + 1];
-                            nz = norms[no + 2];
-                        }
-                    }
-
-                    out.push_back(px);
-                    out.push_back(py);
-                    out.push_back(pz);
-                    out.push_back(nx);
-                    out.push_back(ny);
-                    out.push_back(nz);
-                }
-            }
-        }
-    }
-
-    return out;
-}
-
-static std::string read_text_file(const std::string& path) {
-    std::ifstream in(path);
-    std::stringstream ss;
-    ss << in.rdbuf();
-    return ss.str();
-}
+#include <glm/gtc/type_ptr.hpp>
+#include "glstats.h"
+#include "profiler.h"
+#include "rtpool.h"
+#include "scene.h"
+#include "scenefile.h"
 
 static void glfw_error_callback(int err, const char* msg) {
   std::cerr << "GLFW error " << err << ": " << msg << "\n";
 }
 
-static GLuint compileShader(GLenum type, const char* src) {
-  GLuint s = glCreateShader(type);
-  glShaderSource(s, 1, &src, nullptr);
-  glCompileShader(s);
-
-  GLint ok = 0;
-  glGetShaderiv(s, GL_COMPILE_STATUS, &ok);
-  if (!ok) {
-    GLint len = 0;
-    glGetShaderiv(s, GL_INFO_LOG_LENGTH, &len);
-    std::string log(len, '\0');
-    glGetShaderInfoLog(s, len, nullptr, log.data());
-    std::cerr << "Shader compile error:\n" << log << "\n";
-  }
-  return s;
-}
-
-static GLuint linkProgram(GLuint vs, GLuint fs) {
-  GLuint p = glCreateProgram();
-  glAttachShader(p, vs);
-  glAttachShader(p, fs);
-  glLinkProgram(p);
-
-  GLint ok = 0;
-  glGetProgramiv(p, GL_LINK_STATUS, &ok);
-  if (!ok) {
-    GLint len = 0;
-    glGetProgramiv(p, GL_INFO_LOG_LENGTH, &len);
-    std::string log(len, '\0');
-    glGetProgramInfoLog(p, len, nullptr, log.data());
-    std::cerr << "Program link error:\n" << log << "\n";
-  }
+// Profiler window state.
+struct ProfilerView {
+    std::vector<float> cpuMs, gpuMs;
+    int captureFrames = 120;
+};
 
-  glDetachShader(p, vs);
-  glDetachShader(p, fs);
-  glDeleteShader(vs);
-  glDeleteShader(fs);
-  return p;
-}
-
-static GLuint createProgram(std::string vsPath, std::string fsPath){
-    std::string vsString = read_text_file(vsPath);
-    const char* vsSrc = vsString.c_str();
-    std::string fsString = read_text_file(fsPath);
-    const char* fsSrc = fsString.c_str();
-    return linkProgram(compileShader(GL_VERTEX_SHADER, vsSrc),
-                              compileShader(GL_FRAGMENT_SHADER, fsSrc));
-}
-
-struct RenderObj{
-    std::string name;
-    GLuint prog;
-    GLuint vao, vbo;
-    int vertex_count;
-    glm::vec3 position;
-    glm::vec3 rotation;
-    glm::vec3 scale;
-    glm::vec3 color;
+enum HierarchyType { HIERARCHY_ALL, HIERARCHY_MESHES, HIERARCHY_GROUPS, HIERARCHY_LOADING };
+
+// Hierarchy window state. The rows are what the list clipper walks: slots
+// of the expanded tree, or object indices while filtering.
+struct HierarchyView {
+    std::vector<uint8_t> collapsed;   // by NodeId
+    std::vector<uint32_t> rows;
+    std::vector<uint16_t> depth;      // by slot
+    char filter[128] = "";
+    int type = HIERARCHY_ALL;
+    std::vector<uint32_t> matches;    // search results for matchedQuery
+    std::string matchedQuery;
+    uint32_t matchedVersion = ~0u;    // search index version they came from
+    int anchor = -1;                  // object a shift-click selects from
+    double seconds = 0.0;             // building the window, last frame
 };
 
 struct SceneFBO {
+    RenderTargetPool targets;
+    RenderTargetId color = RENDER_TARGET_NONE;   // held across frames, the image may be reused
+    RenderTargetId depth = RENDER_TARGET_NONE;
     GLuint fbo = 0;
-    GLuint color = 0;
-    GLuint depth = 0;
-    int w = 0, h = 0;
+    int w = 0, h = 0;   // image size, the top left of the targets
+    GLuint occlusionView = 0;   // debug image of the occlusion buffer
+    std::vector<uint32_t> occlusionPixels;
+    ProfilerView profilerView;
+    HierarchyView hierarchyView;
+    double uiSeconds = 0.0;   // building the ImGui frame, without the scene render, last frame
+    bool redrawn = false;   // scene rendered this frame
+    long redraws = 0, skippedFrames = 0;
 };
 
-struct Scene{
-    GLuint prog;
-    std::vector<RenderObj> renderObjs;
-    OrbitCamera orbitCamera;
-    glm::vec3 lightPos;
-    glm::vec3 animLight;
-    int selected;
-};
+// `mesh` is a reference the object takes over, MESH_NONE for a group node
+// that only carries a transform.
+static NodeId add_render_object(Scene *scene, std::string name, MeshId mesh, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale, glm::vec3 color, NodeId parent){
+    RenderObj renderObj;
+    renderObj.name = std::move(name);
+    renderObj.program = &scene->program;
+    renderObj.mesh = mesh;
+    renderObj.node = transforms_add(&scene->transforms, parent, position, rotation, scale);
+    renderObj.color = color;
+    renderObj.lodErrorPixels = 1.0f;
+    renderObj.lodHysteresis = 0.25f;
+    renderObj.lodForce = -1;
+    renderObj.lod = 0;
+    scene->renderObjs.push_back(renderObj);
+    scene->selection.push_back(0);
+    searchindex_set(&scene->search, (uint32_t)scene->renderObjs.size() - 1, renderObj.name);
 
-static glm::mat4 renderobject_model(RenderObj *renderObj){
-    glm::mat4 trans = glm::translate(glm::mat4(1.0), renderObj->position);
-    glm::vec3 eulerRad = glm::radians(renderObj->rotation);
-    glm::mat4 rot = glm::eulerAngleXYZ(eulerRad.x, eulerRad.y, eulerRad.z);
-    glm::mat4 scale = glm::scale(glm::mat4(1.0), renderObj->scale);
-    return trans * rot * scale;
+    scene->nodeObject.resize(renderObj.node + 1, -1);
+    scene->nodeObject[renderObj.node] = (int)scene->renderObjs.size() - 1;
+    return renderObj.node;
 }
 
-static void create_render_object(Scene *scene, std::string modelPath, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale, glm::vec3 color){
-    std::vector<float> vertices = load_obj(modelPath);
-    GLuint vao=0, vbo=0;
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
+// Makes `obj` the primary selection; `extend` keeps the rest selected.
+static void select_object(Scene *scene, int obj, bool extend){
+    if (!extend) {
+        std::fill(scene->selection.begin(), scene->selection.end(), 0);
+        scene->selectionCount = 0;
+    }
+    if (!scene->selection[obj]) {
+        scene->selection[obj] = 1;
+        scene->selectionCount++;
+    }
+    scene->selected = obj;
+}
 
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+// Adds or drops `obj`. The last selected object stays, something has to be
+// in the Inspector.
+static void toggle_selected(Scene *scene, int obj){
+    if (!scene->selection[obj]) {
+        select_object(scene, obj, true);
+        return;
+    }
+    if (scene->selectionCount == 1) return;
+    scene->selection[obj] = 0;
+    scene->selectionCount--;
+    if (scene->selected == obj)
+        scene->selected = (int)(std::find(scene->selection.begin(), scene->selection.end(), 1) - scene->selection.begin());
+}
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    RenderObj renderObj;
-    renderObj.name = modelPath;
-    renderObj.prog = scene->prog;
-    renderObj.vao = vao;
-    renderObj.vbo = vbo;
-    renderObj.vertex_count = vertices.size() / 6;
-    renderObj.position = position;
-    renderObj.rotation = rotation;
-    renderObj.scale = scale;
-    renderObj.color = color;
-    scene->renderObjs.push_back(renderObj);
+// An empty modelPath makes a group node.
+static NodeId create_render_object(Scene *scene, std::string modelPath, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale, glm::vec3 color, NodeId parent = NODE_NONE){
+    MeshId mesh = modelPath.empty() ? MESH_NONE : meshregistry_acquire(&scene->meshes, &scene->loader, modelPath);
+    std::string name = modelPath.empty() ? "group" : modelPath;
+    return add_render_object(scene, std::move(name), mesh, position, rotation, scale, color, parent);
 }
 
-static void render_object(RenderObj *renderObj, glm::mat4 view, glm::mat4 proj, glm::vec3 lightPos, glm::vec3 camPos){
-    glUseProgram(renderObj->prog);
-    const GLint locModel = glGetUniformLocation(renderObj->prog, "uModel");
-    const GLint locView  = glGetUniformLocation(renderObj->prog, "uView");
-    const GLint locProj  = glGetUniformLocation(renderObj->prog, "uProj");
-    const GLint locLightPos = glGetUniformLocation(renderObj->prog, "uLightPos");
-    const GLint locViewPos  = glGetUniformLocation(renderObj->prog, "uViewPos");
-    const GLint locObjCol   = glGetUniformLocation(renderObj->prog, "uObjectColor");
-    const GLint locLightCol = glGetUniformLocation(renderObj->prog, "uLightColor");
+// Creates the objects of a saved scene straight from the mapping. A mesh
+// path is read for the first object that uses it; the rest take another
+// reference by id. The meshes stream in afterwards like any other.
+static bool load_scene_file(Scene *scene, const std::string &path){
+    double start = glfwGetTime();
+    SceneFile file;
+    if (!scenefile_open(&file, path)) {
+        std::cerr << "Failed to open scene: " << path << "\n";
+        return false;
+    }
+    const SceneFileHeader *h = file.header;
+    if (h->objectCount == 0) {   // the windows need an object to select
+        std::cerr << "Scene has no objects: " << path << "\n";
+        scenefile_close(&file);
+        return false;
+    }
+    std::vector<MeshId> meshes(h->meshCount, MESH_NONE);
+    std::vector<NodeId> nodes(h->objectCount);
+    scene->renderObjs.reserve(scene->renderObjs.size() + h->objectCount);
+    for (uint32_t i = 0; i < h->objectCount; ++i) {
+        const SceneFileObject &o = file.objects[i];
+        MeshId mesh = MESH_NONE;
+        if (o.mesh != SCENE_FILE_NONE) {
+            MeshId &m = meshes[o.mesh];
+            if (m == MESH_NONE)
+                m = meshregistry_acquire(&scene->meshes, &scene->loader, scenefile_string(&file, file.meshes[o.mesh].path));
+            else
+                meshregistry_retain(&scene->meshes, m);
+            mesh = m;
+        }
+        NodeId parent = o.parent == SCENE_FILE_NONE ? NODE_NONE : nodes[o.parent];
+        nodes[i] = add_render_object(scene, scenefile_string(&file, o.name), mesh, glm::make_vec3(o.position),
+                                     glm::make_vec3(o.rotation), glm::make_vec3(o.scale), glm::make_vec3(o.color), parent);
+    }
+    std::cout << "Opened " << path << ": " << h->objectCount << " objects, " << h->meshCount << " meshes in "
+              << (glfwGetTime() - start) * 1000.0 << " ms\n";
+    scenefile_close(&file);
+    return true;
+}
 
-    glm::mat4 model = renderobject_model(renderObj);
-    glUniformMatrix4fv(locModel, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(locView,  1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(locProj,  1, GL_FALSE, glm::value_ptr(proj));
+// Uploads finished background loads until the frame's budget is spent. At
+// least one mesh goes up per call so a slow upload can't stall loading.
+static void upload_loaded_meshes(Scene *scene, double budgetSeconds){
+    PROFILE_SCOPE("upload meshes");
+    double start = glfwGetTime();
+    do {
+        MeshLoadResult *r = assetloader_poll(&scene->loader);
+        if (!r) break;
+
+        if (!r->ok) {
+            std::cerr << "Failed to load mesh: " << r->path << "\n";
+            meshregistry_fail(&scene->meshes, r->userId);
+            scene->redraw = true;
+        } else {
+            double uploadStart = glfwGetTime();
+            scene->redraw = true;
+            if (meshregistry_upload(&scene->meshes, r->userId, &r->asset, &r->bvh)) {
+                renderqueue_setup_vao(&scene->renderQueue);
+                glBindVertexArray(0);
+            }
+            const MeshFileHeader *h = r->asset.header;
+            std::cout << "Loaded " << r->path << (r->cacheHit ? " from cache in " : " from source in ")
+                      << r->loadSeconds * 1000.0 << " ms, uploaded in "
+                      << (glfwGetTime() - uploadStart) * 1000.0 << " ms, "
+                      << (h->vertexFormat == MESH_VERTEX_PACKED ? "packed" : "float") << " vertices "
+                      << h->vertexBytes / 1024 << " KB (" << meshcache_float_vertex_bytes(h) / 1024 << " KB as float)\n";
+        }
+        assetloader_free(r);
+    } while (glfwGetTime() - start < budgetSeconds);
 
-    glUniform3fv(locLightPos, 1, glm::value_ptr(lightPos));
-    glUniform3fv(locViewPos,  1, glm::value_ptr(camPos));
+    if (scene->loadStartTime >= 0 && assetloader_pending(&scene->loader) == 0) {
+        std::cout << "All meshes resident after " << (glfwGetTime() - scene->loadStartTime) * 1000.0 << " ms\n";
+        scene->loadStartTime = -1;
+    }
+}
 
-    glm::vec3 lightColor (1.0f, 1.0f, 1.0f);
-    glUniform3fv(locObjCol,   1, glm::value_ptr(renderObj->color));
-    glUniform3fv(locLightCol, 1, glm::value_ptr(lightColor));
+// The program belongs to the scene and the mesh may be shared; the object
+// only gives up its reference.
+static void delete_object(Scene *scene, RenderObj *renderObj){
+    meshregistry_release(&scene->meshes, renderObj->mesh);
+    renderObj->mesh = MESH_NONE;
+    scene->redraw = true;
+}
 
-    glBindVertexArray(renderObj->vao);
-    glDrawArrays(GL_TRIANGLES, 0, renderObj->vertex_count);
+// Hooks render queue variants up to the material once they are built.
+// Returns true while any is still building.
+static bool poll_shader_variants(Scene *scene){
+    struct { ShaderProgram *variant; const ShaderProgram **slot; const char *name; } variants[] = {
+        { &scene->programMultiDraw, &scene->program.multiDraw, "Multi-draw" },
+        { &scene->programInstanced, &scene->program.instanced, "Instanced" },
+    };
+    bool building = false;
+    for (auto &v : variants) {
+        if (v.variant->state != SHADER_BUILDING) continue;
+        ShaderState state = shader_poll(v.variant, &scene->shaderCache);
+        if (state == SHADER_READY)
+            *v.slot = v.variant;
+        else if (state == SHADER_FAILED)
+            std::cerr << v.name << " shader failed, drawing objects individually\n";
+        building |= state == SHADER_BUILDING;
+    }
+    return building;
 }
 
-static void delete_object(RenderObj renderObj){
-    glDeleteProgram(renderObj.prog);
-    glDeleteBuffers(1, &renderObj.vbo);
-    glDeleteVertexArrays(1, &renderObj.vao);
+// Replaces all but the key light with `count` small coloured lights circling
+// through the scene. Seeded, so every run gets the same lights.
+static void set_stress_lights(Scene *scene, int count){
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> u(0.0f, 1.0f);
+    scene->lights.resize(1);
+    scene->lightOrbits.clear();
+    for (int i = 0; i < count; ++i) {
+        LightOrbit orbit;
+        orbit.center = glm::vec3(u(rng) * 5.0f - 2.5f, u(rng) * 1.5f - 0.6f, u(rng) * 5.0f - 2.5f);
+        orbit.radius = 0.1f + u(rng) * 0.5f;
+        orbit.speed = (0.5f + u(rng) * 1.5f) * (u(rng) < 0.5f ? -1.0f : 1.0f);
+        orbit.phase = u(rng) * 6.2831853f;
+        scene->lightOrbits.push_back(orbit);
+        glm::vec3 color(u(rng), u(rng), u(rng));
+        color /= std::max(color.x, std::max(color.y, color.z)) + 1e-3f;
+        scene->lights.push_back(PointLight{ glm::vec4(orbit.center, 0.2f + u(rng) * 0.4f), glm::vec4(color, 0.8f) });
+    }
+    scene->redraw = true;
 }
 
-static void create_scene(Scene* scene){
-    scene->prog = createProgram("assets/shaders/lit_shader.vs", "assets/shaders/lit_shader.fs");
-    scene->selected = 0;
+// Moves the lights to where they are at the scene's light time.
+static void update_lights(Scene *scene){
+    scene->animLight = scene->lightPos + glm::vec3(std::cos(scene->lightTime) * 0.4f, 0.0f, std::sin(scene->lightTime) * 0.4f);
+    scene->lights[0].positionRadius = glm::vec4(scene->animLight, scene->lights[0].positionRadius.w);
+    for (size_t i = 0; i < scene->lightOrbits.size(); ++i) {
+        const LightOrbit &o = scene->lightOrbits[i];
+        float a = o.phase + o.speed * scene->lightTime;
+        glm::vec3 p = o.center + glm::vec3(std::cos(a), 0.0f, std::sin(a)) * o.radius;
+        scene->lights[i + 1].positionRadius = glm::vec4(p, scene->lights[i + 1].positionRadius.w);
+    }
+}
+
+// A saved scene is opened if `scenePath` is given and loads; otherwise an
+// empty model list builds the default scene, and models are placed in a row
+// along x.
+static void create_scene(Scene* scene, bool multiDraw, const std::vector<std::string> &models, const std::string &scenePath,
+                         bool packVertices){
+    double start = glfwGetTime();
+    scene->loadStartTime = start;
+    assetloader_start(&scene->loader, 0, packVertices ? MESH_COOK_PACK_VERTICES : 0);
+    jobsystem_start(&scene->jobs, 0);
+    shadercache_init(&scene->shaderCache, "assets/shaders/cache", (GLADloadproc)glfwGetProcAddress);
+    shader_create(&scene->program, "assets/shaders/lit_shader.vs", "assets/shaders/lit_shader.fs", &scene->shaderCache);
+    // the render queue variants build in the background; objects are drawn
+    // individually until they are ready
+    scene->programMultiDraw.id = 0;
+    scene->programMultiDraw.state = SHADER_FAILED;
+    scene->programInstanced.id = 0;
+    scene->programInstanced.state = SHADER_FAILED;
+    if (multiDraw)
+        shader_create_async(&scene->programMultiDraw, "assets/shaders/lit_shader_mdi.vs", "assets/shaders/lit_shader.fs", &scene->shaderCache);
+    else
+        shader_create_async(&scene->programInstanced, "assets/shaders/lit_shader_instanced.vs", "assets/shaders/lit_shader.fs", &scene->shaderCache);
+    poll_shader_variants(scene);
+    renderqueue_init(&scene->renderQueue, multiDraw);
+    scene->frameUbo = frameuniforms_create();
+    scene->selection.clear();
+    scene->selectionCount = 0;
+    searchindex_clear(&scene->search);
+    scene->picker = Picker{};
+    transforms_clear(&scene->transforms);
     orbitcamera_initialize(&scene->orbitCamera);
-    create_render_object(
-        scene,
-        "assets/models/Planet.obj",
-        glm::vec3(-1.0,0.0,0.0),
-        glm::vec3(0.0, 0.0, 0.0),
-        glm::vec3(0.2,0.2,0.2),
-        glm::vec3(0.9f, 0.55f, 0.2f));
-
-    create_render_object(
-        scene,
-        "assets/models/funnything.obj",
-        glm::vec3(1.0,0.0,0.0),
-        glm::vec3(0.0, 0.0, 0.0),
-        glm::vec3(0.2,0.2,0.2),
-        glm::vec3(0.2f, 0.55f, 0.9f));
-
-    create_render_object(
-        scene,
-        "assets/models/buildings.obj",
-        glm::vec3(0.0,-0.6,0.0),
-        glm::vec3(0.0, 0.0, 0.0),
-        glm::vec3(0.2,0.2,0.2),
-        glm::vec3(0.2f, 0.9f, 0.2f));
+    scene->path = scenePath.empty() ? "scene.scene" : scenePath;
+    bool loaded = !scenePath.empty() && load_scene_file(scene, scenePath);
+    for (size_t i = 0; !loaded && i < models.size(); ++i)
+        create_render_object(
+            scene,
+            models[i],
+            glm::vec3((float)i - (models.size() - 1) * 0.5f, 0.0, 0.0),
+            glm::vec3(0.0, 0.0, 0.0),
+            glm::vec3(0.2,0.2,0.2),
+            glm::vec3(0.9f, 0.55f, 0.2f));
+    if (!loaded && models.empty()) {
+        create_render_object(
+            scene,
+            "assets/models/Planet.obj",
+            glm::vec3(-1.0,0.0,0.0),
+            glm::vec3(0.0, 0.0, 0.0),
+            glm::vec3(0.2,0.2,0.2),
+            glm::vec3(0.9f, 0.55f, 0.2f));
+
+        create_render_object(
+            scene,
+            "assets/models/funnything.obj",
+            glm::vec3(1.0,0.0,0.0),
+            glm::vec3(0.0, 0.0, 0.0),
+            glm::vec3(0.2,0.2,0.2),
+            glm::vec3(0.2f, 0.55f, 0.9f));
+
+        create_render_object(
+            scene,
+            "assets/models/buildings.obj",
+            glm::vec3(0.0,-0.6,0.0),
+            glm::vec3(0.0, 0.0, 0.0),
+            glm::vec3(0.2,0.2,0.2),
+            glm::vec3(0.2f, 0.9f, 0.2f));
+    }
+
+    select_object(scene, 0, false);
 
     scene->lightPos = glm::vec3(1.2f, 1.5f, 1.0f);
+    scene->animLight = scene->lightPos;
+    // reaches far past the scene, so it lights everything about evenly
+    scene->lights.assign(1, PointLight{ glm::vec4(scene->lightPos, 25.0f), glm::vec4(1.0f, 1.0f, 1.0f, 1.0f) });
+    scene->lightOrbits.clear();
+    lightclusters_init(&scene->lightClusters);
+    lighting_create(&scene->lighting);
+    scene->lightClusters.maxIndices = scene->lighting.maxTexels;
+    scene->animateLight = true;
+    scene->lightTime = 0.0f;
+    scene->redraw = true;
+    scene->defragGeometry = true;
+    const ShaderCache &sc = scene->shaderCache;
+    std::cout << "Scene created in " << (glfwGetTime() - start) * 1000.0 << " ms, shaders "
+              << sc.seconds * 1000.0 << " ms (" << sc.hits << " cached, " << sc.misses << " compiled)\n";
 }
 
 static void delete_scene(Scene* scene){
+    assetloader_stop(&scene->loader);
+    jobsystem_stop(&scene->jobs);
+    lightclusters_destroy(&scene->lightClusters);
+    lighting_destroy(&scene->lighting);
+    renderqueue_destroy(&scene->renderQueue);
+    glDeleteBuffers(1, &scene->frameUbo);
     for(int i = 0;i < scene->renderObjs.size(); i++){
-        delete_object(scene->renderObjs[i]);
+        delete_object(scene, &scene->renderObjs[i]);
     }
+    scene->renderObjs.clear();
+    scene->nodeObject.clear();
+    scene->selection.clear();
+    searchindex_clear(&scene->search);
+    transforms_clear(&scene->transforms);
+    meshregistry_destroy(&scene->meshes);
+    shader_destroy(&scene->program);
+    if (scene->programMultiDraw.id) shader_destroy(&scene->programMultiDraw);
+    if (scene->programInstanced.id) shader_destroy(&scene->programInstanced);
 }
 
-static void CreateOrResizeSceneFBO(SceneFBO *s, int w, int h)
+// Returns true when the image size changed and it holds no image yet. The
+// targets only change when the new size leaves their bucket, so dragging a
+// dock splitter mostly just moves the viewport.
+static bool CreateOrResizeSceneFBO(SceneFBO *s, int w, int h)
 {
-    if (w <= 0 || h <= 0) return;
+    if (w <= 0 || h <= 0) return false;
 
     // if same size and already created, do nothing
-    if (s->fbo != 0 && s->w == w && s->h == h) return;
-
-    // destroy old
-    if (s->depth) glDeleteRenderbuffers(1, &s->depth);
-    if (s->color) glDeleteTextures(1, &s->color);
-    if (s->fbo)   glDeleteFramebuffers(1, &s->fbo);
-
+    if (s->fbo != 0 && s->w == w && s->h == h) return false;
     s->w = w; s->h = h;
+    if (s->fbo != 0 && rtpool_fits(&s->targets, s->color, w, h) && rtpool_fits(&s->targets, s->depth, w, h))
+        return true;
+
+    rtpool_release(&s->targets, s->color);
+    rtpool_release(&s->targets, s->depth);
+    s->color = rtpool_acquire(&s->targets, GL_RGBA8, w, h);
+    s->depth = rtpool_acquire(&s->targets, GL_DEPTH24_STENCIL8, w, h);
+    s->fbo = rtpool_framebuffer(&s->targets, s->color, s->depth);
+    return true;
+}
 
-    glGenFramebuffers(1, &s->fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, s->fbo);
-
-    // color texture
-    glGenTextures(1, &s->color);
-    glBindTexture(GL_TEXTURE_2D, s->color);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, s->color, 0);
-
-    // depth buffer
-    glGenRenderbuffers(1, &s->depth);
-    glBindRenderbuffer(GL_RENDERBUFFER, s->depth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, w, h);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, s->depth);
-
-    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+// Updates world matrices; anything that moved makes the scene image stale.
+static void update_transforms(Scene *scene)
+{
+    if (transforms_update(&scene->transforms, &scene->jobs).nodes > 0)
+        scene->redraw = true;
+}
 
-    if (status != GL_FRAMEBUFFER_COMPLETE) {
-        std::cerr << "Scene FBO incomplete: " << status << "\n";
+// Writes every object in hierarchy order, so parents precede children.
+static bool save_scene_file(Scene *scene, const std::string &path){
+    double start = glfwGetTime();
+    update_transforms(scene);   // pre-order layout
+    const TransformHierarchy *h = &scene->transforms;
+    SceneFileWriter writer;
+    std::vector<uint32_t> fileIndex(scene->nodeObject.size(), SCENE_FILE_NONE);   // by NodeId
+    for (uint32_t slot = 0; slot < transforms_count(h); ++slot) {
+        NodeId node = h->node[slot];
+        const RenderObj &o = scene->renderObjs[scene->nodeObject[node]];
+        uint32_t mesh = o.mesh == MESH_NONE ? SCENE_FILE_NONE
+                                            : scenefile_add_mesh(&writer, meshregistry_get(&scene->meshes, o.mesh)->path);
+        NodeId parent = transforms_parent(h, node);
+        fileIndex[node] = scenefile_add_object(&writer, o.name, mesh, parent == NODE_NONE ? SCENE_FILE_NONE : fileIndex[parent],
+                                               transforms_position(h, node), transforms_rotation(h, node),
+                                               transforms_scale(h, node), o.color);
     }
+    if (!scenefile_save(&writer, path)) {
+        std::cerr << "Could not write scene: " << path << "\n";
+        return false;
+    }
+    std::cout << "Saved " << path << ": " << writer.objects.size() << " objects in "
+              << (glfwGetTime() - start) * 1000.0 << " ms\n";
+    return true;
 }
 
 static void RenderSceneToFBO(SceneFBO *s, Scene *scene)
 {
+    PROFILE_GPU_SCOPE("render scene");
     glBindFramebuffer(GL_FRAMEBUFFER, s->fbo);
     glViewport(0, 0, s->w, s->h);
 
     glEnable(GL_DEPTH_TEST);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    glViewport(0, 0, s->w, s->h);
-
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    OrbitCamera *camera = &scene->orbitCamera;
+    FrameUniforms frame;
+    frame.view = orbitcamera_view(camera);
+    frame.proj = orbitcamera_proj(camera, (float)s->w / (float)s->h);
+    frame.viewPos = glm::vec4(orbitcamera_position(camera), 1.0f);
+    {
+        PROFILE_SCOPE("light assignment");
+        lightclusters_build(&scene->lightClusters, scene->lights.data(), scene->lights.size(),
+                            frame.view, frame.proj, camera->nearClip, camera->farClip);
+        lighting_upload(&scene->lighting, scene->lights.data(), scene->lights.size(), &scene->lightClusters);
+    }
+    lighting_bind(&scene->lighting);
+    frame.clusterParams = glm::vec4(camera->nearClip, scene->lightClusters.sliceScale, (float)s->w, (float)s->h);
+    frame.clusterDims = glm::ivec4(CLUSTER_X, CLUSTER_Y, CLUSTER_Z, (int)scene->lights.size());
+    frameuniforms_upload(scene->frameUbo, &frame);
 
-    glm::vec3 camPos = orbitcamera_position(&scene->orbitCamera);
-    glm::mat4 view = orbitcamera_view(&scene->orbitCamera);
-    glm::mat4 proj = orbitcamera_proj(&scene->orbitCamera, (float)s->w / (float)s->h);
-    for(int i = 0; i < scene->renderObjs.size(); i++){
-        render_object(&scene->renderObjs[i], view, proj, scene->animLight, camPos);
+    transforms_update(&scene->transforms, &scene->jobs);
+    {
+        PROFILE_SCOPE("renderqueue build");
+        renderqueue_build(&scene->renderQueue, scene, frame.view, frame.proj, s->h);
+    }
+    {
+        PROFILE_SCOPE("renderqueue submit");
+        renderqueue_submit(&scene->renderQueue, scene);
     }
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
@@ -435,8 +481,378 @@ static void destroyImGui()
     ImGui::DestroyContext();
 }
 
+static std::string object_label(Scene *scene, const RenderObj *obj){
+    if (obj->mesh == MESH_NONE) return obj->name;
+    const GpuMesh *mesh = meshregistry_get(&scene->meshes, obj->mesh);
+    if (mesh->loading) return obj->name + " (loading)";
+    if (mesh->failed) return obj->name + " (failed)";
+    return obj->name;
+}
+
+static bool type_matches(Scene *scene, const RenderObj *obj, int type){
+    switch (type) {
+    case HIERARCHY_MESHES:  return obj->mesh != MESH_NONE;
+    case HIERARCHY_GROUPS:  return obj->mesh == MESH_NONE;
+    case HIERARCHY_LOADING: return obj->mesh != MESH_NONE && meshregistry_get(&scene->meshes, obj->mesh)->loading;
+    default:                return true;
+    }
+}
+
+static int row_object(Scene *scene, const HierarchyView *view, bool filtering, int row){
+    uint32_t r = view->rows[row];
+    return filtering ? (int)r : scene->nodeObject[scene->transforms.node[r]];
+}
+
+// Plain click selects one object, ctrl toggles, shift takes the rows from
+// the last plain or ctrl click.
+static void click_row(Scene *scene, HierarchyView *view, bool filtering, int row, int objIndex){
+    const ImGuiIO &io = ImGui::GetIO();
+    if (io.KeyShift && view->anchor >= 0) {
+        int anchorRow = -1;
+        for (int r = 0; r < (int)view->rows.size() && anchorRow < 0; ++r)
+            if (row_object(scene, view, filtering, r) == view->anchor) anchorRow = r;
+        if (anchorRow >= 0) {
+            if (!io.KeyCtrl) select_object(scene, view->anchor, false);
+            for (int r = std::min(row, anchorRow); r <= std::max(row, anchorRow); ++r)
+                select_object(scene, row_object(scene, view, filtering, r), true);
+            select_object(scene, objIndex, true);
+            return;
+        }
+    }
+    if (io.KeyCtrl) toggle_selected(scene, objIndex);
+    else select_object(scene, objIndex, false);
+    view->anchor = objIndex;
+}
+
+// Only the rows in view are submitted. Each is a tree node pushed under its
+// NodeId, so objects sharing a name still have their own ID, and dropping
+// one row onto another makes it (or the whole selection, if it was part of
+// it) a child. Reparenting waits until the rows are drawn, as it moves slots.
+static void draw_hierarchy_window(Scene *scene, HierarchyView *view){
+    PROFILE_SCOPE("hierarchy");
+    double start = glfwGetTime();
+    if (!ImGui::Begin("Hierarchy")) {
+        ImGui::End();
+        view->seconds = glfwGetTime() - start;
+        return;
+    }
+    if (ImGui::Button("Save")) save_scene_file(scene, scene->path);
+    ImGui::SameLine();
+    ImGui::TextDisabled("%s", scene->path.c_str());
+    ImGui::SetNextItemWidth(-100.0f);
+    ImGui::InputTextWithHint("##filter", "filter by name", view->filter, sizeof(view->filter));
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(-1.0f);
+    ImGui::Combo("##type", &view->type, "all\0meshes\0groups\0loading\0");
+
+    TransformHierarchy *h = &scene->transforms;
+    const bool filtering = view->filter[0] != 0 || view->type != HIERARCHY_ALL;
+    view->rows.clear();
+    if (filtering) {
+        if (view->matchedQuery != view->filter || view->matchedVersion != scene->search.version) {
+            searchindex_query(&scene->search, view->filter, &view->matches);
+            view->matchedQuery = view->filter;
+            view->matchedVersion = scene->search.version;
+        }
+        for (uint32_t obj : view->matches)
+            if (type_matches(scene, &scene->renderObjs[obj], view->type)) view->rows.push_back(obj);
+    } else {
+        // pre-order slots, skipping the subtrees of collapsed nodes
+        const uint32_t count = (uint32_t)transforms_count(h);
+        view->collapsed.resize(scene->nodeObject.size(), 0);
+        view->depth.resize(count);
+        for (uint32_t slot = 0; slot < count;) {
+            view->rows.push_back(slot);
+            uint32_t parent = h->parent[slot];
+            view->depth[slot] = parent == NODE_NONE ? 0 : view->depth[parent] + 1;
+            slot = view->collapsed[h->node[slot]] ? h->subtreeEnd[slot] : slot + 1;
+        }
+    }
+    ImGui::TextDisabled("%d rows, %d selected", (int)view->rows.size(), scene->selectionCount);
+
+    NodeId dragged = NODE_NONE, dropTarget = NODE_NONE;
+    ImGui::BeginChild("rows");
+    ImGuiListClipper clipper;
+    clipper.Begin((int)view->rows.size());
+    while (clipper.Step()) {
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+            int objIndex = row_object(scene, view, filtering, row);
+            const RenderObj *obj = &scene->renderObjs[objIndex];
+            NodeId node = obj->node;
+            uint32_t slot = h->slotOf[node];
+            bool leaf = filtering || h->subtreeEnd[slot] == slot + 1;
+            float indent = filtering ? 0.0f : view->depth[slot] * ImGui::GetStyle().IndentSpacing;
+
+            ImGui::PushID((int)node);
+            if (indent > 0.0f) ImGui::Indent(indent);
+            ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_OpenOnArrow | ImGuiTreeNodeFlags_SpanAvailWidth |
+                                       ImGuiTreeNodeFlags_NoTreePushOnOpen;
+            if (leaf) flags |= ImGuiTreeNodeFlags_Leaf;
+            if (scene->selection[objIndex]) flags |= ImGuiTreeNodeFlags_Selected;
+            if (!leaf) ImGui::SetNextItemOpen(!view->collapsed[node]);
+            bool open = ImGui::TreeNodeEx("node", flags, "%s", object_label(scene, obj).c_str());
+            if (!leaf) view->collapsed[node] = !open;
+            if (ImGui::IsItemClicked() && !ImGui::IsItemToggledOpen())
+                click_row(scene, view, filtering, row, objIndex);
+
+            if (ImGui::BeginDragDropSource()) {
+                ImGui::SetDragDropPayload("HIERARCHY_NODE", &node, sizeof(node));
+                if (scene->selection[objIndex] && scene->selectionCount > 1)
+                    ImGui::Text("%d objects", scene->selectionCount);
+                else
+                    ImGui::TextUnformatted(obj->name.c_str());
+                ImGui::EndDragDropSource();
+            }
+            if (ImGui::BeginDragDropTarget()) {
+                if (const ImGuiPayload *payload = ImGui::AcceptDragDropPayload("HIERARCHY_NODE")) {
+                    dragged = *(const NodeId*)payload->Data;
+                    dropTarget = node;
+                }
+                ImGui::EndDragDropTarget();
+            }
+            if (indent > 0.0f) ImGui::Unindent(indent);
+            ImGui::PopID();
+        }
+    }
+    ImGui::EndChild();
+
+    if (dragged != NODE_NONE) {
+        int draggedObj = scene->nodeObject[dragged];
+        if (scene->selection[draggedObj]) {
+            for (size_t i = 0; i < scene->renderObjs.size(); ++i)
+                if (scene->selection[i]) transforms_set_parent(h, scene->renderObjs[i].node, dropTarget);   // refuses cycles
+        } else {
+            transforms_set_parent(h, dragged, dropTarget);
+        }
+    }
+    ImGui::End();
+    view->seconds = glfwGetTime() - start;
+}
+
+static void draw_inspector(Scene *scene){
+    TransformHierarchy *h = &scene->transforms;
+    RenderObj *o = &scene->renderObjs[scene->selected];
+    ImGui::TextUnformatted(o->name.c_str());
+
+    NodeId parent = transforms_parent(h, o->node);
+    if (parent == NODE_NONE) {
+        ImGui::TextDisabled("root");
+    } else {
+        ImGui::Text("parent: %s", scene->renderObjs[scene->nodeObject[parent]].name.c_str());
+        ImGui::SameLine();
+        if (ImGui::SmallButton("unparent"))
+            transforms_set_parent(h, o->node, NODE_NONE);
+    }
+
+    // local transform, relative to the parent
+    glm::vec3 position = transforms_position(h, o->node);
+    glm::vec3 rotation = transforms_rotation(h, o->node);
+    glm::vec3 scale = transforms_scale(h, o->node);
+    if (ImGui::DragFloat3("position", &position.x, 0.01f)) transforms_set_position(h, o->node, position);
+    if (ImGui::DragFloat3("rotation", &rotation.x, 1.0)) transforms_set_rotation(h, o->node, rotation);
+    if (ImGui::DragFloat3("scale", &scale.x, 0.01f)) transforms_set_scale(h, o->node, scale);
+    if (ImGui::ColorEdit3("color", &o->color.x)) {
+        for (size_t i = 0; scene->selectionCount > 1 && i < scene->renderObjs.size(); ++i)
+            if (scene->selection[i]) scene->renderObjs[i].color = o->color;
+        scene->redraw = true;
+    }
+    if (scene->selectionCount > 1)
+        ImGui::TextDisabled("%d objects selected, colour edits apply to all", scene->selectionCount);
+
+    if (o->mesh == MESH_NONE) return;
+    const GpuMesh *mesh = meshregistry_get(&scene->meshes, o->mesh);
+    if (mesh->failed) ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.3f, 1.0f), "mesh failed to load: %s", mesh->path.c_str());
+    if (!meshregistry_resident(mesh)) return;
+    ImGui::SeparatorText("level of detail");
+    bool edited = ImGui::SliderFloat("max error (px)", &o->lodErrorPixels, 0.1f, 20.0f, "%.1f", ImGuiSliderFlags_Logarithmic);
+    edited |= ImGui::SliderFloat("hysteresis", &o->lodHysteresis, 0.0f, 0.9f);
+    edited |= ImGui::SliderInt("force LOD", &o->lodForce, -1, mesh->lodCount - 1, o->lodForce < 0 ? "auto" : "%d");
+    if (edited) scene->redraw = true;
+    for (int i = 0; i < mesh->lodCount; ++i)
+        ImGui::Text("%s LOD %d: %u triangles, error %.4f", i == o->lod ? ">" : " ", i,
+                    mesh->lods[i].indexCount / 3, mesh->lods[i].error);
+
+    ImGui::SeparatorText("vertices");
+    ImGui::Text("%s, %zu KB (%zu KB as float)", mesh->vertexFormat == MESH_VERTEX_PACKED ? "packed" : "float",
+                mesh->vertexBytes / 1024, mesh->floatVertexBytes / 1024);
+    const VertexPackError &pe = mesh->packError;
+    if (pe.normalDegrees > 0.0f || pe.position > 0.0f)
+        ImGui::Text("packing error: %.2g units (%.3f of an edge), normals %.3f deg",
+                    pe.position, pe.positionRatio, pe.normalDegrees);
+}
+
+// Occlusion settings, counters and the buffer itself, nearer is brighter.
+static void draw_occlusion_window(Scene *scene, SceneFBO *s)
+{
+    RenderQueue *queue = &scene->renderQueue;
+    const OcclusionBuffer *buffer = &queue->occlusion;
+    if (!ImGui::Begin("Occlusion")) {
+        ImGui::End();
+        return;
+    }
+    if (ImGui::Checkbox("enabled", &queue->occlusionCulling)) scene->redraw = true;
+    if (ImGui::SliderInt("max occluders", &queue->maxOccluders, 0, 256)) scene->redraw = true;
+    const OcclusionStats &st = buffer->stats;
+    ImGui::Text("occluders: %d, triangles: %d", st.occluders, st.triangles);
+    ImGui::Text("culled: %d of %d", st.occluded, st.tested);
+    ImGui::Text("raster %.3f ms, test %.3f ms", st.rasterSeconds * 1000.0, st.testSeconds * 1000.0);
+
+    // depth is NDC z, crowded near 1; stretch what's there to the full range
+    const size_t count = (size_t)buffer->width * buffer->height;
+    s->occlusionPixels.resize(count);
+    float nearest = 1.0f;
+    for (int y = 0; y < buffer->height; ++y)
+        for (int x = 0; x < buffer->width; ++x)
+            nearest = std::min(nearest, occlusion_depth(buffer, x, y));
+    float scale = nearest < 1.0f ? 1.0f / (1.0f - nearest) : 0.0f;
+    for (int y = 0; y < buffer->height; ++y)
+        for (int x = 0; x < buffer->width; ++x) {
+            uint32_t v = (uint32_t)((1.0f - occlusion_depth(buffer, x, y)) * scale * 255.0f);
+            s->occlusionPixels[(size_t)y * buffer->width + x] = 0xff000000u | v << 16 | v << 8 | v;
+        }
+
+    if (!s->occlusionView) {
+        glGenTextures(1, &s->occlusionView);
+        glBindTexture(GL_TEXTURE_2D, s->occlusionView);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+    glBindTexture(GL_TEXTURE_2D, s->occlusionView);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, buffer->width, buffer->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, s->occlusionPixels.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // row 0 is the bottom of the screen
+    float w = ImGui::GetContentRegionAvail().x;
+    ImGui::Image((ImTextureID)(intptr_t)s->occlusionView, ImVec2(w, w * buffer->height / buffer->width), ImVec2(0, 1), ImVec2(1, 0));
+    ImGui::End();
+}
+
+// One row per scope; children follow their parent in begin order.
+static int draw_profile_scope(const ProfileFrame &frame, int index)
+{
+    const ProfileScope &sc = frame.scopes[index];
+    int next = index + 1;
+    bool leaf = next >= (int)frame.scopes.size() || frame.scopes[next].depth <= sc.depth;
+    ImGui::TableNextRow();
+    ImGui::TableNextColumn();
+    bool open = ImGui::TreeNodeEx((void*)(intptr_t)index,
+                                  ImGuiTreeNodeFlags_DefaultOpen | ImGuiTreeNodeFlags_SpanAvailWidth |
+                                  (leaf ? ImGuiTreeNodeFlags_Leaf : 0), "%s", sc.name);
+    ImGui::TableNextColumn();
+    ImGui::Text("%.3f", (sc.end - sc.start) * 1000.0);
+    ImGui::TableNextColumn();
+    if (sc.gpuMs >= 0.0f) ImGui::Text("%.3f", sc.gpuMs);
+    else ImGui::TextDisabled("-");
+
+    while (next < (int)frame.scopes.size() && frame.scopes[next].depth > sc.depth) {
+        if (open) next = draw_profile_scope(frame, next);
+        else ++next;
+    }
+    if (open) ImGui::TreePop();
+    return next;
+}
+
+// Frame time graphs, the scope tree of the newest complete frame and trace
+// capture.
+static void draw_profiler_window(ProfilerView *view)
+{
+    if (!ImGui::Begin("Profiler")) {
+        ImGui::End();
+        return;
+    }
+    bool enabled = profiler_enabled();
+    if (ImGui::Checkbox("enabled", &enabled))
+        profiler_set_enabled(enabled);
+
+    profiler_history(&view->cpuMs, &view->gpuMs);
+    const ProfileFrame &frame = profiler_last_frame();
+    char overlay[64];
+    std::snprintf(overlay, sizeof(overlay), "%.2f ms", (frame.end - frame.start) * 1000.0);
+    ImGui::PlotLines("CPU", view->cpuMs.data(), (int)view->cpuMs.size(), 0, overlay, 0.0f, 33.3f, ImVec2(0, 60));
+    if (frame.gpuMs >= 0.0f) std::snprintf(overlay, sizeof(overlay), "%.2f ms", frame.gpuMs);
+    else std::snprintf(overlay, sizeof(overlay), "not ready");
+    ImGui::PlotLines("GPU", view->gpuMs.data(), (int)view->gpuMs.size(), 0, overlay, 0.0f, 33.3f, ImVec2(0, 60));
+
+    ImGui::InputInt("frames", &view->captureFrames);
+    view->captureFrames = std::max(1, view->captureFrames);
+    int remaining = profiler_capture_remaining();
+    if (remaining > 0) {
+        ImGui::Text("capturing, %d frames to go", remaining);
+    } else if (ImGui::Button("Capture trace")) {
+        profiler_set_enabled(true);
+        profiler_capture(view->captureFrames, "profile_trace.json");
+    }
+
+    if (ImGui::BeginTable("scopes", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable)) {
+        ImGui::TableSetupColumn("scope");
+        ImGui::TableSetupColumn("CPU ms");
+        ImGui::TableSetupColumn("GPU ms");
+        ImGui::TableHeadersRow();
+        for (int i = 0; i < (int)frame.scopes.size(); )
+            i = draw_profile_scope(frame, i);
+        ImGui::EndTable();
+    }
+    ImGui::End();
+}
+
+// Light count, the stress scene and the cost of light assignment.
+static void draw_lights_window(Scene *scene)
+{
+    if (!ImGui::Begin("Lights")) {
+        ImGui::End();
+        return;
+    }
+    static int stressLights = 4096;
+    ImGui::Text("lights: %d", (int)scene->lights.size());
+    ImGui::InputInt("stress lights", &stressLights);
+    stressLights = std::max(0, stressLights);
+    if (ImGui::Button("Spawn")) set_stress_lights(scene, stressLights);
+    ImGui::SameLine();
+    if (ImGui::Button("Clear")) set_stress_lights(scene, 0);
+
+    const LightClusterStats &st = scene->lightClusters.stats;
+    ImGui::Text("clusters: %dx%dx%d on %d threads", CLUSTER_X, CLUSTER_Y, CLUSTER_Z,
+                workerpool_size(&scene->lightClusters.pool));
+    ImGui::Text("visible lights: %d, indices: %d, max per cluster: %d", st.visible, st.indices, st.maxPerCluster);
+    ImGui::Text("assignment: %.3f ms", st.seconds * 1000.0);
+    if (st.truncated) ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.3f, 1.0f), "light index list full, lights dropped");
+    ImGui::End();
+}
+
+static void allocator_stats(const char *label, const RangeAllocator *alloc, size_t unitBytes)
+{
+    float occupancy = alloc->capacity ? (float)alloc->used / (float)alloc->capacity : 0.0f;
+    char overlay[64];
+    std::snprintf(overlay, sizeof(overlay), "%.1f / %.1f MB", alloc->used * unitBytes / 1048576.0,
+                  alloc->capacity * unitBytes / 1048576.0);
+    ImGui::Text("%s", label);
+    ImGui::ProgressBar(occupancy, ImVec2(-1.0f, 0.0f), overlay);
+    ImGui::Text("free blocks: %d, largest: %.2f MB, fragmentation: %.0f%%", (int)rangealloc_free_blocks(alloc),
+                rangealloc_largest_free(alloc) * unitBytes / 1048576.0, rangealloc_fragmentation(alloc) * 100.0f);
+}
+
+static void draw_geometry_window(Scene *scene)
+{
+    if (!ImGui::Begin("Geometry")) {
+        ImGui::End();
+        return;
+    }
+    ImGui::Checkbox("defragment", &scene->defragGeometry);
+    for (const GeometryArena &arena : scene->meshes.arenas) {
+        if (!arena.vao) continue;
+        ImGui::SeparatorText(arena.vertexFormat == MESH_VERTEX_PACKED ? "packed vertices" : "float vertices");
+        allocator_stats("vertices", &arena.vertices, arena.vertexStride);
+        allocator_stats("indices", &arena.indices, 4);
+        const GeometryArenaStats &st = arena.stats;
+        ImGui::Text("grows: %ld, moves: %ld (%.1f MB)", st.grows, st.moves, st.movedBytes / 1048576.0);
+    }
+    ImGui::End();
+}
+
 static void RenderImGuiFrame(GLFWwindow* window, Scene *scene, SceneFBO *s)
 {
+    PROFILE_SCOPE("ImGui frame");
+    double uiStart = glfwGetTime(), sceneSeconds = 0.0;
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
@@ -467,18 +883,48 @@ static void RenderImGuiFrame(GLFWwindow* window, Scene *scene, SceneFBO *s)
     ImGui::End();
 
     ImGui::Begin("Inspector");
-    RenderObj *o = &scene->renderObjs[scene->selected];
-    ImGui::DragFloat3("position", &o->position.x, 0.01f);
-    ImGui::DragFloat3("rotation", &o->rotation.x, 1.0);
-    ImGui::DragFloat3("scale", &o->scale.x, 0.01f);
-    ImGui::ColorEdit3("color", &o->color.x);
+    draw_inspector(scene);
     ImGui::End();
 
-    ImGui::Begin("Hierarchy");
-    for(int i=0;i<scene->renderObjs.size();i++){
-        if(ImGui::Button(scene->renderObjs[i].name.c_str())){
-            scene->selected = i;
-        }
+    draw_hierarchy_window(scene, &s->hierarchyView);
+
+    ImGui::Begin("Stats");
+    const GLStats &gl = glstats_last();
+    ImGui::Text("%.1f fps (%.2f ms)", ImGui::GetIO().Framerate, 1000.0f / ImGui::GetIO().Framerate);
+    ImGui::Text("GL calls: %d", gl.calls);
+    ImGui::Text("draw calls: %d", gl.drawCalls);
+    const RenderQueueStats &rq = scene->renderQueue.stats;
+    ImGui::Text("render path: %s", scene->renderQueue.multiDraw ? "multi-draw indirect" : "instanced draws");
+    ImGui::Text("objects: %d, queue draws: %d (%d multi-draw)", rq.objects, rq.draws, rq.multiDraws);
+    ImGui::Text("instanced objects: %d, meshes: %d", rq.instanced, (int)scene->meshes.byPath.size());
+    const MeshRegistry &reg = scene->meshes;
+    ImGui::Text("vertex data: %.2f MB, %d packed meshes, %.2f MB saved", reg.vertexBytes / 1048576.0,
+                reg.packedMeshes, (reg.floatVertexBytes - reg.vertexBytes) / 1048576.0);
+    ImGui::Text("transform nodes: %d", (int)transforms_count(&scene->transforms));
+    ImGui::Text("triangles submitted: %lld", (long long)rq.triangles);
+    ImGui::Text("objects per LOD: %d %d %d %d %d %d", rq.lodObjects[0], rq.lodObjects[1], rq.lodObjects[2],
+                rq.lodObjects[3], rq.lodObjects[4], rq.lodObjects[5]);
+    const PickStats &pick = scene->picker.stats;
+    if (pick.object >= 0)
+        ImGui::Text("pick: triangle %u of %s, %.3f ms", pick.triangle, scene->renderObjs[pick.object].name.c_str(), pick.seconds * 1000.0);
+    else
+        ImGui::Text("pick: nothing, %.3f ms", pick.seconds * 1000.0);
+    if (pick.rebuilt)
+        ImGui::Text("pick instances: %d, rebuilt", pick.instances);
+    else
+        ImGui::Text("pick instances: %d, %d refit", pick.instances, pick.moved);
+    const ShaderCache &sc = scene->shaderCache;
+    ImGui::Text("shaders: %d cached, %d compiled, %d rejected, %.1f ms%s", sc.hits, sc.misses, sc.rejected,
+                sc.seconds * 1000.0, sc.parallelCompile ? ", parallel compile" : "");
+    ImGui::Checkbox("animate light", &scene->animateLight);
+    ImGui::Text("scene redraws: %ld, skipped: %ld", s->redraws, s->skippedFrames);
+    const RenderTargetPoolStats &rt = s->targets.stats;
+    ImGui::Text("render targets: %d (%d in use), %.2f MB", rt.targets, rt.inUse, rt.bytes / 1048576.0);
+    ImGui::Text("target allocations: %ld, reused: %ld, freed: %ld, this frame: %d",
+                rt.allocations, rt.reuses, rt.frees, rt.frameAllocations);
+    if (s->color != RENDER_TARGET_NONE) {
+        const RenderTarget *color = rtpool_get(&s->targets, s->color);
+        ImGui::Text("scene image: %dx%d in a %dx%d target", s->w, s->h, color->width, color->height);
     }
     ImGui::End();
 
@@ -488,10 +934,41 @@ static void RenderImGuiFrame(GLFWwindow* window, Scene *scene, SceneFBO *s)
     int w = (int)avail.x;
     int h = (int)avail.y;
 
-    CreateOrResizeSceneFBO(s, w, h);
-    RenderSceneToFBO(s, scene);
+    // an unchanged scene keeps last frame's image
+    if (CreateOrResizeSceneFBO(s, w, h)) scene->redraw = true;
+    update_transforms(scene);
+    s->redrawn = scene->redraw && s->fbo != 0;
+    if (s->redrawn) {
+        double renderStart = glfwGetTime();
+        RenderSceneToFBO(s, scene);
+        sceneSeconds = glfwGetTime() - renderStart;
+        scene->redraw = false;
+        s->redraws++;
+    } else {
+        s->skippedFrames++;
+    }
 
-    ImGui::Image((ImTextureID)(intptr_t)s->color, avail, ImVec2(0, 1), ImVec2(1, 0));
+    // the image is the bottom left of the target; flip v for ImGui
+    const RenderTarget *color = rtpool_get(&s->targets, s->color);
+    ImVec2 uvMax((float)s->w / color->width, (float)s->h / color->height);
+    ImGui::Image((ImTextureID)(intptr_t)color->texture, avail, ImVec2(0, uvMax.y), ImVec2(uvMax.x, 0));
+    bool imageClicked = ImGui::IsItemClicked(ImGuiMouseButton_Left);
+
+    // culling stats over the top left corner of the image
+    const CullStats &cull = scene->renderQueue.cullStats;
+    const OcclusionStats &occ = scene->renderQueue.occlusion.stats;
+    const RenderQueue &queue = scene->renderQueue;
+    char overlay[352];
+    const LightClusterStats &lights = scene->lightClusters.stats;
+    snprintf(overlay, sizeof(overlay), "culling: %d tested, %d visible, %.3f ms\nocclusion: %d culled, %.3f ms\nframe prep: %.3f ms on %d threads\nlights: %d of %d, %.3f ms\nui: %.3f ms, hierarchy %.3f ms (%d rows)",
+             cull.tested, cull.visible, cull.seconds * 1000.0,
+             occ.occluded, (occ.rasterSeconds + occ.testSeconds) * 1000.0,
+             (queue.buildSeconds + queue.stats.fillSeconds) * 1000.0, jobsystem_size(&scene->jobs),
+             lights.visible, lights.lights, lights.seconds * 1000.0,
+             s->uiSeconds * 1000.0, s->hierarchyView.seconds * 1000.0, (int)s->hierarchyView.rows.size());
+    ImVec2 imageMin = ImGui::GetItemRectMin();
+    ImVec2 imageSize = ImGui::GetItemRectSize();
+    ImGui::GetWindowDrawList()->AddText(ImVec2(imageMin.x + 8.0f, imageMin.y + 8.0f), IM_COL32(255, 255, 255, 220), overlay);
 
     ImGuizmo::BeginFrame();
     ImGuizmo::SetDrawlist();
@@ -505,7 +982,8 @@ static void RenderImGuiFrame(GLFWwindow* window, Scene *scene, SceneFBO *s)
 
     glm::mat4 view = orbitcamera_view(&scene->orbitCamera);
     glm::mat4 proj = orbitcamera_proj(&scene->orbitCamera, (float)s->w / (float)s->h);
-    glm::mat4 model = renderobject_model(&scene->renderObjs[scene->selected]);
+    NodeId selectedNode = scene->renderObjs[scene->selected].node;
+    glm::mat4 model = transforms_world(&scene->transforms, selectedNode);
 
     if(ImGuizmo::Manipulate(
         glm::value_ptr(view),
@@ -514,18 +992,46 @@ static void RenderImGuiFrame(GLFWwindow* window, Scene *scene, SceneFBO *s)
         ImGuizmo::LOCAL,
         glm::value_ptr(model)
     )){
-        scene->renderObjs[scene->selected].position = glm::vec3(model[3]);
+        // the gizmo works in world space, the node stores its offset from the parent
+        glm::vec4 position = model[3];
+        NodeId parent = transforms_parent(&scene->transforms, selectedNode);
+        if (parent != NODE_NONE)
+            position = glm::inverse(transforms_world(&scene->transforms, parent)) * position;
+        transforms_set_position(&scene->transforms, selectedNode, glm::vec3(position));
+    }
+
+    // clicks on the gizmo belong to the gizmo
+    if (imageClicked && !ImGuizmo::IsOver() && !ImGuizmo::IsUsing() && imageSize.x > 0 && imageSize.y > 0) {
+        ImVec2 mouse = ImGui::GetMousePos();
+        glm::vec2 ndc((mouse.x - imageMin.x) / imageSize.x * 2.0f - 1.0f,
+                      1.0f - (mouse.y - imageMin.y) / imageSize.y * 2.0f);
+        glm::vec3 origin, dir;
+        picking_ray(view, proj, ndc, &origin, &dir);
+        int picked = picking_pick(&scene->picker, scene, origin, dir);
+        if (picked >= 0)
+            select_object(scene, picked, ImGui::GetIO().KeyCtrl);
     }
 
     ImGui::End();
 
+    draw_occlusion_window(scene, s);
+    draw_lights_window(scene);
+    draw_geometry_window(scene);
+    draw_profiler_window(&s->profilerView);
+
+    s->uiSeconds = glfwGetTime() - uiStart - sceneSeconds;
+
     // Render
-    ImGui::Render();
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    {
+        PROFILE_GPU_SCOPE("ImGui render");
+        ImGui::Render();
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    }
 
     auto io = ImGui::GetIO();
     // Multi-viewport support (ONLY if enabled)
     if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable) {
+        PROFILE_SCOPE("platform windows");
         GLFWwindow* backup = glfwGetCurrentContext();
         ImGui::UpdatePlatformWindows();
         ImGui::RenderPlatformWindowsDefault();
@@ -535,22 +1041,222 @@ static void RenderImGuiFrame(GLFWwindow* window, Scene *scene, SceneFBO *s)
 }
 
 double lastXPos = 0, lastYPos = 0;
-int main() {
-  glfwSetErrorCallback(glfw_error_callback);
-  if (!glfwInit()) return 1;
+const double UPLOAD_BUDGET_SECONDS = 0.004;   // GL upload time per frame
+const size_t DEFRAG_BUDGET_BYTES = 1 << 20;    // geometry moved per frame when compacting
+const double IDLE_WAIT_SECONDS = 0.5;         // longest sleep with nothing to do
+const int ACTIVE_FRAMES = 3;                  // frames run after input so ImGui settles
+
+// --bench: render a scripted camera path offscreen and report frame times.
+struct BenchOptions {
+    bool enabled = false;
+    int frames = 600;
+    int warmup = 30;   // untimed frames for shader and driver warmup
+    int width = 1280, height = 720;
+    std::string output = "bench.json";
+    bool checksum = false;
+    std::string expectChecksum;   // fail when the last frame differs
+    std::vector<std::string> models;   // empty for the default scene
+    std::string scene;                 // saved scene to open instead
+    int lights = 0;                    // stress lights besides the key light
+    bool packVertices = true;          // off: every mesh keeps float vertices
+};
+
+static bool parse_bench_options(int argc, char **argv, BenchOptions *opt)
+{
+    for (int i = 1; i < argc; ++i) {
+        bool more = i + 1 < argc;
+        if (std::strcmp(argv[i], "--bench") == 0) opt->enabled = true;
+        else if (std::strcmp(argv[i], "--frames") == 0 && more) opt->frames = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--warmup") == 0 && more) opt->warmup = std::max(0, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--size") == 0 && more) {
+            if (std::sscanf(argv[++i], "%dx%d", &opt->width, &opt->height) != 2 || opt->width <= 0 || opt->height <= 0) {
+                std::cerr << "--size expects WxH\n";
+                return false;
+            }
+        }
+        else if (std::strcmp(argv[i], "--out") == 0 && more) opt->output = argv[++i];
+        else if (std::strcmp(argv[i], "--checksum") == 0) opt->checksum = true;
+        else if (std::strcmp(argv[i], "--expect-checksum") == 0 && more) {
+            opt->checksum = true;
+            opt->expectChecksum = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--model") == 0 && more) opt->models.push_back(argv[++i]);
+        else if (std::strcmp(argv[i], "--scene") == 0 && more) opt->scene = argv[++i];
+        else if (std::strcmp(argv[i], "--lights") == 0 && more) opt->lights = std::max(0, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--float-vertices") == 0) opt->packVertices = false;
+        else {
+            std::cerr << "Unknown argument: " << argv[i] << "\n"
+                      << "usage: mygl [--bench [--frames N] [--warmup N] [--size WxH] [--out file.json]\n"
+                      << "                     [--checksum | --expect-checksum HEX]] [--model file.obj]... [--lights N]\n"
+                      << "            [--scene file.scene] [--float-vertices]\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Deterministic path: one full orbit while bobbing in pitch and zooming in
+// and out, so the view sweeps over near, far and culled objects.
+static void bench_camera(OrbitCamera *cam, int frame, int frames)
+{
+    const float TWO_PI = 6.2831853f;
+    float u = (float)frame / (float)frames;
+    cam->yaw = TWO_PI * u;
+    cam->pitch = 0.15f + 0.35f * std::sin(TWO_PI * 2.0f * u);
+    cam->distance = 5.0f * (1.0f + 0.6f * std::sin(TWO_PI * u));
+}
+
+// FNV-1a over the RGBA8 pixels of the scene FBO.
+static uint64_t scene_checksum(SceneFBO *s)
+{
+    std::vector<unsigned char> pixels((size_t)s->w * s->h * 4);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, s->fbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, s->w, s->h, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    uint64_t h = 14695981039346656037ull;
+    for (unsigned char c : pixels)
+        h = (h ^ c) * 1099511628211ull;
+    return h;
+}
+
+static double percentile(const std::vector<double> &sorted, double p)
+{
+    size_t rank = (size_t)std::ceil(p * sorted.size());
+    return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+// Renders only the scene FBO, no ImGui. Every frame ends in glFinish so the
+// time covers the GPU work too; with no swap nothing else would wait for it.
+static int run_benchmark(const BenchOptions &opt)
+{
+    SceneFBO s;
+    rtpool_init(&s.targets);
+    CreateOrResizeSceneFBO(&s, opt.width, opt.height);
+    Scene scene;
+    create_scene(&scene, GLAD_GL_VERSION_4_3 != 0, opt.models, opt.scene, opt.packVertices);
+    set_stress_lights(&scene, opt.lights);
+    while (poll_shader_variants(&scene) || scene.loadStartTime >= 0) {
+        upload_loaded_meshes(&scene, UPLOAD_BUDGET_SECONDS);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::vector<double> frameMs;
+    frameMs.reserve(opt.frames);
+    double draws = 0.0, triangles = 0.0, lightSeconds = 0.0;
+    int maxDraws = 0;
+    int64_t maxTriangles = 0;
+    for (int i = -opt.warmup; i < opt.frames; ++i) {
+        int frame = std::max(i, 0);
+        bench_camera(&scene.orbitCamera, frame, opt.frames);
+        scene.lightTime = frame / 60.0f;
+        update_lights(&scene);
+
+        glstats_begin_frame();
+        double start = glfwGetTime();
+        RenderSceneToFBO(&s, &scene);
+        glFinish();
+        double ms = (glfwGetTime() - start) * 1000.0;
+        glstats_begin_frame();
+        if (i < 0) continue;
+
+        frameMs.push_back(ms);
+        int d = glstats_last().drawCalls;
+        int64_t tris = scene.renderQueue.stats.triangles;
+        draws += d;
+        triangles += (double)tris;
+        lightSeconds += scene.lightClusters.stats.seconds;
+        maxDraws = std::max(maxDraws, d);
+        maxTriangles = std::max(maxTriangles, tris);
+    }
+
+    std::vector<double> sorted = frameMs;
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0.0;
+    for (double ms : frameMs) total += ms;
+    const double n = (double)frameMs.size();
+
+    char checksum[32] = "";
+    if (opt.checksum)
+        std::snprintf(checksum, sizeof(checksum), "%016llx", (unsigned long long)scene_checksum(&s));
+
+    FILE *f = std::fopen(opt.output.c_str(), "w");
+    if (!f) {
+        std::cerr << "Could not write " << opt.output << "\n";
+    } else {
+        std::fprintf(f, "{\n");
+        std::fprintf(f, "  \"renderer\": \"%s\",\n", (const char*)glGetString(GL_RENDERER));
+        std::fprintf(f, "  \"version\": \"%s\",\n", (const char*)glGetString(GL_VERSION));
+        std::fprintf(f, "  \"width\": %d,\n  \"height\": %d,\n  \"frames\": %d,\n", s.w, s.h, opt.frames);
+        std::fprintf(f, "  \"frame_ms\": { \"min\": %.4f, \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f },\n",
+                     sorted.front(), total / n, percentile(sorted, 0.50), percentile(sorted, 0.95),
+                     percentile(sorted, 0.99), sorted.back());
+        std::fprintf(f, "  \"draw_calls\": { \"mean\": %.1f, \"max\": %d },\n", draws / n, maxDraws);
+        std::fprintf(f, "  \"triangles\": { \"mean\": %.0f, \"max\": %lld },\n", triangles / n, (long long)maxTriangles);
+        std::fprintf(f, "  \"lights\": %d,\n  \"light_assign_ms\": %.4f,\n", (int)scene.lights.size(), lightSeconds * 1000.0 / n);
+        std::fprintf(f, "  \"vertex_bytes\": %zu,\n  \"float_vertex_bytes\": %zu",
+                     scene.meshes.vertexBytes, scene.meshes.floatVertexBytes);
+        if (opt.checksum) std::fprintf(f, ",\n  \"checksum\": \"%s\"", checksum);
+        std::fprintf(f, "\n}\n");
+        std::fclose(f);
+    }
+
+    std::printf("%d frames at %dx%d: mean %.3f ms, p50 %.3f, p95 %.3f, p99 %.3f, %.1f draws, %.0f triangles\n",
+                opt.frames, s.w, s.h, total / n, percentile(sorted, 0.50), percentile(sorted, 0.95),
+                percentile(sorted, 0.99), draws / n, triangles / n);
+    int status = f ? 0 : 1;
+    if (opt.checksum) {
+        std::printf("last frame checksum %s\n", checksum);
+        if (!opt.expectChecksum.empty() && opt.expectChecksum != checksum) {
+            std::printf("CHECKSUM MISMATCH: expected %s\n", opt.expectChecksum.c_str());
+            status = 1;
+        }
+    }
+
+    delete_scene(&scene);
+    rtpool_destroy(&s.targets);
+    return status;
+}
 
-  // Modern core context
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+// Core 4.3 enables multi-draw indirect, 3.3 is the floor. Benchmarks use a
+// hidden window, and with no display at all an OSMesa context where GLFW
+// supports it (Mesa llvmpipe).
+static GLFWwindow *create_window(bool hidden)
+{
+  if (hidden) glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  const int versions[2][2] = { { 4, 3 }, { 3, 3 } };
+  for (int api = 0; api < (hidden ? 2 : 1); ++api) {
+    if (api == 1) glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+    for (const int *v : versions) {
+      glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, v[0]);
+      glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, v[1]);
+      GLFWwindow* window = glfwCreateWindow(1280, 720, "Models", nullptr, nullptr);
+      if (window) return window;
+    }
+  }
+  return nullptr;
+}
+
+int main(int argc, char **argv) {
+  BenchOptions bench;
+  if (!parse_bench_options(argc, argv, &bench)) return 1;
+
+  glfwSetErrorCallback(glfw_error_callback);
+#ifdef GLFW_PLATFORM_NULL
+  // no display server: the null platform still offers OSMesa contexts
+  if (bench.enabled && !std::getenv("DISPLAY") && !std::getenv("WAYLAND_DISPLAY"))
+    glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
+  if (!glfwInit()) return 1;
 
-  GLFWwindow* window = glfwCreateWindow(1280, 720, "Models", nullptr, nullptr);
+  GLFWwindow* window = create_window(bench.enabled);
   if (!window) {
     glfwTerminate();
     return 1;
   }
   glfwMakeContextCurrent(window);
-  glfwSwapInterval(1);
+  glfwSwapInterval(bench.enabled ? 0 : 1);
 
   if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
     std::cerr << "Failed to init GLAD\n";
@@ -558,24 +1264,55 @@ int main() {
   }
 
   std::cout << "OpenGL: " << glGetString(GL_VERSION) << "\n";
+  glstats_install();
+  profiler_init();
+
+  if (bench.enabled) {
+    int status = run_benchmark(bench);
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return status;
+  }
 
   glEnable(GL_DEPTH_TEST);
 
   SceneFBO s;
+  rtpool_init(&s.targets);
   CreateOrResizeSceneFBO(&s, 1000, 800);
   Scene scene;
-  create_scene(&scene);
-
-  glUseProgram(scene.prog);
+  double startTime = glfwGetTime();
+  bool firstFrame = true;
+  create_scene(&scene, GLAD_GL_VERSION_4_3 != 0, bench.models, bench.scene, bench.packVertices);
+  set_stress_lights(&scene, bench.lights);
 
   InitImGui(window);
   float rotation = 0;
+  int activeFrames = ACTIVE_FRAMES;
+  double lastTime = glfwGetTime();
 
   while (!glfwWindowShouldClose(window)) {
-    glfwPollEvents();
+    glstats_begin_frame();
+    profiler_begin_frame();
+    rtpool_begin_frame(&s.targets);
+    {
+      // sleep until input when nothing animates or loads
+      PROFILE_SCOPE("poll events");
+      bool busy = activeFrames > 0 || scene.animateLight || assetloader_pending(&scene.loader) > 0 ||
+                  profiler_capture_remaining() > 0;
+      if (busy) {
+        glfwPollEvents();
+      } else {
+        double waitStart = glfwGetTime();
+        glfwWaitEventsTimeout(IDLE_WAIT_SECONDS);
+        if (glfwGetTime() - waitStart < IDLE_WAIT_SECONDS)
+          activeFrames = ACTIVE_FRAMES;
+      }
+    }
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
       glfwSetWindowShouldClose(window, GLFW_TRUE);
-    float t = (float)glfwGetTime();
+    double now = glfwGetTime();
+    float dt = (float)std::min(now - lastTime, 0.1);
+    lastTime = now;
 
     if(glfwGetKey(window, GLFW_KEY_LEFT)){
         rotation -= 0.01;
@@ -586,25 +1323,57 @@ int main() {
     double xpos, ypos;
     glfwGetCursorPos(window, &xpos, &ypos);
 
-    if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS)
+    if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS &&
+        (xpos != lastXPos || ypos != lastYPos))
     {
         orbitcamera_rotate(&scene.orbitCamera, xpos - lastXPos, -(ypos - lastYPos));
+        scene.redraw = true;
     }
     if(glfwGetKey(window, GLFW_KEY_EQUAL)){
         orbitcamera_zoom(&scene.orbitCamera, 0.1);
+        scene.redraw = true;
     }
     if(glfwGetKey(window, GLFW_KEY_MINUS)){
         orbitcamera_zoom(&scene.orbitCamera, -0.1);
+        scene.redraw = true;
     }
     float aspect = (s.h == 0) ? 1.0f : (float)s.w / (float)s.h;
-    scene.animLight = scene.lightPos + glm::vec3(std::cos(t) * 0.4f, 0.0f, std::sin(t) * 0.4f);
-
+    if (scene.animateLight) {
+        scene.lightTime += dt;
+        scene.redraw = true;
+    }
+    update_lights(&scene);
+
+    if (poll_shader_variants(&scene)) activeFrames = ACTIVE_FRAMES;
+    upload_loaded_meshes(&scene, UPLOAD_BUDGET_SECONDS);
+    if (scene.defragGeometry) {
+      PROFILE_SCOPE("geometry defrag");
+      // keep going until there is nothing left to move
+      if (meshregistry_defrag(&scene.meshes, DEFRAG_BUDGET_BYTES) > 0) activeFrames = ACTIVE_FRAMES;
+    }
+    {
+      PROFILE_SCOPE("transforms");
+      update_transforms(&scene);   // Hierarchy needs a current layout
+    }
     RenderImGuiFrame(window, &scene, &s);
+    if (s.redrawn || ImGui::IsAnyItemActive())
+      activeFrames = ACTIVE_FRAMES;
+    else if (activeFrames > 0)
+      activeFrames--;
     lastXPos = xpos;
     lastYPos = ypos;
-    glfwSwapBuffers(window);
+    {
+      PROFILE_SCOPE("swap");
+      glfwSwapBuffers(window);
+    }
+    if (firstFrame) {
+      std::cout << "First frame after " << (glfwGetTime() - startTime) * 1000.0 << " ms\n";
+      firstFrame = false;
+    }
   }
+  profiler_shutdown();
   delete_scene(&scene);
+  rtpool_destroy(&s.targets);
   destroyImGui();
 
   glfwDestroyWindow(window);
@@ -0,0 +1,98 @@
+#include "mappedfile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool mappedfile_open(MappedFile *file, const std::string &path){
+    file->data = nullptr;
+    file->size = 0;
+    file->mapping = nullptr;
+
+    HANDLE fh = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (fh == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(fh, &size)) {
+        CloseHandle(fh);
+        return false;
+    }
+    if (size.QuadPart == 0) {
+        CloseHandle(fh);
+        return true;
+    }
+
+    HANDLE mh = CreateFileMappingA(fh, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(fh);   // the mapping keeps the file alive
+    if (!mh) return false;
+
+    void *view = MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mh);
+        return false;
+    }
+
+    file->data = static_cast<const char*>(view);
+    file->size = static_cast<size_t>(size.QuadPart);
+    file->mapping = mh;
+    return true;
+}
+
+void mappedfile_close(MappedFile *file){
+    if (file->data) UnmapViewOfFile(file->data);
+    if (file->mapping) CloseHandle(static_cast<HANDLE>(file->mapping));
+    file->data = nullptr;
+    file->size = 0;
+    file->mapping = nullptr;
+}
+
+#else
+
+bool mappedfile_open(MappedFile *file, const std::string &path){
+    file->data = nullptr;
+    file->size = 0;
+    file->mapping = nullptr;
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return true;
+    }
+
+    void *addr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);   // the mapping keeps the file alive
+    if (addr == MAP_FAILED) return false;
+
+    // We stream through the file front to back, let the kernel read ahead.
+    madvise(addr, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    file->data = static_cast<const char*>(addr);
+    file->size = (size_t)st.st_size;
+    return true;
+}
+
+void mappedfile_close(MappedFile *file){
+    if (file->data) munmap(const_cast<char*>(file->data), file->size);
+    file->data = nullptr;
+    file->size = 0;
+    file->mapping = nullptr;
+}
+
+#endif
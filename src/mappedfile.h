@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file. An empty file maps to
+// data == nullptr, size == 0 and still counts as successfully opened.
+struct MappedFile
+{
+    const char *data;
+    size_t size;
+
+    void *mapping;      // platform mapping handle (Windows only)
+};
+
+bool mappedfile_open(MappedFile *file, const std::string &path);
+
+void mappedfile_close(MappedFile *file);
@@ -0,0 +1,348 @@
+#include "mesh.h"
+#include "simplify.h"
+
+#include <algorithm>
+#include <cmath>
+
+static const size_t LOD_MIN_TRIANGLES = 64;
+static const float LOD_MIN_REDUCTION = 0.8f;   // a level must drop at least 20%
+static const float LOD_MAX_ERROR = 0.25f;      // of the bounding radius
+
+static uint64_t corner_key(ObjCorner c) {
+    return ((uint64_t)(uint32_t)c.vi << 32) | (uint32_t)c.ni;
+}
+
+static uint64_t hash_key(uint64_t k) {
+    // splitmix64 finalizer
+    k ^= k >> 30; k *= 0xbf58476d1ce4e5b9ull;
+    k ^= k >> 27; k *= 0x94d049bb133111ebull;
+    k ^= k >> 31;
+    return k;
+}
+
+void mesh_build(Mesh *mesh, const ObjData *obj)
+{
+    const size_t cornerCount = obj->corners.size();
+    mesh->vertices.clear();
+    mesh->indices.clear();
+    mesh->indices.reserve(cornerCount);
+
+    // open addressing table of corner key -> vertex index
+    size_t capacity = 16;
+    while (capacity < cornerCount * 2) capacity *= 2;
+    const uint64_t EMPTY = ~0ull;
+    std::vector<uint64_t> keys(capacity, EMPTY);
+    std::vector<uint32_t> values(capacity);
+    const size_t mask = capacity - 1;
+
+    for (size_t i = 0; i < cornerCount; ++i) {
+        const ObjCorner c = obj->corners[i];
+        const uint64_t key = corner_key(c);
+
+        size_t slot = hash_key(key) & mask;
+        while (keys[slot] != EMPTY && keys[slot] != key)
+            slot = (slot + 1) & mask;
+
+        if (keys[slot] == EMPTY) {
+            keys[slot] = key;
+            values[slot] = (uint32_t)(mesh->vertices.size() / MESH_VERTEX_FLOATS);
+
+            const float *p = &obj->positions[(size_t)c.vi * 3];
+            mesh->vertices.insert(mesh->vertices.end(), p, p + 3);
+            if (c.ni >= 0) {
+                const float *n = &obj->normals[(size_t)c.ni * 3];
+                mesh->vertices.insert(mesh->vertices.end(), n, n + 3);
+            } else {
+                mesh->vertices.insert(mesh->vertices.end(), 3, 0.0f);
+            }
+        }
+        mesh->indices.push_back(values[slot]);
+    }
+}
+
+// --- Forsyth vertex cache optimization --------------------------------------
+
+static const int FORSYTH_CACHE_SIZE = 32;
+static const int FORSYTH_MAX_VALENCE = 32;   // valence score saturates here
+
+struct ForsythTables
+{
+    float cache[FORSYTH_CACHE_SIZE];
+    float valence[FORSYTH_MAX_VALENCE + 1];
+};
+
+static const ForsythTables& forsyth_tables() {
+    static const ForsythTables tables = [] {
+        ForsythTables t;
+        for (int i = 0; i < FORSYTH_CACHE_SIZE; ++i) {
+            // the last triangle's vertices get a fixed score so that the
+            // next triangle doesn't simply reuse the same edge
+            if (i < 3) t.cache[i] = 0.75f;
+            else t.cache[i] = std::pow(1.0f - (float)(i - 3) / (FORSYTH_CACHE_SIZE - 3), 1.5f);
+        }
+        t.valence[0] = 0.0f;
+        for (int i = 1; i <= FORSYTH_MAX_VALENCE; ++i)
+            t.valence[i] = 2.0f * std::pow((float)i, -0.5f);
+        return t;
+    }();
+    return tables;
+}
+
+static float forsyth_vertex_score(int cachePos, uint32_t remaining) {
+    if (remaining == 0) return -1.0f;   // no triangles left to use it
+    const ForsythTables &t = forsyth_tables();
+    float score = cachePos >= 0 ? t.cache[cachePos] : 0.0f;
+    return score + t.valence[remaining < FORSYTH_MAX_VALENCE ? remaining : FORSYTH_MAX_VALENCE];
+}
+
+void mesh_optimize_vertex_cache(uint32_t *indices, size_t indexCount, size_t vertexCount)
+{
+    const size_t triCount = indexCount / 3;
+    if (triCount == 0) return;
+
+    // vertex -> triangle adjacency in CSR form; the live triangles of a
+    // vertex are kept at the front of its range
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (size_t i = 0; i < triCount * 3; ++i)
+        remaining[indices[i]]++;
+
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v)
+        offsets[v + 1] = offsets[v] + remaining[v];
+
+    std::vector<uint32_t> adjacency(triCount * 3);
+    {
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t t = 0; t < triCount; ++t)
+            for (int k = 0; k < 3; ++k)
+                adjacency[fill[indices[t * 3 + k]]++] = (uint32_t)t;
+    }
+
+    std::vector<int> cachePos(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        vertexScore[v] = forsyth_vertex_score(-1, remaining[v]);
+
+    std::vector<float> triScore(triCount);
+    std::vector<char> emitted(triCount, 0);
+    for (size_t t = 0; t < triCount; ++t)
+        triScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+
+    std::vector<uint32_t> out;
+    out.reserve(triCount * 3);
+
+    uint32_t cache[FORSYTH_CACHE_SIZE + 3];
+    int cacheCount = 0;
+
+    size_t best = 0;
+    for (size_t t = 1; t < triCount; ++t)
+        if (triScore[t] > triScore[best]) best = t;
+
+    size_t scanCursor = 0;
+    for (size_t done = 0; done < triCount; ++done) {
+        if (best == (size_t)-1) {
+            // nothing useful in the cache, restart from the next unused triangle
+            while (emitted[scanCursor]) ++scanCursor;
+            best = scanCursor;
+        }
+
+        const uint32_t *tri = &indices[best * 3];
+        out.insert(out.end(), tri, tri + 3);
+        emitted[best] = 1;
+
+        // retire the triangle from its vertices' live lists
+        for (int k = 0; k < 3; ++k) {
+            uint32_t v = tri[k];
+            uint32_t *begin = &adjacency[offsets[v]];
+            uint32_t *last = begin + remaining[v] - 1;
+            for (uint32_t *it = begin; it <= last; ++it) {
+                if (*it == best) {
+                    *it = *last;
+                    *last = (uint32_t)best;
+                    break;
+                }
+            }
+            remaining[v]--;
+        }
+
+        // new cache: the triangle's vertices first, then the old contents
+        uint32_t next[FORSYTH_CACHE_SIZE + 3];
+        int nextCount = 0;
+        for (int k = 0; k < 3; ++k) next[nextCount++] = tri[k];
+        for (int i = 0; i < cacheCount; ++i) {
+            uint32_t v = cache[i];
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                next[nextCount++] = v;
+        }
+
+        for (int i = 0; i < nextCount; ++i) {
+            uint32_t v = next[i];
+            cachePos[v] = i < FORSYTH_CACHE_SIZE ? i : -1;
+            vertexScore[v] = forsyth_vertex_score(cachePos[v], remaining[v]);
+        }
+
+        // rescore triangles touching anything whose score changed and pick
+        // the best of them for the next step
+        best = (size_t)-1;
+        float bestScore = 0.0f;
+        for (int i = 0; i < nextCount; ++i) {
+            uint32_t v = next[i];
+            for (uint32_t j = 0; j < remaining[v]; ++j) {
+                uint32_t t = adjacency[offsets[v] + j];
+                const uint32_t *tv = &indices[(size_t)t * 3];
+                float s = vertexScore[tv[0]] + vertexScore[tv[1]] + vertexScore[tv[2]];
+                triScore[t] = s;
+                if (s > bestScore) {
+                    bestScore = s;
+                    best = t;
+                }
+            }
+        }
+
+        cacheCount = nextCount < FORSYTH_CACHE_SIZE ? nextCount : FORSYTH_CACHE_SIZE;
+        for (int i = 0; i < cacheCount; ++i) cache[i] = next[i];
+    }
+
+    std::copy(out.begin(), out.end(), indices);
+}
+
+void mesh_optimize_vertex_fetch(Mesh *mesh)
+{
+    const size_t vertexCount = mesh_vertex_count(mesh);
+    const uint32_t UNUSED = ~0u;
+    std::vector<uint32_t> remap(vertexCount, UNUSED);
+    std::vector<float> vertices;
+    vertices.reserve(mesh->vertices.size());
+
+    uint32_t next = 0;
+    for (uint32_t &index : mesh->indices) {
+        if (remap[index] == UNUSED) {
+            remap[index] = next++;
+            const float *src = &mesh->vertices[(size_t)index * MESH_VERTEX_FLOATS];
+            vertices.insert(vertices.end(), src, src + MESH_VERTEX_FLOATS);
+        }
+        index = remap[index];
+    }
+    mesh->vertices.swap(vertices);
+}
+
+float mesh_acmr(const uint32_t *indices, size_t indexCount, size_t vertexCount, int cacheSize)
+{
+    const size_t triCount = indexCount / 3;
+    if (triCount == 0) return 0.0f;
+
+    // FIFO: a vertex is resident while fewer than cacheSize misses happened
+    // since it was loaded
+    std::vector<size_t> loadedAt(vertexCount, 0);
+    size_t clock = (size_t)cacheSize + 1;
+    size_t misses = 0;
+    for (size_t i = 0; i < triCount * 3; ++i) {
+        uint32_t v = indices[i];
+        if (clock - loadedAt[v] > (size_t)cacheSize) {
+            loadedAt[v] = clock++;
+            ++misses;
+        }
+    }
+    return (float)misses / (float)triCount;
+}
+
+int mesh_index_size(const Mesh *mesh)
+{
+    return mesh_vertex_count(mesh) <= 0x10000 ? 2 : 4;
+}
+
+size_t mesh_vertex_count(const Mesh *mesh)
+{
+    return mesh->vertices.size() / MESH_VERTEX_FLOATS;
+}
+
+void mesh_compute_bounds(Mesh *mesh)
+{
+    MeshBounds *b = &mesh->bounds;
+    const size_t vertexCount = mesh_vertex_count(mesh);
+    if (vertexCount == 0) {
+        *b = MeshBounds{};
+        return;
+    }
+
+    for (int k = 0; k < 3; ++k)
+        b->min[k] = b->max[k] = mesh->vertices[k];
+    for (size_t i = 1; i < vertexCount; ++i) {
+        const float *p = &mesh->vertices[i * MESH_VERTEX_FLOATS];
+        for (int k = 0; k < 3; ++k) {
+            b->min[k] = std::min(b->min[k], p[k]);
+            b->max[k] = std::max(b->max[k], p[k]);
+        }
+    }
+
+    // the farthest vertex from the box center, at most the half diagonal
+    float c[3];
+    for (int k = 0; k < 3; ++k)
+        c[k] = 0.5f * (b->min[k] + b->max[k]);
+    float r2 = 0.0f;
+    for (size_t i = 0; i < vertexCount; ++i) {
+        const float *p = &mesh->vertices[i * MESH_VERTEX_FLOATS];
+        float dx = p[0] - c[0], dy = p[1] - c[1], dz = p[2] - c[2];
+        r2 = std::max(r2, dx * dx + dy * dy + dz * dz);
+    }
+    b->radius = std::sqrt(r2);
+}
+
+void mesh_build_lods(Mesh *mesh)
+{
+    const size_t vertexCount = mesh_vertex_count(mesh);
+    mesh->lods.clear();
+    mesh->lods.push_back(MeshLod{ 0, (uint32_t)mesh->indices.size(), 0.0f });
+
+    const float errorLimit = LOD_MAX_ERROR * mesh->bounds.radius;
+    std::vector<uint32_t> prev(mesh->indices), next;
+    while ((int)mesh->lods.size() < MESH_MAX_LODS) {
+        size_t target = prev.size() / 6 * 3;
+        if (target / 3 < LOD_MIN_TRIANGLES) break;
+
+        // each level starts from the last, so errors add up along the chain
+        float error = mesh->lods.back().error;
+        float step = 0.0f;
+        next.resize(prev.size());
+        size_t count = simplify_indices(next.data(), prev.data(), prev.size(), mesh->vertices.data(), vertexCount,
+                                        MESH_VERTEX_FLOATS, target, errorLimit - error, &step);
+        if (count == 0 || (float)count > LOD_MIN_REDUCTION * prev.size()) break;
+        next.resize(count);
+        mesh_optimize_vertex_cache(next.data(), count, vertexCount);
+
+        mesh->lods.push_back(MeshLod{ (uint32_t)mesh->indices.size(), (uint32_t)count, error + step });
+        mesh->indices.insert(mesh->indices.end(), next.begin(), next.end());
+        prev.swap(next);
+    }
+}
+
+bool mesh_load_obj(Mesh *mesh, const std::string &path, MeshReport *report, int parseThreads)
+{
+    ObjData obj;
+    bool ok = objloader_load(path, &obj, nullptr, parseThreads);
+    mesh_build(mesh, &obj);
+
+    const size_t vertexCount = mesh_vertex_count(mesh);
+    float acmrBefore = mesh_acmr(mesh->indices.data(), mesh->indices.size(), vertexCount);
+
+    mesh_optimize_vertex_cache(mesh->indices.data(), mesh->indices.size(), vertexCount);
+    mesh_optimize_vertex_fetch(mesh);
+    mesh_compute_bounds(mesh);
+
+    if (report) {
+        report->flatVertexCount = obj.corners.size();
+        report->vertexCount = mesh_vertex_count(mesh);
+        report->indexCount = mesh->indices.size();
+        report->indexSize = mesh_index_size(mesh);
+        report->acmrBefore = acmrBefore;
+        report->acmrAfter = mesh_acmr(mesh->indices.data(), mesh->indices.size(), report->vertexCount);
+    }
+
+    mesh_build_lods(mesh);
+    if (report) {
+        report->lodCount = (int)mesh->lods.size();
+        for (size_t i = 0; i < mesh->lods.size(); ++i)
+            report->lodTriangles[i] = mesh->lods[i].indexCount / 3;
+    }
+    return ok;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "objloader.h"
+
+struct MeshBounds
+{
+    float min[3];
+    float max[3];
+    float radius;   // bounding sphere centered on the box center
+};
+
+const int MESH_MAX_LODS = 6;
+
+// One level of detail: a range of the index buffer over the shared vertices.
+struct MeshLod
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error;   // distance the surface may have moved from LOD 0, model units
+};
+
+// Indexed triangle mesh ready for upload. Vertices are unique (v, vn) pairs
+// from the source file.
+struct Mesh
+{
+    std::vector<float> vertices;     // px py pz nx ny nz
+    std::vector<uint32_t> indices;   // triangle lists of every LOD, back to back
+    MeshBounds bounds;               // local space AABB of the positions
+    std::vector<MeshLod> lods;       // lods[0] is the full mesh; empty before mesh_build_lods
+};
+
+struct MeshReport
+{
+    size_t flatVertexCount;   // vertices a non-indexed draw would submit
+    size_t vertexCount;       // after deduplication
+    size_t indexCount;
+    int indexSize;            // bytes per index in the uploaded buffer
+    float acmrBefore;         // deduplicated, source triangle order
+    float acmrAfter;          // after vertex cache optimization
+    int lodCount;
+    size_t lodTriangles[MESH_MAX_LODS];
+};
+
+const int MESH_VERTEX_FLOATS = 6;
+
+// Builds an indexed mesh from parsed OBJ data, merging corners that share
+// both position and normal index.
+void mesh_build(Mesh *mesh, const ObjData *obj);
+
+// Reorders triangles for the post-transform vertex cache (Forsyth's linear
+// speed algorithm, 32 entry LRU model).
+void mesh_optimize_vertex_cache(uint32_t *indices, size_t indexCount, size_t vertexCount);
+
+// Renumbers vertices in order of first use so that fetches walk the vertex
+// buffer mostly forwards.
+void mesh_optimize_vertex_fetch(Mesh *mesh);
+
+// Average cache miss ratio (transformed vertices per triangle) for a FIFO
+// cache of `cacheSize` entries. 3.0 is no reuse, 0.5 is the ideal for a
+// regular grid.
+float mesh_acmr(const uint32_t *indices, size_t indexCount, size_t vertexCount, int cacheSize = 16);
+
+// 2 if every index fits in 16 bits, otherwise 4.
+int mesh_index_size(const Mesh *mesh);
+
+size_t mesh_vertex_count(const Mesh *mesh);
+
+void mesh_compute_bounds(Mesh *mesh);
+
+// Appends a chain of simplified index lists, each aiming for half the
+// triangles of the one before, until another level would save little, get
+// too small or stray too far from the original. Needs bounds.
+void mesh_build_lods(Mesh *mesh);
+
+// Loads, indexes and optimizes an OBJ file and builds its LODs. Returns false if the file could
+// not be read; `mesh` is then empty. `parseThreads` goes to objloader_load; callers that are
+// already one of many loader threads pass 1.
+bool mesh_load_obj(Mesh *mesh, const std::string &path, MeshReport *report = nullptr, int parseThreads = 0);
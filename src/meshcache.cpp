@@ -0,0 +1,214 @@
+#include "meshcache.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+static bool source_identity(const std::string &path, uint64_t *size, int64_t *mtime) {
+    std::error_code ec;
+    uintmax_t s = std::filesystem::file_size(path, ec);
+    if (ec) return false;
+    std::filesystem::file_time_type t = std::filesystem::last_write_time(path, ec);
+    if (ec) return false;
+    *size = (uint64_t)s;
+    *mtime = (int64_t)t.time_since_epoch().count();
+    return true;
+}
+
+static size_t align_up(size_t v, size_t a) {
+    return (v + a - 1) & ~(a - 1);
+}
+
+static void asset_reset(MeshAsset *asset) {
+    asset->header = nullptr;
+    asset->vertexData = nullptr;
+    asset->indexData = nullptr;
+    asset->file = MappedFile{};
+    asset->image.clear();
+}
+
+// Points the asset at a cooked image if it is well formed and every index is in
+// range; anything else is treated as a cache miss and the mesh is cooked again.
+static bool asset_bind(MeshAsset *asset, const uint8_t *base, size_t size) {
+    if (size < sizeof(MeshFileHeader)) return false;
+    const MeshFileHeader *h = reinterpret_cast<const MeshFileHeader*>(base);
+    if (h->magic != MESH_FILE_MAGIC || h->version != MESH_FILE_VERSION) return false;
+    if (h->attribCount > MESH_FILE_MAX_ATTRIBS || h->vertexFormat > MESH_VERTEX_PACKED) return false;
+    // offsets first, so a huge offset cannot wrap the sum past the size
+    if (h->vertexOffset > size || h->vertexBytes > size - h->vertexOffset) return false;
+    if (h->indexOffset > size || h->indexBytes > size - h->indexOffset) return false;
+    if ((uint64_t)h->vertexCount * h->vertexStride != h->vertexBytes) return false;
+    if ((uint64_t)h->indexCount * h->indexSize != h->indexBytes) return false;
+    // only the layouts this version cooks, so readers can trust the stride and attribute offsets
+    if (h->indexSize != 2 && h->indexSize != 4) return false;
+    size_t stride = h->vertexFormat == MESH_VERTEX_PACKED ? sizeof(PackedVertex) : MESH_VERTEX_FLOATS * sizeof(float);
+    if (h->vertexStride != stride) return false;
+    for (uint32_t i = 0; i < h->attribCount; ++i) {
+        const MeshFileAttrib &a = h->attribs[i];
+        if (a.format > MESH_ATTRIB_SNORM16 || a.components < 1 || a.components > 4) return false;
+        uint32_t componentSize = a.format == MESH_ATTRIB_FLOAT32 ? 4 : 2;
+        if ((uint64_t)a.offset + a.components * componentSize > h->vertexStride) return false;
+    }
+    if (h->lodCount < 1 || h->lodCount > (uint32_t)MESH_MAX_LODS) return false;
+    for (uint32_t i = 0; i < h->lodCount; ++i)
+        if ((uint64_t)h->lods[i].firstIndex + h->lods[i].indexCount > h->indexCount) return false;
+    // every index must name a vertex; the BVH build and the draws read through them
+    const uint8_t *indices = base + h->indexOffset;
+    for (uint32_t i = 0; i < h->indexCount; ++i) {
+        uint32_t index;
+        if (h->indexSize == 2) {
+            uint16_t v;
+            std::memcpy(&v, indices + (size_t)i * 2, 2);
+            index = v;
+        } else {
+            std::memcpy(&index, indices + (size_t)i * 4, 4);
+        }
+        if (index >= h->vertexCount) return false;
+    }
+
+    asset->header = h;
+    asset->vertexData = base + h->vertexOffset;
+    asset->indexData = base + h->indexOffset;
+    return true;
+}
+
+std::string meshcache_path(const std::string &sourcePath)
+{
+    return sourcePath + ".mesh";
+}
+
+void meshcache_build_image(std::vector<uint8_t> *image, const Mesh *mesh, uint64_t sourceSize, int64_t sourceMtime,
+                           uint32_t cookFlags)
+{
+    MeshFileHeader h;
+    std::memset(&h, 0, sizeof(h));
+    h.magic = MESH_FILE_MAGIC;
+    h.version = MESH_FILE_VERSION;
+    h.sourceSize = sourceSize;
+    h.sourceMtime = sourceMtime;
+    h.cookFlags = cookFlags;
+
+    std::vector<PackedVertex> packed;
+    bool pack = (cookFlags & MESH_COOK_PACK_VERTICES) && vertexpack_pack(&packed, mesh, &h.packError);
+
+    h.vertexCount = (uint32_t)mesh_vertex_count(mesh);
+    h.attribCount = 2;
+    if (pack) {
+        h.vertexFormat = MESH_VERTEX_PACKED;
+        h.vertexStride = sizeof(PackedVertex);
+        h.attribs[0] = { 0, 4, MESH_ATTRIB_UNORM16, offsetof(PackedVertex, position) };
+        h.attribs[1] = { 1, 2, MESH_ATTRIB_SNORM16, offsetof(PackedVertex, normal) };
+    } else {
+        h.vertexFormat = MESH_VERTEX_FLOAT;
+        h.vertexStride = MESH_VERTEX_FLOATS * sizeof(float);
+        h.attribs[0] = { 0, 3, MESH_ATTRIB_FLOAT32, 0 };                   // position
+        h.attribs[1] = { 1, 3, MESH_ATTRIB_FLOAT32, 3 * sizeof(float) };   // normal
+    }
+
+    h.indexCount = (uint32_t)mesh->indices.size();
+    h.indexSize = (uint32_t)mesh_index_size(mesh);
+    h.bounds = mesh->bounds;
+    if (mesh->lods.empty()) {
+        h.lodCount = 1;
+        h.lods[0] = MeshLod{ 0, h.indexCount, 0.0f };
+    } else {
+        h.lodCount = (uint32_t)mesh->lods.size();
+        std::copy(mesh->lods.begin(), mesh->lods.end(), h.lods);
+    }
+
+    h.vertexBytes = (uint64_t)h.vertexCount * h.vertexStride;
+    h.indexBytes = (uint64_t)h.indexCount * h.indexSize;
+    h.vertexOffset = align_up(sizeof(MeshFileHeader), 16);
+    h.indexOffset = align_up(h.vertexOffset + h.vertexBytes, 16);
+
+    image->assign(h.indexOffset + h.indexBytes, 0);
+    uint8_t *base = image->data();
+    std::memcpy(base, &h, sizeof(h));
+    if (h.vertexBytes)
+        std::memcpy(base + h.vertexOffset, pack ? (const void*)packed.data() : mesh->vertices.data(), h.vertexBytes);
+
+    if (h.indexSize == 2) {
+        uint16_t *dst = reinterpret_cast<uint16_t*>(base + h.indexOffset);
+        for (uint32_t i = 0; i < h.indexCount; ++i)
+            dst[i] = (uint16_t)mesh->indices[i];
+    } else if (h.indexBytes) {
+        std::memcpy(base + h.indexOffset, mesh->indices.data(), h.indexBytes);
+    }
+}
+
+bool meshcache_open(MeshAsset *asset, const std::string &sourcePath, uint32_t cookFlags)
+{
+    asset_reset(asset);
+
+    uint64_t size;
+    int64_t mtime;
+    if (!source_identity(sourcePath, &size, &mtime)) return false;
+
+    if (!mappedfile_open(&asset->file, meshcache_path(sourcePath))) return false;
+
+    const uint8_t *base = reinterpret_cast<const uint8_t*>(asset->file.data);
+    if (!asset_bind(asset, base, asset->file.size) ||
+        asset->header->sourceSize != size || asset->header->sourceMtime != mtime ||
+        asset->header->cookFlags != cookFlags) {
+        meshcache_release(asset);
+        return false;
+    }
+    return true;
+}
+
+bool meshcache_load(MeshAsset *asset, const std::string &sourcePath, uint32_t cookFlags, bool *cacheHit,
+                    int parseThreads)
+{
+    if (meshcache_open(asset, sourcePath, cookFlags)) {
+        if (cacheHit) *cacheHit = true;
+        return true;
+    }
+    if (cacheHit) *cacheHit = false;
+
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    bool haveIdentity = source_identity(sourcePath, &size, &mtime);
+
+    Mesh mesh;
+    if (!mesh_load_obj(&mesh, sourcePath, nullptr, parseThreads)) return false;
+
+    meshcache_build_image(&asset->image, &mesh, size, mtime, cookFlags);
+    asset_bind(asset, asset->image.data(), asset->image.size());
+
+    // Write through a per-thread temporary so that a concurrent reader never
+    // maps a half written file. Failing to cook is not an error, we just pay
+    // the parse again next launch.
+    if (haveIdentity) {
+        std::string path = meshcache_path(sourcePath);
+        std::string tmp = path + ".tmp" + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+        FILE *f = std::fopen(tmp.c_str(), "wb");
+        bool written = false;
+        if (f) {
+            written = std::fwrite(asset->image.data(), 1, asset->image.size(), f) == asset->image.size();
+            written = (std::fclose(f) == 0) && written;
+        }
+        std::error_code ec;
+        if (written)
+            std::filesystem::rename(tmp, path, ec);
+        if (!written || ec) {
+            std::filesystem::remove(tmp, ec);
+            std::cerr << "Could not write mesh cache: " << path << "\n";
+        }
+    }
+    return true;
+}
+
+void meshcache_release(MeshAsset *asset)
+{
+    mappedfile_close(&asset->file);
+    asset->image.clear();
+    asset->image.shrink_to_fit();
+    asset->header = nullptr;
+    asset->vertexData = nullptr;
+    asset->indexData = nullptr;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mappedfile.h"
+#include "mesh.h"
+#include "vertexpack.h"
+
+// Cooked meshes live next to their source as "<source>.mesh". The file is a
+// MeshFileHeader followed by the vertex and index blobs exactly as they are
+// uploaded, so a cache hit maps the file and hands the payload to the GPU
+// without touching it. The vertices are float or packed (see vertexpack.h),
+// chosen per mesh at cook time.
+
+const uint32_t MESH_FILE_MAGIC = 0x4d4c474d;   // "MGLM"
+const uint32_t MESH_FILE_VERSION = 5;
+const int MESH_FILE_MAX_ATTRIBS = 4;
+
+enum MeshAttribFormat : uint32_t
+{
+    MESH_ATTRIB_FLOAT32 = 0,
+    MESH_ATTRIB_UNORM16 = 1,
+    MESH_ATTRIB_SNORM16 = 2,
+};
+
+enum MeshVertexFormat : uint32_t
+{
+    MESH_VERTEX_FLOAT = 0,    // px py pz nx ny nz
+    MESH_VERTEX_PACKED = 1,   // PackedVertex
+};
+
+// Cook options; a cooked file made with other flags is stale.
+const uint32_t MESH_COOK_PACK_VERTICES = 1;   // packed vertices where the error allows
+
+struct MeshFileAttrib
+{
+    uint32_t location;     // shader attribute location
+    uint32_t components;
+    uint32_t format;       // MeshAttribFormat
+    uint32_t offset;       // bytes from the start of the vertex
+};
+
+struct MeshFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+
+    // source file identity at cook time; a mismatch means the cache is stale
+    uint64_t sourceSize;
+    int64_t sourceMtime;
+    uint32_t cookFlags;
+
+    uint32_t vertexFormat;         // MeshVertexFormat
+    VertexPackError packError;     // zero unless packing was tried
+    uint32_t vertexCount;
+    uint32_t vertexStride;
+    uint32_t attribCount;
+    MeshFileAttrib attribs[MESH_FILE_MAX_ATTRIBS];
+
+    uint32_t indexCount;   // every LOD
+    uint32_t indexSize;    // 2 or 4
+
+    MeshBounds bounds;
+    uint32_t lodCount;
+    MeshLod lods[MESH_MAX_LODS];
+
+    uint64_t vertexOffset;
+    uint64_t vertexBytes;
+    uint64_t indexOffset;
+    uint64_t indexBytes;
+};
+
+// Upload-ready geometry. `header`, `vertexData` and `indexData` point into
+// either a mapped cooked file or an in-memory image when the cache could not
+// be written.
+struct MeshAsset
+{
+    const MeshFileHeader *header;
+    const void *vertexData;
+    const void *indexData;
+
+    MappedFile file;
+    std::vector<uint8_t> image;
+};
+
+std::string meshcache_path(const std::string &sourcePath);
+
+// Serializes `mesh` into the cooked file layout, packing the vertices if
+// `cookFlags` asks for it and the mesh allows it.
+void meshcache_build_image(std::vector<uint8_t> *image, const Mesh *mesh, uint64_t sourceSize, int64_t sourceMtime,
+                           uint32_t cookFlags);
+
+// Maps and validates the cooked file for `sourcePath`. Returns false when
+// it is missing, truncated, from another version, older than the source or
+// cooked with other flags.
+bool meshcache_open(MeshAsset *asset, const std::string &sourcePath, uint32_t cookFlags);
+
+// Opens the cooked file, or parses the source, cooks it and keeps the result
+// in memory on a miss. `cacheHit` reports which path was taken. Returns
+// false if the source could not be loaded at all. `parseThreads` is passed
+// on to mesh_load_obj.
+bool meshcache_load(MeshAsset *asset, const std::string &sourcePath, uint32_t cookFlags, bool *cacheHit = nullptr,
+                    int parseThreads = 0);
+
+// Bytes the vertices would take in the float format.
+inline uint64_t meshcache_float_vertex_bytes(const MeshFileHeader *h) {
+    return (uint64_t)h->vertexCount * MESH_VERTEX_FLOATS * sizeof(float);
+}
+
+void meshcache_release(MeshAsset *asset);
@@ -0,0 +1,173 @@
+#include "meshregistry.h"
+
+#include <algorithm>
+#include <utility>
+
+static void free_gpu(MeshRegistry *registry, GpuMesh *mesh) {
+    if (mesh->vao) {
+        registry->vertexBytes -= mesh->vertexBytes;
+        registry->floatVertexBytes -= mesh->floatVertexBytes;
+        registry->packedMeshes -= mesh->vertexFormat == MESH_VERTEX_PACKED;
+    }
+    if (mesh->alloc != GEOMETRY_ALLOC_NONE)
+        geometryarena_remove(&registry->arenas[mesh->arena], mesh->alloc);
+    mesh->alloc = GEOMETRY_ALLOC_NONE;
+    mesh->vao = 0;
+}
+
+static void free_slot(MeshRegistry *registry, MeshId id) {
+    GpuMesh *mesh = &registry->meshes[id];
+    free_gpu(registry, mesh);
+    mesh->bvh = MeshBvh{};
+    registry->byPath.erase(mesh->path);
+    mesh->path.clear();
+    registry->freeSlots.push_back(id);
+    registry->version++;
+}
+
+MeshId meshregistry_acquire(MeshRegistry *registry, AssetLoader *loader, const std::string &path)
+{
+    auto it = registry->byPath.find(path);
+    if (it != registry->byPath.end()) {
+        GpuMesh *mesh = &registry->meshes[it->second];
+        mesh->refCount++;
+        if (mesh->failed) {   // the file may have been fixed since
+            mesh->failed = false;
+            mesh->loading = true;
+            assetloader_request(loader, path, it->second);
+        }
+        return it->second;
+    }
+
+    MeshId id;
+    if (!registry->freeSlots.empty()) {
+        id = registry->freeSlots.back();
+        registry->freeSlots.pop_back();
+    } else {
+        id = (MeshId)registry->meshes.size();
+        registry->meshes.emplace_back();
+        registry->version++;
+    }
+
+    GpuMesh *mesh = &registry->meshes[id];
+    mesh->path = path;
+    mesh->vao = 0;
+    mesh->arena = 0;
+    mesh->alloc = GEOMETRY_ALLOC_NONE;
+    mesh->indexType = GL_UNSIGNED_INT;
+    mesh->vertexFormat = MESH_VERTEX_FLOAT;
+    mesh->dequantize = glm::mat4(1.0f);
+    mesh->vertexBytes = mesh->floatVertexBytes = 0;
+    mesh->packError = VertexPackError{};
+    mesh->lodCount = 0;
+    mesh->bounds = MeshBounds{};
+    mesh->refCount = 1;
+    mesh->loading = true;
+    mesh->failed = false;
+    registry->byPath[path] = id;
+
+    assetloader_request(loader, path, id);
+    return id;
+}
+
+void meshregistry_retain(MeshRegistry *registry, MeshId id)
+{
+    registry->meshes[id].refCount++;
+}
+
+void meshregistry_release(MeshRegistry *registry, MeshId id)
+{
+    if (id == MESH_NONE) return;
+    GpuMesh *mesh = &registry->meshes[id];
+    if (--mesh->refCount > 0) return;
+
+    // A load in flight still carries this id; the slot is freed when it lands
+    // so it can't be handed to another path in the meantime.
+    if (!mesh->loading)
+        free_slot(registry, id);
+}
+
+GpuMesh* meshregistry_get(MeshRegistry *registry, MeshId id)
+{
+    return &registry->meshes[id];
+}
+
+void meshregistry_fail(MeshRegistry *registry, MeshId id)
+{
+    GpuMesh *mesh = &registry->meshes[id];
+    mesh->loading = false;
+    if (mesh->refCount <= 0)
+        free_slot(registry, id);
+    else
+        mesh->failed = true;
+}
+
+bool meshregistry_upload(MeshRegistry *registry, MeshId id, const MeshAsset *asset, MeshBvh *bvh)
+{
+    GpuMesh *mesh = &registry->meshes[id];
+    mesh->loading = false;
+    if (mesh->refCount <= 0) {
+        free_slot(registry, id);
+        return false;
+    }
+
+    // straight from the mapped file (or the freshly cooked image); every
+    // mesh of a format is cooked with the same layout
+    const MeshFileHeader *h = asset->header;
+    GeometryArena *arena = &registry->arenas[h->vertexFormat];
+    const bool created = !arena->vao;
+    if (created)
+        geometryarena_create(arena, h);
+    mesh->arena = h->vertexFormat;
+    mesh->alloc = geometryarena_add(arena, asset);
+    mesh->vao = arena->vao;
+
+    mesh->indexType = h->indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    mesh->lodCount = (int)h->lodCount;
+    std::copy(h->lods, h->lods + h->lodCount, mesh->lods);
+    mesh->bounds = h->bounds;
+    mesh->bvh = std::move(*bvh);
+
+    // unorm positions span the bounding box
+    mesh->vertexFormat = h->vertexFormat;
+    mesh->dequantize = glm::mat4(1.0f);
+    if (h->vertexFormat == MESH_VERTEX_PACKED) {
+        const MeshBounds &b = h->bounds;
+        mesh->dequantize[0][0] = b.max[0] - b.min[0];
+        mesh->dequantize[1][1] = b.max[1] - b.min[1];
+        mesh->dequantize[2][2] = b.max[2] - b.min[2];
+        mesh->dequantize[3] = glm::vec4(b.min[0], b.min[1], b.min[2], 1.0f);
+    }
+    mesh->packError = h->packError;
+    mesh->vertexBytes = (size_t)h->vertexBytes;
+    mesh->floatVertexBytes = (size_t)meshcache_float_vertex_bytes(h);
+    registry->vertexBytes += mesh->vertexBytes;
+    registry->floatVertexBytes += mesh->floatVertexBytes;
+    registry->packedMeshes += mesh->vertexFormat == MESH_VERTEX_PACKED;
+    registry->version++;
+    if (created) glBindVertexArray(arena->vao);
+    return created;
+}
+
+void meshregistry_destroy(MeshRegistry *registry)
+{
+    for (GpuMesh &mesh : registry->meshes)
+        free_gpu(registry, &mesh);
+    for (GeometryArena &arena : registry->arenas)
+        if (arena.vao) geometryarena_destroy(&arena);
+    registry->meshes.clear();
+    registry->freeSlots.clear();
+    registry->byPath.clear();
+    registry->vertexBytes = registry->floatVertexBytes = 0;
+    registry->packedMeshes = 0;
+    registry->version++;
+}
+
+size_t meshregistry_defrag(MeshRegistry *registry, size_t budgetBytes)
+{
+    size_t copied = 0;
+    for (GeometryArena &arena : registry->arenas)
+        if (copied < budgetBytes)
+            copied += geometryarena_defrag(&arena, budgetBytes - copied);
+    return copied;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "assetloader.h"
+#include "geometryarena.h"
+
+// GPU meshes shared by path. Every object placing a model holds a reference;
+// the model is loaded and uploaded once into the geometry arena of its
+// vertex format, and its space there is freed when the last reference goes
+// away.
+
+typedef uint32_t MeshId;
+const MeshId MESH_NONE = 0xffffffffu;
+
+struct GpuMesh
+{
+    std::string path;
+    GLuint vao;                // the arena's, 0 until resident
+    uint32_t arena;            // index in registry->arenas, the vertex format
+    GeometryAllocId alloc;
+    GLenum indexType;
+    uint32_t vertexFormat;     // MeshVertexFormat
+    glm::mat4 dequantize;      // packed positions to model space, identity for float
+    size_t vertexBytes;
+    size_t floatVertexBytes;   // the same vertices as floats
+    VertexPackError packError;
+    int lodCount;
+    MeshLod lods[MESH_MAX_LODS];   // index ranges, finest first
+    MeshBounds bounds;
+    MeshBvh bvh;    // for picking; empty until resident
+    int refCount;
+    bool loading;   // requested, not resident yet
+    bool failed;    // the last load failed; never resident
+};
+
+struct MeshRegistry
+{
+    std::vector<GpuMesh> meshes;   // indexed by MeshId, slots are reused
+    std::vector<MeshId> freeSlots;
+    std::unordered_map<std::string, MeshId> byPath;
+    GeometryArena arenas[2];   // by MeshVertexFormat
+
+    // resident vertex data, and what it would take in the float format
+    size_t vertexBytes = 0;
+    size_t floatVertexBytes = 0;
+    int packedMeshes = 0;
+
+    // changes whenever a mesh becomes resident or is freed, or `meshes`
+    // moves, so anything holding GpuMesh pointers knows to look again
+    uint64_t version = 0;
+};
+
+// Returns a reference to the mesh for `path`, queueing a background load the
+// first time it is seen, or again if its last load failed. The loader's
+// userId is the MeshId.
+MeshId meshregistry_acquire(MeshRegistry *registry, AssetLoader *loader, const std::string &path);
+
+// Another reference to a mesh already acquired, without the path lookup.
+void meshregistry_retain(MeshRegistry *registry, MeshId id);
+
+void meshregistry_release(MeshRegistry *registry, MeshId id);
+
+GpuMesh* meshregistry_get(MeshRegistry *registry, MeshId id);
+
+// Loaded and uploaded, so it can be drawn and picked.
+inline bool meshregistry_resident(const GpuMesh *mesh) { return !mesh->loading && !mesh->failed; }
+
+// Uploads a finished load and takes its BVH. Returns true only when this
+// upload created its arena's vertex array, which is then left bound so
+// callers can add their own attributes once per arena.
+bool meshregistry_upload(MeshRegistry *registry, MeshId id, const MeshAsset *asset, MeshBvh *bvh);
+
+// Ends a load that did not produce a mesh. The slot is freed if nobody
+// wants it anymore; otherwise the mesh stays, marked failed.
+void meshregistry_fail(MeshRegistry *registry, MeshId id);
+
+// Where a resident mesh's vertices and indices are in its arena.
+inline const GeometryRange& meshregistry_range(const MeshRegistry *registry, const GpuMesh *mesh) {
+    return geometryarena_range(&registry->arenas[mesh->arena], mesh->alloc);
+}
+
+// One step of incremental defragmentation over every arena. Returns the
+// bytes copied.
+size_t meshregistry_defrag(MeshRegistry *registry, size_t budgetBytes);
+
+// Frees every mesh regardless of references.
+void meshregistry_destroy(MeshRegistry *registry);
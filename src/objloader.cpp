@@ -0,0 +1,378 @@
+#include "objloader.h"
+#include "mappedfile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+static int fix_obj_index(int idx, int count) {
+    // OBJ:  1..count  (positive)
+    //       -1..-count (negative, relative to end)
+    // We return 0-based index, or -1 if invalid/zero.
+    if (idx > 0) return idx <= count ? idx - 1 : -1;
+    if (idx < 0) return count + idx;   // e.g. -1 => last element
+    return -1;
+}
+
+static inline bool is_blank(char c) {
+    // '\n' never reaches here, lines are split on it first
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static inline const char* skip_blank(const char *p, const char *end) {
+    while (p < end && is_blank(*p)) ++p;
+    return p;
+}
+
+static inline const char* skip_token(const char *p, const char *end) {
+    while (p < end && !is_blank(*p)) ++p;
+    return p;
+}
+
+static inline bool parse_float(const char *&p, const char *end, float *value) {
+    p = skip_blank(p, end);
+    if (p < end && *p == '+') ++p;   // from_chars rejects an explicit plus sign
+    std::from_chars_result r = std::from_chars(p, end, *value);
+    if (r.ec != std::errc()) return false;
+    p = r.ptr;
+    return true;
+}
+
+static inline int parse_int(const char *p, const char *end) {
+    // Mirrors std::stoi on a token prefix: trailing junk is ignored and an
+    // unparsable field reads as 0, which fix_obj_index rejects.
+    if (p < end && *p == '+') ++p;
+    int value = 0;
+    if (std::from_chars(p, end, value).ec != std::errc()) return 0;
+    return value;
+}
+
+static void parse_corner(const char *t, const char *end, int *vi_raw, int *ni_raw) {
+    // Token formats:
+    // v
+    // v/vt
+    // v//vn
+    // v/vt/vn
+    //
+    // We only care about v and vn.
+    *vi_raw = parse_int(t, end);
+    *ni_raw = 0;
+
+    const char *s1 = static_cast<const char*>(std::memchr(t, '/', end - t));
+    if (s1) {
+        const char *s2 = static_cast<const char*>(std::memchr(s1 + 1, '/', end - (s1 + 1)));
+        // there is a vn field (maybe empty between //)
+        if (s2 && s2 + 1 < end)
+            *ni_raw = parse_int(s2 + 1, end);
+        // if only v/vt, no normal
+    }
+}
+
+static ObjCorner resolve_corner(int vi_raw, int ni_raw, int vcount, int ncount) {
+    ObjCorner c;
+    c.vi = fix_obj_index(vi_raw, vcount);
+    c.ni = (ni_raw != 0) ? fix_obj_index(ni_raw, ncount) : -1;
+    if (c.ni < 0) c.ni = -1;
+    return c;
+}
+
+// Fan triangulates one face into `corners`, returns the triangle count.
+static size_t emit_face(const ObjCorner *face, size_t n, std::vector<ObjCorner> &corners) {
+    // fan triangulation: (0, i, i+1)
+    if (face[0].vi < 0) return 0;
+
+    size_t triangles = 0;
+    for (size_t i = 1; i + 1 < n; ++i) {
+        const ObjCorner tri[3] = { face[0], face[i], face[i + 1] };
+        if (tri[1].vi < 0 || tri[2].vi < 0) continue;
+
+        corners.insert(corners.end(), tri, tri + 3);
+        ++triangles;
+    }
+    return triangles;
+}
+
+// Calls `on_face(first, end, vcount, ncount)` for each 'f' line, after
+// appending 'v' and 'vn' records. [first, end) holds the corner tokens.
+template <typename OnFace>
+static void parse_lines(const char *data, size_t size, std::vector<float> &verts, std::vector<float> &norms, OnFace on_face)
+{
+    const char *p = data;
+    const char *end = data + size;
+    while (p < end) {
+        const char *eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!eol) eol = end;
+        const char *line = skip_blank(p, eol);
+        p = eol + 1;
+
+        if (line >= eol || *line == '#')
+            continue;
+
+        const char *typeEnd = skip_token(line, eol);
+        size_t typeLen = typeEnd - line;
+        const char *q = typeEnd;
+
+        if (typeLen == 1 && line[0] == 'v') {
+            float x, y, z;
+            if (parse_float(q, eol, &x) && parse_float(q, eol, &y) && parse_float(q, eol, &z)) {
+                verts.push_back(x);
+                verts.push_back(y);
+                verts.push_back(z);
+            }
+        }
+        else if (typeLen == 2 && line[0] == 'v' && line[1] == 'n') {
+            float x, y, z;
+            if (parse_float(q, eol, &x) && parse_float(q, eol, &y) && parse_float(q, eol, &z)) {
+                norms.push_back(x);
+                norms.push_back(y);
+                norms.push_back(z);
+            }
+        }
+        else if (typeLen == 1 && line[0] == 'f') {
+            on_face(q, eol, static_cast<int>(verts.size() / 3), static_cast<int>(norms.size() / 3));
+        }
+    }
+}
+
+void objloader_parse(const char *data, size_t size, ObjData *out, ObjStats *stats)
+{
+    std::vector<ObjCorner> face; // reused for every 'f' line
+    size_t faceCount = 0;
+    size_t triangleCount = 0;
+
+    out->positions.clear();
+    out->normals.clear();
+    out->corners.clear();
+
+    parse_lines(data, size, out->positions, out->normals,
+        [&](const char *q, const char *eol, int vcount, int ncount) {
+            face.clear();
+            for (;;) {
+                const char *t = skip_blank(q, eol);
+                if (t >= eol) break;
+                q = skip_token(t, eol);
+                int vi_raw, ni_raw;
+                parse_corner(t, q, &vi_raw, &ni_raw);
+                face.push_back(resolve_corner(vi_raw, ni_raw, vcount, ncount));
+            }
+
+            if (face.size() < 3)
+                return;
+            ++faceCount;
+            triangleCount += emit_face(face.data(), face.size(), out->corners);
+        });
+
+    if (stats) {
+        stats->bytes = size;
+        stats->positionCount = out->positions.size() / 3;
+        stats->normalCount = out->normals.size() / 3;
+        stats->faceCount = faceCount;
+        stats->triangleCount = triangleCount;
+    }
+}
+
+// --- parallel parsing --------------------------------------------------------
+//
+// Each chunk is parsed on its own thread without knowing how many 'v'/'vn'
+// records precede it, so faces are kept as raw file indices together with
+// the chunk-local counts at that line. Once every chunk is done, a prefix
+// sum gives each chunk its base counts and the faces are resolved and
+// triangulated exactly like the serial path would have.
+
+struct ObjFaceRecord
+{
+    uint32_t firstCorner;   // into ObjChunk::rawCorners, in pairs
+    uint32_t cornerCount;
+    int vcount;             // chunk-local counts when the face was read
+    int ncount;
+};
+
+struct ObjChunk
+{
+    const char *data;
+    size_t size;
+
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<int> rawCorners;          // v, vn pairs as written
+    std::vector<ObjFaceRecord> faces;     // faces with at least 3 corners
+
+    size_t positionBase;                  // records before this chunk
+    size_t normalBase;
+    std::vector<ObjCorner> corners;       // resolved and triangulated
+    size_t triangleCount;
+    size_t cornerBase;
+};
+
+static void parse_chunk(ObjChunk *chunk) {
+    parse_lines(chunk->data, chunk->size, chunk->positions, chunk->normals,
+        [chunk](const char *q, const char *eol, int vcount, int ncount) {
+            ObjFaceRecord rec;
+            rec.firstCorner = (uint32_t)(chunk->rawCorners.size() / 2);
+            rec.vcount = vcount;
+            rec.ncount = ncount;
+            for (;;) {
+                const char *t = skip_blank(q, eol);
+                if (t >= eol) break;
+                q = skip_token(t, eol);
+                int vi_raw, ni_raw;
+                parse_corner(t, q, &vi_raw, &ni_raw);
+                chunk->rawCorners.push_back(vi_raw);
+                chunk->rawCorners.push_back(ni_raw);
+            }
+            rec.cornerCount = (uint32_t)(chunk->rawCorners.size() / 2) - rec.firstCorner;
+            if (rec.cornerCount < 3) {
+                chunk->rawCorners.resize((size_t)rec.firstCorner * 2);
+                return;
+            }
+            chunk->faces.push_back(rec);
+        });
+}
+
+static void resolve_chunk(ObjChunk *chunk, ObjData *out) {
+    std::copy(chunk->positions.begin(), chunk->positions.end(), out->positions.begin() + chunk->positionBase * 3);
+    std::copy(chunk->normals.begin(), chunk->normals.end(), out->normals.begin() + chunk->normalBase * 3);
+
+    std::vector<ObjCorner> face;
+    chunk->triangleCount = 0;
+    for (const ObjFaceRecord &rec : chunk->faces) {
+        int vcount = (int)chunk->positionBase + rec.vcount;
+        int ncount = (int)chunk->normalBase + rec.ncount;
+        face.clear();
+        for (uint32_t i = 0; i < rec.cornerCount; ++i) {
+            const int *raw = &chunk->rawCorners[((size_t)rec.firstCorner + i) * 2];
+            face.push_back(resolve_corner(raw[0], raw[1], vcount, ncount));
+        }
+        chunk->triangleCount += emit_face(face.data(), face.size(), chunk->corners);
+    }
+}
+
+// Helper threads all parses share, so concurrent loads cannot add up to
+// more threads than cores. A parse that finds the budget spent still splits
+// the same way and runs the chunks it has no thread for itself.
+static std::atomic<int> helperBudget{ -1 };
+
+static int take_helpers(int wanted) {
+    int budget = helperBudget.load();
+    if (budget < 0) {
+        int cores = (int)std::thread::hardware_concurrency();
+        helperBudget.compare_exchange_strong(budget, cores > 1 ? cores - 1 : 0);
+        budget = helperBudget.load();
+    }
+    for (;;) {
+        int take = std::min(budget, wanted);
+        if (take <= 0) return 0;
+        if (helperBudget.compare_exchange_weak(budget, budget - take)) return take;
+    }
+}
+
+template <typename Fn>
+static void run_chunks(std::vector<ObjChunk> &chunks, Fn fn) {
+    const int helpers = take_helpers((int)chunks.size() - 1);
+    std::atomic<size_t> next{ 0 };
+    auto drain = [&] {
+        for (size_t i; (i = next.fetch_add(1)) < chunks.size();)
+            fn(&chunks[i]);
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(helpers);
+    for (int i = 0; i < helpers; ++i)
+        threads.emplace_back(drain);
+    drain();
+    for (std::thread &t : threads)
+        t.join();
+    helperBudget += helpers;
+}
+
+void objloader_parse_parallel(const char *data, size_t size, ObjData *out, int threadCount, ObjStats *stats)
+{
+    if (threadCount <= 0) threadCount = objloader_auto_threads(size);
+    if (threadCount <= 1) {
+        objloader_parse(data, size, out, stats);
+        return;
+    }
+
+    // split at line boundaries
+    std::vector<ObjChunk> chunks(threadCount);
+    const char *end = data + size;
+    const char *p = data;
+    for (int i = 0; i < threadCount; ++i) {
+        const char *split = (i + 1 == threadCount) ? end : data + size * (i + 1) / threadCount;
+        if (split < p) split = p;
+        if (split < end) {
+            const char *nl = static_cast<const char*>(std::memchr(split, '\n', end - split));
+            split = nl ? nl + 1 : end;
+        }
+        chunks[i].data = p;
+        chunks[i].size = split - p;
+        p = split;
+    }
+
+    run_chunks(chunks, parse_chunk);
+
+    size_t positionCount = 0, normalCount = 0, faceCount = 0;
+    for (ObjChunk &c : chunks) {
+        c.positionBase = positionCount;
+        c.normalBase = normalCount;
+        positionCount += c.positions.size() / 3;
+        normalCount += c.normals.size() / 3;
+        faceCount += c.faces.size();
+    }
+    out->positions.resize(positionCount * 3);
+    out->normals.resize(normalCount * 3);
+
+    run_chunks(chunks, [out](ObjChunk *c) { resolve_chunk(c, out); });
+
+    size_t cornerCount = 0, triangleCount = 0;
+    for (ObjChunk &c : chunks) {
+        c.cornerBase = cornerCount;
+        cornerCount += c.corners.size();
+        triangleCount += c.triangleCount;
+    }
+    out->corners.resize(cornerCount);
+
+    run_chunks(chunks, [out](ObjChunk *c) {
+        std::copy(c->corners.begin(), c->corners.end(), out->corners.begin() + c->cornerBase);
+    });
+
+    if (stats) {
+        stats->bytes = size;
+        stats->positionCount = positionCount;
+        stats->normalCount = normalCount;
+        stats->faceCount = faceCount;
+        stats->triangleCount = triangleCount;
+    }
+}
+
+int objloader_auto_threads(size_t size)
+{
+    int cores = (int)std::thread::hardware_concurrency();
+    if (cores < 1) cores = 1;
+    size_t chunks = size / OBJ_PARALLEL_MIN_CHUNK_BYTES;
+    if (chunks < 1) return 1;
+    return chunks < (size_t)cores ? (int)chunks : cores;
+}
+
+bool objloader_load(const std::string &path, ObjData *out, ObjStats *stats, int threadCount)
+{
+    MappedFile file;
+    if (!mappedfile_open(&file, path)) {
+        std::cerr << "Failed to open OBJ file: " << path << "\n";
+        out->positions.clear();
+        out->normals.clear();
+        out->corners.clear();
+        if (stats) *stats = ObjStats{};
+        return false;
+    }
+
+    if (threadCount == 1)
+        objloader_parse(file.data, file.size, out, stats);
+    else
+        objloader_parse_parallel(file.data, file.size, out, threadCount, stats);
+    mappedfile_close(&file);
+    return true;
+}
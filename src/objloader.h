@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct ObjStats
+{
+    size_t bytes;           // size of the parsed text
+    size_t positionCount;   // 'v' records
+    size_t normalCount;     // 'vn' records
+    size_t faceCount;       // 'f' records with at least 3 corners
+    size_t triangleCount;   // triangles emitted after fan triangulation
+};
+
+struct ObjCorner
+{
+    int vi;   // 0-based position index
+    int ni;   // 0-based normal index, -1 if missing
+};
+
+struct ObjData
+{
+    std::vector<float> positions;     // flat xyzxyz...
+    std::vector<float> normals;       // flat xyzxyz...
+    std::vector<ObjCorner> corners;   // 3 per triangle, fan triangulated
+};
+
+// Parses OBJ text into `out`. The text is tokenized in place; `out` is
+// cleared first but keeps its capacity, so a caller that parses many files
+// can reuse it.
+void objloader_parse(const char *data, size_t size, ObjData *out, ObjStats *stats = nullptr);
+
+// Splits the text at line boundaries and parses the pieces on
+// `threadCount` threads. The result is identical to objloader_parse,
+// including how negative (relative) indices resolve. A positive threadCount
+// always splits that many ways, however small the text; threadCount <= 0
+// picks a count from the size with objloader_auto_threads. All parses in
+// flight share one helper thread per core beyond the first; pieces that get
+// no helper run on the calling thread.
+void objloader_parse_parallel(const char *data, size_t size, ObjData *out, int threadCount, ObjStats *stats = nullptr);
+
+// Files are only split when every thread gets at least this much text.
+const size_t OBJ_PARALLEL_MIN_CHUNK_BYTES = 4 * 1024 * 1024;
+
+int objloader_auto_threads(size_t size);
+
+// Memory-maps `path` and parses it, serially when threadCount is 1,
+// otherwise with objloader_parse_parallel.
+bool objloader_load(const std::string &path, ObjData *out, ObjStats *stats = nullptr, int threadCount = 1);
@@ -0,0 +1,283 @@
+#include "occlusion.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define OCCLUSION_SSE 1
+#endif
+
+static const uint32_t FULL_MASK = 0xffffffffu;
+
+void occlusion_init(OcclusionBuffer *buffer, int width, int height, int threadCount)
+{
+    buffer->tilesX = (width + OCCLUSION_TILE_W - 1) / OCCLUSION_TILE_W;
+    buffer->tilesY = (height + OCCLUSION_TILE_H - 1) / OCCLUSION_TILE_H;
+    buffer->width = buffer->tilesX * OCCLUSION_TILE_W;
+    buffer->height = buffer->tilesY * OCCLUSION_TILE_H;
+    buffer->tiles.assign((size_t)buffer->tilesX * buffer->tilesY, OcclusionTile{ 0, 1.0f, 1.0f });
+    buffer->viewProj = glm::mat4(1.0f);
+    buffer->stats = OcclusionStats{};
+
+    workerpool_start(&buffer->pool, threadCount);
+    buffer->threadTris.resize(workerpool_size(&buffer->pool));
+}
+
+void occlusion_destroy(OcclusionBuffer *buffer)
+{
+    workerpool_stop(&buffer->pool);
+    buffer->threadTris.clear();
+    buffer->tiles.clear();
+}
+
+// Clips a clip space triangle against the near plane (z >= -w); returns the
+// corner count of the resulting polygon, 0 to 4.
+static int clip_near(const glm::vec4 in[3], glm::vec4 out[4]) {
+    int n = 0;
+    for (int i = 0; i < 3; ++i) {
+        const glm::vec4 &a = in[i], &b = in[(i + 1) % 3];
+        float da = a.z + a.w, db = b.z + b.w;
+        if (da >= 0.0f) out[n++] = a;
+        if ((da >= 0.0f) != (db >= 0.0f))
+            out[n++] = a + (b - a) * (da / (da - db));
+    }
+    return n;
+}
+
+static glm::vec3 to_screen(const OcclusionBuffer *buffer, const glm::vec4 &c) {
+    float invW = 1.0f / c.w;
+    return glm::vec3((c.x * invW * 0.5f + 0.5f) * buffer->width,
+                     (c.y * invW * 0.5f + 0.5f) * buffer->height,
+                     c.z * invW * 0.5f + 0.5f);
+}
+
+static void setup_triangle(const OcclusionBuffer *buffer, glm::vec3 v0, glm::vec3 v1, glm::vec3 v2,
+                           std::vector<OcclusionTri> *out) {
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+    if (!(std::fabs(area) > 1e-8f)) return;
+    if (area < 0.0f) {
+        std::swap(v1, v2);
+        area = -area;
+    }
+
+    // pixel centers at +0.5
+    OcclusionTri t;
+    t.minX = std::max(0, (int)std::ceil(std::min(std::min(v0.x, v1.x), v2.x) - 0.5f));
+    t.maxX = std::min(buffer->width - 1, (int)std::floor(std::max(std::max(v0.x, v1.x), v2.x) - 0.5f));
+    t.minY = std::max(0, (int)std::ceil(std::min(std::min(v0.y, v1.y), v2.y) - 0.5f));
+    t.maxY = std::min(buffer->height - 1, (int)std::floor(std::max(std::max(v0.y, v1.y), v2.y) - 0.5f));
+    if (t.minX > t.maxX || t.minY > t.maxY) return;
+
+    const glm::vec3 *v[3] = { &v0, &v1, &v2 };
+    for (int e = 0; e < 3; ++e) {
+        const glm::vec3 &a = *v[e], &b = *v[(e + 1) % 3];
+        t.edgeA[e] = a.y - b.y;
+        t.edgeB[e] = b.x - a.x;
+        t.edgeC[e] = -(t.edgeA[e] * a.x + t.edgeB[e] * a.y);
+    }
+
+    float invArea = 1.0f / area;
+    t.zA = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) * invArea;
+    t.zB = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) * invArea;
+    t.zC = v0.z - t.zA * v0.x - t.zB * v0.y;
+    t.zMax = std::min(1.0f, std::max(std::max(v0.z, v1.z), v2.z));
+    out->push_back(t);
+}
+
+static void setup_occluder_triangle(const OcclusionBuffer *buffer, const glm::mat4 &mvp,
+                                    const glm::vec3 *corners, std::vector<OcclusionTri> *out) {
+    glm::vec4 clip[3];
+    for (int c = 0; c < 3; ++c)
+        clip[c] = mvp * glm::vec4(corners[c], 1.0f);
+
+    // entirely outside one side of the frustum
+    for (int axis = 0; axis < 3; ++axis) {
+        if (clip[0][axis] > clip[0].w && clip[1][axis] > clip[1].w && clip[2][axis] > clip[2].w) return;
+        if (clip[0][axis] < -clip[0].w && clip[1][axis] < -clip[1].w && clip[2][axis] < -clip[2].w) return;
+    }
+
+    glm::vec4 poly[4];
+    int n = clip_near(clip, poly);
+    if (n < 3) return;
+    glm::vec3 s0 = to_screen(buffer, poly[0]);
+    glm::vec3 prev = to_screen(buffer, poly[1]);
+    for (int i = 2; i < n; ++i) {
+        glm::vec3 cur = to_screen(buffer, poly[i]);
+        setup_triangle(buffer, s0, prev, cur, out);
+        prev = cur;
+    }
+}
+
+static inline void update_tile(OcclusionTile *tile, uint32_t coverage, float z) {
+    if (!coverage || z >= tile->zMax1) return;
+    // a triangle far in front of the working layer starts a new one
+    if (tile->mask && tile->zMax0 - z > tile->zMax1 - tile->zMax0)
+        tile->mask = 0;
+    tile->zMax0 = tile->mask ? std::max(tile->zMax0, z) : z;
+    tile->mask |= coverage;
+    if (tile->mask == FULL_MASK) {
+        tile->zMax1 = tile->zMax0;
+        tile->mask = 0;
+    }
+}
+
+// Coverage of the tile whose bottom left pixel is (px, py).
+static inline uint32_t tile_coverage(const OcclusionTri &t, int px, int py) {
+    // early out on the edge functions at the corner pixel centers
+    bool full = true;
+    for (int e = 0; e < 3; ++e) {
+        float a = t.edgeA[e], b = t.edgeB[e];
+        float base = a * (px + 0.5f) + b * (py + 0.5f) + t.edgeC[e];
+        float dx = a * (OCCLUSION_TILE_W - 1), dy = b * (OCCLUSION_TILE_H - 1);
+        float lo = base + std::min(dx, 0.0f) + std::min(dy, 0.0f);
+        float hi = base + std::max(dx, 0.0f) + std::max(dy, 0.0f);
+        if (hi < 0.0f) return 0;
+        if (lo < 0.0f) full = false;
+    }
+    if (full) return FULL_MASK;
+
+    uint32_t mask = 0;
+#ifdef OCCLUSION_SSE
+    const __m128 zero = _mm_setzero_ps();
+    __m128 left[3], right[3], stepY[3];
+    for (int e = 0; e < 3; ++e) {
+        __m128 a = _mm_set1_ps(t.edgeA[e]);
+        __m128 base = _mm_set1_ps(t.edgeA[e] * (px + 0.5f) + t.edgeB[e] * (py + 0.5f) + t.edgeC[e]);
+        left[e] = _mm_add_ps(base, _mm_mul_ps(a, _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f)));
+        right[e] = _mm_add_ps(base, _mm_mul_ps(a, _mm_setr_ps(4.0f, 5.0f, 6.0f, 7.0f)));
+        stepY[e] = _mm_set1_ps(t.edgeB[e]);
+    }
+    for (int row = 0; row < OCCLUSION_TILE_H; ++row) {
+        __m128 inL = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(left[0], zero), _mm_cmpge_ps(left[1], zero)), _mm_cmpge_ps(left[2], zero));
+        __m128 inR = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(right[0], zero), _mm_cmpge_ps(right[1], zero)), _mm_cmpge_ps(right[2], zero));
+        uint32_t bits = (uint32_t)_mm_movemask_ps(inL) | ((uint32_t)_mm_movemask_ps(inR) << 4);
+        mask |= bits << (row * OCCLUSION_TILE_W);
+        for (int e = 0; e < 3; ++e) {
+            left[e] = _mm_add_ps(left[e], stepY[e]);
+            right[e] = _mm_add_ps(right[e], stepY[e]);
+        }
+    }
+#else
+    for (int row = 0; row < OCCLUSION_TILE_H; ++row)
+        for (int col = 0; col < OCCLUSION_TILE_W; ++col) {
+            bool inside = true;
+            for (int e = 0; e < 3; ++e)
+                inside &= t.edgeA[e] * (px + col + 0.5f) + t.edgeB[e] * (py + row + 0.5f) + t.edgeC[e] >= 0.0f;
+            if (inside) mask |= 1u << (row * OCCLUSION_TILE_W + col);
+        }
+#endif
+    return mask;
+}
+
+static void rasterize_band(OcclusionBuffer *buffer, int tileRowBegin, int tileRowEnd) {
+    for (const std::vector<OcclusionTri> &tris : buffer->threadTris)
+        for (const OcclusionTri &t : tris) {
+            int ty0 = std::max(tileRowBegin, t.minY / OCCLUSION_TILE_H);
+            int ty1 = std::min(tileRowEnd - 1, t.maxY / OCCLUSION_TILE_H);
+            int tx0 = t.minX / OCCLUSION_TILE_W, tx1 = t.maxX / OCCLUSION_TILE_W;
+            for (int ty = ty0; ty <= ty1; ++ty) {
+                int py = ty * OCCLUSION_TILE_H;
+                float zRow = t.zC + std::max(t.zB * (py + 0.5f), t.zB * (py + OCCLUSION_TILE_H - 0.5f));
+                OcclusionTile *row = &buffer->tiles[(size_t)ty * buffer->tilesX];
+                for (int tx = tx0; tx <= tx1; ++tx) {
+                    int px = tx * OCCLUSION_TILE_W;
+                    // farthest point of the depth plane over the tile
+                    float z = zRow + std::max(t.zA * (px + 0.5f), t.zA * (px + OCCLUSION_TILE_W - 0.5f));
+                    z = std::min(z, t.zMax);
+                    if (z >= row[tx].zMax1) continue;
+                    update_tile(&row[tx], tile_coverage(t, px, py), z);
+                }
+            }
+        }
+}
+
+void occlusion_render(OcclusionBuffer *buffer, const glm::mat4 &viewProj,
+                      const Occluder *occluders, size_t count)
+{
+    auto start = std::chrono::steady_clock::now();
+    buffer->viewProj = viewProj;
+    std::fill(buffer->tiles.begin(), buffer->tiles.end(), OcclusionTile{ 0, 1.0f, 1.0f });
+
+    // split the triangles evenly regardless of which occluder they belong to
+    std::vector<size_t> firstTriangle(count + 1, 0);
+    for (size_t i = 0; i < count; ++i)
+        firstTriangle[i + 1] = firstTriangle[i] + occluders[i].triangleCount;
+    const size_t total = firstTriangle[count];
+    const int threads = workerpool_size(&buffer->pool);
+
+    workerpool_run(&buffer->pool, [&](int index) {
+        std::vector<OcclusionTri> *out = &buffer->threadTris[index];
+        out->clear();
+        size_t begin = total * index / threads, end = total * (index + 1) / threads;
+        size_t o = std::upper_bound(firstTriangle.begin(), firstTriangle.end(), begin) - firstTriangle.begin() - 1;
+        for (size_t tri = begin; tri < end; ++o) {
+            size_t last = std::min(end, firstTriangle[o + 1]);
+            if (tri >= last) continue;
+            glm::mat4 mvp = viewProj * *occluders[o].model;
+            for (; tri < last; ++tri)
+                setup_occluder_triangle(buffer, mvp, &occluders[o].triangles[3 * (tri - firstTriangle[o])], out);
+        }
+    });
+
+    workerpool_run(&buffer->pool, [&](int index) {
+        rasterize_band(buffer, buffer->tilesY * index / threads, buffer->tilesY * (index + 1) / threads);
+    });
+
+    buffer->stats.occluders = (int)count;
+    buffer->stats.triangles = 0;
+    for (const std::vector<OcclusionTri> &tris : buffer->threadTris)
+        buffer->stats.triangles += (int)tris.size();
+    buffer->stats.rasterSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool occlusion_test(const OcclusionBuffer *buffer, const CullBounds &bounds, const glm::mat4 &model)
+{
+    const glm::mat4 mvp = buffer->viewProj * model;
+    float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, minZ = 1e30f;
+    for (int c = 0; c < 8; ++c) {
+        glm::vec3 p(c & 1 ? bounds.extent.x : -bounds.extent.x,
+                    c & 2 ? bounds.extent.y : -bounds.extent.y,
+                    c & 4 ? bounds.extent.z : -bounds.extent.z);
+        glm::vec4 clip = mvp * glm::vec4(glm::vec3(bounds.center) + p, 1.0f);
+        if (clip.z < -clip.w || clip.w <= 0.0f) return true;   // crosses the near plane
+        glm::vec3 s = to_screen(buffer, clip);
+        minX = std::min(minX, s.x);
+        maxX = std::max(maxX, s.x);
+        minY = std::min(minY, s.y);
+        maxY = std::max(maxY, s.y);
+        minZ = std::min(minZ, s.z);
+    }
+
+    // every pixel the rectangle touches
+    int x0 = std::max(0, (int)std::floor(minX)), x1 = std::min(buffer->width - 1, (int)std::floor(maxX));
+    int y0 = std::max(0, (int)std::floor(minY)), y1 = std::min(buffer->height - 1, (int)std::floor(maxY));
+    if (x0 > x1 || y0 > y1) return false;   // off screen
+
+    for (int ty = y0 / OCCLUSION_TILE_H; ty <= y1 / OCCLUSION_TILE_H; ++ty) {
+        int r0 = std::max(y0 - ty * OCCLUSION_TILE_H, 0);
+        int r1 = std::min(y1 - ty * OCCLUSION_TILE_H, OCCLUSION_TILE_H - 1);
+        const OcclusionTile *row = &buffer->tiles[(size_t)ty * buffer->tilesX];
+        for (int tx = x0 / OCCLUSION_TILE_W; tx <= x1 / OCCLUSION_TILE_W; ++tx) {
+            int c0 = std::max(x0 - tx * OCCLUSION_TILE_W, 0);
+            int c1 = std::min(x1 - tx * OCCLUSION_TILE_W, OCCLUSION_TILE_W - 1);
+            uint32_t cols = (0xffu >> (OCCLUSION_TILE_W - 1 - c1)) & ~((1u << c0) - 1);
+            uint32_t rect = 0;
+            for (int r = r0; r <= r1; ++r)
+                rect |= cols << (r * OCCLUSION_TILE_W);
+
+            const OcclusionTile &tile = row[tx];
+            float bound = (rect & ~tile.mask) ? tile.zMax1 : std::min(tile.zMax0, tile.zMax1);
+            if (minZ <= bound) return true;
+        }
+    }
+    return false;
+}
+
+float occlusion_depth(const OcclusionBuffer *buffer, int x, int y)
+{
+    const OcclusionTile &tile = buffer->tiles[(size_t)(y / OCCLUSION_TILE_H) * buffer->tilesX + x / OCCLUSION_TILE_W];
+    uint32_t bit = 1u << ((y % OCCLUSION_TILE_H) * OCCLUSION_TILE_W + x % OCCLUSION_TILE_W);
+    return (tile.mask & bit) ? std::min(tile.zMax0, tile.zMax1) : tile.zMax1;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "culling.h"
+#include "workerpool.h"
+
+// Software occlusion culling with a masked depth buffer.
+//
+// A few large occluders are rasterized on the CPU into a low resolution
+// buffer of 8x4 pixel tiles. Like masked occlusion culling, a tile doesn't
+// store per-pixel depth: it keeps a conservative far depth for the whole
+// tile plus a coverage mask of the pixels covered by a nearer working
+// layer with its own far depth. When the working layer covers the tile it
+// becomes the new tile depth. Objects are then tested with the screen
+// rectangle and nearest depth of their bounding box; one that is behind
+// the stored depth everywhere under that rectangle is hidden.
+//
+// Depth is NDC z mapped to [0, 1], which is linear in screen space.
+// Triangle setup is split over the occluders and rasterization over bands
+// of tile rows, both across a small pool of worker threads.
+
+const int OCCLUSION_TILE_W = 8;
+const int OCCLUSION_TILE_H = 4;
+
+struct OcclusionTile
+{
+    uint32_t mask;   // pixels in the working layer, bit row * 8 + column
+    float zMax0;     // far depth of the working layer
+    float zMax1;     // far depth of the whole tile
+};
+
+// Triangles in model space, 3 corners each, placed by `model`.
+struct Occluder
+{
+    const glm::vec3 *triangles;
+    size_t triangleCount;
+    const glm::mat4 *model;
+};
+
+struct OcclusionStats
+{
+    int occluders;
+    int triangles;   // rasterized, after clipping
+    int tested;
+    int occluded;
+    double rasterSeconds;
+    double testSeconds;
+};
+
+// Screen space triangle ready for rasterization.
+struct OcclusionTri
+{
+    float edgeA[3], edgeB[3], edgeC[3];   // inside where a*x + b*y + c >= 0
+    float zA, zB, zC;                     // depth plane
+    float zMax;
+    int minX, maxX, minY, maxY;           // pixel bounds, inclusive
+};
+
+struct OcclusionBuffer
+{
+    int width, height;   // pixels, multiples of the tile size
+    int tilesX, tilesY;
+    std::vector<OcclusionTile> tiles;   // row 0 at the bottom of the screen
+    glm::mat4 viewProj;
+
+    std::vector<std::vector<OcclusionTri>> threadTris;   // setup output per thread
+    OcclusionStats stats;
+
+    WorkerPool pool;
+};
+
+// threadCount <= 0 picks one per core, up to 4.
+void occlusion_init(OcclusionBuffer *buffer, int width, int height, int threadCount = 0);
+
+void occlusion_destroy(OcclusionBuffer *buffer);
+
+// Clears the buffer and rasterizes the occluders as seen through `viewProj`.
+void occlusion_render(OcclusionBuffer *buffer, const glm::mat4 &viewProj,
+                      const Occluder *occluders, size_t count);
+
+// False if a box with local bounds `bounds` placed by `model` is certainly
+// hidden behind the occluders of the last render.
+bool occlusion_test(const OcclusionBuffer *buffer, const CullBounds &bounds, const glm::mat4 &model);
+
+// Conservative depth of one pixel.
+float occlusion_depth(const OcclusionBuffer *buffer, int x, int y);
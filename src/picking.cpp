@@ -0,0 +1,98 @@
+#include "picking.h"
+
+#include <chrono>
+#include <cstring>
+
+#include "scene.h"
+
+void picking_ray(const glm::mat4 &view, const glm::mat4 &proj, const glm::vec2 &ndc,
+                 glm::vec3 *origin, glm::vec3 *dir)
+{
+    glm::mat4 inv = glm::inverse(proj * view);
+    glm::vec4 nearPoint = inv * glm::vec4(ndc, -1.0f, 1.0f);
+    glm::vec4 farPoint = inv * glm::vec4(ndc, 1.0f, 1.0f);
+    *origin = glm::vec3(nearPoint) / nearPoint.w;
+    *dir = glm::normalize(glm::vec3(farPoint) / farPoint.w - *origin);
+}
+
+// The picking BVH of a render object, or null if it cannot be picked.
+static const MeshBvh* pickable(Scene *scene, const RenderObj &obj) {
+    if (obj.mesh == MESH_NONE) return nullptr;
+    const GpuMesh *mesh = meshregistry_get(&scene->meshes, obj.mesh);
+    if (!meshregistry_resident(mesh) || bvh_empty(&mesh->bvh.bvh)) return nullptr;
+    return &mesh->bvh;
+}
+
+// True if the instances are still the pickable objects, in order.
+static bool same_instances(const SceneBvh *bvh, Scene *scene) {
+    size_t k = 0;
+    for (size_t i = 0; i < scene->renderObjs.size(); ++i) {
+        const MeshBvh *mesh = pickable(scene, scene->renderObjs[i]);
+        if (!mesh) continue;
+        if (k == bvh->instances.size()) return false;
+        const BvhInstance &inst = bvh->instances[k++];
+        if (inst.userId != (uint32_t)i || inst.mesh != mesh) return false;
+    }
+    return k == bvh->instances.size();
+}
+
+static void rebuild(Picker *picker, Scene *scene) {
+    SceneBvh *bvh = &picker->bvh;
+    bvh->instances.clear();
+    for (size_t i = 0; i < scene->renderObjs.size(); ++i) {
+        const RenderObj &obj = scene->renderObjs[i];
+        const MeshBvh *mesh = pickable(scene, obj);
+        if (!mesh) continue;
+
+        BvhInstance inst;
+        inst.mesh = mesh;
+        inst.world = transforms_world(&scene->transforms, obj.node);
+        inst.invWorld = glm::inverse(inst.world);
+        inst.userId = (uint32_t)i;
+        bvh->instances.push_back(inst);
+    }
+    scenebvh_build(bvh);
+}
+
+// Picks up new world matrices; returns how many instances moved.
+static int refit(Picker *picker, Scene *scene) {
+    SceneBvh *bvh = &picker->bvh;
+    int moved = 0;
+    for (BvhInstance &inst : bvh->instances) {
+        const glm::mat4 &world = transforms_world(&scene->transforms, scene->renderObjs[inst.userId].node);
+        if (std::memcmp(&world, &inst.world, sizeof(glm::mat4)) == 0) continue;
+        inst.world = world;
+        inst.invWorld = glm::inverse(world);
+        ++moved;
+    }
+    if (moved) scenebvh_refit(bvh);
+    return moved;
+}
+
+int picking_pick(Picker *picker, Scene *scene, const glm::vec3 &origin, const glm::vec3 &dir)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    SceneBvh *bvh = &picker->bvh;
+    PickStats *stats = &picker->stats;
+    stats->moved = 0;
+    stats->rebuilt = !picker->built || picker->meshesVersion != scene->meshes.version ||
+                     !same_instances(bvh, scene);
+    if (stats->rebuilt)
+        rebuild(picker, scene);
+    else if (picker->transformsVersion != scene->transforms.version)
+        stats->moved = refit(picker, scene);
+    picker->built = true;
+    picker->meshesVersion = scene->meshes.version;
+    picker->transformsVersion = scene->transforms.version;
+
+    RayHit hit;
+    hit.t = 1e30f;
+    bool found = scenebvh_raycast(bvh, origin, dir, &hit);
+
+    stats->object = found ? (int)hit.instance : -1;
+    stats->triangle = found ? hit.triangle : 0;
+    stats->instances = (int)bvh->instances.size();
+    stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats->object;
+}
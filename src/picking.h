@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "raycast.h"
+
+struct Scene;
+
+// Mouse picking: a ray through the clicked pixel against the triangle BVHs
+// of every resident mesh, through a top level over their world bounds. The
+// top level and each instance's inverse world matrix are kept between
+// picks: the tree is rebuilt when objects or resident meshes change, and
+// refit with fresh matrices for the instances that moved when only
+// transforms did.
+
+struct PickStats
+{
+    int object;          // last pick's render object, -1 on a miss
+    uint32_t triangle;   // triangle hit in that object's mesh
+    int instances;       // objects in the top level
+    int moved;           // instances refit for this pick
+    bool rebuilt;        // the top level was built from scratch
+    double seconds;      // top level update and ray cast
+};
+
+struct Picker
+{
+    SceneBvh bvh;                      // instances in object order
+    bool built = false;
+    uint64_t meshesVersion = 0;        // MeshRegistry::version of `bvh`
+    uint64_t transformsVersion = 0;    // TransformHierarchy::version of the matrices
+    PickStats stats = { -1, 0, 0, 0, false, 0.0 };
+};
+
+// World space ray through `ndc` (x and y in [-1, 1], y up).
+void picking_ray(const glm::mat4 &view, const glm::mat4 &proj, const glm::vec2 &ndc,
+                 glm::vec3 *origin, glm::vec3 *dir);
+
+// Closest render object along the ray, or -1.
+int picking_pick(Picker *picker, Scene *scene, const glm::vec3 &origin, const glm::vec3 &dir);
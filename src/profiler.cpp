@@ -0,0 +1,229 @@
+#include "profiler.h"
+
+#include <glad/glad.h>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+// A frame whose GPU queries may still be running.
+struct InFlightFrame
+{
+    ProfileFrame frame;
+    std::vector<GLuint> queries;   // pool, grows to the most GPU scopes seen
+    std::vector<int> queryScope;   // scope measured by each query used
+    bool pending;
+};
+
+bool g_profilerEnabled = true;
+
+static std::chrono::steady_clock::time_point epoch;
+static InFlightFrame inFlight[PROFILER_LATENCY];
+static InFlightFrame *current;   // frame being recorded, null while disabled
+static uint32_t frameNumber;
+static std::vector<int> openScopes;
+static int gpuScope = -1;        // scope owning the running query
+
+static ProfileFrame last;
+static float historyCpu[PROFILER_HISTORY], historyGpu[PROFILER_HISTORY];
+static int historyCount, historyNext;
+
+static std::vector<ProfileFrame> captured;
+static int captureRemaining;
+static std::string capturePath;
+
+static double now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+// Handles carry the frame number so a scope left open across frames can't
+// end a scope of the next one.
+static int make_handle(int index) { return (int)((frameNumber & 0x7f) << 24) | index; }
+
+static void write_trace() {
+    FILE *f = std::fopen(capturePath.c_str(), "w");
+    if (!f) {
+        std::cerr << "Could not write trace: " << capturePath << "\n";
+        return;
+    }
+    std::fprintf(f, "{\"traceEvents\":[\n");
+    std::fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n");
+    std::fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+    for (const ProfileFrame &frame : captured) {
+        std::fprintf(f, ",\n{\"name\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+                     frame.start * 1e6, (frame.end - frame.start) * 1e6);
+        for (const ProfileScope &s : frame.scopes) {
+            std::fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+                         s.name, s.start * 1e6, (s.end - s.start) * 1e6);
+            // only durations are known on the GPU; line them up with the CPU side
+            if (s.gpuMs >= 0.0f)
+                std::fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":%.3f,\"dur\":%.3f}",
+                             s.name, s.start * 1e6, s.gpuMs * 1e3);
+        }
+    }
+    std::fprintf(f, "\n]}\n");
+    std::fclose(f);
+    std::cout << "Wrote " << captured.size() << " frames to " << capturePath << "\n";
+    captured.clear();
+}
+
+static void publish(const ProfileFrame &frame) {
+    last = frame;
+    historyCpu[historyNext] = (float)((frame.end - frame.start) * 1000.0);
+    historyGpu[historyNext] = frame.gpuMs;
+    historyNext = (historyNext + 1) % PROFILER_HISTORY;
+    if (historyCount < PROFILER_HISTORY) historyCount++;
+
+    if (captureRemaining > 0) {
+        captured.push_back(frame);
+        if (--captureRemaining == 0) write_trace();
+    }
+}
+
+// Reads the queries of a frame PROFILER_LATENCY frames old. Only if every
+// result is in; otherwise its GPU times are dropped rather than waited for.
+static void resolve(InFlightFrame *f) {
+    f->pending = false;
+    for (size_t i = 0; i < f->queryScope.size(); ++i) {
+        GLint available = 0;
+        glGetQueryObjectiv(f->queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            f->frame.gpuMs = -1.0f;
+            publish(f->frame);
+            return;
+        }
+    }
+    float total = 0.0f;
+    for (size_t i = 0; i < f->queryScope.size(); ++i) {
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(f->queries[i], GL_QUERY_RESULT, &ns);
+        float ms = (float)(ns * 1e-6);
+        f->frame.scopes[f->queryScope[i]].gpuMs = ms;
+        total += ms;
+    }
+    f->frame.gpuMs = total;
+    publish(f->frame);
+}
+
+void profiler_init()
+{
+    epoch = std::chrono::steady_clock::now();
+    current = nullptr;
+    frameNumber = 0;
+    historyCount = historyNext = 0;
+    last = ProfileFrame{};
+}
+
+void profiler_shutdown()
+{
+    for (InFlightFrame &f : inFlight) {
+        if (!f.queries.empty())
+            glDeleteQueries((GLsizei)f.queries.size(), f.queries.data());
+        f = InFlightFrame{};
+    }
+    current = nullptr;
+}
+
+void profiler_set_enabled(bool enabled)
+{
+    g_profilerEnabled = enabled;
+}
+
+void profiler_begin_frame()
+{
+    double t = now();
+    if (current) {
+        if (gpuScope >= 0) glEndQuery(GL_TIME_ELAPSED);
+        for (int s : openScopes)
+            current->frame.scopes[s].end = t;
+        current->frame.end = t;
+        current->pending = true;
+    }
+    openScopes.clear();
+    gpuScope = -1;
+
+    frameNumber++;
+    InFlightFrame *slot = &inFlight[frameNumber % PROFILER_LATENCY];
+    if (slot->pending) resolve(slot);
+
+    current = nullptr;
+    if (!g_profilerEnabled) return;
+    current = slot;
+    current->frame.scopes.clear();
+    current->frame.start = t;
+    current->frame.gpuMs = 0.0f;
+    current->queryScope.clear();
+}
+
+int profiler_begin(const char *name, bool gpu)
+{
+    if (!current) return -1;
+    std::vector<ProfileScope> &scopes = current->frame.scopes;
+    int index = (int)scopes.size();
+    ProfileScope s;
+    s.name = name;
+    s.parent = openScopes.empty() ? -1 : openScopes.back();
+    s.depth = (int)openScopes.size();
+    s.start = s.end = now();
+    s.gpuMs = -1.0f;
+    scopes.push_back(s);
+    openScopes.push_back(index);
+
+    if (gpu && gpuScope < 0) {
+        size_t q = current->queryScope.size();
+        if (q == current->queries.size()) {
+            GLuint id;
+            glGenQueries(1, &id);
+            current->queries.push_back(id);
+        }
+        glBeginQuery(GL_TIME_ELAPSED, current->queries[q]);
+        current->queryScope.push_back(index);
+        gpuScope = index;
+    }
+    return make_handle(index);
+}
+
+void profiler_end(int handle)
+{
+    if (!current || handle != make_handle(handle & 0xffffff)) return;
+    int index = handle & 0xffffff;
+    if (index >= (int)current->frame.scopes.size()) return;
+
+    current->frame.scopes[index].end = now();
+    if (gpuScope == index) {
+        glEndQuery(GL_TIME_ELAPSED);
+        gpuScope = -1;
+    }
+    while (!openScopes.empty()) {
+        int top = openScopes.back();
+        openScopes.pop_back();
+        if (top == index) break;
+    }
+}
+
+const ProfileFrame& profiler_last_frame()
+{
+    return last;
+}
+
+void profiler_history(std::vector<float> *cpuMs, std::vector<float> *gpuMs)
+{
+    cpuMs->resize(historyCount);
+    gpuMs->resize(historyCount);
+    int first = (historyNext - historyCount + PROFILER_HISTORY) % PROFILER_HISTORY;
+    for (int i = 0; i < historyCount; ++i) {
+        (*cpuMs)[i] = historyCpu[(first + i) % PROFILER_HISTORY];
+        (*gpuMs)[i] = historyGpu[(first + i) % PROFILER_HISTORY];
+    }
+}
+
+void profiler_capture(int frames, const std::string &path)
+{
+    captured.clear();
+    captureRemaining = frames > 0 ? frames : 0;
+    capturePath = path;
+}
+
+int profiler_capture_remaining()
+{
+    return captureRemaining;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Frame profiler: nested named CPU scopes, GPU time of the outermost GPU
+// scopes from GL_TIME_ELAPSED queries, a rolling history and Chrome
+// trace_event export.
+//
+// Scopes are cheap to leave in: when the profiler is disabled a scope is a
+// test of one global flag, and building with MYGL_PROFILER=0 removes them.
+// GPU results are read PROFILER_LATENCY frames later, when the queries have
+// long finished, so the profiler never waits on the GPU; a frame's data is
+// published once its GPU times are in. TIME_ELAPSED queries can't nest, so
+// a GPU scope inside another GPU scope only measures CPU time.
+
+#ifndef MYGL_PROFILER
+#define MYGL_PROFILER 1
+#endif
+
+const int PROFILER_LATENCY = 3;     // frames in flight
+const int PROFILER_HISTORY = 240;   // frames kept for the graph
+
+struct ProfileScope
+{
+    const char *name;   // must outlive the profiler, normally a literal
+    int parent;         // index in the frame, -1 at the top
+    int depth;
+    double start, end;  // seconds since profiler_init
+    float gpuMs;        // < 0 when not measured
+};
+
+struct ProfileFrame
+{
+    double start, end;
+    float gpuMs;        // sum of the GPU scopes
+    std::vector<ProfileScope> scopes;   // in begin order, parents first
+};
+
+void profiler_init();
+
+void profiler_shutdown();
+
+extern bool g_profilerEnabled;
+
+inline bool profiler_enabled() { return g_profilerEnabled; }
+
+void profiler_set_enabled(bool enabled);
+
+// Closes the previous frame and opens the next. Call once per frame with
+// the GL context current.
+void profiler_begin_frame();
+
+// Returns a handle for profiler_end.
+int profiler_begin(const char *name, bool gpu);
+
+void profiler_end(int scope);
+
+// Newest frame with complete results; empty before the first one.
+const ProfileFrame& profiler_last_frame();
+
+// CPU and GPU milliseconds of the last PROFILER_HISTORY frames, oldest first.
+void profiler_history(std::vector<float> *cpuMs, std::vector<float> *gpuMs);
+
+// Records the next `frames` published frames and writes them to `path` as
+// Chrome trace_event JSON (chrome://tracing, Perfetto).
+void profiler_capture(int frames, const std::string &path);
+
+// Frames still to record, 0 when no capture is running.
+int profiler_capture_remaining();
+
+struct ProfilerScope
+{
+    int index;
+    ProfilerScope(const char *name, bool gpu = false) : index(profiler_enabled() ? profiler_begin(name, gpu) : -1) {}
+    ~ProfilerScope() { if (index >= 0) profiler_end(index); }
+};
+
+#define PROFILER_CONCAT_(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_(a, b)
+#if MYGL_PROFILER
+#define PROFILE_SCOPE(name) ProfilerScope PROFILER_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(name) ProfilerScope PROFILER_CONCAT(profileScope, __LINE__)(name, true)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_GPU_SCOPE(name) ((void)0)
+#endif
@@ -0,0 +1,48 @@
+#include "radixsort.h"
+
+#include <algorithm>
+
+void radixsort_u64(uint64_t *keys, uint32_t *values, size_t count,
+                   std::vector<uint64_t> *scratchKeys, std::vector<uint32_t> *scratchValues)
+{
+    if (count < 2) return;
+
+    // one histogram per byte, all gathered in a single read of the keys
+    size_t histogram[8][256] = {};
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t k = keys[i];
+        for (int b = 0; b < 8; ++b)
+            histogram[b][(k >> (b * 8)) & 0xff]++;
+    }
+
+    if (scratchKeys->size() < count) scratchKeys->resize(count);
+    if (scratchValues->size() < count) scratchValues->resize(count);
+
+    uint64_t *srcKeys = keys, *dstKeys = scratchKeys->data();
+    uint32_t *srcValues = values, *dstValues = scratchValues->data();
+
+    for (int b = 0; b < 8; ++b) {
+        size_t *h = histogram[b];
+        const int shift = b * 8;
+        if (h[(srcKeys[0] >> shift) & 0xff] == count) continue;   // all equal
+
+        size_t offset = 0;
+        for (int d = 0; d < 256; ++d) {
+            size_t n = h[d];
+            h[d] = offset;
+            offset += n;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            size_t slot = h[(srcKeys[i] >> shift) & 0xff]++;
+            dstKeys[slot] = srcKeys[i];
+            dstValues[slot] = srcValues[i];
+        }
+        std::swap(srcKeys, dstKeys);
+        std::swap(srcValues, dstValues);
+    }
+
+    if (srcKeys != keys) {
+        std::copy(srcKeys, srcKeys + count, keys);
+        std::copy(srcValues, srcValues + count, values);
+    }
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Stable LSD radix sort of 64-bit keys, carrying a 32-bit payload along.
+// Byte positions where every key agrees are skipped, so keys that only use
+// a few of their bits sort in a few passes. The scratch vectors are grown
+// as needed and can be kept around between calls.
+void radixsort_u64(uint64_t *keys, uint32_t *values, size_t count,
+                   std::vector<uint64_t> *scratchKeys, std::vector<uint32_t> *scratchValues);
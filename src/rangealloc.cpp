@@ -0,0 +1,97 @@
+#include "rangealloc.h"
+
+#include <iterator>
+
+static void add_free(RangeAllocator *alloc, uint32_t offset, uint32_t size) {
+    alloc->freeByOffset[offset] = size;
+    alloc->freeBySize.insert({ size, offset });
+}
+
+static void remove_free(RangeAllocator *alloc, std::map<uint32_t, uint32_t>::iterator it) {
+    alloc->freeBySize.erase({ it->second, it->first });
+    alloc->freeByOffset.erase(it);
+}
+
+// Takes `size` units at `offset` out of the free block starting at `block`.
+static void carve(RangeAllocator *alloc, std::map<uint32_t, uint32_t>::iterator block, uint32_t offset, uint32_t size) {
+    uint32_t start = block->first, end = block->first + block->second;
+    remove_free(alloc, block);
+    if (offset > start) add_free(alloc, start, offset - start);
+    if (offset + size < end) add_free(alloc, offset + size, end - offset - size);
+    alloc->used += size;
+}
+
+void rangealloc_init(RangeAllocator *alloc, uint32_t capacity)
+{
+    alloc->capacity = capacity;
+    alloc->used = 0;
+    alloc->freeByOffset.clear();
+    alloc->freeBySize.clear();
+    if (capacity) add_free(alloc, 0, capacity);
+}
+
+uint32_t rangealloc_alloc(RangeAllocator *alloc, uint32_t size)
+{
+    if (size == 0) return RANGE_NONE;
+    auto fit = alloc->freeBySize.lower_bound({ size, 0 });
+    if (fit == alloc->freeBySize.end()) return RANGE_NONE;
+    uint32_t offset = fit->second;
+    carve(alloc, alloc->freeByOffset.find(offset), offset, size);
+    return offset;
+}
+
+uint32_t rangealloc_alloc_below(RangeAllocator *alloc, uint32_t size, uint32_t limit)
+{
+    if (size == 0) return RANGE_NONE;
+    for (auto it = alloc->freeByOffset.begin(); it != alloc->freeByOffset.end() && it->first + size <= limit; ++it) {
+        if (it->second < size) continue;
+        uint32_t offset = it->first;
+        carve(alloc, it, offset, size);
+        return offset;
+    }
+    return RANGE_NONE;
+}
+
+void rangealloc_free(RangeAllocator *alloc, uint32_t offset, uint32_t size)
+{
+    if (size == 0) return;
+    alloc->used -= size;
+
+    // merge with the free blocks on either side
+    auto next = alloc->freeByOffset.lower_bound(offset);
+    if (next != alloc->freeByOffset.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            offset = prev->first;
+            size += prev->second;
+            remove_free(alloc, prev);
+        }
+    }
+    if (next != alloc->freeByOffset.end() && offset + size == next->first) {
+        size += next->second;
+        remove_free(alloc, next);
+    }
+    add_free(alloc, offset, size);
+}
+
+void rangealloc_grow(RangeAllocator *alloc, uint32_t capacity)
+{
+    if (capacity <= alloc->capacity) return;
+    uint32_t added = capacity - alloc->capacity;
+    uint32_t offset = alloc->capacity;
+    alloc->capacity = capacity;
+    alloc->used += added;   // rangealloc_free takes it back off
+    rangealloc_free(alloc, offset, added);
+}
+
+uint32_t rangealloc_largest_free(const RangeAllocator *alloc)
+{
+    return alloc->freeBySize.empty() ? 0 : alloc->freeBySize.rbegin()->first;
+}
+
+float rangealloc_fragmentation(const RangeAllocator *alloc)
+{
+    uint32_t free = alloc->capacity - alloc->used;
+    if (free == 0) return 0.0f;
+    return 1.0f - (float)rangealloc_largest_free(alloc) / (float)free;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <utility>
+
+// Best-fit allocator over a range of abstract units (vertices, index words)
+// inside one big buffer. Free blocks are kept both by offset, to merge
+// neighbours on free, and by (size, offset), so an allocation takes the
+// smallest block that fits, lowest first among equals. Nothing is stored in
+// the buffer itself.
+
+const uint32_t RANGE_NONE = 0xffffffffu;
+
+struct RangeAllocator
+{
+    uint32_t capacity;
+    uint32_t used;
+    std::map<uint32_t, uint32_t> freeByOffset;              // offset -> size
+    std::set<std::pair<uint32_t, uint32_t>> freeBySize;     // (size, offset)
+};
+
+void rangealloc_init(RangeAllocator *alloc, uint32_t capacity);
+
+// Offset of `size` free units, or RANGE_NONE.
+uint32_t rangealloc_alloc(RangeAllocator *alloc, uint32_t size);
+
+// Like rangealloc_alloc, but only from space ending at or before `limit`,
+// lowest offset first. Used to move allocations towards the start.
+uint32_t rangealloc_alloc_below(RangeAllocator *alloc, uint32_t size, uint32_t limit);
+
+void rangealloc_free(RangeAllocator *alloc, uint32_t offset, uint32_t size);
+
+// Adds free space at the end.
+void rangealloc_grow(RangeAllocator *alloc, uint32_t capacity);
+
+uint32_t rangealloc_largest_free(const RangeAllocator *alloc);
+
+inline size_t rangealloc_free_blocks(const RangeAllocator *alloc) { return alloc->freeByOffset.size(); }
+
+// 0 when the free space is one block, towards 1 the more it is split up.
+float rangealloc_fragmentation(const RangeAllocator *alloc);
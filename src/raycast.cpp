@@ -0,0 +1,149 @@
+#include "raycast.h"
+
+#include <cmath>
+
+// Moller-Trumbore; returns the hit distance or a negative value.
+static inline float ray_triangle(const glm::vec3 &origin, const glm::vec3 &dir,
+                                 const glm::vec3 &v0, const glm::vec3 &v1, const glm::vec3 &v2) {
+    const float EPSILON = 1e-12f;
+    glm::vec3 e1 = v1 - v0, e2 = v2 - v0;
+    glm::vec3 p = glm::cross(dir, e2);
+    float det = glm::dot(e1, p);
+    if (std::fabs(det) < EPSILON) return -1.0f;
+    float inv = 1.0f / det;
+    glm::vec3 s = origin - v0;
+    float u = glm::dot(s, p) * inv;
+    if (u < 0.0f || u > 1.0f) return -1.0f;
+    glm::vec3 q = glm::cross(s, e1);
+    float v = glm::dot(dir, q) * inv;
+    if (v < 0.0f || u + v > 1.0f) return -1.0f;
+    return glm::dot(e2, q) * inv;
+}
+
+static inline uint32_t read_index(const void *indices, int indexSize, size_t i) {
+    if (indexSize == 2) return ((const uint16_t*)indices)[i];
+    return ((const uint32_t*)indices)[i];
+}
+
+void meshbvh_build(MeshBvh *mesh, const float *positions, size_t stride,
+                   const void *indices, int indexSize, size_t indexCount)
+{
+    const size_t triCount = indexCount / 3;
+    const char *base = (const char*)positions;
+    auto corner = [&](size_t i) {
+        const float *p = (const float*)(base + read_index(indices, indexSize, i) * stride);
+        return glm::vec3(p[0], p[1], p[2]);
+    };
+
+    std::vector<BvhBox> boxes(triCount);
+    for (size_t t = 0; t < triCount; ++t) {
+        glm::vec3 a = corner(3 * t), b = corner(3 * t + 1), c = corner(3 * t + 2);
+        boxes[t].min = glm::min(glm::min(a, b), c);
+        boxes[t].max = glm::max(glm::max(a, b), c);
+    }
+    bvh_build(&mesh->bvh, boxes.data(), triCount);
+
+    // store triangles in leaf order so a leaf reads one contiguous run
+    mesh->triangles.resize(3 * triCount);
+    mesh->triangleIds.resize(triCount);
+    for (size_t k = 0; k < triCount; ++k) {
+        uint32_t t = mesh->bvh.prims[k];
+        mesh->triangleIds[k] = t;
+        for (int c = 0; c < 3; ++c)
+            mesh->triangles[3 * k + c] = corner(3 * (size_t)t + c);
+        mesh->bvh.prims[k] = (uint32_t)k;
+    }
+}
+
+bool meshbvh_build_asset(MeshBvh *mesh, const MeshAsset *asset)
+{
+    const MeshFileHeader *h = asset->header;
+    if (h->vertexFormat == MESH_VERTEX_PACKED) {
+        // decoded exactly as the GPU does, so picks match what is drawn
+        std::vector<float> positions(3 * (size_t)h->vertexCount);
+        const PackedVertex *packed = (const PackedVertex*)asset->vertexData;
+        for (uint32_t i = 0; i < h->vertexCount; ++i)
+            vertexpack_position(&packed[i], &h->bounds, &positions[3 * (size_t)i]);
+        meshbvh_build(mesh, positions.data(), 3 * sizeof(float), asset->indexData, (int)h->indexSize, h->lods[0].indexCount);
+        return true;
+    }
+    for (uint32_t i = 0; i < h->attribCount; ++i) {
+        const MeshFileAttrib &a = h->attribs[i];
+        if (a.location != 0 || a.format != MESH_ATTRIB_FLOAT32 || a.components < 3) continue;
+        const float *positions = (const float*)((const char*)asset->vertexData + a.offset);
+        // full detail only; the LODs follow it in the index buffer
+        meshbvh_build(mesh, positions, h->vertexStride, asset->indexData, (int)h->indexSize, h->lods[0].indexCount);
+        return true;
+    }
+    return false;
+}
+
+bool meshbvh_raycast(const MeshBvh *mesh, const glm::vec3 &origin, const glm::vec3 &dir, RayHit *hit)
+{
+    bool found = false;
+    const glm::vec3 *tri = mesh->triangles.data();
+    bvh_raycast(&mesh->bvh, origin, dir, &hit->t, [&](const uint32_t *prims, uint32_t count, float *tMax) {
+        for (uint32_t i = 0; i < count; ++i) {
+            uint32_t k = prims[i];
+            float t = ray_triangle(origin, dir, tri[3 * k], tri[3 * k + 1], tri[3 * k + 2]);
+            if (t >= 0.0f && t < *tMax) {
+                *tMax = t;
+                hit->triangle = mesh->triangleIds[k];
+                found = true;
+            }
+        }
+    });
+    return found;
+}
+
+// World box of a local box (Arvo).
+static BvhBox transform_box(const BvhBox &b, const glm::mat4 &m) {
+    glm::vec3 c = 0.5f * (b.min + b.max), e = 0.5f * (b.max - b.min);
+    glm::vec3 wc = glm::vec3(m * glm::vec4(c, 1.0f));
+    glm::vec3 we(0.0f);
+    for (int col = 0; col < 3; ++col)
+        we += glm::abs(glm::vec3(m[col])) * e[col];
+    return BvhBox{ wc - we, wc + we };
+}
+
+static void instance_boxes(const SceneBvh *scene, std::vector<BvhBox> *boxes) {
+    boxes->resize(scene->instances.size());
+    for (size_t i = 0; i < scene->instances.size(); ++i)
+        (*boxes)[i] = transform_box(bvh_bounds(&scene->instances[i].mesh->bvh), scene->instances[i].world);
+}
+
+void scenebvh_build(SceneBvh *scene)
+{
+    std::vector<BvhBox> boxes;
+    instance_boxes(scene, &boxes);
+    bvh_build(&scene->top, boxes.data(), boxes.size(), 1);
+}
+
+void scenebvh_refit(SceneBvh *scene)
+{
+    std::vector<BvhBox> boxes;
+    instance_boxes(scene, &boxes);
+    bvh_refit(&scene->top, boxes.data());
+}
+
+bool scenebvh_raycast(const SceneBvh *scene, const glm::vec3 &origin, const glm::vec3 &dir, RayHit *hit)
+{
+    bool found = false;
+    bvh_raycast(&scene->top, origin, dir, &hit->t, [&](const uint32_t *prims, uint32_t count, float *tMax) {
+        for (uint32_t i = 0; i < count; ++i) {
+            const BvhInstance &inst = scene->instances[prims[i]];
+            // in local space with an unnormalized direction t stays the world t
+            glm::vec3 o = glm::vec3(inst.invWorld * glm::vec4(origin, 1.0f));
+            glm::vec3 d = glm::vec3(inst.invWorld * glm::vec4(dir, 0.0f));
+            RayHit local;
+            local.t = *tMax;
+            if (meshbvh_raycast(inst.mesh, o, d, &local)) {
+                *tMax = local.t;
+                hit->instance = inst.userId;
+                hit->triangle = local.triangle;
+                found = true;
+            }
+        }
+    });
+    return found;
+}
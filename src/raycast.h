@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "bvh.h"
+#include "meshcache.h"
+
+// Ray casts against triangle meshes through a two-level BVH: a triangle
+// BVH per mesh, built once when the mesh is loaded, and a top level over
+// the world bounds of the instances placing those meshes.
+
+struct MeshBvh
+{
+    Bvh bvh;                            // prims index `triangles` directly
+    std::vector<glm::vec3> triangles;   // 3 corners per triangle, in tree order
+    std::vector<uint32_t> triangleIds;  // source triangle of each, in tree order
+};
+
+struct RayHit
+{
+    float t;             // distance along the ray, in units of its direction
+    uint32_t instance;   // userId of the instance hit
+    uint32_t triangle;   // source triangle index in that mesh
+};
+
+// Builds from an indexed position stream; `stride` is in bytes.
+void meshbvh_build(MeshBvh *mesh, const float *positions, size_t stride,
+                   const void *indices, int indexSize, size_t indexCount);
+
+// Builds from a cooked mesh, float or packed. Returns false if it has no
+// positions.
+bool meshbvh_build_asset(MeshBvh *mesh, const MeshAsset *asset);
+
+// Closest hit with t < hit->t; hit->t must be initialized to the maximum
+// distance. Fills t and triangle on a hit.
+bool meshbvh_raycast(const MeshBvh *mesh, const glm::vec3 &origin, const glm::vec3 &dir, RayHit *hit);
+
+struct BvhInstance
+{
+    const MeshBvh *mesh;
+    glm::mat4 world;
+    glm::mat4 invWorld;
+    uint32_t userId;
+};
+
+struct SceneBvh
+{
+    std::vector<BvhInstance> instances;   // filled by the caller
+    Bvh top;
+};
+
+// Builds the top level over the instances' world bounds.
+void scenebvh_build(SceneBvh *scene);
+
+// Updates the top level for new instance matrices, with the same instances.
+void scenebvh_refit(SceneBvh *scene);
+
+// Closest hit over every instance, as meshbvh_raycast.
+bool scenebvh_raycast(const SceneBvh *scene, const glm::vec3 &origin, const glm::vec3 &dir, RayHit *hit);
@@ -0,0 +1,431 @@
+#include "renderqueue.h"
+#include "jobsystem.h"
+#include "scene.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+
+#include <glm/gtc/type_ptr.hpp>
+
+static const size_t INITIAL_DRAW_CAPACITY = 1024;
+
+// The program an object is drawn with on this path.
+static const ShaderProgram* effective_program(const RenderQueue *queue, const RenderObj *obj) {
+    if (queue->multiDraw && obj->program->multiDraw)
+        return obj->program->multiDraw;
+    if (!queue->multiDraw && obj->program->instanced)
+        return obj->program->instanced;
+    return obj->program;
+}
+
+// Meshes share their arena's vertex array, but 16 and 32 bit index lists
+// can't go out in one multi-draw.
+static GLuint draw_state(const GpuMesh *mesh) {
+    return mesh->vao << 1 | (mesh->indexType == GL_UNSIGNED_INT);
+}
+
+static const MeshLod& object_lod(const GpuMesh *mesh, const RenderObj *obj) {
+    return mesh->lods[std::min(obj->lod, mesh->lodCount - 1)];
+}
+
+static size_t index_size(const GpuMesh *mesh) {
+    return mesh->indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+}
+
+// First index of a LOD in the arena's index buffer, in indices.
+static uint32_t lod_first_index(const GeometryRange &range, const GpuMesh *mesh, const MeshLod &lod) {
+    return (uint32_t)(range.indexOffset * 4 / index_size(mesh)) + lod.firstIndex;
+}
+
+static void* lod_offset(const GeometryRange &range, const GpuMesh *mesh, const MeshLod &lod) {
+    return (void*)(uintptr_t)(lod_first_index(range, mesh, lod) * index_size(mesh));
+}
+
+// Sorted items i and j can go out in one draw. The key keeps only 13 bits
+// of the mesh id, so past 8192 meshes two can share key bits; they then
+// sort together but are still drawn apart.
+static bool same_draw(const RenderQueue *queue, const Scene *scene, size_t i, size_t j) {
+    return frameprep_same_mesh(queue->prep.keys[i], queue->prep.keys[j]) &&
+           scene->renderObjs[queue->prep.items[i]].mesh == scene->renderObjs[queue->prep.items[j]].mesh;
+}
+
+// Grows `buffer` to hold at least `needed` elements, discarding its contents.
+static void reserve_buffer(GLenum target, GLuint buffer, size_t *capacity, size_t needed, size_t elementSize) {
+    if (needed <= *capacity) return;
+    size_t n = *capacity ? *capacity : INITIAL_DRAW_CAPACITY;
+    while (n < needed) n *= 2;
+    glBindBuffer(target, buffer);
+    glBufferData(target, (GLsizeiptr)(n * elementSize), nullptr, GL_STREAM_DRAW);
+    *capacity = n;
+}
+
+static void reserve_draw_ids(RenderQueue *queue, size_t needed) {
+    if (needed <= queue->drawIdCapacity) return;
+    size_t n = queue->drawIdCapacity ? queue->drawIdCapacity : INITIAL_DRAW_CAPACITY;
+    while (n < needed) n *= 2;
+
+    // The same buffer name is respecified, so vertex arrays already
+    // pointing at it pick up the larger contents.
+    std::vector<GLuint> ids(n);
+    for (size_t i = 0; i < n; ++i) ids[i] = (GLuint)i;
+    glBindBuffer(GL_ARRAY_BUFFER, queue->drawIdBuffer);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(n * sizeof(GLuint)), ids.data(), GL_STATIC_DRAW);
+    queue->drawIdCapacity = n;
+}
+
+// Points the instance attributes of the bound vertex array at `first`.
+static void point_instance_attribs(size_t first) {
+    const GLsizei stride = sizeof(ObjectGPUData);
+    const size_t base = first * sizeof(ObjectGPUData);
+    for (GLuint c = 0; c < 4; ++c)
+        glVertexAttribPointer(INSTANCE_MODEL_LOCATION + c, 4, GL_FLOAT, GL_FALSE, stride,
+                              (void*)(base + offsetof(ObjectGPUData, model) + c * sizeof(glm::vec4)));
+    for (GLuint c = 0; c < 3; ++c)
+        glVertexAttribPointer(INSTANCE_NORMAL_LOCATION + c, 3, GL_FLOAT, GL_FALSE, stride,
+                              (void*)(base + offsetof(ObjectGPUData, normalMatrix) + c * sizeof(glm::vec4)));
+    glVertexAttribPointer(INSTANCE_COLOR_LOCATION, 4, GL_FLOAT, GL_FALSE, stride,
+                          (void*)(base + offsetof(ObjectGPUData, color)));
+}
+
+void renderqueue_init(RenderQueue *queue, bool multiDraw)
+{
+    queue->multiDraw = multiDraw;
+    queue->objectBuffer = 0;
+    queue->indirectBuffer = 0;
+    queue->drawIdBuffer = 0;
+    queue->objectCapacity = 0;
+    queue->indirectCapacity = 0;
+    queue->drawIdCapacity = 0;
+    queue->stats = RenderQueueStats{};
+    queue->cullStats = CullStats{};
+    queue->buildSeconds = 0.0;
+    queue->occlusionCulling = true;
+    queue->maxOccluders = 32;
+    occlusion_init(&queue->occlusion, OCCLUSION_WIDTH, OCCLUSION_HEIGHT);
+
+    glGenBuffers(1, &queue->objectBuffer);
+    reserve_buffer(GL_ARRAY_BUFFER, queue->objectBuffer, &queue->objectCapacity, INITIAL_DRAW_CAPACITY, sizeof(ObjectGPUData));
+    if (!multiDraw) return;
+
+    glGenBuffers(1, &queue->indirectBuffer);
+    glGenBuffers(1, &queue->drawIdBuffer);
+    reserve_draw_ids(queue, INITIAL_DRAW_CAPACITY);
+}
+
+void renderqueue_destroy(RenderQueue *queue)
+{
+    glDeleteBuffers(1, &queue->objectBuffer);
+    glDeleteBuffers(1, &queue->indirectBuffer);
+    glDeleteBuffers(1, &queue->drawIdBuffer);
+    queue->objectBuffer = queue->indirectBuffer = queue->drawIdBuffer = 0;
+    occlusion_destroy(&queue->occlusion);
+}
+
+void renderqueue_setup_vao(RenderQueue *queue)
+{
+    if (queue->multiDraw) {
+        glBindBuffer(GL_ARRAY_BUFFER, queue->drawIdBuffer);
+        glVertexAttribIPointer(DRAW_ID_LOCATION, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+        glVertexAttribDivisor(DRAW_ID_LOCATION, 1);
+        glEnableVertexAttribArray(DRAW_ID_LOCATION);
+        return;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, queue->objectBuffer);
+    point_instance_attribs(0);
+    for (GLuint loc = INSTANCE_MODEL_LOCATION; loc < INSTANCE_NORMAL_LOCATION + 3; ++loc) {
+        glVertexAttribDivisor(loc, 1);
+        glEnableVertexAttribArray(loc);
+    }
+}
+
+static CullBounds mesh_cull_bounds(const MeshBounds &b) {
+    CullBounds cb;
+    cb.center = glm::vec4(0.5f * (b.min[0] + b.max[0]), 0.5f * (b.min[1] + b.max[1]), 0.5f * (b.min[2] + b.max[2]), b.radius);
+    cb.extent = glm::vec4(0.5f * (b.max[0] - b.min[0]), 0.5f * (b.max[1] - b.min[1]), 0.5f * (b.max[2] - b.min[2]), 0.0f);
+    return cb;
+}
+
+// Rasterizes the visible objects that look largest from `eye` as occluders,
+// then drops every visible object hidden behind them.
+static void occlusion_cull(RenderQueue *queue, Scene *scene, const glm::mat4 &viewProj, const glm::vec3 &eye) {
+    OcclusionBuffer *buffer = &queue->occlusion;
+    const CullScratch &world = queue->prep.cullScratch;   // world bounds from the frustum pass
+
+    queue->occluderRank.clear();
+    for (uint32_t v : queue->prep.visible) {
+        glm::vec3 d = glm::vec3(world.cx[v], world.cy[v], world.cz[v]) - eye;
+        float size = world.radius[v] / std::sqrt(std::max(glm::dot(d, d), 1e-6f));
+        if (size < OCCLUDER_MIN_SIZE) continue;
+        uint32_t bits;
+        std::memcpy(&bits, &size, sizeof(bits));   // positive floats order as integers
+        queue->occluderRank.push_back((uint64_t)bits << 32 | v);
+    }
+    std::sort(queue->occluderRank.begin(), queue->occluderRank.end(), std::greater<uint64_t>());
+
+    queue->occluders.clear();
+    size_t triangles = 0;
+    for (uint64_t rank : queue->occluderRank) {
+        if ((int)queue->occluders.size() >= queue->maxOccluders) break;
+        uint32_t v = (uint32_t)rank;
+        const RenderObj *obj = &scene->renderObjs[queue->prep.candidates[v]];
+        const MeshBvh &geometry = meshregistry_get(&scene->meshes, obj->mesh)->bvh;
+        size_t count = geometry.triangleIds.size();
+        if (count == 0 || triangles + count > OCCLUDER_TRIANGLE_BUDGET) continue;
+        triangles += count;
+        queue->occluders.push_back(Occluder{ geometry.triangles.data(), count, queue->prep.cullModels[v] });
+    }
+    occlusion_render(buffer, viewProj, queue->occluders.data(), queue->occluders.size());
+
+    auto testStart = std::chrono::steady_clock::now();
+    size_t kept = 0;
+    for (uint32_t v : queue->prep.visible)
+        if (occlusion_test(buffer, queue->prep.cullBounds[v], *queue->prep.cullModels[v]))
+            queue->prep.visible[kept++] = v;
+    buffer->stats.tested = (int)queue->prep.visible.size();
+    buffer->stats.occluded = (int)(queue->prep.visible.size() - kept);
+    buffer->stats.testSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - testStart).count();
+    queue->prep.visible.resize(kept);
+}
+
+static bool resident(Scene *scene, const RenderObj *obj) {
+    return obj->mesh != MESH_NONE && meshregistry_resident(meshregistry_get(&scene->meshes, obj->mesh));
+}
+
+// Culling and drawing input for every resident object, in object order.
+static void gather_candidates(RenderQueue *queue, Scene *scene) {
+    FramePrep *prep = &queue->prep;
+    frameprep_gather(prep, &scene->jobs, scene->renderObjs.size(), [&](size_t begin, size_t end) {
+        uint32_t n = 0;
+        for (size_t i = begin; i < end; ++i)
+            n += resident(scene, &scene->renderObjs[i]);
+        return n;
+    }, [&](size_t begin, size_t end, size_t k) {
+        for (size_t i = begin; i < end; ++i) {
+            RenderObj *obj = &scene->renderObjs[i];
+            if (!resident(scene, obj)) continue;
+            const GpuMesh *mesh = meshregistry_get(&scene->meshes, obj->mesh);
+            prep->candidates[k] = (uint32_t)i;
+            prep->cullBounds[k] = mesh_cull_bounds(mesh->bounds);
+            prep->cullModels[k] = &transforms_world(&scene->transforms, obj->node);
+            PrepDraw &draw = prep->draws[k];
+            draw.node = obj->node;
+            draw.state = (effective_program(queue, obj)->id & 0xffff) << 16 | (draw_state(mesh) & 0xffff);
+            draw.mesh = obj->mesh;
+            draw.lods = mesh->lods;
+            draw.lodCount = mesh->lodCount;
+            // packed positions are relative to the mesh box
+            draw.dequantize = mesh->vertexFormat == MESH_VERTEX_PACKED ? &mesh->dequantize : nullptr;
+            draw.color = obj->color;
+            draw.lodErrorPixels = obj->lodErrorPixels;
+            draw.lodHysteresis = obj->lodHysteresis;
+            draw.lodForce = obj->lodForce;
+            draw.lod = &obj->lod;
+            ++k;
+        }
+    });
+}
+
+void renderqueue_build(RenderQueue *queue, Scene *scene, const glm::mat4 &view, const glm::mat4 &proj, int viewportHeight)
+{
+    auto cullStart = std::chrono::steady_clock::now();
+    FramePrep *prep = &queue->prep;
+    gather_candidates(queue, scene);
+
+    Frustum frustum;
+    frustum_from_matrix(&frustum, proj * view);
+    frameprep_cull(prep, &scene->jobs, &frustum);
+
+    queue->cullStats.tested = (int)prep->candidates.size();
+    queue->cullStats.visible = (int)prep->visible.size();
+    queue->cullStats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - cullStart).count();
+
+    if (queue->occlusionCulling)
+        occlusion_cull(queue, scene, proj * view, glm::vec3(glm::inverse(view)[3]));
+    else
+        queue->occlusion.stats = OcclusionStats{};
+
+    frameprep_keys(prep, &scene->jobs, view, proj, viewportHeight, scene->orbitCamera.nearClip, scene->orbitCamera.farClip);
+    frameprep_sort(prep, &scene->jobs);
+    queue->buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - cullStart).count();
+}
+
+// Matrix the vertex shader gets: packed positions are relative to the mesh
+// box, which is applied before the object's own transform.
+static glm::mat4 draw_model(const TransformHierarchy *transforms, const RenderObj *obj, const GpuMesh *mesh) {
+    const glm::mat4 &world = transforms_world(transforms, obj->node);
+    return mesh->vertexFormat == MESH_VERTEX_PACKED ? world * mesh->dequantize : world;
+}
+
+// Per-object data in sorted order; draw/instance i reads element i. The
+// workers write into the mapped buffer; the old contents are orphaned so
+// mapping does not wait for draws still reading them.
+static void upload_object_data(RenderQueue *queue, Scene *scene, GLenum target) {
+    auto fillStart = std::chrono::steady_clock::now();
+    const size_t count = queue->prep.items.size();
+    const GLsizeiptr bytes = (GLsizeiptr)(count * sizeof(ObjectGPUData));
+    reserve_buffer(target, queue->objectBuffer, &queue->objectCapacity, count, sizeof(ObjectGPUData));
+    glBindBuffer(target, queue->objectBuffer);
+    void *mapped = glMapBufferRange(target, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (mapped) {
+        frameprep_fill(&queue->prep, &scene->jobs, &scene->transforms, static_cast<ObjectGPUData*>(mapped));
+        if (glUnmapBuffer(target) == GL_TRUE) {
+            queue->stats.fillSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - fillStart).count();
+            return;
+        }
+        // the contents were lost while mapped; write them again below
+    }
+    queue->objectData.resize(count);
+    frameprep_fill(&queue->prep, &scene->jobs, &scene->transforms, queue->objectData.data());
+    glBufferSubData(target, 0, bytes, queue->objectData.data());
+    queue->stats.fillSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - fillStart).count();
+}
+
+static void draw_single(RenderQueue *queue, Scene *scene, const RenderObj *obj,
+                        const GpuMesh *mesh, const ShaderProgram *program) {
+    const TransformHierarchy *transforms = &scene->transforms;
+    glUniformMatrix4fv(program->uniforms[UNIFORM_MODEL], 1, GL_FALSE, glm::value_ptr(draw_model(transforms, obj, mesh)));
+    glUniformMatrix3fv(program->uniforms[UNIFORM_NORMAL_MATRIX], 1, GL_FALSE, glm::value_ptr(transforms_normal(transforms, obj->node)));
+    glUniform3fv(program->uniforms[UNIFORM_OBJECT_COLOR], 1, glm::value_ptr(obj->color));
+    const MeshLod &lod = object_lod(mesh, obj);
+    const GeometryRange &range = meshregistry_range(&scene->meshes, mesh);
+    glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)lod.indexCount, mesh->indexType, lod_offset(range, mesh, lod),
+                             (GLint)range.vertexOffset);
+    queue->stats.draws++;
+    queue->stats.triangles += lod.indexCount / 3;
+}
+
+static void submit_instanced(RenderQueue *queue, Scene *scene) {
+    const size_t count = queue->prep.items.size();
+    upload_object_data(queue, scene, GL_ARRAY_BUFFER);
+
+    GLuint boundProgram = 0, boundVao = 0;
+    size_t i = 0;
+    while (i < count) {
+        const RenderObj *obj = &scene->renderObjs[queue->prep.items[i]];
+        const GpuMesh *mesh = meshregistry_get(&scene->meshes, obj->mesh);
+        const ShaderProgram *program = effective_program(queue, obj);
+        if (boundProgram != program->id) {
+            glUseProgram(program->id);
+            boundProgram = program->id;
+        }
+        if (boundVao != mesh->vao) {
+            glBindVertexArray(mesh->vao);
+            boundVao = mesh->vao;
+        }
+
+        if (program == obj->program) {
+            // no instanced variant for this material
+            draw_single(queue, scene, obj, mesh, program);
+            ++i;
+            continue;
+        }
+
+        size_t end = i + 1;
+        while (end < count && same_draw(queue, scene, end, i))
+            ++end;
+
+        // no baseInstance before 4.2, so move the attributes instead
+        point_instance_attribs(i);
+        const MeshLod &lod = object_lod(mesh, obj);
+        const GeometryRange &range = meshregistry_range(&scene->meshes, mesh);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, (GLsizei)lod.indexCount, mesh->indexType, lod_offset(range, mesh, lod),
+                                          (GLsizei)(end - i), (GLint)range.vertexOffset);
+        queue->stats.draws++;
+        queue->stats.triangles += (int64_t)(lod.indexCount / 3) * (int64_t)(end - i);
+        if (end - i > 1) queue->stats.instanced += (int)(end - i);
+        i = end;
+    }
+}
+
+static void submit_multi_draw(RenderQueue *queue, Scene *scene) {
+    const size_t count = queue->prep.items.size();
+    upload_object_data(queue, scene, GL_SHADER_STORAGE_BUFFER);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_DATA_BINDING, queue->objectBuffer);
+
+    // one command per run of a mesh
+    queue->commands.clear();
+    std::vector<uint32_t> &commandStart = queue->commandStart;
+    commandStart.clear();
+    for (size_t i = 0; i < count;) {
+        const RenderObj *obj = &scene->renderObjs[queue->prep.items[i]];
+        const GpuMesh *mesh = meshregistry_get(&scene->meshes, obj->mesh);
+        size_t end = i + 1;
+        while (end < count && same_draw(queue, scene, end, i))
+            ++end;
+
+        const MeshLod &lod = object_lod(mesh, obj);
+        const GeometryRange &range = meshregistry_range(&scene->meshes, mesh);
+        DrawElementsIndirectCommand cmd;
+        cmd.count = lod.indexCount;
+        cmd.instanceCount = (GLuint)(end - i);
+        cmd.firstIndex = lod_first_index(range, mesh, lod);
+        cmd.baseVertex = (GLint)range.vertexOffset;
+        cmd.baseInstance = (GLuint)i;
+        queue->commands.push_back(cmd);
+        commandStart.push_back((uint32_t)i);
+        i = end;
+    }
+
+    const size_t commandCount = queue->commands.size();
+    reserve_draw_ids(queue, count);
+    reserve_buffer(GL_DRAW_INDIRECT_BUFFER, queue->indirectBuffer, &queue->indirectCapacity, commandCount, sizeof(DrawElementsIndirectCommand));
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, queue->indirectBuffer);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, (GLsizeiptr)(commandCount * sizeof(DrawElementsIndirectCommand)), queue->commands.data());
+
+    GLuint boundProgram = 0;
+    size_t k = 0;
+    while (k < commandCount) {
+        const uint64_t key = queue->prep.keys[commandStart[k]];
+        const RenderObj *obj = &scene->renderObjs[queue->prep.items[commandStart[k]]];
+        const GpuMesh *mesh = meshregistry_get(&scene->meshes, obj->mesh);
+        const ShaderProgram *program = effective_program(queue, obj);
+        if (boundProgram != program->id) {
+            glUseProgram(program->id);
+            boundProgram = program->id;
+        }
+        glBindVertexArray(mesh->vao);
+
+        if (program == obj->program) {
+            // no multi-draw variant for this material
+            size_t end = k + 1 < commandCount ? commandStart[k + 1] : count;
+            for (size_t i = commandStart[k]; i < end; ++i)
+                draw_single(queue, scene, &scene->renderObjs[queue->prep.items[i]], mesh, program);
+            ++k;
+            continue;
+        }
+
+        size_t end = k + 1;
+        while (end < commandCount && frameprep_same_state(queue->prep.keys[commandStart[end]], key))
+            ++end;
+
+        glMultiDrawElementsIndirect(GL_TRIANGLES, mesh->indexType,
+                                    (void*)(k * sizeof(DrawElementsIndirectCommand)), (GLsizei)(end - k), 0);
+        queue->stats.draws++;
+        queue->stats.multiDraws++;
+        for (size_t c = k; c < end; ++c) {
+            const DrawElementsIndirectCommand &cmd = queue->commands[c];
+            if (cmd.instanceCount > 1) queue->stats.instanced += (int)cmd.instanceCount;
+            queue->stats.triangles += (int64_t)(cmd.count / 3) * cmd.instanceCount;
+        }
+        k = end;
+    }
+}
+
+void renderqueue_submit(RenderQueue *queue, Scene *scene)
+{
+    queue->stats = RenderQueueStats{};
+    queue->stats.objects = (int)queue->prep.items.size();
+    if (queue->prep.items.empty()) return;
+
+    for (uint32_t i : queue->prep.items)
+        queue->stats.lodObjects[std::min(scene->renderObjs[i].lod, MESH_MAX_LODS - 1)]++;
+
+    if (queue->multiDraw)
+        submit_multi_draw(queue, scene);
+    else
+        submit_instanced(queue, scene);
+}
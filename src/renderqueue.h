@@ -0,0 +1,104 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "culling.h"
+#include "frameprep.h"
+#include "mesh.h"
+#include "occlusion.h"
+
+struct Scene;
+
+// Objects outside the view frustum are culled first, then those hidden
+// behind the largest visible objects (see occlusion.h); each survivor
+// becomes a 64-bit sort key (see frameprep_key in frameprep.h) so that
+// sorting groups draws by program and by the arena vertex array of the mesh
+// (see geometryarena.h), objects drawing the same LOD of a mesh end up next
+// to each other, and each group is front to back. A run of objects sharing
+// a mesh is one instanced draw, offset into the arena by base vertex and
+// first index. With GL 4.3 those draws are indirect commands and runs
+// sharing program and geometry go out with one glMultiDrawElementsIndirect;
+// per-object data comes from an SSBO indexed by a per-instance draw id. On
+// 3.3 the same data is an instance buffer.
+
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+const GLuint OBJECT_DATA_BINDING = 0;   // SSBO binding point
+const GLuint DRAW_ID_LOCATION = 2;      // per-instance attribute locations
+const GLuint INSTANCE_MODEL_LOCATION = 3;   // 3..6, one per matrix column
+const GLuint INSTANCE_COLOR_LOCATION = 7;
+const GLuint INSTANCE_NORMAL_LOCATION = 8;  // 8..10
+
+const int OCCLUSION_WIDTH = 256;    // occlusion buffer size in pixels
+const int OCCLUSION_HEIGHT = 144;
+const size_t OCCLUDER_TRIANGLE_BUDGET = 100000;
+const float OCCLUDER_MIN_SIZE = 0.1f;   // bounding radius over distance
+
+struct RenderQueueStats
+{
+    int objects;      // drawable objects queued
+    int draws;        // GL draw calls issued
+    int multiDraws;   // of which multi-draw indirect
+    int instanced;    // objects drawn as part of a multi-instance draw
+    int64_t triangles;                // submitted
+    int lodObjects[MESH_MAX_LODS];    // objects drawn at each LOD
+    double fillSeconds;               // per-object data written to the buffer
+};
+
+struct RenderQueue
+{
+    bool multiDraw;   // GL 4.3 path
+
+    FramePrep prep;   // candidates through sorted keys, see frameprep.h
+    CullStats cullStats;
+
+    bool occlusionCulling;
+    int maxOccluders;
+    OcclusionBuffer occlusion;
+    std::vector<Occluder> occluders;
+    std::vector<uint64_t> occluderRank;   // size bits over candidate index
+    double buildSeconds;   // renderqueue_build, culling through sorting
+
+    std::vector<ObjectGPUData> objectData;
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<uint32_t> commandStart;   // first sorted item of each command
+    GLuint objectBuffer;     // SSBO on the multi-draw path, instance buffer otherwise
+    GLuint indirectBuffer;
+    GLuint drawIdBuffer;
+    size_t objectCapacity;
+    size_t indirectCapacity;
+    size_t drawIdCapacity;
+
+    RenderQueueStats stats;
+};
+
+void renderqueue_init(RenderQueue *queue, bool multiDraw);
+
+void renderqueue_destroy(RenderQueue *queue);
+
+// Adds the per-instance attributes to the currently bound vertex array.
+// Every vertex array drawn through the queue needs them.
+void renderqueue_setup_vao(RenderQueue *queue);
+
+// Culls the scene against the camera, picks each visible object's LOD for a
+// viewport `viewportHeight` pixels tall, and builds and sorts the keys.
+// Gathering, frustum culling, LOD selection and key generation run in
+// slices on the scene's job system; results do not depend on the number of
+// threads.
+void renderqueue_build(RenderQueue *queue, Scene *scene, const glm::mat4 &view, const glm::mat4 &proj, int viewportHeight);
+
+// Issues the draws. The FrameData block must already be up to date.
+// Per-object data is written straight into the mapped buffer by the job
+// system; only GL calls are made on the calling thread.
+void renderqueue_submit(RenderQueue *queue, Scene *scene);
@@ -0,0 +1,194 @@
+#include "rtpool.h"
+
+#include <algorithm>
+#include <iostream>
+
+struct TargetFormat
+{
+    GLenum format, type;   // pixel transfer pair for glTexImage2D
+    GLenum attachment;
+    int bytes;             // per sample
+    bool filtered;         // linear filtering makes sense
+};
+
+static TargetFormat target_format(GLenum internal) {
+    switch (internal) {
+    case GL_DEPTH24_STENCIL8:   return { GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, GL_DEPTH_STENCIL_ATTACHMENT, 4, false };
+    case GL_DEPTH_COMPONENT32F: return { GL_DEPTH_COMPONENT, GL_FLOAT, GL_DEPTH_ATTACHMENT, 4, false };
+    case GL_R32UI:              return { GL_RED_INTEGER, GL_UNSIGNED_INT, GL_COLOR_ATTACHMENT0, 4, false };
+    case GL_RGBA16F:            return { GL_RGBA, GL_HALF_FLOAT, GL_COLOR_ATTACHMENT0, 8, true };
+    case GL_RGBA8:
+    default:                    return { GL_RGBA, GL_UNSIGNED_BYTE, GL_COLOR_ATTACHMENT0, 4, true };
+    }
+}
+
+static int bucket(int v) {
+    return (v + RTPOOL_GRANULARITY - 1) / RTPOOL_GRANULARITY * RTPOOL_GRANULARITY;
+}
+
+static bool size_fits(const RenderTarget &t, int w, int h) {
+    return t.width >= w && t.height >= h &&
+           (int64_t)t.width * t.height <= (int64_t)RTPOOL_MAX_WASTE * bucket(w) * bucket(h);
+}
+
+static void delete_target(RenderTargetPool *pool, RenderTargetId id) {
+    RenderTarget &t = pool->targets[id];
+    auto &fbs = pool->framebuffers;
+    for (size_t i = 0; i < fbs.size();) {
+        if (fbs[i].color == id || fbs[i].depth == id) {
+            glDeleteFramebuffers(1, &fbs[i].fbo);
+            fbs[i] = fbs.back();
+            fbs.pop_back();
+        } else {
+            ++i;
+        }
+    }
+    glDeleteTextures(1, &t.texture);
+    pool->stats.targets--;
+    pool->stats.bytes -= t.bytes;
+    pool->stats.frees++;
+    t = RenderTarget{};
+    pool->freeSlots.push_back(id);
+}
+
+void rtpool_init(RenderTargetPool *pool)
+{
+    pool->targets.clear();
+    pool->freeSlots.clear();
+    pool->framebuffers.clear();
+    pool->frame = 0;
+    pool->stats = RenderTargetPoolStats{};
+}
+
+void rtpool_destroy(RenderTargetPool *pool)
+{
+    for (RenderTargetId id = 0; id < (RenderTargetId)pool->targets.size(); ++id)
+        if (pool->targets[id].texture) delete_target(pool, id);
+    rtpool_init(pool);
+}
+
+void rtpool_begin_frame(RenderTargetPool *pool)
+{
+    pool->frame++;
+    pool->stats.frameAllocations = 0;
+    for (RenderTargetId id = 0; id < (RenderTargetId)pool->targets.size(); ++id) {
+        const RenderTarget &t = pool->targets[id];
+        if (t.texture && !t.inUse && pool->frame - t.lastUsed > (uint32_t)RTPOOL_IDLE_FRAMES)
+            delete_target(pool, id);
+    }
+}
+
+RenderTargetId rtpool_acquire(RenderTargetPool *pool, GLenum format, int w, int h, int samples)
+{
+    w = std::max(w, 1);
+    h = std::max(h, 1);
+    samples = std::max(samples, 1);
+
+    // smallest waiting target that fits
+    RenderTargetId best = RENDER_TARGET_NONE;
+    for (RenderTargetId id = 0; id < (RenderTargetId)pool->targets.size(); ++id) {
+        const RenderTarget &t = pool->targets[id];
+        if (!t.texture || t.inUse || t.format != format || t.samples != samples || !size_fits(t, w, h)) continue;
+        if (best == RENDER_TARGET_NONE ||
+            (int64_t)t.width * t.height < (int64_t)pool->targets[best].width * pool->targets[best].height)
+            best = id;
+    }
+    if (best != RENDER_TARGET_NONE) {
+        RenderTarget &t = pool->targets[best];
+        t.inUse = true;
+        t.lastUsed = pool->frame;
+        pool->stats.inUse++;
+        pool->stats.reuses++;
+        return best;
+    }
+
+    RenderTargetId id;
+    if (!pool->freeSlots.empty()) {
+        id = pool->freeSlots.back();
+        pool->freeSlots.pop_back();
+    } else {
+        id = (RenderTargetId)pool->targets.size();
+        pool->targets.emplace_back();
+    }
+
+    const TargetFormat f = target_format(format);
+    RenderTarget &t = pool->targets[id];
+    t.format = format;
+    t.width = bucket(w);
+    t.height = bucket(h);
+    t.samples = samples;
+    t.bytes = (size_t)t.width * t.height * samples * f.bytes;
+    t.lastUsed = pool->frame;
+    t.inUse = true;
+
+    glGenTextures(1, &t.texture);
+    if (samples > 1) {
+        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, t.texture);
+        glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, samples, format, t.width, t.height, GL_TRUE);
+        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+    } else {
+        glBindTexture(GL_TEXTURE_2D, t.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, t.width, t.height, 0, f.format, f.type, nullptr);
+        GLint filter = f.filtered ? GL_LINEAR : GL_NEAREST;
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    pool->stats.targets++;
+    pool->stats.inUse++;
+    pool->stats.bytes += t.bytes;
+    pool->stats.allocations++;
+    pool->stats.frameAllocations++;
+    return id;
+}
+
+void rtpool_release(RenderTargetPool *pool, RenderTargetId id)
+{
+    if (id == RENDER_TARGET_NONE || !pool->targets[id].inUse) return;
+    pool->targets[id].inUse = false;
+    pool->stats.inUse--;
+}
+
+bool rtpool_fits(const RenderTargetPool *pool, RenderTargetId id, int w, int h)
+{
+    return id != RENDER_TARGET_NONE && pool->targets[id].texture && size_fits(pool->targets[id], w, h);
+}
+
+const RenderTarget* rtpool_get(const RenderTargetPool *pool, RenderTargetId id)
+{
+    return &pool->targets[id];
+}
+
+static void attach(GLenum attachment, const RenderTarget &t) {
+    GLenum target = t.samples > 1 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
+    glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, target, t.texture, 0);
+}
+
+GLuint rtpool_framebuffer(RenderTargetPool *pool, RenderTargetId color, RenderTargetId depth)
+{
+    for (const RenderTargetFramebuffer &fb : pool->framebuffers)
+        if (fb.color == color && fb.depth == depth) return fb.fbo;
+
+    RenderTargetFramebuffer fb = { 0, color, depth };
+    glGenFramebuffers(1, &fb.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fb.fbo);
+    if (color != RENDER_TARGET_NONE) {
+        attach(GL_COLOR_ATTACHMENT0, pool->targets[color]);
+    } else {
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    }
+    if (depth != RENDER_TARGET_NONE)
+        attach(target_format(pool->targets[depth].format).attachment, pool->targets[depth]);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "Render target framebuffer incomplete: " << status << "\n";
+
+    pool->framebuffers.push_back(fb);
+    return fb.fbo;
+}
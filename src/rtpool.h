@@ -0,0 +1,83 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Pool of render target textures. Sizes are rounded up to buckets of
+// RTPOOL_GRANULARITY pixels, so a target survives small resizes and callers
+// render into the top left w x h of it (glViewport, and UVs of w / width).
+// Released targets wait in the pool and are handed out again for the same
+// format and sample count at a fitting size; ones nobody asked for in
+// RTPOOL_IDLE_FRAMES frames are deleted. Framebuffers over pairs of targets
+// are cached too and go away with their attachments.
+
+typedef uint32_t RenderTargetId;
+const RenderTargetId RENDER_TARGET_NONE = 0xffffffffu;
+
+const int RTPOOL_GRANULARITY = 128;   // bucket step in pixels
+const int RTPOOL_MAX_WASTE = 4;       // a target may be this many times the area asked for
+const int RTPOOL_IDLE_FRAMES = 120;
+
+struct RenderTarget
+{
+    GLuint texture;          // 0 for an empty slot
+    GLenum format;           // internal format
+    int width, height;       // allocated
+    int samples;             // 1 unless multisampled
+    size_t bytes;
+    uint32_t lastUsed;       // frame of the last acquire
+    bool inUse;
+};
+
+struct RenderTargetFramebuffer
+{
+    GLuint fbo;
+    RenderTargetId color, depth;
+};
+
+struct RenderTargetPoolStats
+{
+    int targets;              // alive, in use or waiting
+    int inUse;
+    size_t bytes;             // estimated GPU memory of all targets
+    long allocations;         // since start
+    long reuses;              // acquires served from the pool
+    long frees;
+    int frameAllocations;     // in the current frame
+};
+
+struct RenderTargetPool
+{
+    std::vector<RenderTarget> targets;   // indexed by RenderTargetId, slots are reused
+    std::vector<RenderTargetId> freeSlots;
+    std::vector<RenderTargetFramebuffer> framebuffers;
+    uint32_t frame;
+    RenderTargetPoolStats stats;
+};
+
+void rtpool_init(RenderTargetPool *pool);
+
+// Deletes every target and framebuffer, in use or not.
+void rtpool_destroy(RenderTargetPool *pool);
+
+// Advances the frame and deletes targets idle for too long.
+void rtpool_begin_frame(RenderTargetPool *pool);
+
+// A target of `format` at least w x h, either from the pool or newly
+// allocated at the bucketed size. Held until rtpool_release, across frames
+// if need be.
+RenderTargetId rtpool_acquire(RenderTargetPool *pool, GLenum format, int w, int h, int samples = 1);
+
+void rtpool_release(RenderTargetPool *pool, RenderTargetId id);
+
+// Whether a w x h image may keep using `id`: big enough and not wastefully
+// large.
+bool rtpool_fits(const RenderTargetPool *pool, RenderTargetId id, int w, int h);
+
+const RenderTarget* rtpool_get(const RenderTargetPool *pool, RenderTargetId id);
+
+// Framebuffer with `color` (or none) and `depth` (or none) attached, made on
+// first use.
+GLuint rtpool_framebuffer(RenderTargetPool *pool, RenderTargetId color, RenderTargetId depth);
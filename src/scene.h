@@ -0,0 +1,73 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+#include "assetloader.h"
+#include "jobsystem.h"
+#include "lightclusters.h"
+#include "lighting.h"
+#include "meshregistry.h"
+#include "orbitcamera.h"
+#include "picking.h"
+#include "renderqueue.h"
+#include "searchindex.h"
+#include "shader.h"
+#include "transforms.h"
+
+struct RenderObj{
+    std::string name;
+    const ShaderProgram *program;   // owned by the scene
+    MeshId mesh;                    // reference held in scene->meshes, MESH_NONE for a group
+    NodeId node;                    // transform in scene->transforms
+    glm::vec3 color;
+
+    // level of detail, picked by projected error unless forced
+    float lodErrorPixels;   // coarsest LOD whose error stays under this many pixels
+    float lodHysteresis;    // going coarser needs this fraction of slack
+    int lodForce;           // -1 for automatic
+    int lod;                // current level
+};
+
+// Circle a stress scene light moves along.
+struct LightOrbit{
+    glm::vec3 center;
+    float radius;
+    float speed;    // radians per second
+    float phase;
+};
+
+struct Scene{
+    ShaderProgram program;
+    ShaderProgram programMultiDraw;   // variants for the render queue
+    ShaderProgram programInstanced;
+    ShaderCache shaderCache;
+    GLuint frameUbo;
+    RenderQueue renderQueue;
+    MeshRegistry meshes;
+    TransformHierarchy transforms;
+    JobSystem jobs;   // frame preparation, on every core
+    std::vector<RenderObj> renderObjs;
+    std::vector<int> nodeObject;   // render object of each NodeId
+    OrbitCamera orbitCamera;
+    glm::vec3 lightPos;
+    glm::vec3 animLight;
+    std::vector<PointLight> lights;        // lights[0] follows animLight
+    std::vector<LightOrbit> lightOrbits;   // one per light after the first
+    LightClusters lightClusters;
+    LightingGpu lighting;
+    bool animateLight;   // orbit the light around lightPos
+    float lightTime;     // animation clock, stands still while paused
+    bool redraw;         // the scene image is out of date
+    bool defragGeometry; // compact the geometry arenas a little each frame
+    int selected;                     // primary selection, what the Inspector and gizmo edit
+    std::vector<uint8_t> selection;   // by object, every selected one
+    int selectionCount;
+    SearchIndex search;               // object names, by object index
+    Picker picker;
+    AssetLoader loader;
+    double loadStartTime;   // < 0 once every requested mesh is resident
+    std::string path;       // scene file Save writes to
+};
@@ -0,0 +1,160 @@
+#include "scenefile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+static_assert(sizeof(SceneFileObject) == 64, "scene file objects are written as they are laid out");
+
+static size_t align_up(size_t v, size_t a) {
+    return (v + a - 1) & ~(a - 1);
+}
+
+// `count` items of `itemBytes` at `offset` lie within `size` bytes. Offsets
+// and counts come from the file, so nothing is added or multiplied that
+// could wrap around.
+static bool range_ok(uint64_t offset, uint64_t count, uint64_t itemBytes, uint64_t size) {
+    return offset <= size && count <= (size - offset) / itemBytes;
+}
+
+static bool string_ok(const SceneFileHeader *h, SceneFileString s) {
+    return (uint64_t)s.offset + s.length <= h->stringBytes;
+}
+
+// One pass over the tables; afterwards every offset and index can be used
+// unchecked.
+static bool tables_ok(const SceneFile *scene) {
+    const SceneFileHeader *h = scene->header;
+    for (uint32_t i = 0; i < h->meshCount; ++i)
+        if (!string_ok(h, scene->meshes[i].path)) return false;
+    for (uint32_t i = 0; i < h->objectCount; ++i) {
+        const SceneFileObject &o = scene->objects[i];
+        if (!string_ok(h, o.name)) return false;
+        if (o.mesh != SCENE_FILE_NONE && o.mesh >= h->meshCount) return false;
+        if (o.parent != SCENE_FILE_NONE && o.parent >= i) return false;
+    }
+    return true;
+}
+
+bool scenefile_open(SceneFile *scene, const std::string &path)
+{
+    scene->header = nullptr;
+    if (!mappedfile_open(&scene->file, path)) return false;
+
+    const uint8_t *base = reinterpret_cast<const uint8_t*>(scene->file.data);
+    const uint64_t size = scene->file.size;
+    const SceneFileHeader *h = reinterpret_cast<const SceneFileHeader*>(base);
+    bool ok = size >= sizeof(SceneFileHeader) && h->magic == SCENE_FILE_MAGIC && h->version == SCENE_FILE_VERSION &&
+              h->objectOffset % alignof(SceneFileObject) == 0 && h->meshOffset % alignof(SceneFileMesh) == 0 &&
+              range_ok(h->objectOffset, h->objectCount, sizeof(SceneFileObject), size) &&
+              range_ok(h->meshOffset, h->meshCount, sizeof(SceneFileMesh), size) &&
+              range_ok(h->stringOffset, h->stringBytes, 1, size);
+    if (ok) {
+        scene->header = h;
+        scene->objects = reinterpret_cast<const SceneFileObject*>(base + h->objectOffset);
+        scene->meshes = reinterpret_cast<const SceneFileMesh*>(base + h->meshOffset);
+        scene->strings = reinterpret_cast<const char*>(base + h->stringOffset);
+        ok = tables_ok(scene);
+    }
+    if (!ok) scenefile_close(scene);
+    return ok;
+}
+
+void scenefile_close(SceneFile *scene)
+{
+    mappedfile_close(&scene->file);
+    scene->header = nullptr;
+    scene->objects = nullptr;
+    scene->meshes = nullptr;
+    scene->strings = nullptr;
+}
+
+static SceneFileString add_string(SceneFileWriter *writer, const std::string &s) {
+    SceneFileString r = { (uint32_t)writer->strings.size(), (uint32_t)s.size() };
+    writer->strings += s;
+    return r;
+}
+
+void scenefile_writer_clear(SceneFileWriter *writer)
+{
+    writer->objects.clear();
+    writer->meshes.clear();
+    writer->strings.clear();
+    writer->meshByPath.clear();
+}
+
+uint32_t scenefile_add_mesh(SceneFileWriter *writer, const std::string &path)
+{
+    auto it = writer->meshByPath.find(path);
+    if (it != writer->meshByPath.end()) return it->second;
+    uint32_t index = (uint32_t)writer->meshes.size();
+    writer->meshes.push_back(SceneFileMesh{ add_string(writer, path) });
+    writer->meshByPath[path] = index;
+    return index;
+}
+
+static void copy_vec3(float *dst, const glm::vec3 &v) {
+    dst[0] = v.x;
+    dst[1] = v.y;
+    dst[2] = v.z;
+}
+
+uint32_t scenefile_add_object(SceneFileWriter *writer, const std::string &name, uint32_t mesh, uint32_t parent,
+                              const glm::vec3 &position, const glm::vec3 &rotation, const glm::vec3 &scale,
+                              const glm::vec3 &color)
+{
+    SceneFileObject o;
+    o.name = add_string(writer, name);
+    o.mesh = mesh;
+    o.parent = parent;
+    copy_vec3(o.position, position);
+    copy_vec3(o.rotation, rotation);
+    copy_vec3(o.scale, scale);
+    copy_vec3(o.color, color);
+    writer->objects.push_back(o);
+    return (uint32_t)writer->objects.size() - 1;
+}
+
+void scenefile_build_image(std::vector<uint8_t> *image, const SceneFileWriter *writer)
+{
+    SceneFileHeader h;
+    std::memset(&h, 0, sizeof(h));
+    h.magic = SCENE_FILE_MAGIC;
+    h.version = SCENE_FILE_VERSION;
+    h.objectCount = (uint32_t)writer->objects.size();
+    h.meshCount = (uint32_t)writer->meshes.size();
+    h.stringBytes = writer->strings.size();
+
+    const size_t objectBytes = writer->objects.size() * sizeof(SceneFileObject);
+    const size_t meshBytes = writer->meshes.size() * sizeof(SceneFileMesh);
+    h.objectOffset = align_up(sizeof(SceneFileHeader), 16);
+    h.meshOffset = align_up(h.objectOffset + objectBytes, 16);
+    h.stringOffset = h.meshOffset + meshBytes;
+
+    image->assign(h.stringOffset + h.stringBytes, 0);
+    uint8_t *base = image->data();
+    std::memcpy(base, &h, sizeof(h));
+    if (objectBytes) std::memcpy(base + h.objectOffset, writer->objects.data(), objectBytes);
+    if (meshBytes) std::memcpy(base + h.meshOffset, writer->meshes.data(), meshBytes);
+    if (h.stringBytes) std::memcpy(base + h.stringOffset, writer->strings.data(), h.stringBytes);
+}
+
+bool scenefile_save(const SceneFileWriter *writer, const std::string &path)
+{
+    std::vector<uint8_t> image;
+    scenefile_build_image(&image, writer);
+
+    std::string tmp = path + ".tmp";
+    FILE *f = std::fopen(tmp.c_str(), "wb");
+    if (!f) return false;
+    bool written = std::fwrite(image.data(), 1, image.size(), f) == image.size();
+    written = (std::fclose(f) == 0) && written;
+    std::error_code ec;
+    if (written)
+        std::filesystem::rename(tmp, path, ec);
+    if (!written || ec) {
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mappedfile.h"
+
+// Saved scenes. The file is a SceneFileHeader, a table of fixed size
+// SceneFileObject records, a table of mesh references and one blob holding
+// every name and path. Records refer to strings by offset, so a loader maps
+// the file and reads objects where they lie; nothing is parsed, and a mesh
+// path is only looked at when the first object using it is created. Objects
+// are in hierarchy pre-order, so parents precede their children.
+
+const uint32_t SCENE_FILE_MAGIC = 0x53474c4d;   // "MGLS"
+const uint32_t SCENE_FILE_VERSION = 1;
+const uint32_t SCENE_FILE_NONE = 0xffffffffu;
+
+struct SceneFileString
+{
+    uint32_t offset;   // in the string blob
+    uint32_t length;
+};
+
+struct SceneFileObject
+{
+    SceneFileString name;
+    uint32_t mesh;       // index in the mesh table, SCENE_FILE_NONE for a group
+    uint32_t parent;     // index of an earlier object, SCENE_FILE_NONE for a root
+    float position[3];   // local
+    float rotation[3];   // local, euler degrees (XYZ)
+    float scale[3];      // local
+    float color[3];
+};
+
+struct SceneFileMesh
+{
+    SceneFileString path;   // model source, as given to the mesh registry
+};
+
+struct SceneFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t objectCount;
+    uint32_t meshCount;
+    uint64_t objectOffset;
+    uint64_t meshOffset;
+    uint64_t stringOffset;
+    uint64_t stringBytes;
+};
+
+// An open scene file; the pointers are into the mapping.
+struct SceneFile
+{
+    const SceneFileHeader *header;
+    const SceneFileObject *objects;
+    const SceneFileMesh *meshes;
+    const char *strings;
+
+    MappedFile file;
+};
+
+// Maps and validates `path`. Returns false when it is missing, truncated,
+// from another version or refers outside itself.
+bool scenefile_open(SceneFile *scene, const std::string &path);
+
+void scenefile_close(SceneFile *scene);
+
+inline std::string scenefile_string(const SceneFile *scene, SceneFileString s) {
+    return std::string(scene->strings + s.offset, s.length);
+}
+
+// Collects a scene for saving. Objects must be added parents first.
+struct SceneFileWriter
+{
+    std::vector<SceneFileObject> objects;
+    std::vector<SceneFileMesh> meshes;
+    std::string strings;
+    std::unordered_map<std::string, uint32_t> meshByPath;
+};
+
+void scenefile_writer_clear(SceneFileWriter *writer);
+
+// Index of the mesh table entry for `path`, added the first time it is seen.
+uint32_t scenefile_add_mesh(SceneFileWriter *writer, const std::string &path);
+
+// Returns the object's index, for use as a later object's parent.
+uint32_t scenefile_add_object(SceneFileWriter *writer, const std::string &name, uint32_t mesh, uint32_t parent,
+                              const glm::vec3 &position, const glm::vec3 &rotation, const glm::vec3 &scale,
+                              const glm::vec3 &color);
+
+// Serializes the writer's contents into the file layout.
+void scenefile_build_image(std::vector<uint8_t> *image, const SceneFileWriter *writer);
+
+// Writes through a temporary, so a reader never maps a half written file.
+bool scenefile_save(const SceneFileWriter *writer, const std::string &path);
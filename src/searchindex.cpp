@@ -0,0 +1,123 @@
+#include "searchindex.h"
+
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+
+static std::string lower(const std::string &s) {
+    std::string r(s);
+    for (char &c : r) c = (char)std::tolower((unsigned char)c);
+    return r;
+}
+
+static uint32_t trigram(const std::string &s, size_t i) {
+    return (uint32_t)(uint8_t)s[i] | (uint32_t)(uint8_t)s[i + 1] << 8 | (uint32_t)(uint8_t)s[i + 2] << 16;
+}
+
+static void distinct_trigrams(const std::string &s, std::vector<uint32_t> *out) {
+    out->clear();
+    for (size_t i = 0; i + 3 <= s.size(); ++i) out->push_back(trigram(s, i));
+    std::sort(out->begin(), out->end());
+    out->erase(std::unique(out->begin(), out->end()), out->end());
+}
+
+void searchindex_clear(SearchIndex *index)
+{
+    index->names.clear();
+    index->live.clear();
+    index->postings.clear();
+    index->entries = index->stale = 0;
+    index->version++;
+}
+
+static void add_postings(SearchIndex *index, uint32_t id, std::vector<uint32_t> *grams) {
+    distinct_trigrams(index->names[id], grams);
+    for (uint32_t g : *grams) {
+        std::vector<uint32_t> &list = index->postings[g];
+        // ids mostly arrive in order, so this is nearly always an append
+        if (list.empty() || list.back() < id) {
+            list.push_back(id);
+        } else {
+            auto it = std::lower_bound(list.begin(), list.end(), id);
+            if (*it == id) {   // stale entry from an earlier name
+                index->stale--;
+                continue;
+            }
+            list.insert(it, id);
+        }
+        index->entries++;
+    }
+}
+
+static void count_stale(SearchIndex *index, uint32_t id) {
+    size_t n = index->names[id].size();
+    index->stale += n >= 3 ? n - 2 : 0;   // an upper bound, duplicates count twice
+}
+
+static void rebuild(SearchIndex *index) {
+    index->postings.clear();
+    index->entries = index->stale = 0;
+    std::vector<uint32_t> grams;
+    for (uint32_t id = 0; id < (uint32_t)index->names.size(); ++id)
+        if (index->live[id]) add_postings(index, id, &grams);
+}
+
+void searchindex_set(SearchIndex *index, uint32_t id, const std::string &name)
+{
+    if (id >= index->names.size()) {
+        index->names.resize(id + 1);
+        index->live.resize(id + 1, 0);
+    }
+    if (index->live[id]) count_stale(index, id);
+    index->names[id] = lower(name);
+    index->live[id] = 1;
+    std::vector<uint32_t> grams;
+    add_postings(index, id, &grams);
+    if (index->stale > index->entries / 2) rebuild(index);
+    index->version++;
+}
+
+void searchindex_remove(SearchIndex *index, uint32_t id)
+{
+    if (id >= index->live.size() || !index->live[id]) return;
+    count_stale(index, id);
+    index->names[id].clear();
+    index->live[id] = 0;
+    if (index->stale > index->entries / 2) rebuild(index);
+    index->version++;
+}
+
+void searchindex_query(const SearchIndex *index, const std::string &query, std::vector<uint32_t> *ids)
+{
+    ids->clear();
+    const std::string q = lower(query);
+    if (q.size() < 3) {
+        for (uint32_t id = 0; id < (uint32_t)index->names.size(); ++id)
+            if (index->live[id] && index->names[id].find(q) != std::string::npos) ids->push_back(id);
+        return;
+    }
+
+    std::vector<uint32_t> grams;
+    distinct_trigrams(q, &grams);
+    std::vector<const std::vector<uint32_t>*> lists;
+    for (uint32_t g : grams) {
+        auto it = index->postings.find(g);
+        if (it == index->postings.end()) return;
+        lists.push_back(&it->second);
+    }
+    std::sort(lists.begin(), lists.end(), [](const std::vector<uint32_t> *a, const std::vector<uint32_t> *b) {
+        return a->size() < b->size();
+    });
+
+    std::vector<uint32_t> candidates = *lists[0], next;
+    for (size_t i = 1; i < lists.size() && !candidates.empty(); ++i) {
+        next.clear();
+        std::set_intersection(candidates.begin(), candidates.end(), lists[i]->begin(), lists[i]->end(),
+                              std::back_inserter(next));
+        candidates.swap(next);
+    }
+    // every trigram present does not mean they are adjacent, and stale
+    // entries may have survived
+    for (uint32_t id : candidates)
+        if (index->live[id] && index->names[id].find(q) != std::string::npos) ids->push_back(id);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Case-insensitive substring search over names keyed by a dense id (the
+// Hierarchy uses the object index). Each name is lower-cased once and every
+// distinct trigram in it gets the id added to that trigram's posting list,
+// kept ascending. A query of three or more characters intersects the lists
+// of its trigrams, shortest first, and confirms each survivor with a plain
+// substring test; shorter queries scan the names. Adding or renaming only
+// inserts into the new name's lists. Removed and renamed ids are left in
+// their old lists, where the final test drops them, until such stale
+// entries outnumber the live ones and the lists are rebuilt.
+
+struct SearchIndex
+{
+    std::vector<std::string> names;   // lower-cased, by id
+    std::vector<uint8_t> live;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> postings;   // trigram -> ids, ascending
+    size_t entries = 0;   // in every list
+    size_t stale = 0;     // of those, left by removed or renamed names
+    uint32_t version = 0;   // bumped on every change, for callers caching results
+};
+
+void searchindex_clear(SearchIndex *index);
+
+// Adds `id` or replaces its name.
+void searchindex_set(SearchIndex *index, uint32_t id, const std::string &name);
+
+void searchindex_remove(SearchIndex *index, uint32_t id);
+
+// Every live id whose name contains `query`, ascending. An empty query
+// matches everything.
+void searchindex_query(const SearchIndex *index, const std::string &query, std::vector<uint32_t> *ids);
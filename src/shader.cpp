@@ -0,0 +1,341 @@
+#include "shader.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+const uint32_t PROGRAM_FILE_MAGIC = 0x50474c4d;   // "MLGP"
+const uint32_t PROGRAM_FILE_VERSION = 1;
+
+struct ProgramFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;        // also the file name; guards against renamed files
+    uint32_t format;     // from glGetProgramBinary
+    uint32_t length;     // bytes of binary after the header
+};
+
+static const char *SHADER_UNIFORM_NAMES[UNIFORM_COUNT] = {
+    "uModel",
+    "uNormalMatrix",
+    "uObjectColor",
+};
+
+static bool read_text_file(const std::string& path, std::string *out) {
+    std::ifstream in(path);
+    if (!in) return false;
+    std::stringstream ss;
+    ss << in.rdbuf();
+    *out = ss.str();
+    return true;
+}
+
+static double now_seconds() {
+    using clock = std::chrono::steady_clock;
+    return std::chrono::duration<double>(clock::now().time_since_epoch()).count();
+}
+
+// Resolves #include "file" against the including file's directory and puts
+// the defines right after #version. #line keeps compile errors pointing at
+// the right line of each file.
+static bool preprocess(const std::string &path, const std::vector<std::string> &defines,
+                       std::string *out, int depth = 0) {
+    std::string text;
+    if (depth > 16 || !read_text_file(path, &text)) {
+        std::cerr << "Could not read shader source: " << path << "\n";
+        return false;
+    }
+    std::string dir = path.substr(0, path.find_last_of("/\\") + 1);
+    std::istringstream lines(text);
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(lines, line)) {
+        ++lineNumber;
+        size_t first = line.find_first_not_of(" \t");
+        if (first != std::string::npos && line.compare(first, 8, "#include") == 0) {
+            size_t open = line.find('"', first), close = line.rfind('"');
+            if (open == std::string::npos || close <= open) {
+                std::cerr << path << ":" << lineNumber << ": bad #include\n";
+                return false;
+            }
+            if (!preprocess(dir + line.substr(open + 1, close - open - 1), {}, out, depth + 1)) return false;
+            *out += "#line " + std::to_string(lineNumber + 1) + "\n";
+            continue;
+        }
+        *out += line;
+        *out += '\n';
+        if (first != std::string::npos && line.compare(first, 8, "#version") == 0 && !defines.empty()) {
+            for (const std::string &d : defines)
+                *out += "#define " + d + "\n";
+            *out += "#line " + std::to_string(lineNumber + 1) + "\n";
+        }
+    }
+    return true;
+}
+
+static GLuint compileShader(GLenum type, const char* src) {
+  GLuint s = glCreateShader(type);
+  glShaderSource(s, 1, &src, nullptr);
+  glCompileShader(s);
+  return s;
+}
+
+static void printShaderLog(GLuint s) {
+  GLint ok = 0;
+  glGetShaderiv(s, GL_COMPILE_STATUS, &ok);
+  if (!ok) {
+    GLint len = 0;
+    glGetShaderiv(s, GL_INFO_LOG_LENGTH, &len);
+    std::string log(len, '\0');
+    glGetShaderInfoLog(s, len, nullptr, log.data());
+    std::cerr << "Shader compile error:\n" << log << "\n";
+  }
+}
+
+// Compile and link are only issued; the result is checked in finish_build
+// so a parallel compiling driver can work on them meanwhile.
+static GLuint linkProgram(GLuint vs, GLuint fs, bool retrievable) {
+  GLuint p = glCreateProgram();
+  glAttachShader(p, vs);
+  glAttachShader(p, fs);
+  if (retrievable) glProgramParameteri(p, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  glLinkProgram(p);
+  return p;
+}
+
+static void resolve_locations(ShaderProgram *program) {
+    for (int i = 0; i < UNIFORM_COUNT; ++i)
+        program->uniforms[i] = glGetUniformLocation(program->id, SHADER_UNIFORM_NAMES[i]);
+
+    GLuint block = glGetUniformBlockIndex(program->id, "FrameData");
+    if (block != GL_INVALID_INDEX)
+        glUniformBlockBinding(program->id, block, FRAME_UNIFORM_BINDING);
+
+    // sampler units are program state, not part of a cached binary
+    static const struct { const char *name; GLuint unit; } samplers[] = {
+        { "uLights", LIGHT_TEXTURE_UNIT },
+        { "uClusterGrid", CLUSTER_GRID_TEXTURE_UNIT },
+        { "uLightIndices", LIGHT_INDEX_TEXTURE_UNIT },
+    };
+    glUseProgram(program->id);
+    for (const auto &s : samplers) {
+        GLint location = glGetUniformLocation(program->id, s.name);
+        if (location >= 0) glUniform1i(location, (GLint)s.unit);
+    }
+    glUseProgram(0);
+}
+
+static uint64_t fnv1a(uint64_t h, const std::string &s) {
+    for (unsigned char c : s)
+        h = (h ^ c) * 1099511628211ull;
+    return (h ^ 0xff) * 1099511628211ull;   // separator, so "ab"+"c" != "a"+"bc"
+}
+
+static std::string binary_path(const ShaderCache *cache, uint64_t key) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+    return cache->dir + "/" + name;
+}
+
+// Loads the cached binary into `program`. A file the driver rejects, after
+// an update that kept the version strings say, is removed.
+static bool load_binary(ShaderCache *cache, uint64_t key, GLuint program) {
+    std::string path = binary_path(cache, key);
+    FILE *f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+    ProgramFileHeader header;
+    std::vector<char> blob;
+    bool ok = std::fread(&header, sizeof(header), 1, f) == 1 &&
+              header.magic == PROGRAM_FILE_MAGIC && header.version == PROGRAM_FILE_VERSION &&
+              header.key == key && header.length > 0;
+    if (ok) {
+        blob.resize(header.length);
+        ok = std::fread(blob.data(), 1, blob.size(), f) == blob.size();
+    }
+    std::fclose(f);
+
+    GLint linked = 0;
+    if (ok) {
+        glProgramBinary(program, header.format, blob.data(), (GLsizei)blob.size());
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    }
+    if (!linked) {
+        cache->rejected++;
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+    }
+    return linked != 0;
+}
+
+// Written through a temporary so an interrupted write can't leave a
+// truncated binary behind. Failing to store is not an error.
+static void store_binary(ShaderCache *cache, uint64_t key, GLuint program) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+    ProgramFileHeader header = { PROGRAM_FILE_MAGIC, PROGRAM_FILE_VERSION, key, 0, (uint32_t)length };
+    std::vector<char> blob(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, nullptr, &format, blob.data());
+    header.format = format;
+
+    std::error_code ec;
+    std::filesystem::create_directories(cache->dir, ec);
+    std::string path = binary_path(cache, key);
+    std::string tmp = path + ".tmp";
+    FILE *f = std::fopen(tmp.c_str(), "wb");
+    if (!f) return;
+    bool written = std::fwrite(&header, sizeof(header), 1, f) == 1 &&
+                   std::fwrite(blob.data(), 1, blob.size(), f) == blob.size();
+    written = (std::fclose(f) == 0) && written;
+    if (written) std::filesystem::rename(tmp, path, ec);
+    if (!written || ec) std::filesystem::remove(tmp, ec);
+}
+
+static bool has_extension(const char *name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i)
+        if (std::strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), name) == 0) return true;
+    return false;
+}
+
+void shadercache_init(ShaderCache *cache, const std::string &dir, GLADloadproc load)
+{
+    cache->dir = dir;
+    cache->driver = std::string((const char*)glGetString(GL_VENDOR)) + "|" +
+                    (const char*)glGetString(GL_RENDERER) + "|" + (const char*)glGetString(GL_VERSION);
+    GLint formats = 0;
+    if (GLAD_GL_VERSION_4_1) glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    cache->binaries = formats > 0;
+    cache->parallelCompile = has_extension("GL_KHR_parallel_shader_compile");
+    if (cache->parallelCompile && load) {
+        // as many driver threads as it likes
+        typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+        MaxShaderCompilerThreadsProc maxThreads = (MaxShaderCompilerThreadsProc)load("glMaxShaderCompilerThreadsKHR");
+        if (maxThreads) maxThreads(0xffffffffu);
+    }
+    cache->hits = cache->misses = cache->rejected = 0;
+    cache->seconds = 0.0;
+}
+
+// Checks the link, blocking if the driver isn't done, and caches the binary.
+static ShaderState finish_build(ShaderProgram *program, ShaderCache *cache) {
+    double start = now_seconds();
+    GLint ok = 0;
+    glGetProgramiv(program->id, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        printShaderLog(program->pendingShaders[0]);
+        printShaderLog(program->pendingShaders[1]);
+        GLint len = 0;
+        glGetProgramiv(program->id, GL_INFO_LOG_LENGTH, &len);
+        std::string log(len, '\0');
+        glGetProgramInfoLog(program->id, len, nullptr, log.data());
+        std::cerr << "Program link error:\n" << log << "\n";
+    }
+    for (GLuint &s : program->pendingShaders) {
+        glDetachShader(program->id, s);
+        glDeleteShader(s);
+        s = 0;
+    }
+    if (ok) {
+        resolve_locations(program);
+        if (cache && program->cacheKey) store_binary(cache, program->cacheKey, program->id);
+    }
+    program->state = ok ? SHADER_READY : SHADER_FAILED;
+    if (cache) cache->seconds += now_seconds() - start;
+    return program->state;
+}
+
+bool shader_create_async(ShaderProgram *program, const std::string &vsPath, const std::string &fsPath,
+                         ShaderCache *cache, const std::vector<std::string> &defines)
+{
+    double start = now_seconds();
+    program->id = 0;
+    program->multiDraw = nullptr;
+    program->instanced = nullptr;
+    program->state = SHADER_FAILED;
+    program->pendingShaders[0] = program->pendingShaders[1] = 0;
+    program->cacheKey = 0;
+
+    std::string vsString, fsString;
+    if (!preprocess(vsPath, defines, &vsString) || !preprocess(fsPath, defines, &fsString)) return false;
+
+    bool cached = cache && cache->binaries && !cache->dir.empty();
+    if (cached) {
+        uint64_t key = fnv1a(fnv1a(fnv1a(14695981039346656037ull, cache->driver), vsString), fsString);
+        program->cacheKey = key ? key : 1;
+        GLuint p = glCreateProgram();
+        if (load_binary(cache, program->cacheKey, p)) {
+            program->id = p;
+            program->state = SHADER_READY;
+            resolve_locations(program);
+            cache->hits++;
+            cache->seconds += now_seconds() - start;
+            return true;
+        }
+        glDeleteProgram(p);
+        cache->misses++;
+    }
+
+    program->pendingShaders[0] = compileShader(GL_VERTEX_SHADER, vsString.c_str());
+    program->pendingShaders[1] = compileShader(GL_FRAGMENT_SHADER, fsString.c_str());
+    program->id = linkProgram(program->pendingShaders[0], program->pendingShaders[1], cached);
+    program->state = SHADER_BUILDING;
+    if (cache) cache->seconds += now_seconds() - start;
+    return true;
+}
+
+bool shader_create(ShaderProgram *program, const std::string &vsPath, const std::string &fsPath,
+                   ShaderCache *cache, const std::vector<std::string> &defines)
+{
+    if (!shader_create_async(program, vsPath, fsPath, cache, defines)) return false;
+    if (program->state == SHADER_BUILDING) finish_build(program, cache);
+    return program->state == SHADER_READY;
+}
+
+ShaderState shader_poll(ShaderProgram *program, ShaderCache *cache)
+{
+    if (program->state != SHADER_BUILDING) return program->state;
+    if (cache && cache->parallelCompile) {
+        GLint done = 0;
+        glGetProgramiv(program->id, GL_COMPLETION_STATUS_KHR, &done);
+        if (!done) return SHADER_BUILDING;
+    }
+    return finish_build(program, cache);
+}
+
+void shader_destroy(ShaderProgram *program)
+{
+    for (GLuint &s : program->pendingShaders) {
+        if (s) glDeleteShader(s);
+        s = 0;
+    }
+    glDeleteProgram(program->id);
+    program->id = 0;
+}
+
+GLuint frameuniforms_create()
+{
+    GLuint ubo = 0;
+    glGenBuffers(1, &ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, ubo);
+    return ubo;
+}
+
+void frameuniforms_upload(GLuint ubo, const FrameUniforms *data)
+{
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), data);
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Per-draw uniforms. Locations are looked up once at link time; anything
+// shared by every draw in a frame lives in the FrameData uniform block.
+enum ShaderUniform
+{
+    UNIFORM_MODEL,
+    UNIFORM_NORMAL_MATRIX,
+    UNIFORM_OBJECT_COLOR,
+    UNIFORM_COUNT
+};
+
+enum ShaderState
+{
+    SHADER_READY,
+    SHADER_BUILDING,   // compile or link still running, see shader_poll
+    SHADER_FAILED,
+};
+
+struct ShaderProgram
+{
+    GLuint id;
+    GLint uniforms[UNIFORM_COUNT];   // -1 if the program doesn't use it
+    // variants for the render queue, nullptr if the material has none
+    const ShaderProgram *multiDraw;  // per-object data by draw id (GL 4.3)
+    const ShaderProgram *instanced;  // per-object data as instance attributes
+
+    ShaderState state;
+    GLuint pendingShaders[2];        // attached until a background link ends
+    uint64_t cacheKey;               // 0 when not cached
+};
+
+// Linked programs are cached on disk as "<dir>/<key>.bin", the key being a
+// hash of the preprocessed sources and the driver's vendor, renderer and
+// version strings, so a driver update or an edited include misses cleanly.
+// A binary the driver still rejects is deleted and the program compiled
+// from source. With GL_KHR_parallel_shader_compile, programs built by
+// shader_create_async compile on driver threads while frames go on.
+struct ShaderCache
+{
+    std::string dir;          // empty disables the binary cache
+    std::string driver;
+    bool binaries;            // GL 4.1 program binaries with at least one format
+    bool parallelCompile;     // GL_KHR_parallel_shader_compile
+    int hits, misses, rejected;
+    double seconds;           // spent creating programs on this thread
+};
+
+// `load` resolves extension entry points that glad doesn't carry.
+void shadercache_init(ShaderCache *cache, const std::string &dir, GLADloadproc load);
+
+// Binding point of the FrameData block in every program.
+const GLuint FRAME_UNIFORM_BINDING = 0;
+
+// Texture units of the clustered lighting buffers (uLights, uClusterGrid,
+// uLightIndices), set in every program that uses them.
+const GLuint LIGHT_TEXTURE_UNIT = 1;
+const GLuint CLUSTER_GRID_TEXTURE_UNIT = 2;
+const GLuint LIGHT_INDEX_TEXTURE_UNIT = 3;
+
+// std140 mirror of the FrameData block in the shaders.
+struct FrameUniforms
+{
+    glm::mat4 view;
+    glm::mat4 proj;
+    glm::vec4 viewPos;         // xyz
+    glm::vec4 clusterParams;   // near plane, slices per log depth, viewport width, height
+    glm::ivec4 clusterDims;    // clusters in x, y, z; light count
+};
+
+// Sources are preprocessed first: `#include "file"` is resolved relative to
+// the including file and each of `defines` becomes a #define after #version.
+
+// Builds the program now, from `cache` when possible (null to bypass it).
+bool shader_create(ShaderProgram *program, const std::string &vsPath, const std::string &fsPath,
+                   ShaderCache *cache = nullptr, const std::vector<std::string> &defines = {});
+
+// Starts building the program and returns without waiting for the driver;
+// a cache hit is ready at once. False if the sources can't be read.
+bool shader_create_async(ShaderProgram *program, const std::string &vsPath, const std::string &fsPath,
+                         ShaderCache *cache, const std::vector<std::string> &defines = {});
+
+// Finishes a background build once the driver reports it complete, without
+// blocking when it can tell. Returns the program's state.
+ShaderState shader_poll(ShaderProgram *program, ShaderCache *cache);
+
+void shader_destroy(ShaderProgram *program);
+
+// Creates the frame uniform buffer and binds it to FRAME_UNIFORM_BINDING.
+GLuint frameuniforms_create();
+
+void frameuniforms_upload(GLuint ubo, const FrameUniforms *data);
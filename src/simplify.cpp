@@ -0,0 +1,336 @@
+#include "simplify.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+static const float BORDER_WEIGHT = 10.0f;     // boundary planes vs surface planes
+static const float NORMAL_COS_LIMIT = 0.7f;   // a copy may not land on a normal further off
+static const float FLIP_COS_LIMIT = 0.2f;     // a triangle may not turn further than this
+
+enum VertexKind : uint8_t
+{
+    KIND_INTERIOR,
+    KIND_BORDER,
+    KIND_LOCKED,   // non-manifold or a junction of boundaries
+};
+
+struct Vec3
+{
+    float x, y, z;
+};
+
+static inline Vec3 sub(Vec3 a, Vec3 b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+static inline float dot(Vec3 a, Vec3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+static inline Vec3 cross(Vec3 a, Vec3 b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+
+// Symmetric 4x4 sum of squared plane distances.
+struct Quadric
+{
+    double a00, a01, a02, a03, a11, a12, a13, a22, a23, a33;
+};
+
+static void quadric_add_plane(Quadric *q, Vec3 n, float d, float w) {
+    q->a00 += w * n.x * n.x; q->a01 += w * n.x * n.y; q->a02 += w * n.x * n.z; q->a03 += w * n.x * d;
+    q->a11 += w * n.y * n.y; q->a12 += w * n.y * n.z; q->a13 += w * n.y * d;
+    q->a22 += w * n.z * n.z; q->a23 += w * n.z * d;
+    q->a33 += w * d * d;
+}
+
+static void quadric_add(Quadric *q, const Quadric &o) {
+    q->a00 += o.a00; q->a01 += o.a01; q->a02 += o.a02; q->a03 += o.a03;
+    q->a11 += o.a11; q->a12 += o.a12; q->a13 += o.a13;
+    q->a22 += o.a22; q->a23 += o.a23;
+    q->a33 += o.a33;
+}
+
+static float quadric_eval(const Quadric &q, Vec3 p) {
+    double x = p.x, y = p.y, z = p.z;
+    double e = q.a00 * x * x + 2.0 * q.a01 * x * y + 2.0 * q.a02 * x * z + 2.0 * q.a03 * x
+             + q.a11 * y * y + 2.0 * q.a12 * y * z + 2.0 * q.a13 * y
+             + q.a22 * z * z + 2.0 * q.a23 * z
+             + q.a33;
+    return e > 0.0 ? (float)e : 0.0f;
+}
+
+struct Collapse
+{
+    float cost;
+    uint32_t from, to;   // position ids
+};
+
+struct Simplifier
+{
+    const float *vertices;
+    size_t stride;
+    std::vector<uint32_t> pos;   // vertex -> position id (lowest vertex at that position)
+    std::vector<Quadric> quadrics;   // per position id
+    std::vector<uint32_t> tris;
+
+    // rebuilt every pass
+    std::vector<uint64_t> edges;   // directed position edges, sorted
+    std::vector<VertexKind> kind;
+    std::vector<uint32_t> adjStart, adjTris;   // triangles around each position id
+};
+
+static inline Vec3 position(const Simplifier *s, uint32_t v) {
+    const float *p = s->vertices + v * s->stride;
+    return { p[0], p[1], p[2] };
+}
+
+static inline Vec3 normal(const Simplifier *s, uint32_t v) {
+    const float *p = s->vertices + v * s->stride + 3;
+    return { p[0], p[1], p[2] };
+}
+
+static inline uint64_t edge_key(uint32_t a, uint32_t b) { return (uint64_t)a << 32 | b; }
+
+static bool has_edge(const Simplifier *s, uint32_t a, uint32_t b) {
+    return std::binary_search(s->edges.begin(), s->edges.end(), edge_key(a, b));
+}
+
+// Vertices with bit-identical positions share an id.
+static void build_positions(Simplifier *s, size_t vertexCount) {
+    std::vector<uint32_t> order(vertexCount);
+    std::iota(order.begin(), order.end(), 0u);
+    auto bits = [s](uint32_t v, int k) {
+        uint32_t b;
+        std::memcpy(&b, s->vertices + v * s->stride + k, sizeof(b));
+        return b;
+    };
+    auto less = [&](uint32_t a, uint32_t b) {
+        for (int k = 0; k < 3; ++k)
+            if (bits(a, k) != bits(b, k)) return bits(a, k) < bits(b, k);
+        return a < b;
+    };
+    std::sort(order.begin(), order.end(), less);
+    s->pos.resize(vertexCount);
+    for (size_t i = 0; i < vertexCount; ++i) {
+        uint32_t v = order[i];
+        bool same = i > 0 && bits(v, 0) == bits(order[i - 1], 0) && bits(v, 1) == bits(order[i - 1], 1) && bits(v, 2) == bits(order[i - 1], 2);
+        s->pos[v] = same ? s->pos[order[i - 1]] : v;
+    }
+}
+
+static void drop_degenerate(Simplifier *s) {
+    size_t out = 0;
+    for (size_t t = 0; t + 2 < s->tris.size(); t += 3) {
+        uint32_t a = s->tris[t], b = s->tris[t + 1], c = s->tris[t + 2];
+        uint32_t pa = s->pos[a], pb = s->pos[b], pc = s->pos[c];
+        if (pa == pb || pb == pc || pc == pa) continue;
+        s->tris[out++] = a;
+        s->tris[out++] = b;
+        s->tris[out++] = c;
+    }
+    s->tris.resize(out);
+}
+
+static void build_topology(Simplifier *s, size_t vertexCount) {
+    const size_t triCount = s->tris.size() / 3;
+    s->edges.clear();
+    for (size_t t = 0; t < triCount; ++t)
+        for (int k = 0; k < 3; ++k)
+            s->edges.push_back(edge_key(s->pos[s->tris[3 * t + k]], s->pos[s->tris[3 * t + (k + 1) % 3]]));
+    std::sort(s->edges.begin(), s->edges.end());
+
+    std::vector<uint8_t> borderEdges(vertexCount, 0);
+    s->kind.assign(vertexCount, KIND_INTERIOR);
+    for (size_t i = 0; i < s->edges.size(); ++i) {
+        uint32_t a = (uint32_t)(s->edges[i] >> 32), b = (uint32_t)s->edges[i];
+        bool duplicate = (i > 0 && s->edges[i - 1] == s->edges[i]) ||
+                         (i + 1 < s->edges.size() && s->edges[i + 1] == s->edges[i]);
+        if (duplicate) {
+            s->kind[a] = s->kind[b] = KIND_LOCKED;
+        } else if (!has_edge(s, b, a)) {
+            borderEdges[a] = (uint8_t)std::min(255, borderEdges[a] + 1);
+            borderEdges[b] = (uint8_t)std::min(255, borderEdges[b] + 1);
+        }
+    }
+    for (size_t v = 0; v < vertexCount; ++v) {
+        if (s->kind[v] == KIND_LOCKED || !borderEdges[v]) continue;
+        s->kind[v] = borderEdges[v] == 2 ? KIND_BORDER : KIND_LOCKED;
+    }
+
+    s->adjStart.assign(vertexCount + 1, 0);
+    for (uint32_t v : s->tris)
+        s->adjStart[s->pos[v] + 1]++;
+    for (size_t v = 0; v < vertexCount; ++v)
+        s->adjStart[v + 1] += s->adjStart[v];
+    s->adjTris.resize(s->tris.size());
+    std::vector<uint32_t> fill(s->adjStart.begin(), s->adjStart.end() - 1);
+    for (size_t i = 0; i < s->tris.size(); ++i)
+        s->adjTris[fill[s->pos[s->tris[i]]]++] = (uint32_t)(i / 3);
+}
+
+static void build_quadrics(Simplifier *s, size_t vertexCount) {
+    s->quadrics.assign(vertexCount, Quadric{});
+    for (size_t t = 0; t < s->tris.size(); t += 3) {
+        uint32_t p[3] = { s->pos[s->tris[t]], s->pos[s->tris[t + 1]], s->pos[s->tris[t + 2]] };
+        Vec3 v0 = position(s, p[0]), v1 = position(s, p[1]), v2 = position(s, p[2]);
+        Vec3 n = cross(sub(v1, v0), sub(v2, v0));
+        float len = std::sqrt(dot(n, n));
+        if (len == 0.0f) continue;
+        n = { n.x / len, n.y / len, n.z / len };
+        float d = -dot(n, v0);
+        for (int k = 0; k < 3; ++k)
+            quadric_add_plane(&s->quadrics[p[k]], n, d, 1.0f);
+
+        // boundary edges get a plane through them, perpendicular to the face
+        for (int k = 0; k < 3; ++k) {
+            uint32_t a = p[k], b = p[(k + 1) % 3];
+            if (has_edge(s, b, a)) continue;
+            Vec3 e = sub(position(s, b), position(s, a));
+            Vec3 m = cross(e, n);
+            float mlen = std::sqrt(dot(m, m));
+            if (mlen == 0.0f) continue;
+            m = { m.x / mlen, m.y / mlen, m.z / mlen };
+            float md = -dot(m, position(s, a));
+            quadric_add_plane(&s->quadrics[a], m, md, BORDER_WEIGHT);
+            quadric_add_plane(&s->quadrics[b], m, md, BORDER_WEIGHT);
+        }
+    }
+}
+
+static bool can_move(const Simplifier *s, uint32_t from, bool borderEdge) {
+    if (s->kind[from] == KIND_LOCKED) return false;
+    if (s->kind[from] == KIND_BORDER) return borderEdge;
+    return true;
+}
+
+static void build_collapses(const Simplifier *s, std::vector<Collapse> *collapses) {
+    collapses->clear();
+    for (size_t i = 0; i < s->edges.size(); ++i) {
+        if (i > 0 && s->edges[i] == s->edges[i - 1]) continue;
+        uint32_t a = (uint32_t)(s->edges[i] >> 32), b = (uint32_t)s->edges[i];
+        bool border = !has_edge(s, b, a);
+        if (!border && a > b) continue;   // interior edges once
+
+        Collapse best = { 0.0f, 0, 0 };
+        bool found = false;
+        if (can_move(s, a, border)) {
+            best = { quadric_eval(s->quadrics[a], position(s, b)), a, b };
+            found = true;
+        }
+        if (can_move(s, b, border)) {
+            float cost = quadric_eval(s->quadrics[b], position(s, a));
+            if (!found || cost < best.cost) best = { cost, b, a };
+            found = true;
+        }
+        if (found) collapses->push_back(best);
+    }
+    std::sort(collapses->begin(), collapses->end(), [](const Collapse &x, const Collapse &y) { return x.cost < y.cost; });
+}
+
+size_t simplify_indices(uint32_t *dst, const uint32_t *indices, size_t indexCount,
+                        const float *vertices, size_t vertexCount, size_t strideFloats,
+                        size_t targetIndexCount, float maxError, float *resultError)
+{
+    Simplifier s;
+    s.vertices = vertices;
+    s.stride = strideFloats;
+    s.tris.assign(indices, indices + indexCount - indexCount % 3);
+    build_positions(&s, vertexCount);
+    drop_degenerate(&s);
+    build_topology(&s, vertexCount);
+    build_quadrics(&s, vertexCount);
+
+    const float maxCost = maxError * maxError;
+    float worst = 0.0f;
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> posRemap(vertexCount), vertRemap(vertexCount);
+    std::vector<uint8_t> touched(vertexCount);
+    std::vector<std::pair<uint32_t, uint32_t>> wedgeMap;   // copy at `from` -> copy at `to`
+
+    while (s.tris.size() > targetIndexCount) {
+        build_collapses(&s, &collapses);
+        std::iota(posRemap.begin(), posRemap.end(), 0u);
+        std::iota(vertRemap.begin(), vertRemap.end(), 0u);
+        std::fill(touched.begin(), touched.end(), 0);
+
+        // one collapse per position per pass, cheapest first
+        size_t triCount = s.tris.size() / 3;
+        size_t applied = 0;
+        for (const Collapse &c : collapses) {
+            if (triCount * 3 <= targetIndexCount || c.cost > maxCost) break;
+            if (touched[c.from] || touched[c.to]) continue;
+            const Vec3 target = position(&s, c.to);
+
+            bool ok = true;
+            size_t removed = 0;
+            wedgeMap.clear();
+            for (uint32_t i = s.adjStart[c.from]; i < s.adjStart[c.from + 1] && ok; ++i) {
+                const uint32_t *tri = &s.tris[3 * s.adjTris[i]];
+                uint32_t v[3], p[3];
+                for (int k = 0; k < 3; ++k) {
+                    v[k] = vertRemap[tri[k]];
+                    p[k] = posRemap[s.pos[tri[k]]];
+                }
+                if (p[0] == p[1] || p[1] == p[2] || p[2] == p[0]) continue;   // gone already
+
+                int at = p[0] == c.from ? 0 : p[1] == c.from ? 1 : 2;
+                int other = p[0] == c.to ? 0 : p[1] == c.to ? 1 : p[2] == c.to ? 2 : -1;
+                if (other >= 0) {
+                    // collapses away; tells which copy at `to` this copy lands on
+                    removed++;
+                    bool seen = false;
+                    for (auto &m : wedgeMap)
+                        if (m.first == v[at]) {
+                            seen = true;
+                            ok = m.second == v[other];
+                        }
+                    if (!seen) wedgeMap.push_back({ v[at], v[other] });
+                    continue;
+                }
+
+                Vec3 a = position(&s, p[0]), b = position(&s, p[1]), d = position(&s, p[2]);
+                Vec3 before = cross(sub(b, a), sub(d, a));
+                Vec3 *moved = at == 0 ? &a : at == 1 ? &b : &d;
+                *moved = target;
+                Vec3 after = cross(sub(b, a), sub(d, a));
+                float lb = std::sqrt(dot(before, before)), la = std::sqrt(dot(after, after));
+                ok = la > 0.0f && dot(before, after) >= FLIP_COS_LIMIT * lb * la;
+            }
+            if (!ok || removed == 0) continue;
+
+            // every copy in use must land on its own, similarly lit copy
+            for (uint32_t i = s.adjStart[c.from]; i < s.adjStart[c.from + 1] && ok; ++i) {
+                const uint32_t *tri = &s.tris[3 * s.adjTris[i]];
+                for (int k = 0; k < 3 && ok; ++k) {
+                    uint32_t w = vertRemap[tri[k]];
+                    if (posRemap[s.pos[tri[k]]] != c.from) continue;
+                    ok = std::any_of(wedgeMap.begin(), wedgeMap.end(), [w](const std::pair<uint32_t, uint32_t> &m) { return m.first == w; });
+                }
+            }
+            for (size_t i = 0; i < wedgeMap.size() && ok; ++i) {
+                for (size_t j = i + 1; j < wedgeMap.size(); ++j)
+                    if (wedgeMap[j].second == wedgeMap[i].second) ok = false;
+                // copies without a normal have no shading to keep
+                Vec3 n0 = normal(&s, wedgeMap[i].first), n1 = normal(&s, wedgeMap[i].second);
+                float d = dot(n0, n1);
+                ok = ok && (d >= NORMAL_COS_LIMIT * std::sqrt(dot(n0, n0) * dot(n1, n1)) || dot(n0, n0) == 0.0f || dot(n1, n1) == 0.0f);
+            }
+            if (!ok) continue;
+
+            posRemap[c.from] = c.to;
+            for (auto &m : wedgeMap)
+                vertRemap[m.first] = m.second;
+            quadric_add(&s.quadrics[c.to], s.quadrics[c.from]);
+            touched[c.from] = touched[c.to] = 1;
+            triCount -= removed;
+            worst = std::max(worst, c.cost);
+            applied++;
+        }
+        if (applied == 0) break;
+
+        for (uint32_t &v : s.tris)
+            v = vertRemap[v];
+        drop_degenerate(&s);
+        build_topology(&s, vertexCount);
+    }
+
+    std::copy(s.tris.begin(), s.tris.end(), dst);
+    if (resultError) *resultError = std::sqrt(worst);
+    return s.tris.size();
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Triangle list simplification by quadric error metric edge collapse
+// (Garland-Heckbert). Collapses move a vertex onto one of its neighbours, so
+// the result indexes the same vertex buffer and a LOD is just another index
+// range.
+//
+// Vertices sharing a position but not a normal are one point as far as
+// geometry goes; a collapse must carry every such copy onto a distinct copy
+// at the target, which keeps hard edges in place. Open boundaries only
+// collapse along themselves and add plane constraints so their outline
+// survives. Collapses that would flip a triangle are skipped.
+
+// Simplifies `indexCount` indices into `dst` (room for indexCount) aiming
+// for `targetIndexCount`, without any collapse costing more than `maxError`
+// (distance in model units). `vertices` holds px py pz nx ny nz at the start
+// of every `strideFloats` floats. Returns the new index count and the error
+// reached in `resultError`.
+size_t simplify_indices(uint32_t *dst, const uint32_t *indices, size_t indexCount,
+                        const float *vertices, size_t vertexCount, size_t strideFloats,
+                        size_t targetIndexCount, float maxError, float *resultError);
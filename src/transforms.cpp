@@ -0,0 +1,400 @@
+#include "transforms.h"
+#include "jobsystem.h"
+
+#include <algorithm>
+#include <memory>
+
+#include <glm/gtc/matrix_inverse.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/euler_angles.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define TRANSFORMS_SSE 1
+#endif
+
+// out = a * b, column major. `out` must not alias `a`.
+static inline void mat4_mul(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 *out) {
+#ifdef TRANSFORMS_SSE
+    __m128 a0 = _mm_loadu_ps(&a[0][0]);
+    __m128 a1 = _mm_loadu_ps(&a[1][0]);
+    __m128 a2 = _mm_loadu_ps(&a[2][0]);
+    __m128 a3 = _mm_loadu_ps(&a[3][0]);
+    for (int c = 0; c < 4; ++c) {
+        __m128 r = _mm_mul_ps(a0, _mm_set1_ps(b[c][0]));
+        r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(b[c][1])));
+        r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(b[c][2])));
+        r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(b[c][3])));
+        _mm_storeu_ps(&(*out)[c][0], r);
+    }
+#else
+    *out = a * b;
+#endif
+}
+
+// Local TRS matrix and its inverse transpose. R is orthonormal, so the
+// inverse transpose of R*S is R*S^-1 and no general inverse is needed.
+static inline void compose_local(const glm::vec3 &position, const glm::vec3 &rotation, const glm::vec3 &scale,
+                                 glm::mat4 *local, glm::mat3 *localNormal) {
+    glm::vec3 r = glm::radians(rotation);
+    glm::mat4 rot = glm::eulerAngleXYZ(r.x, r.y, r.z);
+    for (int c = 0; c < 3; ++c) {
+        (*local)[c] = rot[c] * scale[c];
+        float inv = scale[c] != 0.0f ? 1.0f / scale[c] : 0.0f;
+        (*localNormal)[c] = glm::vec3(rot[c]) * inv;
+    }
+    (*local)[3] = glm::vec4(position, 1.0f);
+}
+
+static uint32_t slot_of(const TransformHierarchy *h, NodeId node) {
+    return h->slotOf[node];
+}
+
+template <typename T>
+static void permute(std::vector<T> *v, const std::vector<uint32_t> &order) {
+    std::vector<T> out(order.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        out[i] = (*v)[order[i]];
+    v->swap(out);
+}
+
+// Rebuilds the pre-order layout from the parent links.
+static void relayout(TransformHierarchy *h) {
+    const uint32_t n = (uint32_t)h->parent.size();
+
+    // children of each slot, in slot order
+    std::vector<uint32_t> firstChild(n + 1, 0), children(n);
+    for (uint32_t s = 0; s < n; ++s)
+        if (h->parent[s] != NODE_NONE) firstChild[h->parent[s] + 1]++;
+    for (uint32_t s = 0; s < n; ++s)
+        firstChild[s + 1] += firstChild[s];
+    std::vector<uint32_t> fill(firstChild.begin(), firstChild.end() - 1);
+    for (uint32_t s = 0; s < n; ++s)
+        if (h->parent[s] != NODE_NONE) children[fill[h->parent[s]]++] = s;
+
+    // depth first from each root; the stack holds children in reverse so
+    // they come out in their original order
+    std::vector<uint32_t> order;
+    order.reserve(n);
+    std::vector<uint32_t> stack;
+    for (uint32_t root = 0; root < n; ++root) {
+        if (h->parent[root] != NODE_NONE) continue;
+        stack.push_back(root);
+        while (!stack.empty()) {
+            uint32_t s = stack.back();
+            stack.pop_back();
+            order.push_back(s);
+            for (uint32_t c = firstChild[s + 1]; c > firstChild[s]; --c)
+                stack.push_back(children[c - 1]);
+        }
+    }
+
+    std::vector<uint32_t> newSlot(n);
+    for (uint32_t i = 0; i < n; ++i)
+        newSlot[order[i]] = i;
+
+    std::vector<uint32_t> parent(n);
+    for (uint32_t i = 0; i < n; ++i) {
+        uint32_t p = h->parent[order[i]];
+        parent[i] = p == NODE_NONE ? NODE_NONE : newSlot[p];
+    }
+    h->parent.swap(parent);
+    permute(&h->node, order);
+    permute(&h->position, order);
+    permute(&h->rotation, order);
+    permute(&h->scale, order);
+    permute(&h->world, order);
+    permute(&h->normalMatrix, order);
+    permute(&h->dirty, order);
+    for (uint32_t i = 0; i < n; ++i)
+        h->slotOf[h->node[i]] = i;
+
+    // subtree sizes, children before parents
+    std::vector<uint32_t> size(n, 1);
+    for (uint32_t i = n; i-- > 0;)
+        if (h->parent[i] != NODE_NONE) size[h->parent[i]] += size[i];
+    for (uint32_t i = 0; i < n; ++i)
+        h->subtreeEnd[i] = i + size[i];
+
+    h->layoutDirty = false;
+}
+
+// Recomputes the slots [begin, end), a subtree or a run of sibling subtrees
+// whose parent is already up to date. Locals are composed in one
+// linear pass over the SoA inputs, then concatenated front to back; a
+// parent inside the range has already been written when its children are
+// reached.
+static void update_range(TransformHierarchy *h, uint32_t begin, uint32_t end, TransformScratch *scratch) {
+    const uint32_t count = end - begin;
+    if (scratch->local.size() < count) {
+        scratch->local.resize(count);
+        scratch->localNormal.resize(count);
+    }
+    glm::mat4 *local = scratch->local.data();
+    glm::mat3 *localNormal = scratch->localNormal.data();
+
+    const glm::vec3 *position = h->position.data() + begin;
+    const glm::vec3 *rotation = h->rotation.data() + begin;
+    const glm::vec3 *scale = h->scale.data() + begin;
+    for (uint32_t i = 0; i < count; ++i)
+        compose_local(position[i], rotation[i], scale[i], &local[i], &localNormal[i]);
+
+    const uint32_t *parent = h->parent.data();
+    glm::mat4 *world = h->world.data();
+    glm::mat3 *normal = h->normalMatrix.data();
+    for (uint32_t s = begin; s < end; ++s) {
+        uint32_t p = parent[s];
+        if (p == NODE_NONE) {
+            world[s] = local[s - begin];
+            normal[s] = localNormal[s - begin];
+        } else {
+            mat4_mul(world[p], local[s - begin], &world[s]);
+            normal[s] = normal[p] * localNormal[s - begin];
+        }
+        h->dirty[s] = 0;
+    }
+}
+
+void transforms_clear(TransformHierarchy *h)
+{
+    h->parent.clear();
+    h->subtreeEnd.clear();
+    h->node.clear();
+    h->position.clear();
+    h->rotation.clear();
+    h->scale.clear();
+    h->world.clear();
+    h->normalMatrix.clear();
+    h->dirty.clear();
+    h->slotOf.clear();
+    h->dirtyNodes.clear();
+    h->layoutDirty = false;
+    h->version++;
+}
+
+size_t transforms_count(const TransformHierarchy *h)
+{
+    return h->parent.size();
+}
+
+NodeId transforms_add(TransformHierarchy *h, NodeId parent,
+                      const glm::vec3 &position, const glm::vec3 &rotation, const glm::vec3 &scale)
+{
+    NodeId id = (NodeId)h->slotOf.size();
+    uint32_t slot = (uint32_t)h->parent.size();
+    uint32_t parentSlot = parent == NODE_NONE ? NODE_NONE : slot_of(h, parent);
+
+    h->parent.push_back(parentSlot);
+    h->subtreeEnd.push_back(slot + 1);
+    h->node.push_back(id);
+    h->position.push_back(position);
+    h->rotation.push_back(rotation);
+    h->scale.push_back(scale);
+    h->world.push_back(glm::mat4(1.0f));
+    h->normalMatrix.push_back(glm::mat3(1.0f));
+    h->dirty.push_back(0);
+    h->slotOf.push_back(slot);
+
+    // Still pre-order if the parent's subtree is the tail of the layout;
+    // then every ancestor's subtree ends at the tail too.
+    if (!h->layoutDirty && parentSlot != NODE_NONE) {
+        if (h->subtreeEnd[parentSlot] == slot) {
+            for (uint32_t p = parentSlot; p != NODE_NONE; p = h->parent[p])
+                h->subtreeEnd[p] = slot + 1;
+        } else {
+            h->layoutDirty = true;
+        }
+    }
+
+    transforms_mark_dirty(h, id);
+    return id;
+}
+
+bool transforms_set_parent(TransformHierarchy *h, NodeId node, NodeId parent)
+{
+    if (parent != NODE_NONE && transforms_is_ancestor(h, node, parent)) return false;
+    uint32_t slot = slot_of(h, node);
+    h->parent[slot] = parent == NODE_NONE ? NODE_NONE : slot_of(h, parent);
+    h->layoutDirty = true;
+    transforms_mark_dirty(h, node);
+    return true;
+}
+
+NodeId transforms_parent(const TransformHierarchy *h, NodeId node)
+{
+    uint32_t p = h->parent[slot_of(h, node)];
+    return p == NODE_NONE ? NODE_NONE : h->node[p];
+}
+
+bool transforms_is_ancestor(const TransformHierarchy *h, NodeId ancestor, NodeId node)
+{
+    uint32_t target = slot_of(h, ancestor);
+    for (uint32_t s = slot_of(h, node); s != NODE_NONE; s = h->parent[s])
+        if (s == target) return true;
+    return false;
+}
+
+const glm::vec3& transforms_position(const TransformHierarchy *h, NodeId node)
+{
+    return h->position[slot_of(h, node)];
+}
+
+const glm::vec3& transforms_rotation(const TransformHierarchy *h, NodeId node)
+{
+    return h->rotation[slot_of(h, node)];
+}
+
+const glm::vec3& transforms_scale(const TransformHierarchy *h, NodeId node)
+{
+    return h->scale[slot_of(h, node)];
+}
+
+void transforms_set_position(TransformHierarchy *h, NodeId node, const glm::vec3 &position)
+{
+    h->position[slot_of(h, node)] = position;
+    transforms_mark_dirty(h, node);
+}
+
+void transforms_set_rotation(TransformHierarchy *h, NodeId node, const glm::vec3 &rotation)
+{
+    h->rotation[slot_of(h, node)] = rotation;
+    transforms_mark_dirty(h, node);
+}
+
+void transforms_set_scale(TransformHierarchy *h, NodeId node, const glm::vec3 &scale)
+{
+    h->scale[slot_of(h, node)] = scale;
+    transforms_mark_dirty(h, node);
+}
+
+void transforms_mark_dirty(TransformHierarchy *h, NodeId node)
+{
+    uint8_t &d = h->dirty[slot_of(h, node)];
+    if (d) return;
+    d = 1;
+    h->dirtyNodes.push_back(node);
+}
+
+const glm::mat4& transforms_world(const TransformHierarchy *h, NodeId node)
+{
+    return h->world[slot_of(h, node)];
+}
+
+const glm::mat3& transforms_normal(const TransformHierarchy *h, NodeId node)
+{
+    return h->normalMatrix[slot_of(h, node)];
+}
+
+static const uint32_t PIECE_NODES = 1024;
+
+// Splits the dirty subtree [begin, end) into pieces of at most PIECE_NODES
+// slots, appended in layout order so a piece always follows its `after`.
+static void split_subtree(TransformHierarchy *h, uint32_t begin, uint32_t end, uint32_t after) {
+    if (end - begin <= PIECE_NODES) {
+        h->pieces.push_back({ begin, end, after });
+        return;
+    }
+    const uint32_t head = (uint32_t)h->pieces.size();
+    h->pieces.push_back({ begin, begin + 1, after });
+    // children: small ones are grouped, big ones split again
+    uint32_t group = begin + 1;
+    for (uint32_t c = begin + 1; c < end; c = h->subtreeEnd[c]) {
+        uint32_t cEnd = h->subtreeEnd[c];
+        if (cEnd - c > PIECE_NODES) {
+            if (group < c) h->pieces.push_back({ group, c, head });
+            split_subtree(h, c, cEnd, head);
+            group = cEnd;
+        } else if (cEnd - group > PIECE_NODES) {
+            if (group < c) h->pieces.push_back({ group, c, head });
+            group = c;
+        }
+    }
+    if (group < end) h->pieces.push_back({ group, end, head });
+}
+
+static void update_parallel(TransformHierarchy *h, JobSystem *jobs) {
+    // Consecutive pieces waiting on the same job are batched up to about
+    // PIECE_NODES, so a thousand small subtrees do not make a thousand jobs.
+    struct Batch { uint32_t first, last, after, nodes; };
+    std::vector<Batch> batches;
+    std::vector<uint32_t> batchOf(h->pieces.size());
+    for (uint32_t i = 0; i < (uint32_t)h->pieces.size(); ++i) {
+        const TransformPiece &p = h->pieces[i];
+        uint32_t after = p.after == NODE_NONE ? NODE_NONE : batchOf[p.after];
+        if (batches.empty() || batches.back().after != after || batches.back().nodes >= PIECE_NODES)
+            batches.push_back({ i, i, after, 0 });
+        batches.back().last = i + 1;
+        batches.back().nodes += p.end - p.begin;
+        batchOf[i] = (uint32_t)batches.size() - 1;
+    }
+
+    if (h->scratch.size() < (size_t)jobsystem_size(jobs)) h->scratch.resize(jobsystem_size(jobs));
+    std::unique_ptr<JobCounter[]> done(new JobCounter[batches.size()]);
+    for (const Batch &b : batches) {
+        jobsystem_run(jobs, [h, jobs, b] {
+            TransformScratch *scratch = &h->scratch[jobsystem_worker(jobs)];
+            for (uint32_t i = b.first; i < b.last; ++i)
+                update_range(h, h->pieces[i].begin, h->pieces[i].end, scratch);
+        }, &done[&b - batches.data()], b.after == NODE_NONE ? nullptr : &done[b.after]);
+    }
+    for (size_t i = 0; i < batches.size(); ++i)
+        jobsystem_wait(jobs, &done[i]);
+}
+
+TransformUpdateStats transforms_update(TransformHierarchy *h, JobSystem *jobs)
+{
+    TransformUpdateStats stats = {};
+    if (h->dirtyNodes.empty()) return stats;
+    if (h->layoutDirty) relayout(h);
+    h->version++;
+
+    // Dirty roots in layout order. A dirty node inside a subtree that is
+    // already being updated is covered by it.
+    h->dirtySlots.clear();
+    for (NodeId node : h->dirtyNodes)
+        h->dirtySlots.push_back(slot_of(h, node));
+    h->dirtyNodes.clear();
+    std::sort(h->dirtySlots.begin(), h->dirtySlots.end());
+
+    uint32_t covered = 0;
+    uint32_t roots = 0;
+    for (uint32_t s : h->dirtySlots) {
+        if (s < covered) continue;
+        covered = h->subtreeEnd[s];
+        h->dirtySlots[roots++] = s;
+        stats.subtrees++;
+        stats.nodes += covered - s;
+    }
+    h->dirtySlots.resize(roots);
+
+    if (h->scratch.empty()) h->scratch.resize(1);
+    if (!jobs || jobsystem_size(jobs) == 1 || stats.nodes < 2 * PIECE_NODES) {
+        for (uint32_t s : h->dirtySlots)
+            update_range(h, s, h->subtreeEnd[s], &h->scratch[0]);
+        return stats;
+    }
+
+    h->pieces.clear();
+    for (uint32_t s : h->dirtySlots)
+        split_subtree(h, s, h->subtreeEnd[s], NODE_NONE);
+    update_parallel(h, jobs);
+    return stats;
+}
+
+void transforms_update_all_reference(TransformHierarchy *h)
+{
+    if (h->layoutDirty) relayout(h);
+    h->version++;
+    for (size_t s = 0; s < h->parent.size(); ++s) {
+        glm::vec3 r = glm::radians(h->rotation[s]);
+        glm::mat4 local = glm::translate(glm::mat4(1.0f), h->position[s]) *
+                          glm::eulerAngleXYZ(r.x, r.y, r.z) *
+                          glm::scale(glm::mat4(1.0f), h->scale[s]);
+        uint32_t p = h->parent[s];
+        h->world[s] = p == NODE_NONE ? local : h->world[p] * local;
+        h->normalMatrix[s] = glm::inverseTranspose(glm::mat3(h->world[s]));
+        h->dirty[s] = 0;
+    }
+    h->dirtyNodes.clear();
+}
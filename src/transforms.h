@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Transform hierarchy stored structure-of-arrays. Nodes are addressed by a
+// stable NodeId; internally they live in slots laid out in depth-first
+// pre-order, so every parent precedes its children and each subtree is the
+// contiguous slot range [slot, subtreeEnd[slot]). An update walks only the
+// ranges below nodes whose local transform changed, front to back, reading
+// the parent's world matrix that was written earlier in the same pass.
+
+typedef uint32_t NodeId;
+const NodeId NODE_NONE = 0xffffffffu;
+
+struct JobSystem;
+
+struct TransformScratch
+{
+    std::vector<glm::mat4> local;
+    std::vector<glm::mat3> localNormal;
+};
+
+// Slots [begin, end) updated by one job of a parallel update: a whole
+// subtree, a run of sibling subtrees, or one node whose children were split
+// off. `after` is the piece that writes the parent of its first slot.
+struct TransformPiece
+{
+    uint32_t begin, end;
+    uint32_t after;   // piece index or NODE_NONE
+};
+
+struct TransformHierarchy
+{
+    // per slot
+    std::vector<uint32_t> parent;       // parent slot or NODE_NONE
+    std::vector<uint32_t> subtreeEnd;   // one past the last descendant
+    std::vector<NodeId> node;
+    std::vector<glm::vec3> position;    // local
+    std::vector<glm::vec3> rotation;    // local, euler degrees (XYZ)
+    std::vector<glm::vec3> scale;       // local
+    std::vector<glm::mat4> world;
+    std::vector<glm::mat3> normalMatrix;   // inverse transpose of the world 3x3
+    std::vector<uint8_t> dirty;         // local transform changed
+
+    // per NodeId
+    std::vector<uint32_t> slotOf;
+
+    std::vector<NodeId> dirtyNodes;     // nodes with dirty set
+    bool layoutDirty;                   // slots no longer in pre-order
+    uint64_t version = 0;               // changes with any world matrix
+
+    // update scratch, kept between calls
+    std::vector<uint32_t> dirtySlots;
+    std::vector<TransformScratch> scratch;   // one per worker
+    std::vector<TransformPiece> pieces;
+};
+
+struct TransformUpdateStats
+{
+    size_t subtrees;   // dirty subtrees walked
+    size_t nodes;      // world matrices recomputed
+};
+
+void transforms_clear(TransformHierarchy *h);
+
+size_t transforms_count(const TransformHierarchy *h);
+
+// Adds a node below `parent` (NODE_NONE for a root). Appending below the
+// most recently added subtree keeps the layout; anything else relayouts
+// lazily on the next update.
+NodeId transforms_add(TransformHierarchy *h, NodeId parent,
+                      const glm::vec3 &position, const glm::vec3 &rotation, const glm::vec3 &scale);
+
+// Moves `node` below `parent`, keeping its local transform. Returns false
+// if that would make the node its own ancestor.
+bool transforms_set_parent(TransformHierarchy *h, NodeId node, NodeId parent);
+
+NodeId transforms_parent(const TransformHierarchy *h, NodeId node);
+
+// True if `ancestor` is `node` or above it.
+bool transforms_is_ancestor(const TransformHierarchy *h, NodeId ancestor, NodeId node);
+
+// Local transform. The setters mark the node's subtree for update.
+const glm::vec3& transforms_position(const TransformHierarchy *h, NodeId node);
+const glm::vec3& transforms_rotation(const TransformHierarchy *h, NodeId node);
+const glm::vec3& transforms_scale(const TransformHierarchy *h, NodeId node);
+void transforms_set_position(TransformHierarchy *h, NodeId node, const glm::vec3 &position);
+void transforms_set_rotation(TransformHierarchy *h, NodeId node, const glm::vec3 &rotation);
+void transforms_set_scale(TransformHierarchy *h, NodeId node, const glm::vec3 &scale);
+
+void transforms_mark_dirty(TransformHierarchy *h, NodeId node);
+
+// Valid after transforms_update.
+const glm::mat4& transforms_world(const TransformHierarchy *h, NodeId node);
+const glm::mat3& transforms_normal(const TransformHierarchy *h, NodeId node);
+
+// Recomputes world and normal matrices of every dirty subtree. With a job
+// system and enough dirty nodes the subtrees are split into pieces of about
+// a thousand nodes: disjoint subtrees run in parallel, and a subtree too big
+// for one piece is cut below its root so that its child subtrees run in
+// parallel once the root is done. Results are the same as serially.
+TransformUpdateStats transforms_update(TransformHierarchy *h, JobSystem *jobs = nullptr);
+
+// The same composition, unvectorized and over every node. Reference for the
+// benchmark.
+void transforms_update_all_reference(TransformHierarchy *h);
@@ -0,0 +1,124 @@
+#include "vertexpack.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+static float sign_not_zero(float v) { return v >= 0.0f ? 1.0f : -1.0f; }
+
+// snorm16 as GL 4.2+ converts it; 3.3's (2c + 1) / 65535 differs by less
+// than the rounding step.
+static float snorm16(int16_t c) { return std::max((float)c / 32767.0f, -1.0f); }
+
+void vertexpack_oct_decode(const int16_t in[2], float out[3])
+{
+    float x = snorm16(in[0]), y = snorm16(in[1]);
+    float z = 1.0f - std::fabs(x) - std::fabs(y);
+    float t = std::max(-z, 0.0f);
+    x += x >= 0.0f ? -t : t;
+    y += y >= 0.0f ? -t : t;
+    float len = std::sqrt(x * x + y * y + z * z);
+    out[0] = x / len;
+    out[1] = y / len;
+    out[2] = z / len;
+}
+
+void vertexpack_oct_encode(const float n[3], int16_t out[2])
+{
+    // project onto the octahedron and fold the lower half over the upper
+    float l1 = std::fabs(n[0]) + std::fabs(n[1]) + std::fabs(n[2]);
+    float u = n[0] / l1, v = n[1] / l1;
+    if (n[2] < 0.0f) {
+        float fu = (1.0f - std::fabs(v)) * sign_not_zero(u);
+        float fv = (1.0f - std::fabs(u)) * sign_not_zero(v);
+        u = fu;
+        v = fv;
+    }
+
+    // rounding each component to nearest isn't always the closest normal
+    float bestDot = -2.0f;
+    for (int i = 0; i < 4; ++i) {
+        float cu = (i & 1) ? std::ceil(u * 32767.0f) : std::floor(u * 32767.0f);
+        float cv = (i & 2) ? std::ceil(v * 32767.0f) : std::floor(v * 32767.0f);
+        int16_t c[2] = { (int16_t)std::clamp(cu, -32767.0f, 32767.0f), (int16_t)std::clamp(cv, -32767.0f, 32767.0f) };
+        float d[3];
+        vertexpack_oct_decode(c, d);
+        float dot = d[0] * n[0] + d[1] * n[1] + d[2] * n[2];
+        if (dot > bestDot) {
+            bestDot = dot;
+            out[0] = c[0];
+            out[1] = c[1];
+        }
+    }
+}
+
+void vertexpack_position(const PackedVertex *v, const MeshBounds *bounds, float out[3])
+{
+    for (int k = 0; k < 3; ++k)
+        out[k] = bounds->min[k] + (float)v->position[k] / 65535.0f * (bounds->max[k] - bounds->min[k]);
+}
+
+bool vertexpack_pack(std::vector<PackedVertex> *out, const Mesh *mesh, VertexPackError *error)
+{
+    const size_t vertexCount = mesh_vertex_count(mesh);
+    const MeshBounds &b = mesh->bounds;
+    out->resize(vertexCount);
+    *error = VertexPackError{};
+
+    // shortest non-degenerate edge at each vertex, over every LOD
+    const float INF = std::numeric_limits<float>::infinity();
+    std::vector<float> shortest(vertexCount, INF);
+    const float *vertices = mesh->vertices.data();
+    for (size_t t = 0; t + 2 < mesh->indices.size(); t += 3) {
+        for (int e = 0; e < 3; ++e) {
+            uint32_t i0 = mesh->indices[t + e], i1 = mesh->indices[t + (e + 1) % 3];
+            const float *p0 = &vertices[(size_t)i0 * MESH_VERTEX_FLOATS];
+            const float *p1 = &vertices[(size_t)i1 * MESH_VERTEX_FLOATS];
+            float dx = p0[0] - p1[0], dy = p0[1] - p1[1], dz = p0[2] - p1[2];
+            float len = std::sqrt(dx * dx + dy * dy + dz * dz);
+            if (len <= 0.0f) continue;
+            shortest[i0] = std::min(shortest[i0], len);
+            shortest[i1] = std::min(shortest[i1], len);
+        }
+    }
+
+    for (size_t i = 0; i < vertexCount; ++i) {
+        const float *src = &vertices[i * MESH_VERTEX_FLOATS];
+        PackedVertex &dst = (*out)[i];
+
+        for (int k = 0; k < 3; ++k) {
+            float extent = b.max[k] - b.min[k];
+            float q = extent > 0.0f ? (src[k] - b.min[k]) / extent * 65535.0f : 0.0f;
+            dst.position[k] = (uint16_t)std::clamp(q + 0.5f, 0.0f, 65535.0f);
+        }
+        dst.position[3] = 0;
+
+        float p[3];
+        vertexpack_position(&dst, &b, p);
+        float dx = p[0] - src[0], dy = p[1] - src[1], dz = p[2] - src[2];
+        float moved = std::sqrt(dx * dx + dy * dy + dz * dz);
+        error->position = std::max(error->position, moved);
+        if (shortest[i] < INF)
+            error->positionRatio = std::max(error->positionRatio, moved / shortest[i]);
+
+        const float *n = src + 3;
+        float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (len <= 0.0f) {
+            dst.normal[0] = dst.normal[1] = 0;   // decodes to +Z
+            continue;
+        }
+        float unit[3] = { n[0] / len, n[1] / len, n[2] / len };
+        vertexpack_oct_encode(unit, dst.normal);
+        float d[3];
+        vertexpack_oct_decode(dst.normal, d);
+        // atan2 of sine and cosine stays accurate for tiny angles, acos doesn't
+        float cx = d[1] * unit[2] - d[2] * unit[1];
+        float cy = d[2] * unit[0] - d[0] * unit[2];
+        float cz = d[0] * unit[1] - d[1] * unit[0];
+        float angle = std::atan2(std::sqrt(cx * cx + cy * cy + cz * cz), d[0] * unit[0] + d[1] * unit[1] + d[2] * unit[2]);
+        error->normalDegrees = std::max(error->normalDegrees, angle * 57.2957795f);
+    }
+
+    return error->positionRatio <= VERTEXPACK_EDGE_TOLERANCE &&
+           error->normalDegrees <= VERTEXPACK_MAX_NORMAL_DEGREES;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+
+// Packed vertex format, 12 bytes instead of the 24 of px py pz nx ny nz.
+//
+// Positions are unorm16 over the mesh's bounding box; the box is folded into
+// the model matrix at draw time, so the shader only sees a normalized
+// position. The fourth component is always 0 and tells the shader the
+// vertex is packed: float meshes supply three components and GL fills w
+// with 1. Normals are octahedral, two snorm16 components, decoded in the
+// vertex shader (vertex_decode.glsl).
+//
+// A mesh is only packed when the error stays bounded: no vertex may move by
+// more than VERTEXPACK_EDGE_TOLERANCE of its shortest edge, so small
+// features relative to the box keep the float format, and no normal may
+// turn by more than VERTEXPACK_MAX_NORMAL_DEGREES. Missing (zero) normals
+// have no direction to keep; they are encoded as +Z and left out of the
+// normal error.
+
+struct PackedVertex
+{
+    uint16_t position[4];   // x y z over the bounds, 0
+    int16_t normal[2];      // octahedral
+};
+
+const float VERTEXPACK_EDGE_TOLERANCE = 0.125f;
+const float VERTEXPACK_MAX_NORMAL_DEGREES = 0.1f;
+
+// Measured against the float vertices, also when packing is rejected.
+struct VertexPackError
+{
+    float position;        // largest displacement, model units
+    float positionRatio;   // largest displacement over the vertex's shortest edge
+    float normalDegrees;   // largest normal deviation, zero normals aside
+};
+
+// Nearest of the four roundings of the octahedral projection of unit `n`.
+void vertexpack_oct_encode(const float n[3], int16_t out[2]);
+
+void vertexpack_oct_decode(const int16_t in[2], float out[3]);
+
+// Packs the vertices of `mesh`, which needs its bounds. Returns false, with
+// `out` filled anyway, when the error bounds above are exceeded.
+bool vertexpack_pack(std::vector<PackedVertex> *out, const Mesh *mesh, VertexPackError *error);
+
+// Model space position of a packed vertex, as the GPU computes it.
+void vertexpack_position(const PackedVertex *v, const MeshBounds *bounds, float out[3]);
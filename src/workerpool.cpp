@@ -0,0 +1,61 @@
+#include "workerpool.h"
+
+#include <algorithm>
+
+static void worker_main(WorkerPool *pool, int index) {
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(pool->mutex);
+            pool->wake.wait(lock, [&] { return pool->stopping || pool->generation != seen; });
+            if (pool->stopping) return;
+            seen = pool->generation;
+        }
+        pool->job(index);
+        {
+            std::lock_guard<std::mutex> lock(pool->mutex);
+            if (--pool->remaining == 0) pool->done.notify_one();
+        }
+    }
+}
+
+void workerpool_start(WorkerPool *pool, int threadCount, int maxDefault)
+{
+    if (threadCount <= 0)
+        threadCount = std::min(maxDefault, std::max(1, (int)std::thread::hardware_concurrency() - 1));
+    pool->generation = 0;
+    pool->remaining = 0;
+    pool->stopping = false;
+    for (int i = 1; i < threadCount; ++i)
+        pool->threads.emplace_back(worker_main, pool, i);
+}
+
+void workerpool_stop(WorkerPool *pool)
+{
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->stopping = true;
+    }
+    pool->wake.notify_all();
+    for (std::thread &t : pool->threads)
+        t.join();
+    pool->threads.clear();
+}
+
+void workerpool_run(WorkerPool *pool, std::function<void(int)> job)
+{
+    if (pool->threads.empty()) {
+        job(0);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->job = std::move(job);
+        pool->remaining = (int)pool->threads.size();
+        pool->generation++;
+    }
+    pool->wake.notify_all();
+    pool->job(0);
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    pool->done.wait(lock, [&] { return pool->remaining == 0; });
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A small fixed pool for fork-join passes: workerpool_run hands the same job
+// to every thread with its index and returns when all of them are done.
+// The calling thread is worker 0, so a pool of one has no threads at all.
+
+struct WorkerPool
+{
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::function<void(int)> job;
+    uint64_t generation;
+    int remaining;
+    bool stopping;
+};
+
+// threadCount <= 0 picks one per core, up to `maxDefault`.
+void workerpool_start(WorkerPool *pool, int threadCount, int maxDefault = 4);
+
+void workerpool_stop(WorkerPool *pool);
+
+// Workers including the caller.
+inline int workerpool_size(const WorkerPool *pool) { return (int)pool->threads.size() + 1; }
+
+// Runs job(i) for every worker index i, the caller taking index 0.
+void workerpool_run(WorkerPool *pool, std::function<void(int)> job);